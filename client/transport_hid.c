@@ -0,0 +1,143 @@
+// Ledger USB HID transport. APDUs are split into 64 byte reports, each
+// starting with the channel (0x0101), the APDU tag (0x05) and a sequence
+// number, all big-endian. The first report of an APDU also carries its
+// length.
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zil_transport.h"
+
+#ifdef ZIL_HAVE_HIDAPI
+
+#include <hidapi.h>
+
+#define LEDGER_VENDOR_ID  0x2C97
+#define LEDGER_USAGE_PAGE 0xFFA0
+
+#define HID_PACKET_SIZE 64
+#define HID_CHANNEL     0x0101
+#define HID_TAG_APDU    0x05
+
+typedef struct {
+    zil_transport_t base;
+    hid_device *dev;
+} hid_transport_t;
+
+static int hid_send(zil_transport_t *t, const uint8_t *apdu, size_t len) {
+    hid_transport_t *hid = (hid_transport_t *)t;
+    size_t offset = 0;
+    uint16_t seq = 0;
+    do {
+        // Report ID 0 goes in front of every report.
+        uint8_t packet[1 + HID_PACKET_SIZE] = { 0 };
+        uint8_t *p = packet + 1;
+        *p++ = HID_CHANNEL >> 8;
+        *p++ = HID_CHANNEL & 0xFF;
+        *p++ = HID_TAG_APDU;
+        *p++ = seq >> 8;
+        *p++ = seq & 0xFF;
+        if (seq == 0) {
+            *p++ = (uint8_t)(len >> 8);
+            *p++ = (uint8_t)len;
+        }
+        size_t room = (size_t)(packet + sizeof(packet) - p);
+        size_t n = len - offset < room ? len - offset : room;
+        memcpy(p, apdu + offset, n);
+        offset += n;
+        seq++;
+        if (hid_write(hid->dev, packet, sizeof(packet)) < 0) {
+            return ZIL_ERR_IO;
+        }
+    } while (offset < len);
+    return 0;
+}
+
+static int hid_recv(zil_transport_t *t, uint8_t resp[ZIL_RESPONSE_MAX], size_t *len) {
+    hid_transport_t *hid = (hid_transport_t *)t;
+    size_t total = 0, offset = 0;
+    uint16_t seq = 0;
+    do {
+        uint8_t packet[HID_PACKET_SIZE];
+        if (hid_read_timeout(hid->dev, packet, sizeof(packet), -1) != sizeof(packet)) {
+            return ZIL_ERR_IO;
+        }
+        const uint8_t *p = packet;
+        if (((p[0] << 8) | p[1]) != HID_CHANNEL || p[2] != HID_TAG_APDU ||
+            ((p[3] << 8) | p[4]) != seq) {
+            return ZIL_ERR_PROTOCOL;
+        }
+        p += 5;
+        if (seq == 0) {
+            total = (p[0] << 8) | p[1];
+            p += 2;
+            if (total < 2 || total > ZIL_RESPONSE_MAX) {
+                return ZIL_ERR_PROTOCOL;
+            }
+        }
+        size_t room = (size_t)(packet + sizeof(packet) - p);
+        size_t n = total - offset < room ? total - offset : room;
+        memcpy(resp + offset, p, n);
+        offset += n;
+        seq++;
+    } while (offset < total);
+    *len = total;
+    return 0;
+}
+
+static void hid_transport_close(zil_transport_t *t) {
+    hid_transport_t *hid = (hid_transport_t *)t;
+    hid_close(hid->dev);
+    free(hid);
+    hid_exit();
+}
+
+zil_transport_t *zil_transport_hid_open(const char *path) {
+    if (hid_init() != 0) {
+        return NULL;
+    }
+    hid_device *dev = NULL;
+    if (path != NULL) {
+        dev = hid_open_path(path);
+    } else {
+        struct hid_device_info *devs = hid_enumerate(LEDGER_VENDOR_ID, 0);
+        for (struct hid_device_info *d = devs; d != NULL && dev == NULL; d = d->next) {
+            // The APDU interface is interface 0; macOS only reports the
+            // usage page.
+            if (d->interface_number == 0 || d->usage_page == LEDGER_USAGE_PAGE) {
+                dev = hid_open_path(d->path);
+            }
+        }
+        hid_free_enumeration(devs);
+    }
+    if (dev == NULL) {
+        hid_exit();
+        return NULL;
+    }
+
+    hid_transport_t *hid = calloc(1, sizeof(*hid));
+    if (hid == NULL) {
+        hid_close(dev);
+        hid_exit();
+        return NULL;
+    }
+    hid->base.send = hid_send;
+    hid->base.recv = hid_recv;
+    hid->base.close = hid_transport_close;
+    // The USB stack does not queue a second APDU while the app is busy with
+    // the first one.
+    hid->base.max_inflight = 1;
+    hid->dev = dev;
+    return &hid->base;
+}
+
+#else
+
+zil_transport_t *zil_transport_hid_open(const char *path) {
+    (void)path;
+    errno = ENOTSUP;
+    return NULL;
+}
+
+#endif
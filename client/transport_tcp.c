@@ -0,0 +1,132 @@
+// Speculos APDU port. Each command is sent as a 4 byte big-endian length
+// followed by the APDU. Each response is a 4 byte big-endian length that
+// does not count the status word, the data, then the two status word bytes.
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "zil_transport.h"
+
+typedef struct {
+    zil_transport_t base;
+    int fd;
+} tcp_transport_t;
+
+static int write_all(int fd, const uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return ZIL_ERR_IO;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int read_all(int fd, uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = recv(fd, buf, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return ZIL_ERR_IO;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int tcp_send(zil_transport_t *t, const uint8_t *apdu, size_t len) {
+    tcp_transport_t *tcp = (tcp_transport_t *)t;
+    uint8_t hdr[4] = { 0, 0, (uint8_t)(len >> 8), (uint8_t)len };
+    // One write per frame so that Nagle does not hold the APDU back.
+    uint8_t buf[4 + 5 + 255];
+    if (len > sizeof(buf) - sizeof(hdr)) {
+        return ZIL_ERR_ARG;
+    }
+    memcpy(buf, hdr, sizeof(hdr));
+    memcpy(buf + sizeof(hdr), apdu, len);
+    return write_all(tcp->fd, buf, sizeof(hdr) + len);
+}
+
+static int tcp_recv(zil_transport_t *t, uint8_t resp[ZIL_RESPONSE_MAX], size_t *len) {
+    tcp_transport_t *tcp = (tcp_transport_t *)t;
+    uint8_t hdr[4];
+    if (read_all(tcp->fd, hdr, sizeof(hdr)) != 0) {
+        return ZIL_ERR_IO;
+    }
+    uint32_t data_len = ((uint32_t)hdr[0] << 24) | ((uint32_t)hdr[1] << 16) |
+                        ((uint32_t)hdr[2] << 8) | hdr[3];
+    if (data_len > ZIL_RESPONSE_MAX - 2) {
+        return ZIL_ERR_PROTOCOL;
+    }
+    if (read_all(tcp->fd, resp, data_len + 2) != 0) {
+        return ZIL_ERR_IO;
+    }
+    *len = data_len + 2;
+    return 0;
+}
+
+static void tcp_close(zil_transport_t *t) {
+    tcp_transport_t *tcp = (tcp_transport_t *)t;
+    close(tcp->fd);
+    free(tcp);
+}
+
+zil_transport_t *zil_transport_tcp_open(const char *host, int port) {
+    char service[8];
+    snprintf(service, sizeof(service), "%d", port);
+    struct addrinfo hints = { 0 };
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *res;
+    if (getaddrinfo(host, service, &hints, &res) != 0) {
+        return NULL;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai != NULL; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0) {
+        return NULL;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    tcp_transport_t *tcp = calloc(1, sizeof(*tcp));
+    if (tcp == NULL) {
+        close(fd);
+        return NULL;
+    }
+    tcp->base.send = tcp_send;
+    tcp->base.recv = tcp_recv;
+    tcp->base.close = tcp_close;
+    // Speculos queues the next command until the app asks for it, so one
+    // chunk can travel while the previous one is being decoded.
+    tcp->base.max_inflight = 2;
+    tcp->fd = fd;
+    return &tcp->base;
+}
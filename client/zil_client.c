@@ -0,0 +1,318 @@
+#include <string.h>
+
+#include "zil_client.h"
+
+#define OFFSET_CLA   0
+#define OFFSET_INS   1
+#define OFFSET_P1    2
+#define OFFSET_P2    3
+#define OFFSET_LC    4
+#define OFFSET_CDATA 5
+
+static void put_u32le(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+void zil_client_init(zil_client_t *c, zil_transport_t *t) {
+    memset(c, 0, sizeof(*c));
+    c->transport = t;
+    c->chunk_len = ZIL_TXN_CHUNK_MAX;
+    c->window = t->max_inflight;
+}
+
+// Send the command in c->frame, whose data is already in place.
+static int send_frame(zil_client_t *c, uint8_t ins, uint8_t p1, uint8_t p2, size_t lc) {
+    c->frame[OFFSET_CLA] = ZIL_CLA;
+    c->frame[OFFSET_INS] = ins;
+    c->frame[OFFSET_P1] = p1;
+    c->frame[OFFSET_P2] = p2;
+    c->frame[OFFSET_LC] = (uint8_t)lc;
+    return c->transport->send(c->transport, c->frame, OFFSET_CDATA + lc);
+}
+
+// Read the next response into c->resp and strip its status word.
+static int recv_response(zil_client_t *c) {
+    size_t len = 0;
+    int status = c->transport->recv(c->transport, c->resp, &len);
+    if (status != 0) {
+        return status;
+    }
+    if (len < 2) {
+        return ZIL_ERR_PROTOCOL;
+    }
+    c->resp_len = len - 2;
+    unsigned sw = (c->resp[len - 2] << 8) | c->resp[len - 1];
+    return sw == ZIL_SW_OK ? 0 : (int)sw;
+}
+
+static int exchange(zil_client_t *c, uint8_t ins, uint8_t p1, uint8_t p2, size_t lc) {
+    int status = send_frame(c, ins, p1, p2, lc);
+    if (status != 0) {
+        return status;
+    }
+    return recv_response(c);
+}
+
+// Non-final INS_SIGN_TXN chunks are answered with a bare 0x9000.
+static int recv_ack(zil_client_t *c) {
+    int status = recv_response(c);
+    if (status == 0 && c->resp_len != 0) {
+        return ZIL_ERR_PROTOCOL;
+    }
+    return status;
+}
+
+int zil_get_version(zil_client_t *c, uint8_t version[3]) {
+    int status = exchange(c, ZIL_INS_GET_VERSION, 0, 0, 0);
+    if (status != 0) {
+        return status;
+    }
+    if (c->resp_len != 3) {
+        return ZIL_ERR_PROTOCOL;
+    }
+    memcpy(version, c->resp, 3);
+    return 0;
+}
+
+int zil_get_transport(zil_client_t *c, zil_link_t *link) {
+    int status = exchange(c, ZIL_INS_GET_TRANSPORT, 0, 0, 0);
+    if (status != 0) {
+        return status;
+    }
+    // response = media (1) || segment (2) || first header (1) || next header (1)
+    //            || wrapper (1) || max data (2), little-endian
+    if (c->resp_len != 8) {
+        return ZIL_ERR_PROTOCOL;
+    }
+    link->media = c->resp[0];
+    link->segment = c->resp[1] | (c->resp[2] << 8);
+    link->first_header = c->resp[3];
+    link->next_header = c->resp[4];
+    link->wrapper = c->resp[5];
+    link->max_data = c->resp[6] | (c->resp[7] << 8);
+    return 0;
+}
+
+// Segments an APDU of len bytes takes on link.
+static size_t link_segments(const zil_link_t *link, size_t len) {
+    size_t first = link->segment - link->first_header;
+    size_t next = link->segment - link->next_header;
+    len += link->wrapper;
+    return len <= first ? 1 : 1 + (len - first + next - 1) / next;
+}
+
+size_t zil_link_chunk_len(const zil_link_t *link, size_t key_len, uint8_t p1) {
+    // hostBytesLeft, txnLen, and the offset and checksum if asked for.
+    size_t header = 8 + ((p1 & ZIL_SIGN_TXN_OFFSETS) ? 4 : 0) + ((p1 & ZIL_SIGN_TXN_CHECKSUM) ? 4 : 0);
+    // The first frame, with the key in front.
+    size_t max_data = ZIL_DATA_MAX;
+    if (link->max_data > key_len + header && link->max_data < max_data) {
+        max_data = link->max_data;
+    }
+    size_t max = max_data - key_len - header;
+    if (max > ZIL_TXN_CHUNK_MAX) {
+        max = ZIL_TXN_CHUNK_MAX;
+    }
+    if (link->segment <= link->first_header || link->segment <= link->next_header) {
+        return max;
+    }
+    // Sized for the continuation frames.
+    size_t best = max;
+    size_t best_cost = link_segments(link, OFFSET_CDATA + header + best) + 1;
+    for (size_t n = max - 1; n > 0; n--) {
+        size_t cost = link_segments(link, OFFSET_CDATA + header + n) + 1;
+        if (n * best_cost > best * cost) {
+            best = n;
+            best_cost = cost;
+        }
+    }
+    return best;
+}
+
+int zil_get_public_key(zil_client_t *c, uint32_t index, uint8_t display,
+                       uint8_t pubkey[ZIL_PUBKEY_LEN], char address[ZIL_ADDRSTR_LEN + 1]) {
+    put_u32le(c->frame + OFFSET_CDATA, index);
+    int status = exchange(c, ZIL_INS_GET_PUBLIC_KEY, 0, display, 4);
+    if (status != 0) {
+        return status;
+    }
+    // response = public_key (33) || address (42)
+    if (c->resp_len != ZIL_PUBKEY_LEN + ZIL_ADDRSTR_LEN) {
+        return ZIL_ERR_PROTOCOL;
+    }
+    memcpy(pubkey, c->resp, ZIL_PUBKEY_LEN);
+    memcpy(address, c->resp + ZIL_PUBKEY_LEN, ZIL_ADDRSTR_LEN);
+    address[ZIL_ADDRSTR_LEN] = '\0';
+    return 0;
+}
+
+int zil_sign_hash(zil_client_t *c, uint32_t index, const uint8_t hash[ZIL_HASH_LEN],
+                  uint8_t sig[ZIL_SIG_LEN]) {
+    put_u32le(c->frame + OFFSET_CDATA, index);
+    memcpy(c->frame + OFFSET_CDATA + 4, hash, ZIL_HASH_LEN);
+    int status = exchange(c, ZIL_INS_SIGN_HASH, 0, 0, 4 + ZIL_HASH_LEN);
+    if (status != 0) {
+        return status;
+    }
+    if (c->resp_len != ZIL_SIG_LEN) {
+        return ZIL_ERR_PROTOCOL;
+    }
+    memcpy(sig, c->resp, ZIL_SIG_LEN);
+    return 0;
+}
+
+// Read the acks of chunks still in flight. Only the first failure is kept.
+static int drain(zil_client_t *c, unsigned *inflight, int status) {
+    while (*inflight > 0) {
+        int s = recv_ack(c);
+        (*inflight)--;
+        if (status == 0) {
+            status = s;
+        }
+        if (s < 0) {
+            // The transport is gone, there is nothing left to read.
+            *inflight = 0;
+        }
+    }
+    return status;
+}
+
+int zil_sign_txn_cb(zil_client_t *c, uint32_t index, size_t txn_len,
+                    zil_txn_reader_t read, zil_review_cb_t on_review, void *arg,
+                    uint8_t sig[ZIL_SIG_LEN]) {
+    if (read == NULL || txn_len == 0 || txn_len > ZIL_TXN_MAX_SIZE ||
+        c->chunk_len == 0 || c->chunk_len > ZIL_TXN_CHUNK_MAX) {
+        return ZIL_ERR_ARG;
+    }
+    unsigned window = c->window;
+    if (window == 0 || window > c->transport->max_inflight) {
+        window = c->transport->max_inflight;
+    }
+
+    // The device reads the next chunk as soon as it has acked the previous
+    // one, so up to window chunks can be on their way while we build the
+    // next. The final chunk starts the review and is only sent once every
+    // earlier chunk has been acked, so that errors show up before the user is
+    // asked anything.
+    size_t sent = 0;
+    unsigned inflight = 0;
+    int status = 0;
+    while (sent < txn_len) {
+        size_t n = txn_len - sent < c->chunk_len ? txn_len - sent : c->chunk_len;
+        bool last = (sent + n == txn_len);
+
+        uint8_t *p = c->frame + OFFSET_CDATA;
+        if (sent == 0) {
+            put_u32le(p, index);
+            p += 4;
+        }
+        put_u32le(p, (uint32_t)(txn_len - sent - n)); // hostBytesLeft
+        put_u32le(p + 4, (uint32_t)n);                // txnLen
+        p += 8;
+        if (!read(arg, p, n)) {
+            status = drain(c, &inflight, ZIL_ERR_SOURCE);
+            if (status == ZIL_ERR_SOURCE && sent > 0) {
+                // The device is waiting for more data. A continuation frame
+                // that is too short makes it give up on this transaction.
+                if (send_frame(c, ZIL_INS_SIGN_TXN, 0, 0, 0) == 0) {
+                    recv_response(c);
+                }
+            }
+            return status;
+        }
+        size_t lc = (size_t)(p + n - (c->frame + OFFSET_CDATA));
+
+        if (last) {
+            status = drain(c, &inflight, 0);
+            if (status != 0) {
+                return status;
+            }
+        }
+        status = send_frame(c, ZIL_INS_SIGN_TXN, 0, 0, lc);
+        if (status != 0) {
+            return drain(c, &inflight, status);
+        }
+        sent += n;
+
+        if (!last && ++inflight == window) {
+            status = recv_ack(c);
+            inflight--;
+            if (status != 0) {
+                return drain(c, &inflight, status);
+            }
+        }
+    }
+
+    if (on_review) {
+        on_review(arg);
+    }
+    status = recv_response(c);
+    if (status != 0) {
+        return status;
+    }
+    if (c->resp_len != ZIL_SIG_LEN) {
+        return ZIL_ERR_PROTOCOL;
+    }
+    memcpy(sig, c->resp, ZIL_SIG_LEN);
+    return 0;
+}
+
+typedef struct {
+    const uint8_t *next;
+} mem_reader_t;
+
+static bool read_mem(void *arg, uint8_t *buf, size_t len) {
+    mem_reader_t *r = arg;
+    memcpy(buf, r->next, len);
+    r->next += len;
+    return true;
+}
+
+int zil_sign_txn(zil_client_t *c, uint32_t index, const uint8_t *txn, size_t txn_len,
+                 uint8_t sig[ZIL_SIG_LEN]) {
+    if (txn == NULL) {
+        return ZIL_ERR_ARG;
+    }
+    mem_reader_t r = { txn };
+    return zil_sign_txn_cb(c, index, txn_len, read_mem, NULL, &r, sig);
+}
+
+const char *zil_strerror(int status) {
+    switch (status) {
+    case 0:
+        return "success";
+    case ZIL_ERR_IO:
+        return "transport error";
+    case ZIL_ERR_PROTOCOL:
+        return "unexpected response from the device";
+    case ZIL_ERR_ARG:
+        return "invalid argument";
+    case ZIL_ERR_SOURCE:
+        return "transaction data unavailable";
+    case ZIL_SW_USER_REJECTED:
+        return "rejected by the user";
+    case 0x6A87:
+        return "wrong data length";
+    case 0x6801:
+        return "request failed on the device";
+    case 0x6B00:
+        return "internal error on the device";
+    case 0x6B01:
+        return "invalid parameter";
+    case 0x6B02:
+        return "improper initialization";
+    case 0x6B03:
+        return "transaction chunk out of sequence";
+    case ZIL_SW_SIGN_RETRY:
+        return "signing failed, send the transaction again";
+    case 0x6D00:
+        return "instruction not supported";
+    case 0x6E00:
+        return "class not supported";
+    default:
+        return "device error";
+    }
+}
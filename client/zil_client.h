@@ -0,0 +1,126 @@
+#ifndef ZIL_CLIENT_H
+#define ZIL_CLIENT_H
+
+// Host-side client for the Zilliqa Ledger app. This speaks the same APDU
+// protocol as tests/functional/apps/zilliqa.py, without needing Python.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "zil_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ZIL_CLA 0xE0
+
+#define ZIL_INS_GET_VERSION    0x01
+#define ZIL_INS_GET_PUBLIC_KEY 0x02
+#define ZIL_INS_SIGN_TXN       0x04
+#define ZIL_INS_SIGN_HASH      0x08
+#define ZIL_INS_GET_TRANSPORT  0x10
+
+#define ZIL_P2_DISPLAY_PUBKEY  0x00
+#define ZIL_P2_DISPLAY_ADDRESS 0x01
+#define ZIL_P2_DISPLAY_NONE    0x02
+
+#define ZIL_SW_OK              0x9000
+#define ZIL_SW_USER_REJECTED   0x6985
+// r or s came out as 0 (probability 2^-256): stream the transaction again.
+#define ZIL_SW_SIGN_RETRY      0x6B04
+
+#define ZIL_PUBKEY_LEN   33
+#define ZIL_ADDRSTR_LEN  42
+#define ZIL_HASH_LEN     32
+#define ZIL_SIG_LEN      64
+
+// Transaction bytes per INS_SIGN_TXN frame. The first frame carries a 12 byte
+// header and later ones an 8 byte header, and Lc is a single byte, so 243
+// bytes fit in every frame.
+#define ZIL_TXN_CHUNK_MAX 243
+// Largest command data (Lc) of the app on USB, BLE or NFC.
+#define ZIL_DATA_MAX      255
+// Bytes of the key in the first frame: a key index, or a BIP32 path of n
+// components, 1 + 4 * n bytes.
+#define ZIL_KEY_INDEX_LEN 4
+// P1 of the first INS_SIGN_TXN frame: the fields every frame then carries,
+// 4 bytes each (see src/stream.h).
+#define ZIL_SIGN_TXN_OFFSETS  0x04
+#define ZIL_SIGN_TXN_CHECKSUM 0x08
+// Must match the app's ZIL_MAX_TXN_SIZE.
+#define ZIL_TXN_MAX_SIZE  8388608
+
+typedef struct {
+    zil_transport_t *transport;
+    // Transaction bytes per frame, 1..ZIL_TXN_CHUNK_MAX.
+    size_t chunk_len;
+    // Non-final chunks kept in flight, 1..transport->max_inflight.
+    unsigned window;
+    // Every command is built in place here, one at a time.
+    uint8_t frame[5 + 255];
+    uint8_t resp[ZIL_RESPONSE_MAX];
+    size_t resp_len;
+} zil_client_t;
+
+// Prepare a client for t with the largest chunk size and as much pipelining
+// as the transport allows.
+void zil_client_init(zil_client_t *c, zil_transport_t *t);
+
+int zil_get_version(zil_client_t *c, uint8_t version[3]);
+
+// How APDUs travel on the link the device is reached through.
+typedef struct {
+    uint8_t media;        // G_io_apdu_media of the device: 1 USB HID, 2 BLE, 7 U2F...
+    uint16_t segment;     // Bytes per transport segment, 0 if the device does not know.
+    uint8_t first_header; // Framing bytes in the first segment of an APDU,
+    uint8_t next_header;  // and in the next ones.
+    uint8_t wrapper;      // Bytes sent in front of the APDU, e.g. by U2F.
+    uint16_t max_data;    // Largest command data (Lc) the device takes on the link.
+} zil_link_t;
+
+int zil_get_transport(zil_client_t *c, zil_link_t *link);
+
+// Transaction bytes per frame that carry the most data per segment on link,
+// counting one more segment for every acknowledgement: a chunk a few bytes
+// short of ZIL_TXN_CHUNK_MAX may save a whole BLE connection interval. The
+// first frame, with its key_len bytes of key and the fields asked for by
+// p1, stays within max_data.
+size_t zil_link_chunk_len(const zil_link_t *link, size_t key_len, uint8_t p1);
+
+// display is one of ZIL_P2_DISPLAY_*. With anything but ZIL_P2_DISPLAY_NONE
+// the call blocks until the user approves on the device. address receives
+// the NUL-terminated bech32 address.
+int zil_get_public_key(zil_client_t *c, uint32_t index, uint8_t display,
+                       uint8_t pubkey[ZIL_PUBKEY_LEN], char address[ZIL_ADDRSTR_LEN + 1]);
+
+int zil_sign_hash(zil_client_t *c, uint32_t index, const uint8_t hash[ZIL_HASH_LEN],
+                  uint8_t sig[ZIL_SIG_LEN]);
+
+// Fill buf with exactly len more bytes of the transaction. Return false if
+// the data is not available; signing is then abandoned with ZIL_ERR_SOURCE.
+typedef bool (*zil_txn_reader_t)(void *arg, uint8_t *buf, size_t len);
+// Called once the last chunk is sent, while the device shows the review.
+typedef void (*zil_review_cb_t)(void *arg);
+
+// Stream a serialized ProtoTransactionCoreInfo of txn_len bytes to the device
+// and return its signature. read writes each chunk straight into the frame
+// buffer, so the transaction never has to be held in memory at once.
+// on_review may be NULL.
+int zil_sign_txn_cb(zil_client_t *c, uint32_t index, size_t txn_len,
+                    zil_txn_reader_t read, zil_review_cb_t on_review, void *arg,
+                    uint8_t sig[ZIL_SIG_LEN]);
+
+// Same as zil_sign_txn_cb for a transaction already in memory.
+int zil_sign_txn(zil_client_t *c, uint32_t index, const uint8_t *txn, size_t txn_len,
+                 uint8_t sig[ZIL_SIG_LEN]);
+
+// Describe a return code of the calls above.
+const char *zil_strerror(int status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
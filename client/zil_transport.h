@@ -0,0 +1,60 @@
+#ifndef ZIL_TRANSPORT_H
+#define ZIL_TRANSPORT_H
+
+// A transport moves raw APDUs between the host and the device. Commands and
+// responses are matched in order: recv always returns the response to the
+// oldest command that has been sent but not yet received.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest response APDU: 255 bytes of data followed by the status word.
+#define ZIL_RESPONSE_MAX (255 + 2)
+
+// Host-side errors. Library calls return 0 on success, one of these on a
+// host-side failure, or the device status word (e.g. 0x6985) when the device
+// refused the command.
+#define ZIL_ERR_IO       -1 // transport failure, errno may tell more
+#define ZIL_ERR_PROTOCOL -2 // malformed or unexpected response
+#define ZIL_ERR_ARG      -3 // bad argument from the caller
+#define ZIL_ERR_SOURCE   -4 // the transaction reader came up short
+
+typedef struct zil_transport zil_transport_t;
+
+struct zil_transport {
+    // Send one command APDU. The caller may reuse apdu as soon as this
+    // returns. Returns 0 or a negative ZIL_ERR_* code.
+    int (*send)(zil_transport_t *t, const uint8_t *apdu, size_t len);
+    // Receive one response APDU (data followed by the two status word
+    // bytes) into resp. Blocks until the device answers, which for signing
+    // commands includes waiting for the user. Returns 0 or ZIL_ERR_*.
+    int (*recv)(zil_transport_t *t, uint8_t resp[ZIL_RESPONSE_MAX], size_t *len);
+    void (*close)(zil_transport_t *t);
+    // How many commands may be sent before their responses are read. 1 means
+    // strict request/response.
+    unsigned max_inflight;
+};
+
+// Connect to the APDU port of Speculos (usually 9999).
+zil_transport_t *zil_transport_tcp_open(const char *host, int port);
+
+// Open a Ledger device over USB HID. path selects a device as listed by
+// hidapi; NULL picks the first Ledger device found. Only available when the
+// library is built with HIDAPI=1, otherwise it always fails.
+zil_transport_t *zil_transport_hid_open(const char *path);
+
+static inline void zil_transport_close(zil_transport_t *t) {
+    if (t) {
+        t->close(t);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
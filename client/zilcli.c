@@ -0,0 +1,261 @@
+// Command line front end to the client library, e.g.
+//
+//   zilcli -t tcp:127.0.0.1:9999 version
+//   zilcli -i 1 pubkey -d address
+//   zilcli -i 1 sign-hash 0123...ef
+//   zilcli -i 1 -c 16 sign-txn txn.bin
+//   zilcli -t hid -c auto sign-txn txn.bin
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "zil_client.h"
+
+static void usage(FILE *out) {
+    fprintf(out,
+            "usage: zilcli [options] command [args]\n"
+            "\n"
+            "options:\n"
+            "  -t TRANSPORT  hid[:PATH] (default) or tcp:HOST:PORT for Speculos\n"
+            "  -i INDEX      key index (default 0)\n"
+            "  -c BYTES      transaction bytes per frame, 1-%d (default %d), or auto\n"
+            "                to fill whole segments of the link the device is on\n"
+            "  -w FRAMES     chunks kept in flight (default: transport maximum)\n"
+            "\n"
+            "commands:\n"
+            "  version\n"
+            "  transport       link of the device and the chunk size that suits it\n"
+            "  pubkey [-d address|key|none]\n"
+            "  sign-hash HEX\n"
+            "  sign-txn FILE   serialized ProtoTransactionCoreInfo, - for stdin\n",
+            ZIL_TXN_CHUNK_MAX, ZIL_TXN_CHUNK_MAX);
+}
+
+static zil_transport_t *open_transport(const char *spec) {
+    if (strcmp(spec, "hid") == 0) {
+        return zil_transport_hid_open(NULL);
+    }
+    if (strncmp(spec, "hid:", 4) == 0) {
+        return zil_transport_hid_open(spec + 4);
+    }
+    if (strncmp(spec, "tcp:", 4) == 0) {
+        char host[256];
+        const char *colon = strrchr(spec + 4, ':');
+        if (colon == NULL || (size_t)(colon - (spec + 4)) >= sizeof(host)) {
+            return NULL;
+        }
+        memcpy(host, spec + 4, colon - (spec + 4));
+        host[colon - (spec + 4)] = '\0';
+        return zil_transport_tcp_open(host, atoi(colon + 1));
+    }
+    errno = EINVAL;
+    return NULL;
+}
+
+static void print_hex(const uint8_t *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        printf("%02x", buf[i]);
+    }
+    printf("\n");
+}
+
+static int parse_hex(const char *hex, uint8_t *out, size_t len) {
+    if (strlen(hex) != 2 * len) {
+        return -1;
+    }
+    for (size_t i = 0; i < len; i++) {
+        unsigned byte;
+        if (sscanf(hex + 2 * i, "%2x", &byte) != 1) {
+            return -1;
+        }
+        out[i] = (uint8_t)byte;
+    }
+    return 0;
+}
+
+static bool read_file(void *arg, uint8_t *buf, size_t len) {
+    return fread(buf, 1, len, (FILE *)arg) == len;
+}
+
+static void on_review(void *arg) {
+    (void)arg;
+    fprintf(stderr, "Please review the transaction on the device\n");
+}
+
+static int cmd_sign_txn(zil_client_t *c, uint32_t index, const char *path) {
+    FILE *f;
+    size_t len;
+    uint8_t *txn = NULL;
+    if (strcmp(path, "-") == 0) {
+        // A pipe has no size up front, so read it all first.
+        size_t cap = 4096, n;
+        len = 0;
+        txn = malloc(cap);
+        while (txn != NULL && (n = fread(txn + len, 1, cap - len, stdin)) > 0) {
+            len += n;
+            if (len == cap && len < ZIL_TXN_MAX_SIZE) {
+                uint8_t *bigger = realloc(txn, cap *= 2);
+                if (bigger == NULL) {
+                    free(txn);
+                }
+                txn = bigger;
+            }
+        }
+        f = txn != NULL ? fmemopen(txn, len, "rb") : NULL;
+    } else {
+        long end = -1;
+        f = fopen(path, "rb");
+        if (f != NULL && fseek(f, 0, SEEK_END) == 0) {
+            end = ftell(f);
+            rewind(f);
+        }
+        if (f != NULL && end < 0) {
+            fclose(f);
+            f = NULL;
+        }
+        len = (size_t)end;
+    }
+    if (f == NULL) {
+        perror(path);
+        free(txn);
+        return 1;
+    }
+
+    uint8_t sig[ZIL_SIG_LEN];
+    int status = zil_sign_txn_cb(c, index, len, read_file, on_review, f, sig);
+    fclose(f);
+    free(txn);
+    if (status != 0) {
+        fprintf(stderr, "sign-txn: %s (%d)\n", zil_strerror(status), status);
+        return 1;
+    }
+    print_hex(sig, sizeof(sig));
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *transport = "hid";
+    uint32_t index = 0;
+    long chunk = ZIL_TXN_CHUNK_MAX;
+    bool auto_chunk = false;
+    long window = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "+t:i:c:w:h")) != -1) {
+        switch (opt) {
+        case 't':
+            transport = optarg;
+            break;
+        case 'i':
+            index = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            auto_chunk = strcmp(optarg, "auto") == 0;
+            if (!auto_chunk) {
+                chunk = strtol(optarg, NULL, 0);
+            }
+            break;
+        case 'w':
+            window = strtol(optarg, NULL, 0);
+            break;
+        case 'h':
+            usage(stdout);
+            return 0;
+        default:
+            usage(stderr);
+            return 2;
+        }
+    }
+    if (optind >= argc || chunk < 1 || chunk > ZIL_TXN_CHUNK_MAX || window < 0) {
+        usage(stderr);
+        return 2;
+    }
+    const char *cmd = argv[optind++];
+
+    zil_transport_t *t = open_transport(transport);
+    if (t == NULL) {
+        fprintf(stderr, "cannot open %s: %s\n", transport, strerror(errno));
+        return 1;
+    }
+    zil_client_t client;
+    zil_client_init(&client, t);
+    client.chunk_len = (size_t)chunk;
+    if (auto_chunk) {
+        // Older versions of the app do not know the command, keep the
+        // largest chunks then.
+        zil_link_t link;
+        if (zil_get_transport(&client, &link) == 0) {
+            client.chunk_len = zil_link_chunk_len(&link, ZIL_KEY_INDEX_LEN, 0);
+        }
+    }
+    if (window > 0) {
+        client.window = (unsigned)window;
+    }
+
+    int ret = 0, status = 0;
+    if (strcmp(cmd, "version") == 0) {
+        uint8_t v[3];
+        status = zil_get_version(&client, v);
+        if (status == 0) {
+            printf("%d.%d.%d\n", v[0], v[1], v[2]);
+        }
+    } else if (strcmp(cmd, "transport") == 0) {
+        zil_link_t link;
+        status = zil_get_transport(&client, &link);
+        if (status == 0) {
+            printf("media %u, %u-byte segments, chunks of %zu bytes\n", link.media, link.segment,
+                   zil_link_chunk_len(&link, ZIL_KEY_INDEX_LEN, 0));
+        }
+    } else if (strcmp(cmd, "pubkey") == 0) {
+        uint8_t display = ZIL_P2_DISPLAY_NONE;
+        if (optind + 1 < argc && strcmp(argv[optind], "-d") == 0) {
+            const char *what = argv[optind + 1];
+            if (strcmp(what, "address") == 0) {
+                display = ZIL_P2_DISPLAY_ADDRESS;
+            } else if (strcmp(what, "key") == 0) {
+                display = ZIL_P2_DISPLAY_PUBKEY;
+            } else if (strcmp(what, "none") != 0) {
+                usage(stderr);
+                zil_transport_close(t);
+                return 2;
+            }
+        }
+        uint8_t pubkey[ZIL_PUBKEY_LEN];
+        char address[ZIL_ADDRSTR_LEN + 1];
+        status = zil_get_public_key(&client, index, display, pubkey, address);
+        if (status == 0) {
+            print_hex(pubkey, sizeof(pubkey));
+            printf("%s\n", address);
+        }
+    } else if (strcmp(cmd, "sign-hash") == 0) {
+        uint8_t hash[ZIL_HASH_LEN], sig[ZIL_SIG_LEN];
+        if (optind >= argc || parse_hex(argv[optind], hash, sizeof(hash)) != 0) {
+            fprintf(stderr, "sign-hash needs a %d byte hex hash\n", ZIL_HASH_LEN);
+            ret = 2;
+        } else {
+            status = zil_sign_hash(&client, index, hash, sig);
+            if (status == 0) {
+                print_hex(sig, sizeof(sig));
+            }
+        }
+    } else if (strcmp(cmd, "sign-txn") == 0) {
+        if (optind >= argc) {
+            usage(stderr);
+            ret = 2;
+        } else {
+            ret = cmd_sign_txn(&client, index, argv[optind]);
+        }
+    } else {
+        usage(stderr);
+        ret = 2;
+    }
+
+    if (status != 0) {
+        fprintf(stderr, "%s: %s (%d)\n", cmd, zil_strerror(status), status);
+        ret = 1;
+    }
+    zil_transport_close(t);
+    return ret;
+}
@@ -0,0 +1,203 @@
+// This file contains the implementation of the addRecipient command, which
+// adds a recipient to the book of trusted recipients (see addr_book.h), or
+// removes one from it. The user reviews the label and the address, and the
+// book in flash only changes once they approve. From then on, the review of
+// a transaction to the address shows the label, which takes a glance to
+// check, instead of the 42 characters of the bech32 address.
+//
+// The data is the 20 bytes of the address, followed by the label when
+// adding. P1_RECIPIENT_REMOVE removes the address instead.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "os.h"
+#include "os_io_seproxyhal.h"
+
+#include "zilliqa.h"
+#include "zilliqa_ux.h"
+#include "bech32_addr.h"
+#include "addr_book.h"
+
+#define P1_RECIPIENT_REMOVE 0x01
+
+static addRecipientContext_t * const ctx = &global.addRecipientContext;
+
+static void do_approve(void)
+{
+	if (ctx->remove) {
+		addr_book_remove(ctx->slot);
+	} else {
+		addr_book_put(ctx->slot, ctx->addr, ctx->label);
+	}
+	io_exchange_with_code(SW_OK, 0);
+#ifdef HAVE_BAGL
+	ui_idle();
+#else
+	nbgl_useCaseStatus(ctx->remove ? "RECIPIENT\nREMOVED" : "RECIPIENT\nADDED", true, ui_idle);
+#endif
+}
+
+static void do_reject(void)
+{
+	io_exchange_with_code(SW_USER_REJECTED, 0);
+#ifdef HAVE_BAGL
+	ui_idle();
+#else
+	nbgl_useCaseStatus("Recipient rejected", false, ui_idle);
+#endif
+}
+
+#ifdef HAVE_BAGL
+UX_FLOW_DEF_NOCB(
+    ux_addrecipient_flow_1_step,
+    pnn,
+    {
+      &C_icon_certificate,
+      "Trust recipient",
+      ctx->label,
+    });
+UX_FLOW_DEF_NOCB(
+    ux_removerecipient_flow_1_step,
+    pnn,
+    {
+      &C_icon_crossmark,
+      "Forget recipient",
+      ctx->label,
+    });
+UX_FLOW_DEF_NOCB(
+    ux_addrecipient_flow_2_step,
+    bnnn_paging,
+    {
+      .title = "Address",
+      .text = ctx->addrStr,
+    });
+UX_FLOW_DEF_VALID(
+    ux_addrecipient_flow_3_step,
+    pn,
+    do_approve(),
+    {
+      &C_icon_validate_14,
+      "Approve",
+    });
+UX_FLOW_DEF_VALID(
+    ux_addrecipient_flow_4_step,
+    pn,
+    do_reject(),
+    {
+      &C_icon_crossmark,
+      "Cancel",
+    });
+
+UX_FLOW(ux_addrecipient_flow,
+  &ux_addrecipient_flow_1_step,
+  &ux_addrecipient_flow_2_step,
+  &ux_addrecipient_flow_3_step,
+  &ux_addrecipient_flow_4_step
+);
+
+UX_FLOW(ux_removerecipient_flow,
+  &ux_removerecipient_flow_1_step,
+  &ux_addrecipient_flow_2_step,
+  &ux_addrecipient_flow_3_step,
+  &ux_addrecipient_flow_4_step
+);
+
+static void ui_display_add_recipient_flow(void) {
+	ux_flow_init(0, ctx->remove ? ux_removerecipient_flow : ux_addrecipient_flow, NULL);
+}
+
+#else // HAVE_BAGL
+
+static nbgl_layoutTagValue_t pairs[2];
+static nbgl_layoutTagValueList_t pairList = {0};
+static nbgl_pageInfoLongPress_t infoLongPress;
+
+static void recipient_rejected(void) {
+	do_reject();
+}
+
+static void reject_confirmation(void) {
+	nbgl_useCaseConfirm("Reject recipient?", NULL, "Yes, Reject", "Go back", recipient_rejected);
+}
+
+static void review_choice(bool confirm) {
+	if (confirm) {
+		do_approve();
+	} else {
+		reject_confirmation();
+	}
+}
+
+static void single_action_review_continue(void) {
+	pairs[0].item = "Label";
+	pairs[0].value = ctx->label;
+	pairs[1].item = "Address";
+	pairs[1].value = ctx->addrStr;
+
+	pairList.nbMaxLinesForValue = 0;
+	pairList.nbPairs = 2;
+	pairList.pairs = pairs;
+	infoLongPress.icon = &C_zilliqa_stax_64px;
+	infoLongPress.text = ctx->remove ? "Forget recipient" : "Trust recipient";
+	infoLongPress.longPressText = "Hold to approve";
+
+	nbgl_useCaseStaticReview(&pairList, &infoLongPress, "Reject", review_choice);
+}
+
+static void ui_display_add_recipient_flow(void) {
+	nbgl_useCaseReviewStart(&C_zilliqa_stax_64px,
+							ctx->remove ? "Remove trusted\nrecipient" : "Add trusted\nrecipient",
+							ctx->label,
+							"Reject",
+							single_action_review_continue,
+							reject_confirmation);
+}
+#endif // HAVE_BAGL
+
+void handleAddRecipient(uint8_t p1, uint8_t p2, uint8_t *dataBuffer, uint16_t dataLength, volatile unsigned int *flags, volatile unsigned int *tx) {
+	char buf[BECH32_ENCODE_BUF_LEN];
+
+	UNUSED(p2);
+	UNUSED(tx);
+
+	if (p1 & ~P1_RECIPIENT_REMOVE) {
+		THROW(SW_INVALID_PARAM);
+	}
+	ctx->remove = p1 & P1_RECIPIENT_REMOVE;
+	if (dataLength < PUB_ADDR_BYTES_LEN || (ctx->remove && dataLength != PUB_ADDR_BYTES_LEN)) {
+		THROW(SW_WRONG_DATA_LENGTH);
+	}
+	memcpy(ctx->addr, dataBuffer, PUB_ADDR_BYTES_LEN);
+
+	if (ctx->remove) {
+		// Show the label the address goes by.
+		ctx->slot = addr_book_find(ctx->addr);
+		if (ctx->slot < 0) {
+			THROW(SW_NOT_IN_BOOK);
+		}
+		addr_book_label(ctx->slot, ctx->label);
+	} else {
+		unsigned int labelLen = dataLength - PUB_ADDR_BYTES_LEN;
+		if (!addr_book_label_valid(dataBuffer + PUB_ADDR_BYTES_LEN, labelLen)) {
+			THROW(SW_INVALID_PARAM);
+		}
+		memcpy(ctx->label, dataBuffer + PUB_ADDR_BYTES_LEN, labelLen);
+		ctx->label[labelLen] = '\0';
+		// A known address gets its new label in place.
+		ctx->slot = addr_book_slot_for(ctx->addr);
+		if (ctx->slot < 0) {
+			THROW(SW_BOOK_FULL);
+		}
+	}
+
+	if (!bech32_addr_encode(buf, "zil", ctx->addr, PUB_ADDR_BYTES_LEN) ||
+	    strlen(buf) != BECH32_ADDRSTR_LEN) {
+		FAIL("bech32 encoding of the recipient failed");
+	}
+	memcpy(ctx->addrStr, buf, BECH32_ADDRSTR_LEN);
+	ctx->addrStr[BECH32_ADDRSTR_LEN] = '\0';
+
+	ui_display_add_recipient_flow();
+
+	*flags |= IO_ASYNCH_REPLY;
+}
@@ -0,0 +1,115 @@
+#include <string.h>
+
+#include "os.h"
+#include "addr_book.h"
+
+// The N_ prefix puts the book in the NVM section of the app, which is
+// zeroed when the app is installed: an all-zero book is empty, and there
+// is nothing to initialize. It is only ever written with nvm_write, and
+// read through N_addrBook, as the compiler would take a const variable
+// without initializer for zeros.
+const addrBook_t N_addrBook_real;
+#define N_addrBook (*(volatile addrBook_t *) PIC(&N_addrBook_real))
+
+#define ADDR_BOOK_FREE    '\0'
+#define ADDR_BOOK_REMOVED '\x01'
+
+// Addresses are the tail of a SHA-256 or Keccak-256 digest already: their
+// first bytes are as good a hash as any.
+static unsigned int addr_hash(const uint8_t *addr)
+{
+	return U4LE(addr, 0) & (ADDR_BOOK_SIZE - 1);
+}
+
+static bool entry_is(volatile addrBookEntry_t *e, const uint8_t *addr)
+{
+	for (unsigned int i = 0; i < PUB_ADDR_BYTES_LEN; i++) {
+		if (e->addr[i] != addr[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool addr_book_label_valid(const uint8_t *label, unsigned int len)
+{
+	if (len == 0 || len > ADDR_BOOK_LABEL_MAX) {
+		return false;
+	}
+	for (unsigned int i = 0; i < len; i++) {
+		if (label[i] < 0x20 || label[i] > 0x7E) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int addr_book_find(const uint8_t *addr)
+{
+	unsigned int h = addr_hash(addr);
+
+	for (unsigned int i = 0; i < ADDR_BOOK_SIZE; i++) {
+		unsigned int slot = (h + i) & (ADDR_BOOK_SIZE - 1);
+		volatile addrBookEntry_t *e = &N_addrBook.entries[slot];
+		// A removed entry does not end the probe sequence: the address may
+		// have been added after it.
+		if (e->label[0] == ADDR_BOOK_FREE) {
+			return -1;
+		}
+		if (e->label[0] != ADDR_BOOK_REMOVED && entry_is(e, addr)) {
+			return slot;
+		}
+	}
+	return -1;
+}
+
+int addr_book_slot_for(const uint8_t *addr)
+{
+	unsigned int h = addr_hash(addr);
+	int slot = addr_book_find(addr);
+
+	if (slot >= 0) {
+		return slot;
+	}
+	for (unsigned int i = 0; i < ADDR_BOOK_SIZE; i++) {
+		slot = (h + i) & (ADDR_BOOK_SIZE - 1);
+		char c = N_addrBook.entries[slot].label[0];
+		if (c == ADDR_BOOK_FREE || c == ADDR_BOOK_REMOVED) {
+			return slot;
+		}
+	}
+	return -1;
+}
+
+void addr_book_label(int slot, char *label)
+{
+	volatile addrBookEntry_t *e = &N_addrBook.entries[slot];
+
+	for (unsigned int i = 0; i <= ADDR_BOOK_LABEL_MAX; i++) {
+		label[i] = e->label[i];
+	}
+	label[ADDR_BOOK_LABEL_MAX] = '\0';
+}
+
+void addr_book_put(int slot, const uint8_t *addr, const char *label)
+{
+	addrBookEntry_t entry;
+
+	assert(slot >= 0 && slot < ADDR_BOOK_SIZE);
+	memset(&entry, 0, sizeof(entry));
+	memcpy(entry.addr, addr, PUB_ADDR_BYTES_LEN);
+	strlcpy(entry.label, label, sizeof(entry.label));
+	nvm_write((void*) &N_addrBook.entries[slot], &entry, sizeof(entry));
+}
+
+void addr_book_remove(int slot)
+{
+	addrBookEntry_t entry;
+
+	assert(slot >= 0 && slot < ADDR_BOOK_SIZE);
+	// The address goes, the slot stays taken for the probe sequences that
+	// went past it.
+	memset(&entry, 0, sizeof(entry));
+	entry.label[0] = ADDR_BOOK_REMOVED;
+	nvm_write((void*) &N_addrBook.entries[slot], &entry, sizeof(entry));
+}
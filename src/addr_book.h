@@ -0,0 +1,49 @@
+#ifndef ZIL_ADDR_BOOK_H
+#define ZIL_ADDR_BOOK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "zilliqa.h"
+
+// The book of trusted recipients: addresses the user approved once, with a
+// label of their choice, which the review of a transaction to them shows
+// instead of the bech32 address. It is kept in flash, and only changes
+// through INS_ADD_RECIPIENT, with the user's approval.
+
+// A power of two: the book is a hash table.
+#define ADDR_BOOK_SIZE 32
+// Printable ASCII characters, without the '\0'.
+#define ADDR_BOOK_LABEL_MAX 16
+
+typedef struct {
+	uint8_t addr[PUB_ADDR_BYTES_LEN];
+	// '\0'-terminated. Empty in a slot never used, a single
+	// ADDR_BOOK_REMOVED in one whose entry was removed.
+	char label[ADDR_BOOK_LABEL_MAX + 1];
+} addrBookEntry_t;
+
+// Open addressing with linear probing, from a hash of the address.
+typedef struct {
+	addrBookEntry_t entries[ADDR_BOOK_SIZE];
+} addrBook_t;
+
+// Whether label is 1 to ADDR_BOOK_LABEL_MAX printable ASCII characters.
+bool addr_book_label_valid(const uint8_t *label, unsigned int len);
+
+// The slot of addr, or -1 if it is not in the book.
+int addr_book_find(const uint8_t *addr);
+
+// The slot addr goes into: its own, or the first free one. -1 if the book
+// is full.
+int addr_book_slot_for(const uint8_t *addr);
+
+// Copy the label of the entry in slot into label[ADDR_BOOK_LABEL_MAX + 1].
+void addr_book_label(int slot, char *label);
+
+// Write an entry to flash, at the slot addr_book_slot_for returned.
+void addr_book_put(int slot, const uint8_t *addr, const char *label);
+
+// Remove the entry in slot from flash.
+void addr_book_remove(int slot);
+
+#endif
@@ -44,7 +44,7 @@ static int prepareZilPubKeyAddr()
     cx_ecfp_public_key_t publicKey;
 
     // 1. Generate public key
-    deriveZilPubKey(ctx->keyIndex, &publicKey);
+    deriveZilPubKey(&ctx->path, &publicKey);
     assert(publicKey.W_len == PUBLIC_KEY_BYTES_LEN);
     memmove(G_io_apdu_buffer + tx, publicKey.W, publicKey.W_len);
     tx += publicKey.W_len;
@@ -154,7 +154,7 @@ void ui_display_public_key_flow(void) {
     } else {
         strlcpy(ctx->typeStr, "Generate Public", sizeof(ctx->typeStr));
     }
-    snprintf(ctx->keyStr, sizeof(ctx->keyStr), "Key #%d?", ctx->keyIndex);
+    formatKeyPath(ctx->keyStr, sizeof(ctx->keyStr), "Key #", "Key ", "?", &ctx->path);
 
     ux_flow_init(0, ux_display_public_flow, NULL);
 }
@@ -185,7 +185,7 @@ void ui_display_public_key_flow(void) {
     } else {
         strlcpy(ctx->typeStr, "Verify Zilliqa\n Public Key", sizeof(ctx->typeStr));
     }
-    snprintf(ctx->keyStr, sizeof(ctx->keyStr), "Using key index %d", ctx->keyIndex);
+    formatKeyPath(ctx->keyStr, sizeof(ctx->keyStr), "Using key index ", "Using path ", "", &ctx->path);
 
 
     nbgl_useCaseReviewStart(&C_zilliqa_stax_64px,
@@ -209,9 +209,9 @@ void handleGetPublicKey(uint8_t p1,
                         uint16_t dataLength,
                         volatile unsigned int *flags,
                         volatile unsigned int *tx) {
-    UNUSED(p1);
     UNUSED(tx);
-    // Sanity-check the command parameters.
+    // Sanity-check the command parameters. P1 is only looked at for
+    // P1_BIP32_PATH, its other bits are ignored.
     if ((p2 != P2_DISPLAY_ADDRESS) && (p2 != P2_DISPLAY_PUBKEY) && (p2 != P2_DISPLAY_NONE)) {
         // Although THROW is technically a general-purpose exception
         // mechanism, within a command handler it is basically just a
@@ -223,14 +223,11 @@ void handleGetPublicKey(uint8_t p1,
         THROW(SW_INVALID_PARAM);
     }
 
-    // Sanity-check the command length
-    if (dataLength != sizeof(uint32_t)) {
+    // Read the key index or path from dataBuffer, which holds nothing else,
+    // and set the genAddr flag according to p2.
+    if (readKeyPath(p1, dataBuffer, dataLength, &ctx->path) != dataLength) {
         THROW(SW_WRONG_DATA_LENGTH);
     }
-
-    // Read the key index from dataBuffer and set the genAddr flag according
-    // to p2.
-    ctx->keyIndex = U4LE(dataBuffer, 0);
     ctx->genAddr = (p2 == P2_DISPLAY_ADDRESS);
 
     if (p2 == P2_DISPLAY_NONE)
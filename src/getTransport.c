@@ -0,0 +1,94 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <os.h>
+#include <os_io_seproxyhal.h>
+#include "zilliqa.h"
+#include "zilliqa_ux.h"
+
+// Defaults of the Makefile, for builds that leave them out.
+#ifndef USB_SEGMENT_SIZE
+#define USB_SEGMENT_SIZE 64
+#endif
+#ifndef BLE_SEGMENT_SIZE
+#define BLE_SEGMENT_SIZE 32
+#endif
+
+// The Ledger framing of USB HID and WebUSB packets: channel, tag and
+// sequence number, plus the length of the APDU in the first one.
+#define HID_FIRST_HEADER 7
+#define HID_NEXT_HEADER  5
+// The same over BLE, without the channel.
+#define BLE_FIRST_HEADER 5
+#define BLE_NEXT_HEADER  3
+// U2FHID packets: CID, command and byte count, then CID and sequence
+// number. The APDU travels as the key handle of a U2F authentication
+// request, behind its own header, the control byte, the challenge and
+// application parameters and the key handle length.
+#define U2F_FIRST_HEADER 7
+#define U2F_NEXT_HEADER  5
+#define U2F_WRAPPER      (7 + 1 + 32 + 32 + 1)
+
+// handleGetTransport reports how APDUs travel on the link this command came
+// from, for the host to pick INS_SIGN_TXN chunks that fill whole segments:
+// every segment costs a USB poll or a BLE connection interval.
+//
+// Response: media (1 byte, G_io_apdu_media), segment size (2 bytes), header
+// of the first segment of an APDU and of the next ones (1 byte each), bytes
+// sent in front of the APDU in its first segment (1 byte), and the largest
+// command data the app takes on this link, Lc (2 bytes). Sizes are
+// little-endian. A segment size of 0 stands for a link the app knows
+// nothing about.
+void handleGetTransport(uint8_t p1, uint8_t p2, uint8_t *dataBuffer, uint16_t dataLength, volatile unsigned int *flags, volatile unsigned int *tx) {
+	UNUSED(p2);
+	UNUSED(dataBuffer);
+	UNUSED(flags);
+	UNUSED(tx);
+
+	if (p1 != 0) {
+		THROW(SW_INVALID_PARAM);
+	}
+	if (dataLength != 0) {
+		THROW(SW_WRONG_DATA_LENGTH);
+	}
+
+	uint16_t segment = 0, maxData;
+	uint8_t firstHeader = 0, nextHeader = 0, wrapper = 0;
+	switch (G_io_apdu_media) {
+	case IO_APDU_MEDIA_USB_HID:
+	case IO_APDU_MEDIA_USB_WEBUSB:
+		segment = USB_SEGMENT_SIZE;
+		firstHeader = HID_FIRST_HEADER;
+		nextHeader = HID_NEXT_HEADER;
+		break;
+	case IO_APDU_MEDIA_BLE:
+		segment = BLE_SEGMENT_SIZE;
+		firstHeader = BLE_FIRST_HEADER;
+		nextHeader = BLE_NEXT_HEADER;
+		break;
+	case IO_APDU_MEDIA_U2F:
+		segment = USB_SEGMENT_SIZE;
+		firstHeader = U2F_FIRST_HEADER;
+		nextHeader = U2F_NEXT_HEADER;
+		wrapper = U2F_WRAPPER;
+		break;
+	default:
+		break;
+	}
+
+	// The APDU buffer holds the header of the command and, on U2F, the
+	// wrapper it arrives in. Lc is one byte.
+	maxData = IO_APDU_BUFFER_SIZE - OFFSET_CDATA - wrapper;
+	if (maxData > 255) {
+		maxData = 255;
+	}
+
+	G_io_apdu_buffer[0] = G_io_apdu_media;
+	G_io_apdu_buffer[1] = segment & 0xFF;
+	G_io_apdu_buffer[2] = segment >> 8;
+	G_io_apdu_buffer[3] = firstHeader;
+	G_io_apdu_buffer[4] = nextHeader;
+	G_io_apdu_buffer[5] = wrapper;
+	G_io_apdu_buffer[6] = maxData & 0xFF;
+	G_io_apdu_buffer[7] = maxData >> 8;
+	io_exchange_with_code(SW_OK, 8);
+}
@@ -117,6 +117,8 @@ bolos_ux_params_t G_ux_params;
 
 static void app_quit(void) {
     // exit app here
+    zil_ecschnorr_nonce_wipe();
+    wipeKeyCache();
     os_sched_exit(-1);
 }
 
@@ -135,6 +137,20 @@ UX_STEP_NOCB(
       "Version",
       APPVERSION,
     });
+// Whether EVM contract data may be signed (see settings.h), flipped by
+// pressing both buttons on it.
+static char contractDataStr[12];
+
+static void toggle_contract_data(void);
+
+UX_STEP_VALID(
+    ux_idle_flow_settings_step,
+    bn,
+    toggle_contract_data(),
+    {
+      "Contract data",
+      contractDataStr,
+    });
 UX_STEP_VALID(
     ux_idle_flow_3_step,
     pb,
@@ -147,8 +163,19 @@ UX_STEP_VALID(
 UX_FLOW(ux_idle_flow,
   &ux_idle_flow_1_step,
   &ux_idle_flow_2_step,
+  &ux_idle_flow_settings_step,
   &ux_idle_flow_3_step);
 
+static void idle_flow_init(const ux_flow_step_t *step) {
+    strlcpy(contractDataStr, settings_contract_data() ? "Allowed" : "Not allowed", sizeof(contractDataStr));
+    ux_flow_init(0, ux_idle_flow, step);
+}
+
+static void toggle_contract_data(void) {
+    settings_set_contract_data(!settings_contract_data());
+    idle_flow_init(&ux_idle_flow_settings_step);
+}
+
 // ui_idle displays the main menu. Note that your app isn't required to use a
 // menu as its idle screen; you can define your own completely custom screen.
 void ui_idle(void) {
@@ -156,7 +183,7 @@ void ui_idle(void) {
     if(G_ux.stack_count == 0) {
         ux_stack_push();
     }
-    ux_flow_init(0, ux_idle_flow, NULL);
+    idle_flow_init(NULL);
 }
 
 #else // HAVE_BAGL
@@ -165,17 +192,39 @@ void ui_idle(void) {
 static const char* const INFO_TYPES[] = {"Version"};
 static const char* const INFO_CONTENTS[] = {APPVERSION};
 
+// Settings page, whether EVM contract data may be signed (see settings.h)
+#define CONTRACT_DATA_TOKEN FIRST_USER_TOKEN
+
+static nbgl_layoutSwitch_t switches[1];
+
 static bool nav_callback(uint8_t page, nbgl_pageContent_t* content) {
-    UNUSED(page);
-    content->type = INFOS_LIST;
-    content->infosList.nbInfos = 1;
-    content->infosList.infoTypes = (const char**) INFO_TYPES;
-    content->infosList.infoContents = (const char**) INFO_CONTENTS;
+    if (page == 0) {
+        switches[0].text = "Contract data";
+        switches[0].subText = "Allow signing EVM transactions that call or create contracts";
+        switches[0].initState = settings_contract_data() ? ON_STATE : OFF_STATE;
+        switches[0].token = CONTRACT_DATA_TOKEN;
+        switches[0].tuneId = TUNE_TAP_CASUAL;
+        content->type = SWITCHES_LIST;
+        content->switchesList.nbSwitches = 1;
+        content->switchesList.switches = (nbgl_layoutSwitch_t*) switches;
+    } else {
+        content->type = INFOS_LIST;
+        content->infosList.nbInfos = 1;
+        content->infosList.infoTypes = (const char**) INFO_TYPES;
+        content->infosList.infoContents = (const char**) INFO_CONTENTS;
+    }
     return true;
 }
 
+static void controls_callback(int token, uint8_t index) {
+    UNUSED(index);
+    if (token == CONTRACT_DATA_TOKEN) {
+        settings_set_contract_data(!settings_contract_data());
+    }
+}
+
 static void ui_menu_about(void) {
-    nbgl_useCaseSettings(APPNAME, 0, 1, false, ui_idle, nav_callback, NULL);
+    nbgl_useCaseSettings(APPNAME, 0, 2, false, ui_idle, nav_callback, controls_callback);
 }
 
 void ui_idle(void) {
@@ -193,6 +242,8 @@ void io_exchange_with_code(uint16_t code, uint16_t tx) {
 	G_io_apdu_buffer[tx++] = code >> 8;
 	G_io_apdu_buffer[tx++] = code & 0xFF;
 	io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, tx);
+	// The command is over.
+	wipeKeyCache();
 }
 
 // The APDU protocol uses a single-byte instruction code (INS) to specify
@@ -202,6 +253,11 @@ void io_exchange_with_code(uint16_t code, uint16_t tx) {
 #define INS_GET_PUBLIC_KEY 0x02
 #define INS_SIGN_TXN  0x04
 #define INS_SIGN_HASH 0x08
+#define INS_GET_TRANSPORT 0x10
+#define INS_SIGN_EVM_TXN  0x20
+#define INS_ADD_RECIPIENT 0x40
+// Only in TRACE=1 builds, see trace.h.
+#define INS_DUMP_TRACE 0xF0
 
 // This is the function signature for a command handler. 'flags' and 'tx' are
 // out-parameters that will control the behavior of the next io_exchange call
@@ -213,6 +269,12 @@ handler_fn_t handleGetVersion;
 handler_fn_t handleGetPublicKey;
 handler_fn_t handleSignTxn;
 handler_fn_t handleSignHash;
+handler_fn_t handleGetTransport;
+handler_fn_t handleSignEvmTxn;
+handler_fn_t handleAddRecipient;
+#ifdef HAVE_ZIL_TRACE
+handler_fn_t handleDumpTrace;
+#endif
 
 static handler_fn_t* lookupHandler(uint8_t ins) {
 	switch (ins) {
@@ -220,6 +282,12 @@ static handler_fn_t* lookupHandler(uint8_t ins) {
 		case INS_GET_PUBLIC_KEY: return handleGetPublicKey;
 		case INS_SIGN_TXN:  return handleSignTxn;
 		case INS_SIGN_HASH: return handleSignHash;
+		case INS_GET_TRANSPORT: return handleGetTransport;
+		case INS_SIGN_EVM_TXN:  return handleSignEvmTxn;
+		case INS_ADD_RECIPIENT: return handleAddRecipient;
+#ifdef HAVE_ZIL_TRACE
+		case INS_DUMP_TRACE: return handleDumpTrace;
+#endif
 		default:                 return NULL;
 	}
 }
@@ -253,6 +321,20 @@ static void zil_main(void) {
 			TRY {
 				rx = tx;
 				tx = 0; // ensure no race in CATCH_OTHER if io_exchange throws an error
+				if (!(flags & IO_ASYNCH_REPLY)) {
+					// The command is over, unless it waits for the user.
+					wipeKeyCache();
+					if (rx > 0) {
+						// Answer first, the host has no need to wait for the nonce.
+						io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, rx);
+						rx = 0;
+					}
+				}
+				// The app is idle until the next command or the user's
+				// answer: get the nonce of a coming signature ready, one
+				// scalar multiplication at most. This is the only place it
+				// is done; io_event has to stay quick.
+				zil_ecschnorr_nonce_fill();
 				rx = io_exchange(CHANNEL_APDU | flags, rx);
 
                 PLOC();
@@ -300,6 +382,7 @@ static void zil_main(void) {
 				// codes?
                 PLOC();
                 PRINTF("e:%d\n", e);
+				wipeKeyCache();
 				switch (e & 0xF000) {
 				case 0x6000:
 				case 0x9000:
@@ -328,6 +411,10 @@ static void zil_main(void) {
 // Next, we'll look at how the various commands are implemented. We'll start
 // with the simplest command, signHash.c.
 
+// The host simulator in tests/unit-tests/simulator builds this file with its
+// own io_exchange and UX, and drives zil_main itself.
+#ifndef ZIL_SIMULATOR
+
 #ifdef HAVE_BAGL
 // override point, but nothing more to do
 void io_seproxyhal_display(const bagl_element_t *element) {
@@ -404,7 +491,15 @@ unsigned short io_exchange_al(unsigned char channel, unsigned short tx_len) {
 	return 0;
 }
 
+void zil_io_reset(void) {
+	io_seproxyhal_init();
+	USB_power(0);
+	USB_power(1);
+}
+
 static void app_exit(void) {
+	zil_ecschnorr_nonce_wipe();
+	wipeKeyCache();
 	BEGIN_TRY_L(exit) {
 		TRY_L(exit) {
 			os_sched_exit(-1);
@@ -453,3 +548,5 @@ __attribute__((section(".boot"))) int main(void) {
 	app_exit();
 	return 0;
 }
+
+#endif // ZIL_SIMULATOR
@@ -37,6 +37,27 @@
  * This was the default until nanopb-0.2.1. */
 /* #define PB_OLD_CALLBACK_STYLE */
 
+/* The options below trim the library down to what the app decodes (see the
+ * NANOPB_FULL switch in the Makefile). They are not part of upstream nanopb. */
+
+/* Compile out pb_encode.c entirely. */
+/* #define PB_NO_ENCODE 1 */
+
+/* Compile out extension field support. */
+/* #define PB_NO_EXTENSIONS 1 */
+
+/* Only keep the field decoders needed by ProtoTransactionCoreInfo. */
+/* #define PB_MINIMAL_DECODERS 1 */
+
+/* Callback streams tell where the bytes they already hold in memory are
+ * (window in pb_istream_t), and varints are decoded from there without a
+ * call per byte. */
+/* #define PB_ISTREAM_WINDOW 1 */
+
+#if defined(PB_NO_EXTENSIONS) && (defined(PROTO2_SUPPORT) || defined(PB_ENABLE_MALLOC))
+#error "PB_NO_EXTENSIONS cannot be combined with PROTO2_SUPPORT or PB_ENABLE_MALLOC"
+#endif
+
 
 /******************************************************************
  * You usually don't need to change anything below this line.     *
@@ -571,13 +592,7 @@ struct pb_extension_s {
  * PB_GET_ERROR() always returns a pointer to a string.
  * PB_RETURN_ERROR() sets the error and returns false from current
  *                   function.
- * G_depth is a global that should be initialized to 0 when 
- * creating an input stream. It helps tracking the level of the 
- * call stack when instrumentation is enabled 
- * (set `INTRUMENT_FUNCTION += -finstrument-functions` in your 
- * Makfile to do so)
  */
-extern int G_depth;
 
 #ifdef PB_NO_ERRMSG
 #define PB_SET_ERROR(stream, msg) PB_UNUSED(stream)
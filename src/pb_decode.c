@@ -30,22 +30,26 @@ static bool checkreturn read_raw_value(pb_istream_t *stream, pb_wire_type_t wire
 static bool checkreturn decode_static_field(pb_istream_t *stream, pb_wire_type_t wire_type, pb_field_iter_t *iter);
 static bool checkreturn decode_callback_field(pb_istream_t *stream, pb_wire_type_t wire_type, pb_field_iter_t *iter);
 static bool inline checkreturn decode_field(pb_istream_t *stream, pb_wire_type_t wire_type, pb_field_iter_t *iter) __attribute__((no_instrument_function));
+#ifndef PB_NO_EXTENSIONS
 static void iter_from_extension(pb_field_iter_t *iter, pb_extension_t *extension);
 static bool checkreturn default_extension_decoder(pb_istream_t *stream, pb_extension_t *extension, uint32_t tag, pb_wire_type_t wire_type);
 static bool checkreturn decode_extension(pb_istream_t *stream, uint32_t tag, pb_wire_type_t wire_type, pb_field_iter_t *iter);
 static bool checkreturn find_extension_field(pb_field_iter_t *iter);
+#endif
 static void pb_field_set_to_default(pb_field_iter_t *iter);
 static void pb_message_set_to_defaults(const pb_field_t fields[], void *dest_struct);
-static bool checkreturn pb_dec_varint(pb_istream_t *stream, const pb_field_t *field, void *dest);
 static bool inline checkreturn pb_decode_varint32_eof(pb_istream_t *stream, uint32_t *dest, bool *eof) __attribute__((no_instrument_function));
 static bool checkreturn pb_dec_uvarint(pb_istream_t *stream, const pb_field_t *field, void *dest);
+static bool checkreturn pb_dec_submessage(pb_istream_t *stream, const pb_field_t *field, void *dest);
+#ifndef PB_MINIMAL_DECODERS
+static bool checkreturn pb_dec_varint(pb_istream_t *stream, const pb_field_t *field, void *dest);
 static bool checkreturn pb_dec_svarint(pb_istream_t *stream, const pb_field_t *field, void *dest);
 static bool checkreturn pb_dec_fixed32(pb_istream_t *stream, const pb_field_t *field, void *dest);
 static bool checkreturn pb_dec_fixed64(pb_istream_t *stream, const pb_field_t *field, void *dest);
 static bool checkreturn pb_dec_bytes(pb_istream_t *stream, const pb_field_t *field, void *dest);
 static bool checkreturn pb_dec_string(pb_istream_t *stream, const pb_field_t *field, void *dest);
-static bool checkreturn pb_dec_submessage(pb_istream_t *stream, const pb_field_t *field, void *dest);
 static bool checkreturn pb_dec_fixed_length_bytes(pb_istream_t *stream, const pb_field_t *field, void *dest);
+#endif
 static bool checkreturn pb_skip_varint(pb_istream_t *stream);
 static bool checkreturn pb_skip_string(pb_istream_t *stream);
 
@@ -67,6 +71,24 @@ static void initialize_pointer_field(void *pItem, pb_field_iter_t *iter);
 /* --- Function pointers to field decoders ---
  * Order in the array must match pb_action_t LTYPE numbering.
  */
+#ifdef PB_MINIMAL_DECODERS
+/* Only the static field types used by ProtoTransactionCoreInfo (see txn.pb.c)
+ * get a decoder. Bytes fields are all callbacks and never go through this
+ * table. A NULL entry is reported as an invalid field type. */
+static const pb_decoder_t PB_DECODERS[PB_LTYPES_COUNT] = {
+    NULL, /* varint */
+    &pb_dec_uvarint,
+    NULL, /* svarint */
+    NULL, /* fixed32 */
+    NULL, /* fixed64 */
+
+    NULL, /* bytes */
+    NULL, /* string */
+    &pb_dec_submessage,
+    NULL, /* extensions */
+    NULL  /* fixed length bytes */
+};
+#else
 static const pb_decoder_t PB_DECODERS[PB_LTYPES_COUNT] = {
     &pb_dec_varint,
     &pb_dec_uvarint,
@@ -80,119 +102,11 @@ static const pb_decoder_t PB_DECODERS[PB_LTYPES_COUNT] = {
     NULL, /* extensions */
     &pb_dec_fixed_length_bytes
 };
-
-extern void _ebss;
-extern void _estack;
-int G_depth;
-int last_stack_left;
-typedef struct addr_to_fname_s {
-    const void* const addr;
-    const char* const name;
-} addr_to_fname_t;
+#endif
 
 static bool checkreturn inline decode_pointer_field(pb_istream_t *stream, pb_wire_type_t wire_type, pb_field_iter_t *iter) __attribute__((no_instrument_function));
 static bool checkreturn pb_readbyte(pb_istream_t *stream, pb_byte_t *buf);
 
-const addr_to_fname_t addr_to_fnames[] = {
-    { pb_readbyte, "pb_readbyte" },
-    { decode_pointer_field, "decode_pointer_field" },
-#ifdef PB_ENABLE_MALLOC
-    { initialize_pointer_field, "initialize_pointer_field" },
-    { allocate_field, "allocate_field" },
-    { pb_release_union_field, "pb_release_union_field" },
-    { pb_release_single_field, "pb_release_single_field" },
-    { pb_release, "pb_release" },
-#endif
-    { pb_decode, "pb_decode" },
-    { pb_message_set_to_defaults, "pb_message_set_to_defaults" },
-    { pb_decode_noinit, "pb_decode_noinit" },
-    { buf_read, "buf_read" },
-    { read_raw_value, "read_raw_value" },
-    { decode_static_field, "decode_static_field" },
-    { decode_callback_field, "decode_callback_field" },
-    { decode_field, "decode_field" },
-    { iter_from_extension, "iter_from_extension" },
-    { default_extension_decoder, "default_extension_decoder" },
-    { decode_extension, "decode_extension" },
-    { find_extension_field, "find_extension_field" },
-    { pb_field_set_to_default, "pb_field_set_to_default" },
-    { pb_message_set_to_defaults, "pb_message_set_to_defaults" },
-    { pb_dec_varint, "pb_dec_varint" },
-    { pb_decode_varint32_eof, "pb_decode_varint32_eof" },
-    { pb_dec_uvarint, "pb_dec_uvarint" },
-    { pb_dec_svarint, "pb_dec_svarint" },
-    { pb_dec_fixed32, "pb_dec_fixed32" },
-    { pb_dec_fixed64, "pb_dec_fixed64" },
-    { pb_dec_bytes, "pb_dec_bytes" },
-    { pb_dec_string, "pb_dec_string" },
-    { pb_dec_submessage, "pb_dec_submessage" },
-    { pb_dec_fixed_length_bytes, "pb_dec_fixed_length_bytes" },
-    { pb_skip_varint, "pb_skip_varint" },
-    { pb_skip_string, "pb_skip_string" },
-    { pb_decode_delimited, "pb_decode_delimited" },
-    { pb_decode_delimited_noinit, "pb_decode_delimited_noinit" },
-    { pb_decode_nullterminated, "pb_decode_nullterminated" },
-    { pb_istream_from_buffer, "pb_istream_from_buffer" },
-    { pb_read, "pb_read" },
-    { pb_decode_tag, "pb_decode_tag" },
-    { pb_skip_field, "pb_skip_field" },
-    // { pb_decode_varint, "pb_decode_varint" },
-    { pb_decode_varint32, "pb_decode_varint32" },
-    { pb_decode_svarint, "pb_decode_svarint" },
-    { pb_decode_fixed32, "pb_decode_fixed32" },
-    { pb_make_string_substream, "pb_make_string_substream" },
-    { pb_close_string_substream, "pb_close_string_substream" },
-    { decode_pointer_field, "decode_pointer_field" },
-    { decode_callback_field, "decode_callback_field" }
-};
-
-#ifdef HAVE_PRINTF
-const char* addr_to_fname(void* func) __attribute__((no_instrument_function));
-const char* addr_to_fname(void* func){
-    for(int i = 0; i < sizeof(addr_to_fnames)/sizeof(*addr_to_fnames); i++){
-        if(PIC(addr_to_fnames[i].addr) == func){
-            return (const char*)(PIC(addr_to_fnames[i].name));
-        }
-    }
-    return "";
-}
-#endif
-
-void __cyg_profile_func_enter(void *this_fn, void *call_site) __attribute__((no_instrument_function));
-void __cyg_profile_func_enter( void *func, void *callsite )
-{
-#ifdef HAVE_PRINTF
-    const char* fname = addr_to_fname(func);
-    for(int i = 0; i < G_depth; i++){
-        PRINTF(" ");
-    }
-    PRINTF("-> %p '%s' [from %p], STACK %p, left: %d\n", func, fname, callsite, &fname, ((void*)&fname) - &_ebss); //, last_stack_left - (((void*)&fname) - &_ebss));
-    last_stack_left = ((void*)&fname) - &_ebss;
-#else
-    UNUSED(func);
-    UNUSED(callsite);
-#endif
-    G_depth++;
-}
-void __cyg_profile_func_exit(void *this_fn, void *call_site) __attribute__((no_instrument_function));
-void __cyg_profile_func_exit( void *func, void *callsite )
-{
-#ifdef HAVE_PRINTF
-    const char* fname = addr_to_fname(func);
-    // last_stack_left = ((void*)&fname) - &_ebss;
-    G_depth--;
-    for(int i = 0; i < G_depth; i++){
-        PRINTF(" ");
-    }
-    PRINTF("<- %p '%s' [from %p], left: %d\n", func, fname, callsite, ((void*)&fname) - &_ebss);
-    // last_stack_left = ((void*)&fname) - &_ebss;
-#else
-    UNUSED(func);
-    UNUSED(callsite);
-    G_depth--;
-#endif
-}
-
 /*******************************
  * pb_istream_t implementation *
  *******************************/
@@ -212,6 +126,44 @@ static bool checkreturn buf_read(pb_istream_t *stream, pb_byte_t *buf, size_t co
     return true;
 }
 
+#ifdef PB_ISTREAM_WINDOW
+/* The bytes that can be read right away, without calling back. */
+static inline size_t window_peek(const pb_istream_t *stream, const pb_byte_t **bytes)
+{
+    size_t len;
+#ifndef PB_BUFFER_ONLY
+    if (stream->callback != buf_read)
+    {
+        *bytes = stream->window;
+        len = stream->window_len;
+    }
+    else
+#endif
+    {
+        *bytes = (const pb_byte_t*)stream->state;
+        len = stream->bytes_left;
+    }
+    return len < stream->bytes_left ? len : stream->bytes_left;
+}
+
+static inline void window_consume(pb_istream_t *stream, size_t count)
+{
+#ifndef PB_BUFFER_ONLY
+    if (stream->callback != buf_read)
+    {
+        stream->window += count;
+        stream->window_len -= count;
+    }
+    else
+#endif
+    {
+        stream->state = (pb_byte_t*)stream->state + count;
+    }
+    stream->bytes_left -= count;
+}
+
+#endif
+
 bool checkreturn pb_read(pb_istream_t *stream, pb_byte_t *buf, size_t count)
 {
 #ifndef PB_BUFFER_ONLY
@@ -219,6 +171,28 @@ bool checkreturn pb_read(pb_istream_t *stream, pb_byte_t *buf, size_t count)
 	{
 		/* Skip input bytes */
 		pb_byte_t tmp[16];
+#ifdef PB_ISTREAM_WINDOW
+		/* Step over what the window holds, and only call back for the
+		 * bytes after it. */
+		while (count > 16)
+		{
+			const pb_byte_t *bytes;
+			size_t len = window_peek(stream, &bytes);
+			if (len > count)
+				len = count;
+			if (len == 0)
+			{
+				if (!pb_read(stream, tmp, 16))
+					return false;
+				len = 16;
+			}
+			else
+			{
+				window_consume(stream, len);
+			}
+			count -= len;
+		}
+#else
 		while (count > 16)
 		{
 			if (!pb_read(stream, tmp, 16))
@@ -226,6 +200,7 @@ bool checkreturn pb_read(pb_istream_t *stream, pb_byte_t *buf, size_t count)
 			
 			count -= 16;
 		}
+#endif
 		
 		return pb_read(stream, tmp, count);
 	}
@@ -284,6 +259,10 @@ pb_istream_t pb_istream_from_buffer(const pb_byte_t *buf, size_t bufsize)
     state.c_state = buf;
     stream.state = state.state;
     stream.bytes_left = bufsize;
+#ifdef PB_ISTREAM_WINDOW
+    stream.window = NULL;
+    stream.window_len = 0;
+#endif
 #ifndef PB_NO_ERRMSG
     stream.errmsg = NULL;
 #endif
@@ -294,10 +273,46 @@ pb_istream_t pb_istream_from_buffer(const pb_byte_t *buf, size_t bufsize)
  * Helper functions *
  ********************/
 
+#ifdef PB_ISTREAM_WINDOW
+/* The length of the varint at the start of the window, if it ends within
+ * the window and max_len bytes, 0 otherwise. */
+static inline size_t window_varint_len(const pb_istream_t *stream, const pb_byte_t **bytes, size_t max_len)
+{
+    size_t len = window_peek(stream, bytes), i;
+    if (len > max_len)
+        len = max_len;
+    for (i = 0; i < len; i++)
+    {
+        if (((*bytes)[i] & 0x80) == 0)
+            return i + 1;
+    }
+    return 0;
+}
+#endif
+
 static bool checkreturn pb_decode_varint32_eof(pb_istream_t *stream, uint32_t *dest, bool *eof)
 {
     pb_byte_t byte;
     uint32_t result;
+
+#ifdef PB_ISTREAM_WINDOW
+    /* Up to 5 bytes, all in the window: 32-bit values. The longer forms of
+     * negative numbers, and varints cut by the end of the window, take the
+     * way below. */
+    const pb_byte_t *bytes;
+    size_t len = window_varint_len(stream, &bytes, 5), i;
+    if (len != 0)
+    {
+        if (len == 5 && (bytes[4] & 0x70) != 0)
+            PB_RETURN_ERROR(stream, "varint overflow");
+        result = 0;
+        for (i = 0; i < len; i++)
+            result |= (uint32_t)(bytes[i] & 0x7F) << (7 * i);
+        window_consume(stream, len);
+        *dest = result;
+        return true;
+    }
+#endif
     
     if (!pb_readbyte(stream, &byte))
     {
@@ -367,6 +382,19 @@ bool checkreturn pb_decode_varint(pb_istream_t *stream, uint64_t *dest)
     pb_byte_t byte;
     uint_fast8_t bitpos = 0;
     uint64_t result = 0;
+
+#ifdef PB_ISTREAM_WINDOW
+    const pb_byte_t *bytes;
+    size_t len = window_varint_len(stream, &bytes, 10), i;
+    if (len != 0)
+    {
+        for (i = 0; i < len; i++)
+            result |= (uint64_t)(bytes[i] & 0x7F) << (7 * i);
+        window_consume(stream, len);
+        *dest = result;
+        return true;
+    }
+#endif
     
     do
     {
@@ -387,6 +415,17 @@ bool checkreturn pb_decode_varint(pb_istream_t *stream, uint64_t *dest)
 bool checkreturn pb_skip_varint(pb_istream_t *stream)
 {
     pb_byte_t byte;
+
+#ifdef PB_ISTREAM_WINDOW
+    const pb_byte_t *bytes;
+    size_t len = window_varint_len(stream, &bytes, 10);
+    if (len != 0)
+    {
+        window_consume(stream, len);
+        return true;
+    }
+#endif
+
     do
     {
         if (!pb_read(stream, &byte, 1))
@@ -496,6 +535,10 @@ bool checkreturn pb_close_string_substream(pb_istream_t *stream, pb_istream_t *s
     }
 
     stream->state = substream->state;
+#ifdef PB_ISTREAM_WINDOW
+    stream->window = substream->window;
+    stream->window_len = substream->window_len;
+#endif
 
 #ifndef PB_NO_ERRMSG
     stream->errmsg = substream->errmsg;
@@ -513,6 +556,10 @@ static bool checkreturn decode_static_field(pb_istream_t *stream, pb_wire_type_t
 {
     type = ((const pb_field_t *)PIC(iter->pos))->type;
     func = (pb_decoder_t)PIC(PB_DECODERS[PB_LTYPE(type)]);
+#ifdef PB_MINIMAL_DECODERS
+    if (func == NULL)
+        PB_RETURN_ERROR(stream, "invalid field type");
+#endif
                   
     switch (PB_HTYPE(type))
     {
@@ -655,6 +702,10 @@ static bool checkreturn decode_pointer_field(pb_istream_t *stream, pb_wire_type_
     
     type = ((const pb_field_t *)PIC(iter->pos))->type;
     func = PIC(PB_DECODERS[PB_LTYPE(type)]);
+#ifdef PB_MINIMAL_DECODERS
+    if (func == NULL)
+        PB_RETURN_ERROR(stream, "invalid field type");
+#endif
     
     switch (PB_HTYPE(type))
     {
@@ -848,6 +899,7 @@ static bool checkreturn decode_field(pb_istream_t *stream, pb_wire_type_t wire_t
     }
 }
 
+#ifndef PB_NO_EXTENSIONS
 static void iter_from_extension(pb_field_iter_t *iter, pb_extension_t *extension)
 {
     /* Fake a field iterator for the extension field.
@@ -923,12 +975,14 @@ static bool checkreturn find_extension_field(pb_field_iter_t *iter)
     
     return false;
 }
+#endif
 
 /* Initialize message fields to default values, recursively */
 static void pb_field_set_to_default(pb_field_iter_t *iter)
 {
     pb_type_t type;
     type = ((const pb_field_t *)PIC(iter->pos))->type;
+#ifndef PB_NO_EXTENSIONS
     if (PB_LTYPE(type) == PB_LTYPE_EXTENSION)
     {
         pb_extension_t *ext = *(pb_extension_t* const *)iter->pData;
@@ -941,7 +995,9 @@ static void pb_field_set_to_default(pb_field_iter_t *iter)
             ext = ext->next;
         }
     }
-    else if (PB_ATYPE(type) == PB_ATYPE_STATIC)
+    else
+#endif
+    if (PB_ATYPE(type) == PB_ATYPE_STATIC)
     {
         bool init_data = true;
         if (PB_HTYPE(type) == PB_HTYPE_OPTIONAL && iter->pSize != iter->pData)
@@ -1365,6 +1421,8 @@ bool pb_decode_fixed64(pb_istream_t *stream, void *dest)
     return true;
 }
 #endif
+
+#ifndef PB_MINIMAL_DECODERS
 static bool checkreturn pb_dec_varint(pb_istream_t *stream, const pb_field_t *field, void *dest)
 {
     pb_uint64_t value=0;
@@ -1401,6 +1459,7 @@ static bool checkreturn pb_dec_varint(pb_istream_t *stream, const pb_field_t *fi
     
     return true;
 }
+#endif
 
 static bool checkreturn pb_dec_uvarint(pb_istream_t *stream, const pb_field_t *field, void *dest)
 {
@@ -1426,6 +1485,7 @@ static bool checkreturn pb_dec_uvarint(pb_istream_t *stream, const pb_field_t *f
     return true;
 }
 
+#ifndef PB_MINIMAL_DECODERS
 static bool checkreturn pb_dec_svarint(pb_istream_t *stream, const pb_field_t *field, void *dest)
 {
     pb_int64_t value, clamped;
@@ -1538,6 +1598,7 @@ static bool checkreturn pb_dec_string(pb_istream_t *stream, const pb_field_t *fi
     *((pb_byte_t*)dest + size) = 0;
     return status;
 }
+#endif
 
 static bool checkreturn pb_dec_submessage(pb_istream_t *stream, const pb_field_t *field, void *dest)
 {
@@ -1566,6 +1627,7 @@ static bool checkreturn pb_dec_submessage(pb_istream_t *stream, const pb_field_t
     return status;
 }
 
+#ifndef PB_MINIMAL_DECODERS
 static bool checkreturn pb_dec_fixed_length_bytes(pb_istream_t *stream, const pb_field_t *field, void *dest)
 {
     uint32_t size;
@@ -1588,3 +1650,4 @@ static bool checkreturn pb_dec_fixed_length_bytes(pb_istream_t *stream, const pb
 
     return pb_read(stream, (pb_byte_t*)dest, field->data_size);
 }
+#endif
@@ -12,10 +12,6 @@
 extern "C" {
 #endif
 
-/* Tracks call stack when instrumentation is enabled
- * Should be set to 0 when instantiating pb_istream_t*/
-extern int G_depth;
-
 /* Structure for defining custom input streams. You will need to provide
  * a callback function to read the bytes from your storage, which can be
  * for example a file or a network socket.
@@ -43,6 +39,15 @@ struct pb_istream_s
 
     void *state; /* Free field for use by callback implementation */
     size_t bytes_left;
+
+#ifdef PB_ISTREAM_WINDOW
+    /* The next window_len bytes of the stream, if the callback has them in
+     * memory: the varint decoders read them in place and move window on,
+     * and the callback carries on from there. NULL if it has none. Buffer
+     * streams leave it NULL, their state is their window. */
+    const pb_byte_t *window;
+    size_t window_len;
+#endif
     
 #ifndef PB_NO_ERRMSG
     const char *errmsg;
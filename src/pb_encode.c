@@ -7,6 +7,8 @@
 #include "pb_encode.h"
 #include "pb_common.h"
 
+#ifndef PB_NO_ENCODE
+
 #ifdef OS_IO_SEPROXYHAL
 #include "os.h"
 #else
@@ -829,3 +831,4 @@ static bool checkreturn pb_enc_fixed_length_bytes(pb_ostream_t *stream, const pb
     return pb_encode_string(stream, (const pb_byte_t*)src, field->data_size);
 }
 
+#endif /* PB_NO_ENCODE */
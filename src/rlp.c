@@ -0,0 +1,155 @@
+#include <string.h>
+
+#include "rlp.h"
+
+// Bytes left in the current list, or in the stream at the top level.
+static size_t list_left(const rlp_decoder_t *d)
+{
+	if (d->depth == 0) {
+		return d->stream->bytes_left;
+	}
+	return d->stream->bytes_left - d->end[d->depth - 1];
+}
+
+void rlp_init(rlp_decoder_t *d, pb_istream_t *stream)
+{
+	memset(d, 0, sizeof(*d));
+	d->stream = stream;
+}
+
+bool rlp_at_end(const rlp_decoder_t *d)
+{
+	return list_left(d) == 0;
+}
+
+bool rlp_next(rlp_decoder_t *d, rlp_item_t *item)
+{
+	size_t left = list_left(d);
+	uint8_t prefix, lenBuf[4];
+	uint32_t len;
+
+	memset(item, 0, sizeof(*item));
+	if (left == 0 || !pb_read(d->stream, &prefix, 1)) {
+		return false;
+	}
+	left--;
+
+	if (prefix < 0x80) {
+		item->inlined = true;
+		item->byte = prefix;
+		item->len = 1;
+		return true;
+	}
+
+	item->list = prefix >= 0xC0;
+	len = prefix - (item->list ? 0xC0 : 0x80);
+	if (len >= 56) {
+		// The length follows, on len - 55 bytes. Four are plenty for the
+		// ZIL_MAX_TXN_SIZE bytes a stream may carry.
+		uint32_t lenLen = len - 55;
+		if (lenLen > sizeof(lenBuf) || lenLen > left || !pb_read(d->stream, lenBuf, lenLen) ||
+		    lenBuf[0] == 0) {
+			return false;
+		}
+		left -= lenLen;
+		len = 0;
+		for (uint32_t i = 0; i < lenLen; i++) {
+			len = (len << 8) | lenBuf[i];
+		}
+		if (len < 56) {
+			return false;
+		}
+	}
+	if (len > left) {
+		return false;
+	}
+	item->len = len;
+
+	// A single byte below 0x80 has to be encoded as itself.
+	if (!item->list && len == 1) {
+		if (!pb_read(d->stream, &item->byte, 1) || item->byte < 0x80) {
+			return false;
+		}
+		item->inlined = true;
+	}
+	return true;
+}
+
+bool rlp_enter(rlp_decoder_t *d)
+{
+	rlp_item_t item;
+
+	if (d->depth == RLP_MAX_DEPTH || !rlp_next(d, &item) || !item.list) {
+		return false;
+	}
+	d->end[d->depth++] = d->stream->bytes_left - item.len;
+	return true;
+}
+
+bool rlp_leave(rlp_decoder_t *d)
+{
+	if (d->depth == 0 || !rlp_at_end(d)) {
+		return false;
+	}
+	d->depth--;
+	return true;
+}
+
+bool rlp_read(rlp_decoder_t *d, rlp_item_t *item, uint8_t *buf, uint32_t n)
+{
+	if (item->list || n > item->len) {
+		return false;
+	}
+	if (n == 0) {
+		return true;
+	}
+	item->len -= n;
+	if (item->inlined) {
+		if (buf != NULL) {
+			buf[0] = item->byte;
+		}
+		return true;
+	}
+	return pb_read(d->stream, buf, n);
+}
+
+bool rlp_skip(rlp_decoder_t *d, rlp_item_t *item)
+{
+	uint32_t n = item->len;
+
+	item->len = 0;
+	if (n == 0 || item->inlined) {
+		return true;
+	}
+	return pb_read(d->stream, NULL, n);
+}
+
+bool rlp_read_uint(rlp_decoder_t *d, uint8_t *out, uint32_t len)
+{
+	rlp_item_t item;
+	uint32_t n;
+
+	if (!rlp_next(d, &item) || item.list || item.len > len) {
+		return false;
+	}
+	n = item.len;
+	memset(out, 0, len - n);
+	if (!rlp_read(d, &item, out + len - n, n)) {
+		return false;
+	}
+	return n == 0 || out[len - n] != 0;
+}
+
+bool rlp_read_u64(rlp_decoder_t *d, uint64_t *v)
+{
+	uint8_t buf[sizeof(uint64_t)];
+
+	if (!rlp_read_uint(d, buf, sizeof(buf))) {
+		return false;
+	}
+	*v = 0;
+	for (unsigned int i = 0; i < sizeof(buf); i++) {
+		*v = (*v << 8) | buf[i];
+	}
+	return true;
+}
@@ -0,0 +1,66 @@
+#ifndef ZIL_RLP_H
+#define ZIL_RLP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "pb_decode.h"
+
+// A streaming decoder of RLP, the serialization of Ethereum transactions.
+// It reads from a nanopb input stream, so the same code decodes a buffer
+// or the chunks of a stream (see stream.h) as they come in, and keeps no
+// more than the ends of the lists it is in: payloads go straight to the
+// caller, or are skipped. Only canonical encodings are accepted.
+//
+// Every function returns false on malformed or truncated input.
+
+// Lists in lists: an EIP-1559 transaction, its access list, an entry of
+// the access list and its storage keys.
+#define RLP_MAX_DEPTH 4
+
+typedef struct {
+	pb_istream_t *stream;
+	uint8_t depth;
+	// stream->bytes_left where each open list ends.
+	size_t end[RLP_MAX_DEPTH];
+} rlp_decoder_t;
+
+typedef struct {
+	uint32_t len;     // Payload bytes not read yet.
+	bool list;
+	// A byte below 0x80 is its own encoding: it came with the header, and
+	// rlp_read returns it from here.
+	bool inlined;
+	uint8_t byte;
+} rlp_item_t;
+
+void rlp_init(rlp_decoder_t *d, pb_istream_t *stream);
+
+// Whether the list the decoder is in has been read to its end. At the top
+// level, whether the stream has.
+bool rlp_at_end(const rlp_decoder_t *d);
+
+// Read the header of the next item of the current list.
+bool rlp_next(rlp_decoder_t *d, rlp_item_t *item);
+
+// Read the next item, which must be a list, and go into it.
+bool rlp_enter(rlp_decoder_t *d);
+
+// Leave the current list, which must have been read to its end.
+bool rlp_leave(rlp_decoder_t *d);
+
+// Read up to n bytes of the payload of a string item, or skip them when buf
+// is NULL.
+bool rlp_read(rlp_decoder_t *d, rlp_item_t *item, uint8_t *buf, uint32_t n);
+
+// Skip what is left of an item, list or string.
+bool rlp_skip(rlp_decoder_t *d, rlp_item_t *item);
+
+// Read the next item as a big-endian unsigned integer of at most len bytes,
+// into out[len]. Integers have no leading zeros in RLP.
+bool rlp_read_uint(rlp_decoder_t *d, uint8_t *out, uint32_t len);
+
+// Read the next item as a uint64_t.
+bool rlp_read_u64(rlp_decoder_t *d, uint64_t *v);
+
+#endif
@@ -0,0 +1,41 @@
+// The seeded generator of TEST_RNG=1 builds, see rng.h.
+
+#ifdef HAVE_ZIL_TEST_RNG
+
+#include <string.h>
+#include <os.h>
+#include <cx.h>
+#include "zilliqa.h"
+#include "rng.h"
+
+#warning "HAVE_ZIL_TEST_RNG: predictable signing nonces, never load this build on a device"
+
+// Blocks drawn from each stream since the app started.
+static uint32_t rng_blocks[ZIL_RNG_STREAMS];
+
+void zil_rng(uint8_t stream, unsigned char *buf, unsigned int len)
+{
+	const uint64_t seed = ZIL_TEST_RNG_SEED;
+	unsigned char in[13], block[32];
+	unsigned int n;
+
+	assert(stream < ZIL_RNG_STREAMS);
+	for (unsigned int i = 0; i < 8; i++) {
+		in[i] = seed >> (8 * i);
+	}
+	in[8] = stream;
+	while (len > 0) {
+		uint32_t count = rng_blocks[stream]++;
+		for (unsigned int i = 0; i < 4; i++) {
+			in[9 + i] = count >> (8 * i);
+		}
+		cx_hash_sha256(in, sizeof(in), block, sizeof(block));
+		n = len < sizeof(block) ? len : sizeof(block);
+		memcpy(buf, block, n);
+		buf += n;
+		len -= n;
+	}
+	explicit_bzero(block, sizeof(block));
+}
+
+#endif // HAVE_ZIL_TEST_RNG
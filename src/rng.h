@@ -0,0 +1,39 @@
+#ifndef ZIL_NANOS_RNG_H
+#define ZIL_NANOS_RNG_H
+
+// Where the random bytes of the app come from: the nonces of Schnorr
+// signatures and the ids of resumable streams. Release builds draw them from
+// the device (cx_rng, cx_bn_rng). Test builds made with TEST_RNG=1 draw them
+// from a generator seeded at build time instead, so that the signatures and
+// responses of a Speculos run repeat byte for byte from one run, and one
+// machine, to the next. Their nonces give the keys away: such a build must
+// never be loaded on a device.
+
+#include <os.h>
+#include <cx.h>
+
+// Every consumer draws from a stream of its own: the nonce pool is filled
+// whenever the app is idle, and how its draws interleave with the others
+// must not change what each of them gets.
+#define ZIL_RNG_NONCE   0
+#define ZIL_RNG_SESSION 1
+#define ZIL_RNG_STREAMS 2
+
+#ifdef HAVE_ZIL_TEST_RNG
+
+#ifndef ZIL_TEST_RNG_SEED
+#define ZIL_TEST_RNG_SEED 0
+#endif
+
+// Fill buf with the next len bytes of a stream: 32 bytes at a time, the
+// SHA-256 of the seed (8 bytes), the stream (1 byte) and the number of
+// blocks drawn from it so far (4 bytes), integers little-endian.
+void zil_rng(uint8_t stream, unsigned char *buf, unsigned int len);
+
+#else
+
+#define zil_rng(stream, buf, len) ((void) (stream), cx_rng(buf, len))
+
+#endif // HAVE_ZIL_TEST_RNG
+
+#endif // ZIL_NANOS_RNG_H
@@ -2,72 +2,97 @@
 
 #include "schnorr.h"
 #include "zilliqa.h"
+#include "rng.h"
+
+// The curve is the SDK's own secp256k1: its order n and base point G are
+// loaded straight into the crypto accelerator, where the scalars and points
+// of a computation stay until it is over.
+#define CURVE CX_CURVE_SECP256K1
+#define SCALAR_LEN 32
+
+// Nonces (k, kG) computed ahead of time, each used by one signature at
+// most. The nonce_count of them from nonce_first on, wrapping around, are
+// ready; the other slots are all zeros. They are used in the order they
+// were computed, so that signatures get the nonces of the generator in
+// order however many of them were computed ahead (see rng.h).
+static struct {
+  unsigned char K[32];
+  unsigned char R[33];   // kG, compressed.
+} nonce_pool[ZIL_NONCE_POOL_SIZE];
+static unsigned int nonce_first, nonce_count;
+
+// Draw a random k from [0, ..., order-1] and compute its commitment
+// R = kG, compressed. K and R are left all zeros on error.
+static cx_err_t nonce_generate(unsigned char K[32], unsigned char R[33])
+{
+  cx_err_t error;
+  cx_bn_t n, k;
+  cx_ecpoint_t Q;
+  uint32_t odd = 0;
+#ifdef HAVE_ZIL_TEST_RNG
+  cx_bn_t d;
+#endif
+
+  CX_CHECK(cx_bn_lock(SCALAR_LEN, 0));
+  CX_CHECK(cx_bn_alloc(&n, SCALAR_LEN));
+  CX_CHECK(cx_ecdomain_parameter_bn(CURVE, CX_CURVE_PARAM_Order, n));
+  CX_CHECK(cx_bn_alloc(&k, SCALAR_LEN));
+#ifdef HAVE_ZIL_TEST_RNG
+  // Reduced rather than drawn again when not below n, about one chance in
+  // 2^128.
+  zil_rng(ZIL_RNG_NONCE, K, SCALAR_LEN);
+  CX_CHECK(cx_bn_alloc_init(&d, SCALAR_LEN, K, SCALAR_LEN));
+  CX_CHECK(cx_bn_reduce(k, d, n));
+#else
+  CX_CHECK(cx_bn_rng(k, n));
+#endif
+  CX_CHECK(cx_bn_export(k, K, SCALAR_LEN));
+
+  CX_CHECK(cx_ecpoint_alloc(&Q, CURVE));
+  CX_CHECK(cx_ecdomain_generator_bn(CURVE, &Q));
+  CX_CHECK(cx_ecpoint_rnd_scalarmul(&Q, K, SCALAR_LEN));
+  CX_CHECK(cx_ecpoint_compress(&Q, R+1, SCALAR_LEN, &odd));
+  R[0] = odd ? 0x03 : 0x02;
+
+end:
+  // Releasing the accelerator wipes its memory.
+  cx_bn_unlock();
+  if (error != CX_OK) {
+    explicit_bzero(K, SCALAR_LEN);
+    explicit_bzero(R, 1+SCALAR_LEN);
+  }
+  return error;
+}
+
+bool zil_ecschnorr_nonce_fill(void)
+{
+  unsigned int slot = (nonce_first + nonce_count) % ZIL_NONCE_POOL_SIZE;
 
-/* ------------------------------------------------------------------------ */
-/* ---                            secp256k1                             --- */
-/* ------------------------------------------------------------------------ */
-
-static unsigned char const C_cx_secp256k1_a[]  = {
-  // a:  0x00
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-static unsigned char const C_cx_secp256k1_b[]  = {
-  //b:  0x07
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07};
-static  unsigned char const C_cx_secp256k1_p []  = {
-  //p:  0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe, 0xff, 0xff, 0xfc, 0x2f};
-static unsigned char const C_cx_secp256k1_Hp[]  = {
-  //Hp: 0x000000000000000000000000000000000000000000000001000007a2000e90a1
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x07, 0xa2, 0x00, 0x0e, 0x90, 0xa1};
-static unsigned char const C_cx_secp256k1_Gx[] = {
-  //Gx: 0x79be667ef9dcbbac55a06295ce870b07029bfcdb2dce28d959f2815b16f81798
-  0x79, 0xbe, 0x66, 0x7e, 0xf9, 0xdc, 0xbb, 0xac, 0x55, 0xa0, 0x62, 0x95, 0xce, 0x87, 0x0b, 0x07,
-  0x02, 0x9b, 0xfc, 0xdb, 0x2d, 0xce, 0x28, 0xd9, 0x59, 0xf2, 0x81, 0x5b, 0x16, 0xf8, 0x17, 0x98};
-static unsigned char const C_cx_secp256k1_Gy[] = {
-  //Gy:  0x483ada7726a3c4655da4fbfc0e1108a8fd17b448a68554199c47d08ffb10d4b8
-  0x48, 0x3a, 0xda, 0x77, 0x26, 0xa3, 0xc4, 0x65, 0x5d, 0xa4, 0xfb, 0xfc, 0x0e, 0x11, 0x08, 0xa8,
-  0xfd, 0x17, 0xb4, 0x48, 0xa6, 0x85, 0x54, 0x19, 0x9c, 0x47, 0xd0, 0x8f, 0xfb, 0x10, 0xd4, 0xb8};
-static unsigned char const C_cx_secp256k1_n[]  = {
-  //n: 0xfffffffffffffffffffffffffffffffebaaedce6af48a03bbfd25e8cd0364141
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
-  0xba, 0xae, 0xdc, 0xe6, 0xaf, 0x48, 0xa0, 0x3b, 0xbf, 0xd2, 0x5e, 0x8c, 0xd0, 0x36, 0x41, 0x41};
-static unsigned char const C_cx_secp256k1_Hn[]  = {
-  //Hn:0x9d671cd581c69bc5e697f5e45bcd07c6741496c20e7cf878896cf21467d7d140
-  0x9d, 0x67, 0x1c, 0xd5, 0x81, 0xc6, 0x9b, 0xc5, 0xe6, 0x97, 0xf5, 0xe4, 0x5b, 0xcd, 0x07, 0xc6,
-  0x74, 0x14, 0x96, 0xc2, 0x0e, 0x7c, 0xf8, 0x78, 0x89, 0x6c, 0xf2, 0x14, 0x67, 0xd7, 0xd1, 0x40};
-
-static unsigned char const C_cx_secp256k1_h = 1;
-
-cx_curve_weierstrass_t const C_cx_secp256k1 = {
-  CX_CURVE_SECP256K1,
-  256, 32,
-  (unsigned char*)C_cx_secp256k1_a,
-  (unsigned char*)C_cx_secp256k1_b,
-  (unsigned char*)C_cx_secp256k1_p,
-  (unsigned char*)C_cx_secp256k1_Gx,
-  (unsigned char*)C_cx_secp256k1_Gy,
-  (unsigned char*)C_cx_secp256k1_n,
-  &C_cx_secp256k1_h,
-  (unsigned char*)C_cx_secp256k1_Hn,
-  (unsigned char*)C_cx_secp256k1_Hp
-};
+  if (nonce_count == ZIL_NONCE_POOL_SIZE) {
+    return false;
+  }
+  // On error the slot stays empty, and the signature that would have taken
+  // it computes its own nonce instead.
+  if (nonce_generate(nonce_pool[slot].K, nonce_pool[slot].R) != CX_OK) {
+    return false;
+  }
+  nonce_count++;
+  return true;
+}
+
+void zil_ecschnorr_nonce_wipe(void)
+{
+  explicit_bzero(nonce_pool, sizeof(nonce_pool));
+  nonce_first = 0;
+  nonce_count = 0;
+}
 
 // Begin schnorr signing. Initializes the already allocated parameter S.
 void zil_ecschnorr_sign_init
 (zil_ecschnorr_t *T, const cx_ecfp_private_key_t *pv_key)
 {
-  cx_curve_weierstrass_t WIDE const *domain = &C_cx_secp256k1;
-  unsigned int size = domain->length;
-
-  union {
-    unsigned char Q[65];
-    cx_ecfp_256_public_key_t  pub_key;
-  } U;
-  unsigned Q_LEN = sizeof(U.Q);
+  unsigned int size = SCALAR_LEN;
+  cx_ecfp_256_public_key_t pub_key;
   unsigned char R[33];
 
   assert(size==32 && sizeof(T->K) == size);
@@ -85,33 +110,26 @@ void zil_ecschnorr_sign_init
   // 5. If s = 0 goto 1.
   // 5  Signature on m is (r, s)
 
-  //generate random, pick a few extra bytes for better security.
-  unsigned char nonce[size+8];
-  cx_rng(nonce, size+8);
-  cx_math_modm(nonce, size+8, (unsigned WIDE char *) PIC(domain->n), size);
-  memcpy(T->K, nonce, size);
-
-  //sign
-  U.Q[0] = 4;
-  memmove(U.Q+1,      domain->Gx,size);
-  memmove(U.Q+1+size, domain->Gy,size);
-  cx_ecfp_scalar_mult(domain->curve, U.Q, Q_LEN, T->K, size);
-
-  if ((U.Q[2*size]&1) == 1) {
-    R[0] = 0x03;
-  } else {
-    R[0] = 0x02;
+  // Steps 1 and 2 may have been done already, while the app was idle.
+  if (nonce_count > 0) {
+    memcpy(T->K, nonce_pool[nonce_first].K, size);
+    memcpy(R, nonce_pool[nonce_first].R, sizeof(R));
+    explicit_bzero(&nonce_pool[nonce_first], sizeof(nonce_pool[nonce_first]));
+    nonce_first = (nonce_first + 1) % ZIL_NONCE_POOL_SIZE;
+    nonce_count--;
+  } else if (nonce_generate(T->K, R) != CX_OK) {
+    FAIL("Schnorr nonce generation failed");
   }
-  memmove(R+1, U.Q+1, size),
-  cx_ecfp_generate_pair2(domain->curve, &U.pub_key, (cx_ecfp_private_key_t *)pv_key, 1, CX_NONE);
-  if ((U.pub_key.W[2*size]&1) == 1) {
-    U.pub_key.W[0] = 0x03;
+
+  cx_ecfp_generate_pair2(CURVE, &pub_key, (cx_ecfp_private_key_t *)pv_key, 1, CX_NONE);
+  if ((pub_key.W[2*size]&1) == 1) {
+    pub_key.W[0] = 0x03;
   } else {
-    U.pub_key.W[0] = 0x02;
+    pub_key.W[0] = 0x02;
   }
   cx_sha256_init(&(T->H));
   cx_hash((cx_hash_t*) &(T->H), 0, R, 1+size, NULL, 0);
-  cx_hash((cx_hash_t*) &(T->H), 0, U.pub_key.W, 1+size, NULL, 0);
+  cx_hash((cx_hash_t*) &(T->H), 0, pub_key.W, 1+size, NULL, 0);
 }
 
 // Partially sign msg and update the schnorr state T.
@@ -122,37 +140,58 @@ void zil_ecschnorr_sign_continue
     cx_hash((cx_hash_t*) &(T->H), 0, msg, msg_len, NULL, 0);
 }
 
-// Complete the signing process and return signature.
+// Complete the signing process and return signature. Returns 0 when r or s
+// comes out as 0, and the nonce is then spent all the same.
 int zil_ecschnorr_sign_finish(
   zil_ecschnorr_t *T, const cx_ecfp_private_key_t *pv_key,
   unsigned char *sig, unsigned int sig_len)
 {
+  cx_err_t error;
+  cx_bn_t n, h, r, d, k, s;
+  bool zero = true;
+  unsigned char H[32];
+
   UNUSED(sig_len);
-  cx_curve_weierstrass_t WIDE const *domain = &C_cx_secp256k1;
-  unsigned int size = domain->length;
-  unsigned char R[32];
-  unsigned char S[32];
-
-  cx_hash((cx_hash_t*) &(T->H), CX_LAST|CX_NO_REINIT, NULL, 0, R, sizeof(R));
-  cx_math_modm(R, size, domain->n, size);
-  if (cx_math_is_zero(R, size)) {
-    return 0;
+
+  cx_hash((cx_hash_t*) &(T->H), CX_LAST|CX_NO_REINIT, NULL, 0, H, sizeof(H));
+
+  // Everything from r = H mod n to s = (k-r*pv_key.d)%n happens in
+  // accelerator memory, only r and s come out.
+  CX_CHECK(cx_bn_lock(SCALAR_LEN, 0));
+  CX_CHECK(cx_bn_alloc(&n, SCALAR_LEN));
+  CX_CHECK(cx_ecdomain_parameter_bn(CURVE, CX_CURVE_PARAM_Order, n));
+  CX_CHECK(cx_bn_alloc_init(&h, SCALAR_LEN, H, sizeof(H)));
+  CX_CHECK(cx_bn_alloc(&r, SCALAR_LEN));
+  CX_CHECK(cx_bn_reduce(r, h, n));
+  CX_CHECK(cx_bn_is_zero(r, &zero));
+  if (zero) {
+    goto end;
   }
-  //s = (k-r*pv_key.d)%n
-  cx_math_multm(sig, R, pv_key->d, domain->n, size);
-  cx_math_subm(S, T->K, sig, domain->n, size);
-  if (cx_math_is_zero(S, size)) {
-    return 0;
+
+  CX_CHECK(cx_bn_alloc_init(&d, SCALAR_LEN, pv_key->d, pv_key->d_len));
+  CX_CHECK(cx_bn_alloc_init(&k, SCALAR_LEN, T->K, sizeof(T->K)));
+  CX_CHECK(cx_bn_alloc(&s, SCALAR_LEN));
+  // h is done with, it takes r*d.
+  CX_CHECK(cx_bn_mod_mul(h, r, d, n));
+  CX_CHECK(cx_bn_mod_sub(s, k, h, n));
+  CX_CHECK(cx_bn_is_zero(s, &zero));
+  if (zero) {
+    goto end;
   }
 
-  // Clear for security reasons.
-  explicit_bzero(T->K, size);
+  CX_CHECK(cx_bn_export(r, sig, SCALAR_LEN));
+  CX_CHECK(cx_bn_export(s, sig+SCALAR_LEN, SCALAR_LEN));
 
-  // Move the (r,s) signature to the destination.
-  memmove (sig, R, size);
-  memmove (sig+size, S, size);
+end:
+  cx_bn_unlock();
+  // Clear for security reasons. A nonce is used once, even when it fails.
+  explicit_bzero(T->K, sizeof(T->K));
+  if (error != CX_OK) {
+    explicit_bzero(sig, SCHNORR_SIG_LEN_RS);
+    FAIL("Schnorr signature: accelerator error");
+  }
 
-  return 1;
+  return !zero;
 }
 
 // Sign a message in one go.
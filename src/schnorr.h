@@ -24,6 +24,7 @@ limitations under the License.
 // => 30 ..  02 03  01 02 03         02 03 00 81 02 03
 //
 
+#include <stdbool.h>
 #include <os.h>
 #include <cx.h>
 
@@ -32,6 +33,23 @@ typedef struct  {
     unsigned char K[32];   // Random number.
 } zil_ecschnorr_t;
 
+// Number of nonces zil_ecschnorr_nonce_fill keeps ready, 65 bytes of RAM
+// each.
+#ifndef ZIL_NONCE_POOL_SIZE
+#define ZIL_NONCE_POOL_SIZE 4
+#endif
+
+// Compute one nonce k and its commitment kG for a coming signature, unless
+// the pool is full. Returns whether it did; an accelerator error only
+// leaves the pool as it was. zil_ecschnorr_sign_init takes its nonce from
+// the pool when there is one, saving a scalar multiplication on the way to
+// the signature, and wipes it. Call it from the APDU loop only, never from
+// io_event: it takes as long as the scalar multiplication.
+bool zil_ecschnorr_nonce_fill(void);
+
+// Wipe the nonces not used yet.
+void zil_ecschnorr_nonce_wipe(void);
+
 void zil_ecschnorr_sign_init
   (zil_ecschnorr_t *T, const cx_ecfp_private_key_t *pv_key);
 
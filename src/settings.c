@@ -0,0 +1,19 @@
+#include "os.h"
+#include "settings.h"
+
+// In the NVM section of the app, zeroed when it is installed, like the book
+// of trusted recipients (see addr_book.c).
+const settings_t N_settings_real;
+#define N_settings (*(volatile settings_t *) PIC(&N_settings_real))
+
+bool settings_contract_data(void)
+{
+	return N_settings.contractData != 0;
+}
+
+void settings_set_contract_data(bool allowed)
+{
+	uint8_t value = allowed ? 1 : 0;
+
+	nvm_write((void*) &N_settings.contractData, &value, sizeof(value));
+}
@@ -0,0 +1,22 @@
+#ifndef ZIL_SETTINGS_H
+#define ZIL_SETTINGS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The settings of the app menu, kept in flash. An all-zero settings_t,
+// that of a new install, has every option off.
+
+typedef struct {
+	// Whether EVM transactions with calldata, contract calls and creations,
+	// may be signed. Their review only shows the selector and length of the
+	// data, so the user signs them blind.
+	uint8_t contractData;
+} settings_t;
+
+bool settings_contract_data(void);
+
+// Write the option to flash.
+void settings_set_contract_data(bool allowed);
+
+#endif
@@ -0,0 +1,546 @@
+// This file contains the implementation of the signEvmTxn command, which
+// signs the EVM transactions Zilliqa also runs, with the same keys as
+// signTxn. They come in the chunks of signTxn (see stream.h), and are RLP
+// encoded the way Ethereum signs them:
+//
+// - EIP-155 legacy transactions: rlp([nonce, gasPrice, gasLimit, to,
+//   value, data, chainId, 0, 0]).
+// - EIP-1559 transactions: 0x02 || rlp([chainId, nonce,
+//   maxPriorityFeePerGas, maxFeePerGas, gasLimit, to, value, data,
+//   accessList]).
+//
+// Every chunk goes into the Keccak-256 state as it comes in, and the RLP
+// decoder only keeps the fields shown in the review: the data of contract
+// calls, which may run into KBs, is never held in RAM. Once the user
+// approves, the hash is signed with ECDSA and the response is the y parity
+// of R (0 or 1), r and s. v is the y parity for EIP-1559 transactions, and
+// chainId * 2 + 35 + y parity for legacy ones.
+//
+// The data of a contract call or creation only shows as its selector and
+// length: such transactions are signed blind. They are refused with
+// SW_DATA_NOT_ALLOWED unless "Contract data" is allowed in the settings,
+// and their review then starts with a warning.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "os.h"
+#include "os_io_seproxyhal.h"
+#include "zilliqa.h"
+#include "zilliqa_ux.h"
+#include "uint256.h"
+#include "stream.h"
+#include "rlp.h"
+
+static signEvmTxnContext_t * const ctx = &global.signEvmTxnContext;
+
+// The type byte of EIP-1559 transactions (EIP-2718). Legacy ones start with
+// their RLP list.
+#define EVM_TXN_EIP1559 0x02
+// ZIL has 18 decimals on the EVM side, as ETH does.
+#define EVM_DECIMALS 18
+
+static void do_approve(void)
+{
+	deriveAndSignEcdsa(G_io_apdu_buffer, ECDSA_SIG_LEN_VRS, &ctx->path, ctx->hash);
+	explicit_bzero(ctx->hash, sizeof(ctx->hash));
+	io_exchange_with_code(SW_OK, ECDSA_SIG_LEN_VRS);
+#ifdef HAVE_BAGL
+	ui_idle();
+#else
+	nbgl_useCaseStatus("TRANSACTION\nSIGNED", true, ui_idle);
+#endif
+}
+
+static void do_reject(void)
+{
+	explicit_bzero(ctx->hash, sizeof(ctx->hash));
+	io_exchange_with_code(SW_USER_REJECTED, 0);
+#ifdef HAVE_BAGL
+	ui_idle();
+#else
+	nbgl_useCaseStatus("Transaction rejected", false, ui_idle);
+#endif
+}
+
+#ifdef HAVE_BAGL
+UX_FLOW_DEF_NOCB(
+    ux_signevm_flow_0_step,
+    bnnn_paging,
+    {
+      .title = "Blind signing",
+      .text = "The contract data can not be reviewed",
+    });
+UX_FLOW_DEF_NOCB(
+    ux_signevm_flow_1_step,
+    pnn,
+    {
+      &C_icon_certificate,
+      "Sign EVM Txn",
+      ctx->indexStr,
+    });
+UX_FLOW_DEF_NOCB(
+    ux_signevm_flow_2_step,
+    bnnn_paging,
+    {
+      .title = "Chain ID",
+      .text = ctx->chainStr,
+    });
+UX_FLOW_DEF_NOCB(
+    ux_signevm_flow_3_step,
+    bnnn_paging,
+    {
+      .title = "Amount",
+      .text = ctx->valueStr,
+    });
+UX_FLOW_DEF_NOCB(
+    ux_signevm_flow_4_step,
+    bnnn_paging,
+    {
+      .title = "Max fee",
+      .text = ctx->feeStr,
+    });
+UX_FLOW_DEF_NOCB(
+    ux_signevm_flow_5_step,
+    bnnn_paging,
+    {
+      .title = "Total",
+      .text = ctx->totalStr,
+    });
+UX_FLOW_DEF_NOCB(
+    ux_signevm_flow_6_step,
+    bnnn_paging,
+    {
+      .title = "To",
+      .text = ctx->toStr,
+    });
+UX_FLOW_DEF_NOCB(
+    ux_signevm_flow_7_step,
+    bnnn_paging,
+    {
+      .title = "Data",
+      .text = ctx->dataStr,
+    });
+UX_FLOW_DEF_VALID(
+    ux_signevm_flow_8_step,
+    pn,
+    do_approve(),
+    {
+      &C_icon_validate_14,
+      "Sign",
+    });
+UX_FLOW_DEF_VALID(
+    ux_signevm_flow_9_step,
+    pn,
+    do_reject(),
+    {
+      &C_icon_crossmark,
+      "Cancel",
+    });
+
+/* Transfer */
+UX_FLOW(ux_signevm_simple_flow,
+  &ux_signevm_flow_1_step,
+  &ux_signevm_flow_2_step,
+  &ux_signevm_flow_3_step,
+  &ux_signevm_flow_4_step,
+  &ux_signevm_flow_5_step,
+  &ux_signevm_flow_6_step,
+  &ux_signevm_flow_8_step,
+  &ux_signevm_flow_9_step);
+
+/* Contract call or creation */
+UX_FLOW(ux_signevm_data_flow,
+  &ux_signevm_flow_0_step,
+  &ux_signevm_flow_1_step,
+  &ux_signevm_flow_2_step,
+  &ux_signevm_flow_3_step,
+  &ux_signevm_flow_4_step,
+  &ux_signevm_flow_5_step,
+  &ux_signevm_flow_6_step,
+  &ux_signevm_flow_7_step,
+  &ux_signevm_flow_8_step,
+  &ux_signevm_flow_9_step);
+
+static void ui_display_sign_evm_txn_flow(void) {
+	formatKeyPath(ctx->indexStr, sizeof(ctx->indexStr), "with Key #", "with ", "?", &ctx->path);
+
+	if (ctx->fields.dataLen == 0) {
+		ux_flow_init(0, ux_signevm_simple_flow, NULL);
+	} else {
+		ux_flow_init(0, ux_signevm_data_flow, NULL);
+	}
+}
+
+#else // HAVE_BAGL
+
+static nbgl_layoutTagValue_t pairs[6];
+static nbgl_layoutTagValueList_t pairList = {0};
+static nbgl_pageInfoLongPress_t infoLongPress;
+
+static void transaction_rejected(void) {
+	do_reject();
+}
+
+static void reject_confirmation(void) {
+	nbgl_useCaseConfirm("Reject transaction?", NULL, "Yes, Reject", "Go back to transaction", transaction_rejected);
+}
+
+static void review_choice(bool confirm) {
+	if (confirm) {
+		do_approve();
+	} else {
+		reject_confirmation();
+	}
+}
+
+static void single_action_review_continue(void) {
+	pairs[0].item = "Chain ID";
+	pairs[0].value = ctx->chainStr;
+	pairs[1].item = "Amount";
+	pairs[1].value = ctx->valueStr;
+	pairs[2].item = "Max fee";
+	pairs[2].value = ctx->feeStr;
+	pairs[3].item = "Total";
+	pairs[3].value = ctx->totalStr;
+	pairs[4].item = "To";
+	pairs[4].value = ctx->toStr;
+	pairList.nbPairs = 5;
+	if (ctx->fields.dataLen != 0) {
+		pairs[5].item = "Data";
+		pairs[5].value = ctx->dataStr;
+		pairList.nbPairs = 6;
+	}
+
+	pairList.nbMaxLinesForValue = 0;
+	pairList.pairs = pairs;
+	infoLongPress.icon = &C_zilliqa_stax_64px;
+	infoLongPress.text = "Sign transaction";
+	infoLongPress.longPressText = "Hold to sign";
+
+	nbgl_useCaseStaticReview(&pairList, &infoLongPress, "Reject transaction", review_choice);
+}
+
+static void review_start(void) {
+	nbgl_useCaseReviewStart(&C_zilliqa_stax_64px,
+							"Review EVM transaction",
+							ctx->indexStr,
+							"Reject transaction",
+							single_action_review_continue,
+							reject_confirmation);
+}
+
+static void blind_signing_choice(bool confirm) {
+	if (confirm) {
+		review_start();
+	} else {
+		do_reject();
+	}
+}
+
+static void ui_display_sign_evm_txn_flow(void) {
+	formatKeyPath(ctx->indexStr, sizeof(ctx->indexStr), "Using key index ", "Using path ", "", &ctx->path);
+	if (ctx->fields.dataLen == 0) {
+		review_start();
+	} else {
+		nbgl_useCaseChoice(&C_zilliqa_stax_64px,
+						   "Blind signing",
+						   "This transaction calls a contract whose data can not be reviewed",
+						   "Continue",
+						   "Reject transaction",
+						   blind_signing_choice);
+	}
+}
+#endif // HAVE_BAGL
+
+// Hash the chunks after the first one as they come in.
+static void evm_hash_chunk(const uint8_t *chunk, unsigned int len)
+{
+	cx_hash((cx_hash_t*) &ctx->keccak, 0, chunk, len, NULL, 0);
+}
+
+static bool decode_uint256(rlp_decoder_t *d, uint256_t *v)
+{
+	uint8_t buf[32];
+
+	if (!rlp_read_uint(d, buf, sizeof(buf))) {
+		return false;
+	}
+	readu256BE(buf, v);
+	return true;
+}
+
+// The recipient: 20 bytes, or none for a contract creation.
+static bool decode_to(rlp_decoder_t *d)
+{
+	rlp_item_t item;
+
+	if (!rlp_next(d, &item) || item.list) {
+		return false;
+	}
+	if (item.len == 0) {
+		ctx->fields.hasTo = false;
+		return true;
+	}
+	ctx->fields.hasTo = true;
+	return item.len == PUB_ADDR_BYTES_LEN && rlp_read(d, &item, ctx->fields.to, PUB_ADDR_BYTES_LEN);
+}
+
+// The data is not kept, only its length and the function selector in its
+// first 4 bytes. The rest goes by as it streams in. Refused as soon as its
+// length is known unless the settings allow it, rather than after maybe
+// KBs of it have been streamed.
+static bool decode_data(rlp_decoder_t *d)
+{
+	rlp_item_t item;
+
+	if (!rlp_next(d, &item) || item.list) {
+		return false;
+	}
+	if (item.len != 0 && !settings_contract_data()) {
+		THROW(SW_DATA_NOT_ALLOWED);
+	}
+	ctx->fields.dataLen = item.len;
+	return rlp_read(d, &item, ctx->fields.selector, MIN(item.len, sizeof(ctx->fields.selector))) &&
+	       rlp_skip(d, &item);
+}
+
+// [[address, [storageKey, ...]], ...]: checked for its shape and skipped.
+static bool decode_access_list(rlp_decoder_t *d)
+{
+	rlp_item_t item;
+
+	if (!rlp_enter(d)) {
+		return false;
+	}
+	while (!rlp_at_end(d)) {
+		if (!rlp_enter(d) ||
+		    !rlp_next(d, &item) || item.list || item.len != PUB_ADDR_BYTES_LEN || !rlp_skip(d, &item) ||
+		    !rlp_enter(d)) {
+			return false;
+		}
+		while (!rlp_at_end(d)) {
+			if (!rlp_next(d, &item) || item.list || item.len != 32 || !rlp_skip(d, &item)) {
+				return false;
+			}
+		}
+		if (!rlp_leave(d) || !rlp_leave(d)) {
+			return false;
+		}
+	}
+	return rlp_leave(d);
+}
+
+static bool decode_legacy(rlp_decoder_t *d)
+{
+	evmTxnFields_t *f = &ctx->fields;
+	uint64_t nonce;
+	uint8_t zero[1];
+
+	// EIP-155: chainId, r = 0 and s = 0 follow the fields of the signed
+	// transaction. Without them, the signature could be replayed on any
+	// chain.
+	return rlp_read_u64(d, &nonce) &&
+	       decode_uint256(d, &f->gasPrice) &&
+	       rlp_read_u64(d, &f->gasLimit) &&
+	       decode_to(d) &&
+	       decode_uint256(d, &f->value) &&
+	       decode_data(d) &&
+	       rlp_read_u64(d, &f->chainId) && f->chainId != 0 &&
+	       rlp_read_uint(d, zero, 0) &&
+	       rlp_read_uint(d, zero, 0);
+}
+
+static bool decode_eip1559(rlp_decoder_t *d)
+{
+	evmTxnFields_t *f = &ctx->fields;
+	uint256_t maxPriorityFee;
+	uint64_t nonce;
+
+	// The most the transaction may cost is maxFeePerGas per gas.
+	return rlp_read_u64(d, &f->chainId) && f->chainId != 0 &&
+	       rlp_read_u64(d, &nonce) &&
+	       decode_uint256(d, &maxPriorityFee) &&
+	       decode_uint256(d, &f->gasPrice) &&
+	       rlp_read_u64(d, &f->gasLimit) &&
+	       decode_to(d) &&
+	       decode_uint256(d, &f->value) &&
+	       decode_data(d) &&
+	       decode_access_list(d);
+}
+
+// Write a wei amount as ZIL, e.g. "1.5 ZIL".
+static void format_wei(uint256_t *wei, char *out, size_t out_len)
+{
+	char digits[78 + 1];
+	size_t n, o = 0;
+
+	if (!tostring256(wei, 10, digits, sizeof(digits))) {
+		FAIL("Error converting 256b unsigned to decimal");
+	}
+	n = strlen(digits);
+	assert(out_len >= EVM_AMOUNT_STR_LEN);
+	if (n <= EVM_DECIMALS) {
+		out[o++] = '0';
+		out[o++] = '.';
+		memset(out + o, '0', EVM_DECIMALS - n);
+		o += EVM_DECIMALS - n;
+		memcpy(out + o, digits, n);
+		o += n;
+	} else {
+		memcpy(out, digits, n - EVM_DECIMALS);
+		o = n - EVM_DECIMALS;
+		out[o++] = '.';
+		memcpy(out + o, digits + n - EVM_DECIMALS, EVM_DECIMALS);
+		o += EVM_DECIMALS;
+	}
+	// No trailing zeros, nor a trailing decimal point.
+	while (out[o - 1] == '0') {
+		o--;
+	}
+	if (out[o - 1] == '.') {
+		o--;
+	}
+	out[o] = '\0';
+	strlcat(out, " ZIL", out_len);
+}
+
+static const char HEX[] = "0123456789abcdef";
+
+static void format_u64(uint64_t v, char *out, size_t out_len)
+{
+	char buf[20];
+	size_t n = 0;
+
+	do {
+		buf[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v != 0);
+	assert(out_len > n);
+	for (size_t i = 0; i < n; i++) {
+		out[i] = buf[n - 1 - i];
+	}
+	out[n] = '\0';
+}
+
+// Write the recipient with the mixed-case checksum of EIP-55, which wallets
+// show. Uses the Keccak state, so it must run before any other string
+// overwrites it.
+static void format_to(void)
+{
+	char hex[2 * PUB_ADDR_BYTES_LEN];
+	uint8_t digest[32];
+
+	if (!ctx->fields.hasTo) {
+		strlcpy(ctx->toStr, "New contract", sizeof(ctx->toStr));
+		return;
+	}
+	for (int i = 0; i < PUB_ADDR_BYTES_LEN; i++) {
+		hex[2 * i] = HEX[ctx->fields.to[i] >> 4];
+		hex[2 * i + 1] = HEX[ctx->fields.to[i] & 0x0F];
+	}
+	cx_keccak_init(&ctx->keccak, 256);
+	cx_hash((cx_hash_t*) &ctx->keccak, CX_LAST, (uint8_t*) hex, sizeof(hex), digest, sizeof(digest));
+	for (unsigned int i = 0; i < sizeof(hex); i++) {
+		uint8_t nibble = (digest[i / 2] >> ((i % 2) ? 0 : 4)) & 0x0F;
+		if (hex[i] >= 'a' && nibble >= 8) {
+			hex[i] -= 'a' - 'A';
+		}
+	}
+	ctx->toStr[0] = '0';
+	ctx->toStr[1] = 'x';
+	memcpy(ctx->toStr + 2, hex, sizeof(hex));
+	ctx->toStr[2 + sizeof(hex)] = '\0';
+}
+
+// Compute the maximum fee and the total cost, and format all the review
+// strings from ctx->fields. Must only be called once decoding and hashing
+// are done, as the strings share their storage with ctx->keccak.
+static void format_review_strings(void)
+{
+	evmTxnFields_t *f = &ctx->fields;
+	uint256_t gasLimit, fee, check, rem, total;
+
+	clear256(&gasLimit);
+	LOWER(LOWER(gasLimit)) = f->gasLimit;
+	mul256(&f->gasPrice, &gasLimit, &fee);
+	if (f->gasLimit != 0) {
+		divmod256(&fee, &gasLimit, &check, &rem);
+		if (!equal256(&check, &f->gasPrice)) {
+			FAIL("Transaction fee overflows 256b");
+		}
+	}
+	add256(&f->value, &fee, &total);
+	if (gt256(&f->value, &total)) {
+		FAIL("Transaction total overflows 256b");
+	}
+
+	format_to();
+	format_u64(f->chainId, ctx->chainStr, sizeof(ctx->chainStr));
+	format_wei(&f->value, ctx->valueStr, sizeof(ctx->valueStr));
+	format_wei(&fee, ctx->feeStr, sizeof(ctx->feeStr));
+	format_wei(&total, ctx->totalStr, sizeof(ctx->totalStr));
+
+	ctx->dataStr[0] = '\0';
+	if (f->dataLen != 0) {
+		unsigned int n = MIN(f->dataLen, sizeof(f->selector));
+		char *p = ctx->dataStr;
+		*p++ = '0';
+		*p++ = 'x';
+		for (unsigned int i = 0; i < n; i++) {
+			*p++ = HEX[f->selector[i] >> 4];
+			*p++ = HEX[f->selector[i] & 0x0F];
+		}
+		snprintf(p, sizeof(ctx->dataStr) - (p - ctx->dataStr), ", %u bytes", (unsigned int) f->dataLen);
+	}
+	PRINTF("Amount: %s, Max fee: %s, To: %s\n", ctx->valueStr, ctx->feeStr, ctx->toStr);
+	CHECK_CANARY;
+}
+
+// Hash and decode the transaction. May call io_exchange multiple times.
+static bool sign_evm_deserialize_stream(uint8_t p1, const uint8_t *dataBuffer, uint16_t dataLength)
+{
+	pb_istream_t stream = stream_start(&ctx->sd, &ctx->path, evm_hash_chunk, p1, dataBuffer,
+	                                   dataLength);
+	rlp_decoder_t *d = &ctx->rlp;
+	bool ok;
+
+	if (ctx->sd.len == 0) {
+		return false;
+	}
+	cx_keccak_init(&ctx->keccak, 256);
+	cx_hash((cx_hash_t*) &ctx->keccak, 0, ctx->sd.buf, ctx->sd.len, NULL, 0);
+	memset(&ctx->fields, 0, sizeof(ctx->fields));
+
+	// The first byte tells the type, and is already there to look at.
+	rlp_init(d, &stream);
+	if (ctx->sd.buf[0] == EVM_TXN_EIP1559) {
+		uint8_t type;
+		ok = pb_read(&stream, &type, 1) && rlp_enter(d) && decode_eip1559(d);
+	} else {
+		ok = rlp_enter(d) && decode_legacy(d);
+	}
+	// Every byte streamed has been hashed, and must have been decoded.
+	if (!ok || !rlp_leave(d) || !rlp_at_end(d)) {
+		PRINTF("sign_evm_deserialize_stream: bad RLP\n");
+		return false;
+	}
+	CHECK_CANARY;
+
+	cx_hash((cx_hash_t*) &ctx->keccak, CX_LAST, NULL, 0, ctx->hash, sizeof(ctx->hash));
+	format_review_strings();
+	return true;
+}
+
+void handleSignEvmTxn(uint8_t p1, uint8_t p2, uint8_t *dataBuffer, uint16_t dataLength, volatile unsigned int *flags, volatile unsigned int *tx) {
+	UNUSED(p2);
+	UNUSED(tx);
+
+	if (!sign_evm_deserialize_stream(p1, dataBuffer, dataLength)) {
+		FAIL("sign_evm_deserialize_stream failed");
+	}
+
+	ui_display_sign_evm_txn_flow();
+
+	*flags |= IO_ASYNCH_REPLY;
+}
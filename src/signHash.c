@@ -36,7 +36,7 @@ static void do_approve(void)
 		// the APDU buffer.
 		assert(SHA256_HASH_LEN == sizeof(ctx->hash));
 		deriveAndSign(G_io_apdu_buffer, SCHNORR_SIG_LEN_RS,
-									ctx->keyIndex, ctx->hash, SHA256_HASH_LEN);
+									&ctx->path, ctx->hash, SHA256_HASH_LEN);
 		// Send the data in the APDU buffer, which is a 64 byte signature.
 		assert(IO_APDU_BUFFER_SIZE >= SCHNORR_SIG_LEN_RS);
 		io_exchange_with_code(SW_OK, SCHNORR_SIG_LEN_RS);
@@ -100,7 +100,7 @@ UX_FLOW(ux_signhash_flow,
 
 void ui_display_sign_hash_flow(void) {
 	// Generate a string for the index.
-	snprintf(ctx->indexStr, sizeof(ctx->indexStr), "with Key #%d?", ctx->keyIndex);
+	formatKeyPath(ctx->indexStr, sizeof(ctx->indexStr), "with Key #", "with ", "?", &ctx->path);
 
 	ux_flow_init(0, ux_signhash_flow, NULL);
 }
@@ -145,7 +145,7 @@ static void single_action_review_continue(void) {
 }
 
 void ui_display_sign_hash_flow(void) {
-	snprintf(ctx->indexStr, sizeof(ctx->indexStr), "Using key index %d", ctx->keyIndex);
+	formatKeyPath(ctx->indexStr, sizeof(ctx->indexStr), "Using key index ", "Using path ", "", &ctx->path);
 	nbgl_useCaseReviewStart(&C_zilliqa_stax_64px,
 							"Review SHA256 hash\ntransaction",
 							ctx->indexStr,
@@ -160,20 +160,18 @@ void ui_display_sign_hash_flow(void) {
 // dataBuffer, initializing the command context, and displaying the first
 // screen of the command.
 void handleSignHash(uint8_t p1, uint8_t p2, uint8_t *dataBuffer, uint16_t dataLength, volatile unsigned int *flags, volatile unsigned int *tx) {
-	UNUSED(p1);
 	UNUSED(p2);
 	UNUSED(tx);
 
-	if (dataLength != sizeof(uint32_t) + sizeof(ctx->hash)) {
+	// Read the index or the path of the signing key. P1 is only looked at
+	// for P1_BIP32_PATH, its other bits are ignored.
+	unsigned int keyLen = readKeyPath(p1, dataBuffer, dataLength, &ctx->path);
+	if (dataLength != keyLen + sizeof(ctx->hash)) {
 		FAIL("Incorrect dataLength calling handleSignHash");
 	}
 
-	// Read the index of the signing key. U4LE is a helper macro for
-	// converting a 4-byte buffer to a uint32_t.
-	ctx->keyIndex = U4LE(dataBuffer, 0);
-
 	// Read the hash.
-	memmove(ctx->hash, dataBuffer+4, sizeof(ctx->hash));
+	memmove(ctx->hash, dataBuffer + keyLen, sizeof(ctx->hash));
 	// Prepare to display the comparison screen by converting the hash to hex
 	snprintf(ctx->hexHash, sizeof(ctx->hexHash), "%.*h", sizeof(ctx->hash), ctx->hash);
 	PRINTF("hash:    %.*H \n", 32, ctx->hash);
@@ -10,13 +10,32 @@
 #include "txn.pb.h"
 #include "uint256.h"
 #include "bech32_addr.h"
+#include "stream.h"
+#include "addr_book.h"
 
 static signTxnContext_t * const ctx = &global.signTxnContext;
 
+// Only the hash midstate, with the nonce and its commitment already hashed
+// in, is kept through the review: the key is derived again and the
+// signature computed once the user approved, as signHash does. The review
+// shows up as soon as the last chunk is decoded, and a rejection costs no
+// signing at all.
 static void do_approve(void)
 {
 		assert(IO_APDU_BUFFER_SIZE >= SCHNORR_SIG_LEN_RS);
-		memcpy(G_io_apdu_buffer, ctx->signature, SCHNORR_SIG_LEN_RS);
+		if (!deriveAndSignFinish(&ctx->ecs, &ctx->path, G_io_apdu_buffer, SCHNORR_SIG_LEN_RS)) {
+			// r or s is 0. Unlike zil_ecschnorr_sign, we cannot try another
+			// nonce: its commitment went into the hash before the
+			// transaction, which is gone. Have the host stream it again.
+			io_exchange_with_code(SW_SIGN_RETRY, 0);
+#ifdef HAVE_BAGL
+			ui_idle();
+#else
+			nbgl_useCaseStatus("Signing failed,\nplease retry", false, ui_idle);
+#endif
+			return;
+		}
+		PRINTF("do_approve: signature: 0x%.*h\n", SCHNORR_SIG_LEN_RS, G_io_apdu_buffer);
 		// Send the data in the APDU buffer, which is a 64 byte signature.
 		io_exchange_with_code(SW_OK, SCHNORR_SIG_LEN_RS);
 #ifdef HAVE_BAGL
@@ -29,6 +48,8 @@ static void do_approve(void)
 
 static void do_reject(void)
 {
+    // The nonce is never going to be used.
+    explicit_bzero(&ctx->ecs, sizeof(ctx->ecs));
     io_exchange_with_code(SW_USER_REJECTED, 0);
 #ifdef HAVE_BAGL
     ui_idle();
@@ -63,26 +84,40 @@ UX_FLOW_DEF_NOCB(
 UX_FLOW_DEF_NOCB(
     ux_signmsg_flow_4_step,
     bnnn_paging,
+    {
+      .title = "Max fee",
+      .text = ctx->feeStr,
+    });
+UX_FLOW_DEF_NOCB(
+    ux_signmsg_flow_5_step,
+    bnnn_paging,
+    {
+      .title = "Total",
+      .text = ctx->totalStr,
+    });
+UX_FLOW_DEF_NOCB(
+    ux_signmsg_flow_6_step,
+    bnnn_paging,
     {
       .title = "To",
       .text = ctx->toAddrStr,
     });
 UX_FLOW_DEF_NOCB(
-    ux_signmsg_flow_5_step,
+    ux_signmsg_flow_7_step,
     bnnn_paging,
     {
       .title = "Contract code",
       .text = ctx->codeStr,
     });
 UX_FLOW_DEF_NOCB(
-    ux_signmsg_flow_6_step,
+    ux_signmsg_flow_8_step,
     bnnn_paging,
     {
       .title = "Contract data",
       .text = ctx->dataStr,
     });
 UX_FLOW_DEF_VALID(
-    ux_signmsg_flow_7_step,
+    ux_signmsg_flow_9_step,
     pn,
     do_approve(),
     {
@@ -90,7 +125,7 @@ UX_FLOW_DEF_VALID(
       "Sign",
     });
 UX_FLOW_DEF_VALID(
-    ux_signmsg_flow_8_step,
+    ux_signmsg_flow_10_step,
     pn,
     do_reject(),
     {
@@ -104,8 +139,10 @@ UX_FLOW(ux_signmsg_simple_flow,
   &ux_signmsg_flow_2_step,
   &ux_signmsg_flow_3_step,
   &ux_signmsg_flow_4_step,
-  &ux_signmsg_flow_7_step,
-  &ux_signmsg_flow_8_step);
+  &ux_signmsg_flow_5_step,
+  &ux_signmsg_flow_6_step,
+  &ux_signmsg_flow_9_step,
+  &ux_signmsg_flow_10_step);
 
 /* Flow without Smart Contract code but with data */
 UX_FLOW(ux_signmsg_data_flow,
@@ -113,9 +150,11 @@ UX_FLOW(ux_signmsg_data_flow,
   &ux_signmsg_flow_2_step,
   &ux_signmsg_flow_3_step,
   &ux_signmsg_flow_4_step,
+  &ux_signmsg_flow_5_step,
   &ux_signmsg_flow_6_step,
-  &ux_signmsg_flow_7_step,
-  &ux_signmsg_flow_8_step);
+  &ux_signmsg_flow_8_step,
+  &ux_signmsg_flow_9_step,
+  &ux_signmsg_flow_10_step);
 
 /* Flow with Smart Contract code and data */
 UX_FLOW(ux_signmsg_code_data_flow,
@@ -126,11 +165,13 @@ UX_FLOW(ux_signmsg_code_data_flow,
   &ux_signmsg_flow_5_step,
   &ux_signmsg_flow_6_step,
   &ux_signmsg_flow_7_step,
-  &ux_signmsg_flow_8_step);
+  &ux_signmsg_flow_8_step,
+  &ux_signmsg_flow_9_step,
+  &ux_signmsg_flow_10_step);
 
 void ui_display_sign_txn_flow(void) {
 	// Generate a string for the index.
-	snprintf(ctx->indexStr, sizeof(ctx->indexStr), "with Key #%d?", ctx->keyIndex);
+	formatKeyPath(ctx->indexStr, sizeof(ctx->indexStr), "with Key #", "with ", "?", &ctx->path);
 
 	if (ctx->codeStr[0] == '\0') {
 		if (ctx->dataStr[0] == '\0') {
@@ -145,7 +186,7 @@ void ui_display_sign_txn_flow(void) {
 
 #else // HAVE_BAGL
 
-static nbgl_layoutTagValue_t pairs[5];
+static nbgl_layoutTagValue_t pairs[7];
 static nbgl_layoutTagValueList_t pairList = {0};
 static nbgl_pageInfoLongPress_t infoLongPress;
 
@@ -172,23 +213,27 @@ static void single_action_review_continue(void) {
 	pairs[0].value = ctx->amountStr;
 	pairs[1].item = "Gasprice";
 	pairs[1].value = ctx->gaspriceStr;
-	pairs[2].item = "To";
-	pairs[2].value = ctx->toAddrStr;
+	pairs[2].item = "Max fee";
+	pairs[2].value = ctx->feeStr;
+	pairs[3].item = "Total";
+	pairs[3].value = ctx->totalStr;
+	pairs[4].item = "To";
+	pairs[4].value = ctx->toAddrStr;
 
 	if (ctx->codeStr[0] == '\0') {
 		if (ctx->dataStr[0] == '\0') {
-			pairList.nbPairs = 3;
+			pairList.nbPairs = 5;
 		} else {
-			pairs[3].item = "Contract data";
-			pairs[3].value = ctx->dataStr;
-			pairList.nbPairs = 4;
+			pairs[5].item = "Contract data";
+			pairs[5].value = ctx->dataStr;
+			pairList.nbPairs = 6;
 		}
 	} else {
-		pairs[3].item = "Contract code";
-		pairs[3].value = ctx->codeStr;
-		pairs[4].item = "Contract data";
-		pairs[4].value = ctx->dataStr;
-		pairList.nbPairs = 5;
+		pairs[5].item = "Contract code";
+		pairs[5].value = ctx->codeStr;
+		pairs[6].item = "Contract data";
+		pairs[6].value = ctx->dataStr;
+		pairList.nbPairs = 7;
 	}
 
 	pairList.nbMaxLinesForValue = 0;
@@ -201,7 +246,7 @@ static void single_action_review_continue(void) {
 }
 
 void ui_display_sign_txn_flow(void) {
-	snprintf(ctx->indexStr, sizeof(ctx->indexStr), "Using key index %d", ctx->keyIndex);
+	formatKeyPath(ctx->indexStr, sizeof(ctx->indexStr), "Using key index ", "Using path ", "", &ctx->path);
 	nbgl_useCaseReviewStart(&C_zilliqa_stax_64px,
 							"Review transaction",
 							ctx->indexStr,
@@ -211,84 +256,6 @@ void ui_display_sign_txn_flow(void) {
 }
 #endif // HAVE_BAGL
 
-static bool istream_callback (pb_istream_t *stream, pb_byte_t *buf, size_t count)
-{
-	StreamData *sd = stream->state;
-	int bufNext = 0;
-	CHECK_CANARY;
-	PRINTF("istream_callback: sd->nextIdx = %d\n", sd->nextIdx);
-	PRINTF("istream_callback: sd->len = %d\n", sd->len);
-	int sdbufRem = sd->len - sd->nextIdx;
-	if (sdbufRem > 0) {
-		// We have some data to spare.
-		int copylen = MIN(sdbufRem, (int)count);
-		memcpy(buf, sd->buf + sd->nextIdx, copylen);
-		count -= copylen;
-		bufNext += copylen;
-		sd->nextIdx += copylen;
-		PRINTF("Streamed %d bytes of data.\n", copylen);
-	}
-
-	if (count > 0) {
-		// More data to be streamed, but we've run out. Stream from host.
-		PRINTF("Still need to stream %d bytes of data.\n", count);
-		assert(sd->len == sd->nextIdx);
-		if (sd->hostBytesLeft) {
-			G_io_apdu_buffer[0] = 0x90;
-			G_io_apdu_buffer[1] = 0x00;
-			unsigned rx = io_exchange(CHANNEL_APDU, 2);
-			// Sanity-check the command length
-			if (rx < OFFSET_CDATA) {
-				FAIL("Bad command length");
-			}
-			// APDU length and LC field consistency
-			if (rx - OFFSET_CDATA != G_io_apdu_buffer[OFFSET_LC]) {
-				FAIL("Bad command length");
-			}
-			static const uint32_t hostBytesLeftOffset = OFFSET_CDATA + 0;
-			static const uint32_t txnLenOffset = OFFSET_CDATA + 4;
-			static const uint32_t dataOffset = OFFSET_CDATA + 8;
-
-			// Sanity-check the command length
-			if (rx < OFFSET_CDATA + sizeof(uint32_t) + sizeof(uint32_t)) {
-				FAIL("Bad command length");
-			}
-
-			// These two cannot be made static as the function is recursive.
-			uint32_t hostBytesLeft = U4LE(G_io_apdu_buffer, hostBytesLeftOffset);
-			uint32_t txnLen = U4LE(G_io_apdu_buffer, txnLenOffset);
-			PRINTF("istream_callback: io_exchanged %d bytes\n", rx);
-			PRINTF("istream_callback: hostBytesLeft: %d\n", hostBytesLeft);
-			PRINTF("istream_callback: txnLen: %d\n", txnLen);
-			if (rx != dataOffset + txnLen) {
-				FAIL("Bad command length");
-			}
-			if (txnLen > TXN_BUF_SIZE) {
-				FAIL("Cannot handle large data sent from host");
-			}
-			assert(hostBytesLeft <= ZIL_MAX_TXN_SIZE - txnLen);
-
-			// Update and move data to our state.
-			sd->len = txnLen;
-			memcpy(sd->buf, G_io_apdu_buffer + dataOffset, txnLen);
-			sd->hostBytesLeft = hostBytesLeft;
-			sd->nextIdx = 0;
-			CHECK_CANARY;
-			// Take care of updating our signature state.
-			deriveAndSignContinue(&ctx->ecs, sd->buf, txnLen);
-
-			PRINTF("Making recursive call to stream after io_exchange\n");
-			return istream_callback(stream, buf+bufNext, count);
-		} else {
-			// We need more data but can't fetch again. This is an error.
-			FAIL("Ran out of data to stream from host");
-		}
-	}
-
-	return true;
-}
-
-
 static bool decode_and_store_in_ctx(pb_istream_t *stream, char* buffer, uint32_t buffer_len)
 {
 	size_t jsonLen = stream->bytes_left;
@@ -334,8 +301,6 @@ static bool decode_data_callback (pb_istream_t *stream, const pb_field_t *field,
 static bool decode_toaddr_callback (pb_istream_t *stream, const pb_field_t *field, void **arg)
 {
 	UNUSED(arg);
-	uint8_t buf[PUB_ADDR_BYTES_LEN];
-	char buf2[BECH32_ENCODE_BUF_LEN];
 
 	CHECK_CANARY;
 
@@ -343,21 +308,11 @@ static bool decode_toaddr_callback (pb_istream_t *stream, const pb_field_t *fiel
 		FAIL("Unexpected data");
 	}
 
-	if (pb_read(stream, (pb_byte_t*) buf, PUB_ADDR_BYTES_LEN)) {
-		CHECK_CANARY;
-		PRINTF("decoded bytes: 0x%.*h\n", PUB_ADDR_BYTES_LEN, buf);
-		// Write data for display.
-		if (!bech32_addr_encode(buf2, "zil", buf, PUB_ADDR_BYTES_LEN)) {
-			FAIL ("bech32 encoding of sendto address failed");
-		}
-		CHECK_CANARY;
-		if (strlen(buf2) != BECH32_ADDRSTR_LEN) {
-			FAIL ("bech32 encoded address of incorrect length");
-		}
-		assert(sizeof(ctx->toAddrStr) >= BECH32_ADDRSTR_LEN + 1);
-		memcpy(ctx->toAddrStr, buf2, BECH32_ADDRSTR_LEN);
-		ctx->toAddrStr[BECH32_ADDRSTR_LEN] = '\0';
-		CHECK_CANARY;
+	// The bech32 string for display is built once decoding is done.
+	if (pb_read(stream, (pb_byte_t*) ctx->fields.toAddr, PUB_ADDR_BYTES_LEN)) {
+		PRINTF("decoded bytes: 0x%.*h\n", PUB_ADDR_BYTES_LEN, ctx->fields.toAddr);
+		ctx->fields.flags.hasToAddr = 1;
+		ctx->fields.toAddrSlot = addr_book_find(ctx->fields.toAddr);
 	} else {
 		PRINTF("pb_read failed\n");
 		return false;
@@ -367,10 +322,99 @@ static bool decode_toaddr_callback (pb_istream_t *stream, const pb_field_t *fiel
 	return true;
 }
 
+// Convert a Qa value to a '\0' terminated decimal "<value> ZIL" string.
+static void format_zil_amount(uint128_t *qa, char *out, uint32_t out_len)
+{
+	// UINT128 can have a maximum of 39 decimal digits. When we convert
+	// "Qa" values to "Zil", we may have to append "0." at the start.
+	// So a total of 39 + 2 + '\0' = 42.
+	char buf[ZIL_UINT128_BUF_LEN];
+
+	if (!tostring128(qa, 10, buf, sizeof(buf))) {
+		FAIL("Error converting 128b unsigned to decimal");
+	}
+	PRINTF("128b to decimal converted value: %s\n", buf);
+	CHECK_CANARY;
+	qa_to_zil(buf, out, out_len);
+	strlcat(out, " ZIL", out_len);
+}
+
+// Encode the 20 bytes recipient address as a bech32 string for display,
+// or show the label of a trusted recipient instead.
+static void format_toaddr(void)
+{
+	char buf[BECH32_ENCODE_BUF_LEN];
+
+	if (ctx->fields.toAddrSlot >= 0) {
+		assert(sizeof(ctx->toAddrStr) >= ADDR_BOOK_LABEL_MAX + sizeof(" (trusted)"));
+		addr_book_label(ctx->fields.toAddrSlot, ctx->toAddrStr);
+		strlcat(ctx->toAddrStr, " (trusted)", sizeof(ctx->toAddrStr));
+		return;
+	}
+
+	if (!bech32_addr_encode(buf, "zil", ctx->fields.toAddr, PUB_ADDR_BYTES_LEN)) {
+		FAIL ("bech32 encoding of sendto address failed");
+	}
+	CHECK_CANARY;
+	if (strlen(buf) != BECH32_ADDRSTR_LEN) {
+		FAIL ("bech32 encoded address of incorrect length");
+	}
+	assert(sizeof(ctx->toAddrStr) >= BECH32_ADDRSTR_LEN + 1);
+	memcpy(ctx->toAddrStr, buf, BECH32_ADDRSTR_LEN);
+	ctx->toAddrStr[BECH32_ADDRSTR_LEN] = '\0';
+}
+
+// Compute the maximum fee (gasprice * gaslimit) and the total cost
+// (amount + fee) of the decoded transaction, and format all the review
+// strings from ctx->fields. Must only be called once pb_decode is done,
+// as the strings share their storage with ctx->txn.
+static void format_review_strings(void)
+{
+	txnFields_t *f = &ctx->fields;
+	uint256_t gasprice, gaslimit, fee;
+	uint128_t total;
+
+	// The product of a 128b gasprice and a 64b gaslimit may not fit in
+	// 128b, so compute it on 256b and check the upper half.
+	clear256(&gasprice);
+	copy128(&LOWER(gasprice), &f->gasprice);
+	clear256(&gaslimit);
+	LOWER(LOWER(gaslimit)) = f->gaslimit;
+	mul256(&gasprice, &gaslimit, &fee);
+	if (!zero128(&UPPER(fee))) {
+		FAIL("Transaction fee overflows 128b");
+	}
+
+	add128(&f->amount, &LOWER(fee), &total);
+	if (gt128(&f->amount, &total)) {
+		FAIL("Transaction total overflows 128b");
+	}
+
+	// Initialize the display messages.
+	ctx->toAddrStr[0] = '\0';
+	ctx->amountStr[0] = '\0';
+	ctx->gaspriceStr[0] = '\0';
+
+	if (f->flags.hasToAddr) {
+		format_toaddr();
+	}
+	if (f->flags.hasAmount) {
+		format_zil_amount(&f->amount, ctx->amountStr, sizeof(ctx->amountStr));
+		PRINTF("Amount Qa converted to Zil: %s\n", ctx->amountStr);
+	}
+	if (f->flags.hasGasprice) {
+		format_zil_amount(&f->gasprice, ctx->gaspriceStr, sizeof(ctx->gaspriceStr));
+		PRINTF("Gasprice Qa converted to Zil: %s\n", ctx->gaspriceStr);
+	}
+	format_zil_amount(&LOWER(fee), ctx->feeStr, sizeof(ctx->feeStr));
+	format_zil_amount(&total, ctx->totalStr, sizeof(ctx->totalStr));
+	PRINTF("Max fee: %s, Total: %s\n", ctx->feeStr, ctx->totalStr);
+	CHECK_CANARY;
+}
+
 static bool decode_amount_gasprice_callback (pb_istream_t *stream, const pb_field_t *field, void **arg)
 {
 	uint8_t buf[ZIL_AMOUNT_GASPRICE_BYTES];
-	char buf2[ZIL_UINT128_BUF_LEN];
 
 	CHECK_CANARY;
 
@@ -386,9 +430,7 @@ static bool decode_amount_gasprice_callback (pb_istream_t *stream, const pb_fiel
 	if (pb_read(stream, (pb_byte_t*) buf, ZIL_AMOUNT_GASPRICE_BYTES)) {
 		CHECK_CANARY;
 		PRINTF("decoded bytes: 0x%.*h\n", ZIL_AMOUNT_GASPRICE_BYTES, buf);
-		// Write data for display.
 		// It is either gasprice or amount. a uint128_t value.
-		// Convert to decimal, appending a '\0'.
 		// ZIL data is big-endian, we need little-endian here.
 		for (int i = 0; i < 4; i++) {
 			// The upper 64b and lower 64b themselves aren't swapped, just within them.
@@ -402,24 +444,14 @@ static bool decode_amount_gasprice_callback (pb_istream_t *stream, const pb_fiel
 			buf[15-i] = t;
 		}
 		CHECK_CANARY;
-		// UINT128 can have a maximum of 39 decimal digits. When we convert
-		// "Qa" values to "Zil", we may have to append "0." at the start.
-		// So a total of 39 + 2 + '\0' = 42.
-		if (tostring128((uint128_t*)buf, 10, buf2, sizeof(buf2))) {
-			PRINTF("128b to decimal converted value: %s\n", buf2);
-			CHECK_CANARY;
-			if ((int) *arg == ProtoTransactionCoreInfo_amount_tag) {
-				qa_to_zil(buf2, ctx->amountStr, sizeof(ctx->amountStr));
-				strlcat(ctx->amountStr, " ZIL", sizeof(ctx->amountStr));
-				PRINTF("Amount Qa converted to Zil: %s\n", ctx->amountStr);
-			} else {
-				qa_to_zil(buf2, ctx->gaspriceStr, sizeof(ctx->gaspriceStr));
-				strlcat(ctx->gaspriceStr, " ZIL", sizeof(ctx->gaspriceStr));
-				PRINTF("Gasprice Qa converted to Zil: %s\n", ctx->gaspriceStr);
-			}
-			CHECK_CANARY;
+		// Keep the raw value around, the display strings, fee and total
+		// are computed from it once the whole transaction has been decoded.
+		if ((int) *arg == ProtoTransactionCoreInfo_amount_tag) {
+			copy128(&ctx->fields.amount, (uint128_t*)buf);
+			ctx->fields.flags.hasAmount = 1;
 		} else {
-			FAIL("Error converting 128b unsigned to decimal");
+			copy128(&ctx->fields.gasprice, (uint128_t*)buf);
+			ctx->fields.flags.hasGasprice = 1;
 		}
 		CHECK_CANARY;
 	} else {
@@ -431,34 +463,36 @@ static bool decode_amount_gasprice_callback (pb_istream_t *stream, const pb_fiel
 	return true;
 }
 
-// Sign the txn, also deserializes parts of it. May call io_exchange multiple times.
+// Hash the chunks after the first one into the signature.
+static void sign_hash_chunk(const uint8_t *chunk, unsigned int len)
+{
+	deriveAndSignContinue(&ctx->ecs, chunk, len);
+}
+
+// Hash the txn for signing, also deserializes parts of it. May call io_exchange multiple times.
 // Output: 1. Display message will be populated in ctx->msg.
-//         2. Signature will be populated in ctx->signature.
-static bool sign_deserialize_stream(const uint8_t *txn1, int txn1Len, int hostBytesLeft)
+//         2. The hash state to sign from on approval will be in ctx->ecs.
+static bool sign_deserialize_stream(uint8_t p1, const uint8_t *dataBuffer, uint16_t dataLength)
 {
-	// Initialize stream data.
-	memcpy(ctx->sd.buf, txn1, txn1Len);
-	ctx->sd.nextIdx = 0; ctx->sd.len = txn1Len; ctx->sd.hostBytesLeft = hostBytesLeft;
-	assert(hostBytesLeft <= ZIL_MAX_TXN_SIZE - txn1Len);
-  // Setup the stream.
-	pb_istream_t stream = { istream_callback, &ctx->sd, hostBytesLeft + txn1Len, NULL };
+	// Setup the stream.
+	pb_istream_t stream = stream_start(&ctx->sd, &ctx->path, sign_hash_chunk, p1, dataBuffer,
+	                                   dataLength);
 
 	// Initialize the display messages.
-	ctx->toAddrStr[0] = '\0';
-	ctx->amountStr[0] = '\0';
-	ctx->gaspriceStr[0] = '\0';
 	ctx->codeStr[0] = '\0';
 	ctx->dataStr[0] = '\0';
 
 	CHECK_CANARY;
 	// Initialize schnorr signing, continue with what we have so far.
-	deriveAndSignInit(&ctx->ecs, ctx->keyIndex);
+	deriveAndSignInit(&ctx->ecs, &ctx->path);
 	CHECK_CANARY;
-	deriveAndSignContinue(&ctx->ecs, txn1, txn1Len);
+	deriveAndSignContinue(&ctx->ecs, ctx->sd.buf, ctx->sd.len);
 	CHECK_CANARY;
 
 	// Initialize protobuf Txn structs.
 	memset(&ctx->txn, 0, sizeof(ctx->txn));
+	memset(&ctx->fields, 0, sizeof(ctx->fields));
+	ctx->fields.toAddrSlot = -1;
 	// Set callbacks for handling the fields that what we need.
 	ctx->txn.toaddr.funcs.decode = decode_toaddr_callback;
 	// Since we're using the same callback for amount and gasprice,
@@ -473,11 +507,11 @@ static bool sign_deserialize_stream(const uint8_t *txn1, int txn1Len, int hostBy
 
 	CHECK_CANARY;
 
-	// Start decoding (and signing).
+	// Start decoding (and hashing).
 	if (pb_decode(&stream, ProtoTransactionCoreInfo_fields, &ctx->txn)) {
 		PRINTF ("pb_decode successful\n");
-		deriveAndSignFinish(&ctx->ecs, ctx->keyIndex, ctx->signature, SCHNORR_SIG_LEN_RS);
-		PRINTF ("sign_deserialize_stream: signature: 0x%.*h\n", SCHNORR_SIG_LEN_RS, ctx->signature);
+		ctx->fields.gaslimit = ctx->txn.gaslimit;
+		format_review_strings();
 	} else {
 		PRINTF ("pb_decode failed\n");
 		return false;
@@ -488,40 +522,13 @@ static bool sign_deserialize_stream(const uint8_t *txn1, int txn1Len, int hostBy
 }
 
 void handleSignTxn(uint8_t p1, uint8_t p2, uint8_t *dataBuffer, uint16_t dataLength, volatile unsigned int *flags, volatile unsigned int *tx) {
-	UNUSED(p1);
 	UNUSED(p2);
 	UNUSED(tx);
-	int txnLen, hostBytesLeft;
-
-	static const int dataIndexOffset = 0;      // offset for the key index to use
-	static const int dataHostBytesLeftOffset = 4; // offset for integer: is there more data (do io_exhange again)?
-	static const int dataTxnLenOffset = 8;     // offset for integer containing length of current txn
-	static const int dataOffset = 12;          // offset for actual transaction data.
-
-	// Sanity-check the command length
-	if (dataLength < sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t)) {
-		THROW(SW_WRONG_DATA_LENGTH);
-	}
-
-  // Read the various integers at the beginning.
-	ctx->keyIndex = U4LE(dataBuffer, dataIndexOffset);
-
-	PRINTF("handleSignTxn: keyIndex: %d \n", ctx->keyIndex);
-	hostBytesLeft = U4LE(dataBuffer, dataHostBytesLeftOffset);
-	PRINTF("handleSignTxn: hostBytesLeft: %d \n", hostBytesLeft);
-	txnLen = U4LE(dataBuffer, dataTxnLenOffset);
-	PRINTF("handleSignTxn: txnLen: %d\n", txnLen);
-	if (dataLength != dataOffset + txnLen) {
-		THROW(SW_WRONG_DATA_LENGTH);
-	}
-	if (txnLen > TXN_BUF_SIZE) {
-		FAIL("Cannot handle large data sent from host");
-	}
 
 	// Read the (partial) transaction and
-	// Sign the txn and get message for confirmation display, all in ctx.
-	// Signature will not go back to host until message display + approval.
-	if (!sign_deserialize_stream(dataBuffer + dataOffset, txnLen, hostBytesLeft)) {
+	// Hash the txn and get message for confirmation display, all in ctx.
+	// Signature will not be computed until message display + approval.
+	if (!sign_deserialize_stream(p1, dataBuffer, dataLength)) {
 		FAIL("sign_deserialize_stream failed");
 	}
 
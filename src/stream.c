@@ -0,0 +1,343 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "os.h"
+#include "os_io_seproxyhal.h"
+#include "zilliqa.h"
+#include "zilliqa_ux.h"
+#include "stream.h"
+#include "rng.h"
+
+static void put_u32le(uint8_t *p, uint32_t v)
+{
+	p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+// The CRC-32 of zlib and Ethernet, bit by bit: chunks are at most 243
+// bytes and a table would cost 1kB of flash for little gain.
+static uint32_t crc32_update(uint32_t crc, const uint8_t *p, size_t n)
+{
+	crc = ~crc;
+	while (n--) {
+		crc ^= *p++;
+		for (int i = 0; i < 8; i++) {
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+		}
+	}
+	return ~crc;
+}
+
+// Length of the fields between txnLen and the data of a chunk.
+static unsigned chunk_check_len(uint8_t flags)
+{
+	return ((flags & P1_SIGN_TXN_OFFSETS) ? sizeof(uint32_t) : 0) +
+	       ((flags & P1_SIGN_TXN_CHECKSUM) ? sizeof(uint32_t) : 0);
+}
+
+// Check that a chunk follows the ones already hashed: its hostBytesLeft and
+// txnLen add up to what was left, and when the stream asked for them, its
+// offset is where the previous chunk ended and its checksum covers what was
+// received so far plus this chunk. A dropped, repeated or corrupted chunk
+// is then caught as soon as it comes in, and not when the decoder trips
+// over it, maybe after the whole transaction went through. On success the
+// chunk becomes the one to read from.
+static uint16_t stream_accept_chunk(StreamData *sd, uint32_t hostBytesLeft, uint32_t txnLen,
+                                    const uint8_t *check, const uint8_t *data)
+{
+	uint32_t crc = sd->crc;
+
+	if (hostBytesLeft + txnLen != (uint32_t)sd->hostBytesLeft) {
+		return SW_STREAM_MISMATCH;
+	}
+	if (sd->flags & P1_SIGN_TXN_OFFSETS) {
+		if (U4LE(check, 0) != sd->offset) {
+			return SW_STREAM_MISMATCH;
+		}
+		check += sizeof(uint32_t);
+	}
+	if (sd->flags & P1_SIGN_TXN_CHECKSUM) {
+		crc = crc32_update(crc, data, txnLen);
+		if (U4LE(check, 0) != crc) {
+			return SW_STREAM_MISMATCH;
+		}
+	}
+
+	// The data stays in the APDU buffer.
+	sd->len = txnLen;
+	sd->buf = data;
+	sd->hostBytesLeft = hostBytesLeft;
+	sd->nextIdx = 0;
+	sd->offset += txnLen;
+	sd->crc = crc;
+	return SW_OK;
+}
+
+// Only the command that started the stream goes on with it, or resumes it:
+// anything else in the middle of a stream is refused.
+static void stream_check_frame(const StreamData *sd, unsigned rx)
+{
+	if (rx < OFFSET_CDATA) {
+		FAIL("Bad command length");
+	}
+	if (G_io_apdu_buffer[OFFSET_CLA] != CLA || G_io_apdu_buffer[OFFSET_INS] != sd->ins) {
+		THROW(SW_IMPROPER_INIT);
+	}
+}
+
+// Answer the chunk just handled with sw and wait for the next one. Resumable
+// streams add the session id and the offset of the next byte expected to
+// the answer, and outlive a transport reset: the hash midstate and the
+// decoder, whose state is this very stack, are left as they are while the
+// transport comes back up. The host then sends P1_SIGN_TXN_RESUME with the
+// session id, and carries on from the offset it gets back. Nothing is
+// signed before the whole transaction has been streamed and approved, as
+// for any other stream.
+static unsigned stream_next_chunk(StreamData *sd, uint16_t sw)
+{
+	unsigned tx = 0;
+	if (sd->sessionId != 0) {
+		put_u32le(G_io_apdu_buffer, sd->sessionId);
+		put_u32le(G_io_apdu_buffer + 4, sd->offset);
+		tx = 8;
+	}
+	G_io_apdu_buffer[tx++] = sw >> 8;
+	G_io_apdu_buffer[tx++] = sw & 0xFF;
+
+	if (sd->sessionId == 0) {
+		unsigned rx = io_exchange(CHANNEL_APDU, tx);
+		stream_check_frame(sd, rx);
+		return rx;
+	}
+
+	for (;;) {
+		volatile unsigned rx = 0;
+		volatile bool reset = false;
+		BEGIN_TRY {
+			TRY {
+				rx = io_exchange(CHANNEL_APDU, tx);
+			}
+			CATCH(EXCEPTION_IO_RESET) {
+				reset = true;
+			}
+			FINALLY {
+			}
+		}
+		END_TRY;
+
+		if (reset) {
+			PRINTF("stream_next_chunk: transport reset at offset %d\n", sd->offset);
+			zil_io_reset();
+			// Nothing to send, the host has to come back first.
+			tx = 0;
+			continue;
+		}
+		stream_check_frame(sd, rx);
+		if (G_io_apdu_buffer[OFFSET_P1] != P1_SIGN_TXN_RESUME) {
+			return rx;
+		}
+		if (rx != OFFSET_CDATA + sizeof(uint32_t) || G_io_apdu_buffer[OFFSET_LC] != sizeof(uint32_t) ||
+		    U4LE(G_io_apdu_buffer, OFFSET_CDATA) != sd->sessionId) {
+			FAIL("Bad resume");
+		}
+		// Tell the host where to pick up again.
+		put_u32le(G_io_apdu_buffer, sd->sessionId);
+		put_u32le(G_io_apdu_buffer + 4, sd->offset);
+		G_io_apdu_buffer[8] = 0x90;
+		G_io_apdu_buffer[9] = 0x00;
+		tx = 10;
+	}
+}
+
+static bool stream_read(StreamData *sd, pb_byte_t *buf, size_t count)
+{
+	int bufNext = 0;
+	CHECK_CANARY;
+	PRINTF("stream_read: sd->nextIdx = %d\n", sd->nextIdx);
+	PRINTF("stream_read: sd->len = %d\n", sd->len);
+	int sdbufRem = sd->len - sd->nextIdx;
+	if (sdbufRem > 0) {
+		// We have some data to spare.
+		int copylen = MIN(sdbufRem, (int)count);
+		memcpy(buf, sd->buf + sd->nextIdx, copylen);
+		count -= copylen;
+		bufNext += copylen;
+		sd->nextIdx += copylen;
+		PRINTF("Streamed %d bytes of data.\n", copylen);
+	}
+
+	if (count > 0) {
+		// More data to be streamed, but we've run out. Stream from host.
+		PRINTF("Still need to stream %d bytes of data.\n", count);
+		assert(sd->len == sd->nextIdx);
+		if (sd->hostBytesLeft) {
+			static const uint32_t hostBytesLeftOffset = OFFSET_CDATA + 0;
+			static const uint32_t txnLenOffset = OFFSET_CDATA + 4;
+			static const uint32_t checkOffset = OFFSET_CDATA + 8;
+			const uint32_t dataOffset = checkOffset + chunk_check_len(sd->flags);
+			uint16_t sw = SW_OK;
+
+			do {
+				unsigned rx = stream_next_chunk(sd, sw);
+				// Sanity-check the command length
+				if (rx < OFFSET_CDATA) {
+					FAIL("Bad command length");
+				}
+				// APDU length and LC field consistency
+				if (rx - OFFSET_CDATA != G_io_apdu_buffer[OFFSET_LC]) {
+					FAIL("Bad command length");
+				}
+				// Sanity-check the command length
+				if (rx < dataOffset) {
+					FAIL("Bad command length");
+				}
+
+				// These two cannot be made static as the function is recursive.
+				uint32_t hostBytesLeft = U4LE(G_io_apdu_buffer, hostBytesLeftOffset);
+				uint32_t txnLen = U4LE(G_io_apdu_buffer, txnLenOffset);
+				PRINTF("stream_read: io_exchanged %d bytes\n", rx);
+				PRINTF("stream_read: hostBytesLeft: %d\n", hostBytesLeft);
+				PRINTF("stream_read: txnLen: %d\n", txnLen);
+				if (rx != dataOffset + txnLen) {
+					FAIL("Bad command length");
+				}
+				assert(hostBytesLeft <= ZIL_MAX_TXN_SIZE - txnLen);
+
+				sw = stream_accept_chunk(sd, hostBytesLeft, txnLen, G_io_apdu_buffer + checkOffset,
+				                         G_io_apdu_buffer + dataOffset);
+				if (sw != SW_OK) {
+					PRINTF("stream_read: chunk does not follow offset %d\n", sd->offset);
+					// A resumable stream tells the host where it stands and
+					// waits for the right chunk, others end here.
+					if (sd->sessionId == 0) {
+						THROW(sw);
+					}
+				}
+			} while (sw != SW_OK);
+			CHECK_CANARY;
+			// Take care of updating our signature state.
+			sd->hash(sd->buf, sd->len);
+
+			PRINTF("Making recursive call to stream after io_exchange\n");
+			return stream_read(sd, buf+bufNext, count);
+		} else {
+			// We need more data but can't fetch again. This is an error.
+			FAIL("Ran out of data to stream from host");
+		}
+	}
+
+	return true;
+}
+
+static bool istream_callback(pb_istream_t *stream, pb_byte_t *buf, size_t count)
+{
+	StreamData *sd = stream->state;
+	bool ok;
+
+#ifdef PB_ISTREAM_WINDOW
+	// The varint decoders may have read from the window since the last
+	// call: the chunk is consumed up to where it starts.
+	sd->nextIdx = stream->window - sd->buf;
+#endif
+	ok = stream_read(sd, buf, count);
+#ifdef PB_ISTREAM_WINDOW
+	// What is left of the chunk, which may be a new one.
+	stream->window = sd->buf + sd->nextIdx;
+	stream->window_len = sd->len - sd->nextIdx;
+#endif
+	return ok;
+}
+
+pb_istream_t stream_start(StreamData *sd, bip32Path_t *path, stream_hash_fn *hash, uint8_t p1,
+                          const uint8_t *dataBuffer, uint16_t dataLength)
+{
+	int txnLen, hostBytesLeft;
+	uint32_t crc = 0;
+
+	static const int dataHostBytesLeftOffset = 0; // offset for integer: is there more data (do io_exhange again)?
+	static const int dataTxnLenOffset = 4;     // offset for integer containing length of current txn
+	static const int dataCheckOffset = 8;      // offset for the optional offset and checksum.
+	// offset for actual transaction data.
+	const unsigned dataOffset = dataCheckOffset + chunk_check_len(p1);
+
+	// A stream can only be resumed while it is still running, from
+	// istream_callback.
+	if (p1 == P1_SIGN_TXN_RESUME) {
+		THROW(SW_IMPROPER_INIT);
+	}
+	if (p1 & ~P1_SIGN_TXN_FLAGS) {
+		THROW(SW_INVALID_PARAM);
+	}
+
+	// The key index or path to use comes first, the offsets below are from
+	// its end.
+	unsigned int keyLen = readKeyPath(p1, dataBuffer, dataLength, path);
+	dataBuffer += keyLen;
+	dataLength -= keyLen;
+
+	// Sanity-check the command length
+	if (dataLength < dataOffset) {
+		THROW(SW_WRONG_DATA_LENGTH);
+	}
+
+  // Read the various integers at the beginning.
+	hostBytesLeft = U4LE(dataBuffer, dataHostBytesLeftOffset);
+	PRINTF("stream_start: hostBytesLeft: %d \n", hostBytesLeft);
+	txnLen = U4LE(dataBuffer, dataTxnLenOffset);
+	PRINTF("stream_start: txnLen: %d\n", txnLen);
+	if (dataLength != dataOffset + txnLen) {
+		THROW(SW_WRONG_DATA_LENGTH);
+	}
+
+	// The first chunk starts the transaction, its checksum covers itself.
+	const uint8_t *check = dataBuffer + dataCheckOffset;
+	if (p1 & P1_SIGN_TXN_OFFSETS) {
+		if (U4LE(check, 0) != 0) {
+			THROW(SW_STREAM_MISMATCH);
+		}
+		check += sizeof(uint32_t);
+	}
+	if (p1 & P1_SIGN_TXN_CHECKSUM) {
+		crc = crc32_update(0, dataBuffer + dataOffset, txnLen);
+		if (U4LE(check, 0) != crc) {
+			THROW(SW_STREAM_MISMATCH);
+		}
+	}
+	const uint8_t *txn1 = dataBuffer + dataOffset;
+
+	// Initialize stream data.
+	sd->buf = txn1;
+	sd->nextIdx = 0; sd->len = txnLen; sd->hostBytesLeft = hostBytesLeft;
+	sd->offset = txnLen;
+	sd->flags = p1;
+	// INS_SIGN_TXN or INS_SIGN_EVM_TXN, the first frame is still in the
+	// APDU buffer.
+	sd->ins = G_io_apdu_buffer[OFFSET_INS];
+	sd->crc = crc;
+	sd->sessionId = 0;
+	sd->hash = hash;
+	// A single frame has nothing to resume.
+	if ((p1 & P1_SIGN_TXN_RESUMABLE) && hostBytesLeft != 0) {
+		uint8_t id[4];
+		zil_rng(ZIL_RNG_SESSION, id, sizeof(id));
+		// Never 0, which stands for "not resumable".
+		sd->sessionId = U4LE(id, 0) | 1;
+	}
+	assert(hostBytesLeft <= ZIL_MAX_TXN_SIZE - txnLen);
+
+	if (hostBytesLeft == 0) {
+		// Most transfers fit in the first frame: decode them right from the
+		// APDU buffer, without going through istream_callback and its
+		// copies, and with skipped fields just stepped over.
+		return pb_istream_from_buffer(txn1, txnLen);
+	}
+	// errmsg is compiled out of pb_istream_t when PB_NO_ERRMSG is set.
+	return (pb_istream_t) {
+		.callback = istream_callback,
+		.state = sd,
+		.bytes_left = hostBytesLeft + txnLen,
+#ifdef PB_ISTREAM_WINDOW
+		.window = sd->buf,
+		.window_len = sd->len,
+#endif
+	};
+}
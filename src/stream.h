@@ -0,0 +1,54 @@
+#ifndef ZIL_STREAM_H
+#define ZIL_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pb_decode.h"
+#include "zilliqa.h"
+
+// A transaction too long for one APDU is streamed in chunks: every frame of
+// INS_SIGN_TXN and INS_SIGN_EVM_TXN carries hostBytesLeft (4 bytes, what
+// the host still has to send after this frame), txnLen (4 bytes, the chunk
+// length), the checks the first frame asked for, and the chunk. The first
+// frame starts with the key (see readKeyPath). Integers are little-endian.
+
+// P1 of the first frame, a combination of these flags.
+#define P1_SIGN_TXN_RESUMABLE 0x01
+// Every frame carries the offset of its first byte in the transaction.
+#define P1_SIGN_TXN_OFFSETS   0x04
+// Every frame carries the CRC-32 of the transaction up to its last byte.
+#define P1_SIGN_TXN_CHECKSUM  0x08
+// And P1_BIP32_PATH: the frame starts with a path instead of a key index.
+#define P1_SIGN_TXN_FLAGS (P1_SIGN_TXN_RESUMABLE | P1_SIGN_TXN_OFFSETS | P1_SIGN_TXN_CHECKSUM | \
+                           P1_BIP32_PATH)
+// P1 of a frame that picks a resumable stream up again.
+#define P1_SIGN_TXN_RESUME    0x02
+
+// Called with every chunk received after the first one, before it is
+// decoded: the hash of the transaction is updated as it streams by.
+typedef void stream_hash_fn(const uint8_t *chunk, unsigned int len);
+
+// The streamed chunks are not copied: buf points at the payload of the last
+// APDU received, inside G_io_apdu_buffer, which is left untouched until the
+// chunk has been fully consumed.
+typedef struct {
+	const uint8_t *buf;
+	uint8_t nextIdx, len;  // next read into buf and len of buf.
+	uint8_t flags;         // P1_SIGN_TXN_* flags of the first frame.
+	uint8_t ins;           // INS of the first frame, which every frame carries.
+	int hostBytesLeft;     // How many more bytes to be streamed from host.
+	uint32_t offset;       // Bytes received so far: where the next chunk starts.
+	uint32_t sessionId;    // Resumable streams only, 0 otherwise.
+	uint32_t crc;          // CRC-32 of the bytes received so far, if checked.
+	stream_hash_fn *hash;
+} StreamData;
+
+// stream_start reads the first frame of a stream into path and sd, and
+// returns the stream to decode the transaction from: pb_read and the
+// decoders built on it fetch the next chunks from the host as they need
+// them. The first chunk, in sd->buf and sd->len, is left for the caller to
+// hash. Throws on a malformed first frame.
+pb_istream_t stream_start(StreamData *sd, bip32Path_t *path, stream_hash_fn *hash, uint8_t p1,
+                          const uint8_t *dataBuffer, uint16_t dataLength);
+
+#endif
@@ -0,0 +1,182 @@
+// The function call tracer of TRACE=1 builds, see trace.h.
+//
+// Recording an event takes a few stores, so that the tracer barely changes
+// the timing it measures: the function address is kept as is, and the host
+// looks its name up in the ELF file.
+
+#ifdef HAVE_ZIL_TRACE
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <os.h>
+#include <os_io_seproxyhal.h>
+#include "zilliqa.h"
+#include "zilliqa_ux.h"
+#include "trace.h"
+
+#define NO_TRACE __attribute__((no_instrument_function))
+
+// The clock of the ticks. The default counts events, so a flame graph
+// weighs functions by the traced calls under them; builds with a cycle
+// counter can define ZIL_TRACE_CLOCK to a function reading it.
+#ifdef ZIL_TRACE_CLOCK
+uint32_t ZIL_TRACE_CLOCK(void);
+#else
+#define ZIL_TRACE_CLOCK() (trace.total)
+#endif
+
+// Where the stack ends, to turn the stack pointer into the stack left.
+#ifdef ZIL_TRACE_STACK_END
+extern uintptr_t ZIL_TRACE_STACK_END;
+#else
+// Defined by the link script.
+extern unsigned long _stack;
+#define ZIL_TRACE_STACK_END ((uintptr_t) &_stack)
+#endif
+
+static struct {
+	zilTraceRecord_t ring[ZIL_TRACE_LEN];
+	// The traced functions being run, innermost last.
+	uint32_t fns[ZIL_TRACE_DEPTH];
+	uint16_t stackLeft[ZIL_TRACE_DEPTH];
+	uint32_t total; // Events since the buffer was cleared.
+	uint8_t depth;
+	bool paused;
+} trace;
+
+void NO_TRACE zil_trace_pause(bool paused)
+{
+	trace.paused = paused;
+}
+
+static void NO_TRACE trace_record(void *fn, uint8_t kind)
+{
+	if (trace.paused) {
+		return;
+	}
+
+	uintptr_t sp = (uintptr_t) __builtin_frame_address(0);
+	uint16_t left = sp <= ZIL_TRACE_STACK_END ? 0 : MIN(sp - ZIL_TRACE_STACK_END, 0xFFFF);
+	uint8_t followed = MIN(trace.depth, ZIL_TRACE_DEPTH);
+	uint32_t id = (uintptr_t) fn;
+
+	if (kind == ZIL_TRACE_ENTER && trace.depth == followed) {
+		// A THROW leaves functions without their exit event. Their frames
+		// are gone once a new function gets one as deep, or when the same
+		// function is entered again with the same frame. Inlined functions
+		// share the frame of their caller, hence the second test.
+		while (followed > 0 && trace.stackLeft[followed - 1] < left) {
+			followed = --trace.depth;
+		}
+		if (followed > 0 && trace.stackLeft[followed - 1] == left &&
+		    trace.fns[followed - 1] == id) {
+			trace.depth--;
+		}
+	} else if (kind == ZIL_TRACE_EXIT) {
+		// Leave whatever fn called and left with a THROW as well.
+		uint8_t d = followed;
+		while (d > 0 && trace.fns[d - 1] != id) {
+			d--;
+		}
+		if (d > 0 && trace.depth == followed) {
+			trace.depth = d;
+		}
+		if (trace.depth > 0) {
+			trace.depth--;
+		}
+	}
+
+	zilTraceRecord_t *r = &trace.ring[trace.total % ZIL_TRACE_LEN];
+	r->fn = id;
+	r->tick = ZIL_TRACE_CLOCK();
+	r->stackLeft = left;
+	r->depth = trace.depth;
+	r->kind = kind;
+	trace.total++;
+
+	if (kind == ZIL_TRACE_ENTER) {
+		if (trace.depth < ZIL_TRACE_DEPTH) {
+			trace.fns[trace.depth] = id;
+			trace.stackLeft[trace.depth] = left;
+		}
+		if (trace.depth < UINT8_MAX) {
+			trace.depth++;
+		}
+	}
+}
+
+void __cyg_profile_func_enter(void *fn, void *callsite) NO_TRACE;
+void __cyg_profile_func_enter(void *fn, void *callsite)
+{
+	UNUSED(callsite);
+	trace_record(fn, ZIL_TRACE_ENTER);
+}
+
+void __cyg_profile_func_exit(void *fn, void *callsite) NO_TRACE;
+void __cyg_profile_func_exit(void *fn, void *callsite)
+{
+	UNUSED(callsite);
+	trace_record(fn, ZIL_TRACE_EXIT);
+}
+
+static void NO_TRACE put_u32le(uint8_t *p, uint32_t v)
+{
+	p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+// P1 of INS_DUMP_TRACE.
+#define P1_TRACE_READ  0x00
+#define P1_TRACE_CLEAR 0x01
+
+// handleDumpTrace reads the trace. P1_TRACE_READ takes the 2-byte index of
+// the first record wanted, 0 being the oldest one kept, and pauses the
+// tracer so that the records stay put while the host reads them. It answers
+// with the events recorded since the buffer was cleared (4 bytes), the
+// address of __cyg_profile_func_enter, for the host to find where the app
+// was loaded (4 bytes), and as many records as fit from the index on.
+// P1_TRACE_CLEAR empties the buffer and resumes tracing.
+void NO_TRACE handleDumpTrace(uint8_t p1, uint8_t p2, uint8_t *dataBuffer, uint16_t dataLength,
+                              volatile unsigned int *flags, volatile unsigned int *tx)
+{
+	UNUSED(p2);
+	UNUSED(flags);
+	UNUSED(tx);
+
+	if (p1 == P1_TRACE_CLEAR) {
+		trace.total = 0;
+		trace.depth = 0;
+		trace.paused = false;
+		io_exchange_with_code(SW_OK, 0);
+		return;
+	}
+	if (p1 != P1_TRACE_READ) {
+		THROW(SW_INVALID_PARAM);
+	}
+	if (dataLength != sizeof(uint16_t)) {
+		THROW(SW_WRONG_DATA_LENGTH);
+	}
+
+	trace.paused = true;
+	uint32_t kept = MIN(trace.total, ZIL_TRACE_LEN);
+	uint32_t oldest = trace.total - kept;
+	uint32_t index = dataBuffer[0] | (dataBuffer[1] << 8);
+	uint16_t len = 0;
+
+	put_u32le(G_io_apdu_buffer + len, trace.total);
+	len += 4;
+	put_u32le(G_io_apdu_buffer + len, (uintptr_t) &__cyg_profile_func_enter);
+	len += 4;
+	for (; index < kept && len + ZIL_TRACE_RECORD_LEN <= IO_APDU_BUFFER_SIZE - 2; index++) {
+		const zilTraceRecord_t *r = &trace.ring[(oldest + index) % ZIL_TRACE_LEN];
+		put_u32le(G_io_apdu_buffer + len, r->fn);
+		put_u32le(G_io_apdu_buffer + len + 4, r->tick);
+		G_io_apdu_buffer[len + 8] = r->stackLeft;
+		G_io_apdu_buffer[len + 9] = r->stackLeft >> 8;
+		G_io_apdu_buffer[len + 10] = r->depth;
+		G_io_apdu_buffer[len + 11] = r->kind;
+		len += ZIL_TRACE_RECORD_LEN;
+	}
+	io_exchange_with_code(SW_OK, len);
+}
+
+#endif // HAVE_ZIL_TRACE
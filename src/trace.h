@@ -0,0 +1,45 @@
+#ifndef ZIL_NANOS_TRACE_H
+#define ZIL_NANOS_TRACE_H
+
+// Function call tracer, for debug builds made with TRACE=1. The functions
+// of the files built with -finstrument-functions record an event when
+// they are entered and left into a ring buffer in RAM. INS_DUMP_TRACE reads
+// it back, and tools/trace2flame.py turns it into a flame graph and a stack
+// depth profile.
+
+#ifdef HAVE_ZIL_TRACE
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Events kept, the oldest are overwritten. 12 bytes each.
+#ifndef ZIL_TRACE_LEN
+#define ZIL_TRACE_LEN 64
+#endif
+
+// Nesting of traced functions the tracer follows, 6 bytes each.
+#ifndef ZIL_TRACE_DEPTH
+#define ZIL_TRACE_DEPTH 24
+#endif
+
+#define ZIL_TRACE_ENTER 0
+#define ZIL_TRACE_EXIT  1
+
+typedef struct {
+	uint32_t fn;        // Address of the function, resolved on the host.
+	uint32_t tick;      // ZIL_TRACE_CLOCK() at the event.
+	uint16_t stackLeft; // Bytes of stack left below the frame of fn.
+	uint8_t depth;      // Traced functions fn is nested in.
+	uint8_t kind;       // ZIL_TRACE_ENTER or ZIL_TRACE_EXIT.
+} zilTraceRecord_t;
+
+// Size of a record in an INS_DUMP_TRACE response, little-endian fields in
+// the order above.
+#define ZIL_TRACE_RECORD_LEN 12
+
+// Stop or resume recording.
+void zil_trace_pause(bool paused);
+
+#endif // HAVE_ZIL_TRACE
+
+#endif // ZIL_NANOS_TRACE_H
@@ -10,17 +10,173 @@
 
 #define KEY_SEED_LEN 32
 
-void getKeySeed(uint8_t* keySeed, uint32_t index) {
+// The one purpose and coin type the app may derive from (APP_LOAD_PARAMS).
+#define BIP32_HARDENED 0x80000000
+#define BIP32_PURPOSE  (44 | BIP32_HARDENED)
+#define BIP32_ZIL      (313 | BIP32_HARDENED)
+
+unsigned int readKeyPath(uint8_t p1, const uint8_t *data, unsigned int dataLength, bip32Path_t *path) {
+    if (!(p1 & P1_BIP32_PATH)) {
+        if (dataLength < sizeof(uint32_t)) {
+            THROW(SW_WRONG_DATA_LENGTH);
+        }
+        // bip32 path for 44'/313'/n'/0'/0'
+        // 313 0x80000139 ZIL Zilliqa
+        path->path[0] = BIP32_PURPOSE;
+        path->path[1] = BIP32_ZIL;
+        path->path[2] = U4LE(data, 0) | BIP32_HARDENED;
+        path->path[3] = BIP32_HARDENED;
+        path->path[4] = BIP32_HARDENED;
+        path->len = 5;
+        return sizeof(uint32_t);
+    }
+
+    if (dataLength < 1) {
+        THROW(SW_WRONG_DATA_LENGTH);
+    }
+    unsigned int len = data[0];
+    if (len <= 2 || len > MAX_BIP32_PATH) {
+        THROW(SW_INVALID_PARAM);
+    }
+    if (dataLength < 1 + len * sizeof(uint32_t)) {
+        THROW(SW_WRONG_DATA_LENGTH);
+    }
+    for (unsigned int i = 0; i < len; i++) {
+        path->path[i] = U4LE(data, 1 + i * sizeof(uint32_t));
+    }
+    if (path->path[0] != BIP32_PURPOSE || path->path[1] != BIP32_ZIL) {
+        THROW(SW_INVALID_PARAM);
+    }
+    path->len = len;
+    return 1 + len * sizeof(uint32_t);
+}
+
+bool keyPathIndex(const bip32Path_t *path, uint32_t *index) {
+    if (path->len != 5 || path->path[0] != BIP32_PURPOSE || path->path[1] != BIP32_ZIL ||
+        !(path->path[2] & BIP32_HARDENED) ||
+        path->path[3] != BIP32_HARDENED || path->path[4] != BIP32_HARDENED) {
+        return false;
+    }
+    *index = path->path[2] & ~BIP32_HARDENED;
+    return true;
+}
+
+void formatKeyPath(char *dst, size_t dst_len, const char *indexPrefix,
+                   const char *pathPrefix, const char *suffix, const bip32Path_t *path) {
+    uint32_t index;
+    if (keyPathIndex(path, &index)) {
+        snprintf(dst, dst_len, "%s%u%s", indexPrefix, index, suffix);
+        return;
+    }
+
+    strlcpy(dst, pathPrefix, dst_len);
+    for (unsigned int i = 0; i < path->len; i++) {
+        size_t n = strlen(dst);
+        snprintf(dst + n, dst_len - n, "%s%u%s", i ? "/" : "", path->path[i] & ~BIP32_HARDENED,
+                 (path->path[i] & BIP32_HARDENED) ? "'" : "");
+    }
+    strlcat(dst, suffix, dst_len);
+}
+
+#ifdef HAVE_ZIL_BIP32_CACHE
+// Every path starts with 44'/313', so its node is derived by the OS once per
+// command and kept, and getKeySeed only goes down the rest of the path
+// itself: a signature then costs one full derivation instead of two, one
+// to start hashing and one to sign once approved. The node is the key of
+// the whole account tree, so it is wiped when the command is over (see
+// wipeKeyCache).
+static struct {
+    uint8_t key[32];
+    uint8_t chain[32];
+    bool valid;
+} keyCache;
+
+static const uint8_t secp256k1_n[32] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
+    0xba, 0xae, 0xdc, 0xe6, 0xaf, 0x48, 0xa0, 0x3b,
+    0xbf, 0xd2, 0x5e, 0x8c, 0xd0, 0x36, 0x41, 0x41};
+
+// BIP32 private child key derivation, in place. Returns false, with key
+// wiped, in the (2^-127 likely) case BIP32 calls the child invalid or if
+// the accelerator fails, which is then left to the OS.
+static bool bip32Ckd(uint8_t key[32], uint8_t chain[32], uint32_t index) {
+    uint8_t data[1 + 32 + 4], I[64];
+    cx_err_t error;
+    int diff = 0;
+    bool valid = false;
+
+    if (index & BIP32_HARDENED) {
+        data[0] = 0;
+        memcpy(data + 1, key, 32);
+    } else {
+        cx_ecfp_private_key_t pk;
+        cx_ecfp_public_key_t publicKey;
+        cx_ecfp_init_private_key(CX_CURVE_SECP256K1, key, 32, &pk);
+        cx_ecfp_init_public_key(CX_CURVE_SECP256K1, NULL, 0, &publicKey);
+        cx_ecfp_generate_pair(CX_CURVE_SECP256K1, &publicKey, &pk, 1);
+        explicit_bzero(&pk, sizeof(pk));
+        compressPubKey(&publicKey);
+        memcpy(data, publicKey.W, PUBLIC_KEY_BYTES_LEN);
+    }
+    data[33] = index >> 24;
+    data[34] = index >> 16;
+    data[35] = index >> 8;
+    data[36] = index;
+
+    cx_hmac_sha512(chain, 32, data, sizeof(data), I, sizeof(I));
+    CX_CHECK(cx_math_cmp_no_throw(I, secp256k1_n, 32, &diff));
+    if (diff < 0) {
+        CX_CHECK(cx_math_addm_no_throw(key, key, I, secp256k1_n, 32));
+        uint8_t acc = 0;
+        for (int i = 0; i < 32; i++) {
+            acc |= key[i];
+        }
+        valid = acc != 0;
+        memcpy(chain, I + 32, 32);
+    }
+
+end:
+    if (!valid) {
+        explicit_bzero(key, 32);
+    }
+    explicit_bzero(data, sizeof(data));
+    explicit_bzero(I, sizeof(I));
+    return valid;
+}
 
-    // bip32 path for 44'/313'/n'/0'/0'
-    // 313 0x80000139 ZIL Zilliqa
-    uint32_t bip32Path[] = {44 | 0x80000000,
-                            313 | 0x80000000,
-                            index | 0x80000000,
-                            0x80000000,
-                            0x80000000};
+static bool getCachedKeySeed(uint8_t *keySeed, const bip32Path_t *path) {
+    uint8_t chain[32];
+    bool valid = true;
 
-    os_perso_derive_node_bip32(CX_CURVE_SECP256K1, bip32Path, 5, keySeed, NULL);
+    if (!keyCache.valid) {
+        os_perso_derive_node_bip32(CX_CURVE_SECP256K1, path->path, 2, keyCache.key, keyCache.chain);
+        keyCache.valid = true;
+    }
+    memcpy(keySeed, keyCache.key, 32);
+    memcpy(chain, keyCache.chain, 32);
+    for (unsigned int i = 2; valid && i < path->len; i++) {
+        valid = bip32Ckd(keySeed, chain, path->path[i]);
+    }
+    explicit_bzero(chain, sizeof(chain));
+    return valid;
+}
+#endif // HAVE_ZIL_BIP32_CACHE
+
+void wipeKeyCache(void) {
+#ifdef HAVE_ZIL_BIP32_CACHE
+    explicit_bzero(&keyCache, sizeof(keyCache));
+#endif
+}
+
+void getKeySeed(uint8_t* keySeed, const bip32Path_t *path) {
+#ifdef HAVE_ZIL_BIP32_CACHE
+    if (!getCachedKeySeed(keySeed, path)) {
+        os_perso_derive_node_bip32(CX_CURVE_SECP256K1, path->path, path->len, keySeed, NULL);
+    }
+#else
+    os_perso_derive_node_bip32(CX_CURVE_SECP256K1, path->path, path->len, keySeed, NULL);
+#endif
     PRINTF("keySeed: %.*H \n", KEY_SEED_LEN, keySeed);
 }
 
@@ -44,12 +200,12 @@ void compressPubKey(cx_ecfp_public_key_t *publicKey) {
     PLOC();
 }
 
-void deriveZilPubKey(uint32_t index,
+void deriveZilPubKey(const bip32Path_t *path,
                       cx_ecfp_public_key_t *publicKey) {
     cx_ecfp_private_key_t pk;
 
     uint8_t keySeed[KEY_SEED_LEN];
-    getKeySeed(keySeed, index);
+    getKeySeed(keySeed, path);
 
     cx_ecfp_init_private_key(CX_CURVE_SECP256K1, keySeed, 32, &pk);
 
@@ -65,12 +221,11 @@ void deriveZilPubKey(uint32_t index,
     PLOC();
 }
 
-void deriveAndSign(uint8_t *dst, uint32_t dst_len, uint32_t index, const uint8_t *msg, unsigned int msg_len) {
-    PRINTF("deriveAndSign: index: %d\n", index);
+void deriveAndSign(uint8_t *dst, uint32_t dst_len, const bip32Path_t *path, const uint8_t *msg, unsigned int msg_len) {
     PRINTF("deriveAndSign: msg: %.*H \n", msg_len, msg);
 
     uint8_t keySeed[KEY_SEED_LEN];
-    getKeySeed(keySeed, index);
+    getKeySeed(keySeed, path);
 
     cx_ecfp_private_key_t privateKey;
     cx_ecfp_init_private_key(CX_CURVE_SECP256K1, keySeed, 32, &privateKey);
@@ -87,14 +242,68 @@ void deriveAndSign(uint8_t *dst, uint32_t dst_len, uint32_t index, const uint8_t
     explicit_bzero(&privateKey, sizeof(privateKey));
 }
 
-void deriveAndSignInit(zil_ecschnorr_t *T, uint32_t index)
-{
-    PRINTF("deriveAndSignInit: index: %d\n", index);
+// s and n - s are both valid: keep the lower one, the only one Ethereum
+// accepts since EIP-2, and flip the parity of R along with it.
+static void ecdsaLowS(uint8_t *s, uint32_t *info) {
+    cx_err_t error;
+    cx_bn_t n, half, bs;
+    int diff = 0;
+
+    CX_CHECK(cx_bn_lock(32, 0));
+    CX_CHECK(cx_bn_alloc(&n, 32));
+    CX_CHECK(cx_ecdomain_parameter_bn(CX_CURVE_SECP256K1, CX_CURVE_PARAM_Order, n));
+    CX_CHECK(cx_bn_alloc(&half, 32));
+    CX_CHECK(cx_bn_copy(half, n));
+    CX_CHECK(cx_bn_shr(half, 1));
+    CX_CHECK(cx_bn_alloc_init(&bs, 32, s, 32));
+    CX_CHECK(cx_bn_cmp(bs, half, &diff));
+    if (diff > 0) {
+        // half is done with, it takes n - s.
+        CX_CHECK(cx_bn_sub(half, n, bs));
+        CX_CHECK(cx_bn_export(half, s, 32));
+        *info ^= CX_ECCINFO_PARITY_ODD;
+    }
+
+end:
+    cx_bn_unlock();
+    if (error != CX_OK) {
+        FAIL("ECDSA: accelerator error");
+    }
+}
 
+void deriveAndSignEcdsa(uint8_t *dst, uint32_t dst_len, const bip32Path_t *path, const uint8_t *hash) {
+    uint8_t keySeed[KEY_SEED_LEN];
+    cx_ecfp_private_key_t privateKey;
+    uint32_t info = 0;
+    cx_err_t error;
+
+    if (dst_len != ECDSA_SIG_LEN_VRS)
+        THROW (INVALID_PARAMETER);
+
+    getKeySeed(keySeed, path);
+    cx_ecfp_init_private_key(CX_CURVE_SECP256K1, keySeed, 32, &privateKey);
+    error = cx_ecdsa_sign_rs_no_throw(&privateKey, CX_RND_RFC6979 | CX_LAST, CX_SHA256, hash, 32, 32,
+                                      dst + 1, dst + 33, &info);
+
+    // Erase private keys for better security.
+    explicit_bzero(keySeed, sizeof(keySeed));
+    explicit_bzero(&privateKey, sizeof(privateKey));
+    // An x of R above n (2^-128 likely) has no v to recover it with.
+    if (error != CX_OK || (info & CX_ECCINFO_xGTn)) {
+        FAIL("ECDSA signature failed");
+    }
+
+    ecdsaLowS(dst + 33, &info);
+    dst[0] = (info & CX_ECCINFO_PARITY_ODD) ? 1 : 0;
+    PRINTF("deriveAndSignEcdsa: signature: %.*H\n", ECDSA_SIG_LEN_VRS, dst);
+}
+
+void deriveAndSignInit(zil_ecschnorr_t *T, const bip32Path_t *path)
+{
     uint8_t keySeed[KEY_SEED_LEN];
 
     CHECK_CANARY;
-    getKeySeed(keySeed, index);
+    getKeySeed(keySeed, path);
     cx_ecfp_private_key_t privateKey;
     cx_ecfp_init_private_key(CX_CURVE_SECP256K1, keySeed, 32, &privateKey);
     PRINTF("deriveAndSignInit: privateKey: %.*H \n", privateKey.d_len, privateKey.d);
@@ -117,14 +326,12 @@ void deriveAndSignContinue(zil_ecschnorr_t *T, const uint8_t *msg, unsigned int
     CHECK_CANARY;
 }
 
-int deriveAndSignFinish(zil_ecschnorr_t *T, uint32_t index, unsigned char *dst, unsigned int dst_len)
+int deriveAndSignFinish(zil_ecschnorr_t *T, const bip32Path_t *path, unsigned char *dst, unsigned int dst_len)
 {
-    PRINTF("deriveAndSignFinish: index: %d\n", index);
-
     uint8_t keySeed[KEY_SEED_LEN];
 
     CHECK_CANARY;
-    getKeySeed(keySeed, index);
+    getKeySeed(keySeed, path);
     cx_ecfp_private_key_t privateKey;
     cx_ecfp_init_private_key(CX_CURVE_SECP256K1, keySeed, 32, &privateKey);
     PRINTF("deriveAndSignFinish: privateKey: %.*H \n", privateKey.d_len, privateKey.d);
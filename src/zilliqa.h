@@ -65,10 +65,23 @@ void print_available_stack();
 // https://github.com/Zilliqa/Zilliqa/wiki/Address-Standard#specification
 #define BECH32_ADDRSTR_LEN (3 + 1 + 32 + 6)
 #define SCHNORR_SIG_LEN_RS 64
+// y parity of R, r and s.
+#define ECDSA_SIG_LEN_VRS 65
 #define ZIL_AMOUNT_GASPRICE_BYTES 16
 #define ZIL_MAX_TXN_SIZE 8388608 // 8MB
 // bech32_addr_encode requires 73 + strlen("zil") sized buffer.
 #define BECH32_ENCODE_BUF_LEN 73 + 3
+// Longest BIP32 path a command may ask for, 44'/313' included: the five
+// levels of BIP44 and one more. Every level costs 16 bytes of command
+// context, path and display string included.
+#define MAX_BIP32_PATH 6
+// Longest path as text: up to 10 digits and a "'" per component, "/"
+// between them and a '\0'.
+#define BIP32_PATH_STR_LEN (MAX_BIP32_PATH * 12)
+
+// With this P1 flag, commands read the key as a BIP32 path (see
+// readKeyPath) instead of a key index.
+#define P1_BIP32_PATH 0x80
 
 // exception codes
 #define SW_WRONG_DATA_LENGTH 0x6A87
@@ -77,6 +90,11 @@ void print_available_stack();
 #define SW_DEVELOPER_ERR     0x6B00
 #define SW_INVALID_PARAM     0x6B01
 #define SW_IMPROPER_INIT     0x6B02
+#define SW_STREAM_MISMATCH   0x6B03
+#define SW_SIGN_RETRY        0x6B04
+#define SW_BOOK_FULL         0x6B05
+#define SW_NOT_IN_BOOK       0x6B06
+#define SW_DATA_NOT_ALLOWED  0x6B07
 #define SW_USER_REJECTED     0x6985
 #define SW_OK                0x9000
 
@@ -84,26 +102,67 @@ void print_available_stack();
 #define U8BE(buf, off) (((uint64_t)(U4BE(buf, off))     << 32) | ((uint64_t)(U4BE(buf, off + 4)) & 0xFFFFFFFF))
 #define U8LE(buf, off) (((uint64_t)(U4LE(buf, off + 4)) << 32) | ((uint64_t)(U4LE(buf, off))     & 0xFFFFFFFF))
 
+// TYPES
+
+typedef struct {
+    uint32_t path[MAX_BIP32_PATH];
+    uint8_t len;
+} bip32Path_t;
+
 // FUNCTIONS
 
+// readKeyPath reads the key a command is for from the start of its data and
+// returns how many bytes it took. Without P1_BIP32_PATH in p1 that is a
+// 4-byte key index, for the path 44'/313'/index'/0'/0'. With it, a byte n
+// followed by the n components of the path, 4 bytes each, little-endian
+// like the other integers of the protocol. The path must stay within
+// 44'/313', the only one the app may derive from.
+unsigned int readKeyPath(uint8_t p1, const uint8_t *data, unsigned int dataLength, bip32Path_t *path);
+
+// keyPathIndex returns true, with the index in *index, when path is the one
+// of a key index.
+bool keyPathIndex(const bip32Path_t *path, uint32_t *index);
+
+// formatKeyPath writes the key a command uses for display, followed by
+// suffix: indexPrefix and the key index when the path is that of one, and
+// otherwise pathPrefix and the path, e.g. "44'/313'/0'/0/7".
+void formatKeyPath(char *dst, size_t dst_len, const char *indexPrefix,
+                   const char *pathPrefix, const char *suffix, const bip32Path_t *path);
+
+// wipeKeyCache forgets the cached 44'/313' node, if HAVE_ZIL_BIP32_CACHE.
+// zil_main and io_exchange_with_code call it at the end of every command, so
+// the node only outlives the command that derived it while that command
+// streams its data or waits for the user.
+void wipeKeyCache(void);
+
+
 // Convert un-compressed zilliqa public key to a compressed form.
 void compressPubKey(cx_ecfp_public_key_t *publicKey);
 
 // pubkeyToZilAddress converts a Ledger pubkey to a Zilliqa wallet address.
 void pubkeyToZilAddress(uint8_t *dst, cx_ecfp_public_key_t *publicKey);
 
-// deriveZilPubKey derives an Ed25519 key pair from an index and the Ledger
+// deriveZilPubKey derives an Ed25519 key pair from a path and the Ledger
 // seed. Returns the public key (private key is not needed).
-void deriveZilPubKey(uint32_t index, cx_ecfp_public_key_t *publicKey);
+void deriveZilPubKey(const bip32Path_t *path, cx_ecfp_public_key_t *publicKey);
 
 // Three functions to stream the signature process. See deriveAndSign to do in a single operation.
-void deriveAndSignInit(zil_ecschnorr_t *T, uint32_t index);
+void deriveAndSignInit(zil_ecschnorr_t *T, const bip32Path_t *path);
 void deriveAndSignContinue(zil_ecschnorr_t *T, const uint8_t *msg, unsigned int msg_len);
-int deriveAndSignFinish(zil_ecschnorr_t *T, uint32_t index, unsigned char *dst, unsigned int dst_len);
+// deriveAndSignFinish returns 0 when r or s came out as 0. The nonce is then
+// spent, and since its commitment is hashed before the message, trying a
+// new one means hashing the whole message again.
+int deriveAndSignFinish(zil_ecschnorr_t *T, const bip32Path_t *path, unsigned char *dst, unsigned int dst_len);
 
-// deriveAndSign derives an ECFP private key from an user specified index and the Ledger seed,
+// deriveAndSign derives an ECFP private key from an user specified path and the Ledger seed,
 // and uses it to produce a SCHNORR_SIG_LEN_RS length signature of the provided message
 // The key is cleared from memory after signing.
-void deriveAndSign(uint8_t *dst, uint32_t dst_len, uint32_t index, const uint8_t *msg, unsigned int msg_len);
+void deriveAndSign(uint8_t *dst, uint32_t dst_len, const bip32Path_t *path, const uint8_t *msg, unsigned int msg_len);
+
+// deriveAndSignEcdsa signs a 32-byte hash with ECDSA, as Ethereum does, with
+// the key of path. It writes the ECDSA_SIG_LEN_VRS bytes y parity of R
+// (0 or 1), r and s to dst. s is the low one of the two valid values
+// (EIP-2). The key is cleared from memory after signing.
+void deriveAndSignEcdsa(uint8_t *dst, uint32_t dst_len, const bip32Path_t *path, const uint8_t *hash);
 
 #endif
\ No newline at end of file
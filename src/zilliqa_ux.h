@@ -5,70 +5,146 @@
 #include "zilliqa.h"
 #include "qatozil.h"
 #include "txn.pb.h"
+#include "uint256.h"
+#include "stream.h"
+#include "rlp.h"
+#include "addr_book.h"
+#include "settings.h"
 #include "ux.h"
 #ifdef HAVE_NBGL
 #include "nbgl_use_case.h"
 #endif
 
-#define TXN_BUF_SIZE 256
 #define TXN_DISP_CODE_MAX_LEN 500 // Probably quite generous on Nano screens...
 #define TXN_DISP_DATA_MAX_LEN 500 // Probably quite generous on Nano screens...
+// Longest key line: "Using key index " + 10 digits, or "Using path " + a
+// path, and a '\0' either way.
+#define KEY_INDEX_STR_LEN (sizeof("Using path ") - 1 + BIP32_PATH_STR_LEN)
+#define ZIL_AMOUNT_STR_LEN (ZIL_UINT128_BUF_LEN + sizeof(" ZIL") - 1)
+// The 78 digits of a uint256_t in wei, a decimal point, " ZIL" and a '\0'.
+#define EVM_AMOUNT_STR_LEN (78 + 1 + sizeof(" ZIL"))
+// "0x" and 40 hex digits, or "New contract".
+#define EVM_ADDR_STR_LEN (2 + 2 * PUB_ADDR_BYTES_LEN + 1)
 
 typedef struct {
-	uint32_t keyIndex;
+	bip32Path_t path;
 	bool genAddr;
-	uint8_t displayIndex;
 	// NUL-terminated strings for display
-	char typeStr[40]; // variable-length
-	char keyStr[40]; // variable-length
+	char typeStr[28]; // variable-length
+	char keyStr[KEY_INDEX_STR_LEN]; // variable-length
 	char fullStr[77]; // variable length
-	// partialStr contains 12 characters of a longer string. This allows text
-	// to be scrolled.
-	char partialStr[13];
 } getPublicKeyContext_t;
 
 typedef struct {
-	uint32_t keyIndex;
+	bip32Path_t path;
 	uint8_t hash[32];
 	char hexHash[65]; // 2*sizeof(hash) + 1 for '\0'
-	uint8_t displayIndex;
 	// NUL-terminated strings for display
-	char indexStr[40]; // variable-length
-	uint8_t partialHashStr[13];
+	char indexStr[KEY_INDEX_STR_LEN]; // variable-length
 } signHashContext_t;
 
+// The transaction fields that are still needed once decoding is over.
 typedef struct {
-	uint8_t buf[TXN_BUF_SIZE];
-	uint32_t nextIdx, len; // next read into buf and len of buf.
-	int hostBytesLeft;     // How many more bytes to be streamed from host.
-} StreamData;
+	uint128_t amount;   // in Qa
+	uint128_t gasprice; // in Qa
+	uint64_t gaslimit;
+	uint8_t toAddr[PUB_ADDR_BYTES_LEN];
+	int8_t toAddrSlot;  // In the address book, -1 if not a trusted recipient.
+	struct {
+		uint8_t hasAmount : 1;
+		uint8_t hasGasprice : 1;
+		uint8_t hasToAddr : 1;
+	} flags;
+} txnFields_t;
 
 typedef struct {
-	uint32_t keyIndex;
+	bip32Path_t path;
 	zil_ecschnorr_t ecs;
-	uint8_t signature[SCHNORR_SIG_LEN_RS];
 	StreamData sd;
+	txnFields_t fields;
 
-	char toAddrStr[BECH32_ADDRSTR_LEN + 1];
-	char amountStr[ZIL_UINT128_BUF_LEN + sizeof(" ZIL") - 1];
-	char gaspriceStr[ZIL_UINT128_BUF_LEN + sizeof(" ZIL") - 1];
 	char codeStr[TXN_DISP_CODE_MAX_LEN];
 	char dataStr[TXN_DISP_DATA_MAX_LEN];
-	ProtoTransactionCoreInfo txn;
 
-	uint32_t displayIndex;
-	char indexStr[40]; // variable-length
+	// The nanopb struct is only used while decoding, and the review strings
+	// are only formatted from 'fields' after that, so they share storage.
+	union {
+		ProtoTransactionCoreInfo txn;
+		struct {
+			char toAddrStr[BECH32_ADDRSTR_LEN + 1];
+			char amountStr[ZIL_AMOUNT_STR_LEN];
+			char gaspriceStr[ZIL_AMOUNT_STR_LEN];
+			char feeStr[ZIL_AMOUNT_STR_LEN];   // gasprice * gaslimit
+			char totalStr[ZIL_AMOUNT_STR_LEN]; // amount + fee
+			char indexStr[KEY_INDEX_STR_LEN];  // variable-length
+		};
+	};
 } signTxnContext_t;
 
+// The EVM transaction fields that are still needed once decoding is over.
+typedef struct {
+	uint256_t value;    // in wei
+	uint256_t gasPrice; // in wei, maxFeePerGas for EIP-1559 transactions
+	uint64_t chainId;
+	uint64_t gasLimit;
+	uint32_t dataLen;
+	uint8_t selector[4]; // The first bytes of the data, at most 4.
+	uint8_t to[PUB_ADDR_BYTES_LEN];
+	bool hasTo;          // false for a contract creation.
+} evmTxnFields_t;
+
+typedef struct {
+	bip32Path_t path;
+	StreamData sd;
+	evmTxnFields_t fields;
+	uint8_t hash[32];   // Keccak-256 of the transaction, once streamed.
+
+	// The hash state and the decoder are only used while streaming, the
+	// review strings are only formatted after that.
+	union {
+		struct {
+			cx_sha3_t keccak;
+			rlp_decoder_t rlp;
+		};
+		struct {
+			char chainStr[21];                  // uint64_t in decimal
+			char toStr[EVM_ADDR_STR_LEN];
+			char valueStr[EVM_AMOUNT_STR_LEN];
+			char feeStr[EVM_AMOUNT_STR_LEN];    // gasPrice * gasLimit
+			char totalStr[EVM_AMOUNT_STR_LEN];  // value + fee
+			char dataStr[sizeof("0x12345678, 4294967295 bytes")];
+			char indexStr[KEY_INDEX_STR_LEN];   // variable-length
+		};
+	};
+} signEvmTxnContext_t;
+
+typedef struct {
+	uint8_t addr[PUB_ADDR_BYTES_LEN];
+	int8_t slot;        // In the address book.
+	bool remove;
+	// NUL-terminated strings for display
+	char label[ADDR_BOOK_LABEL_MAX + 1];
+	char addrStr[BECH32_ADDRSTR_LEN + 1];
+} addRecipientContext_t;
+
 // To save memory, we store all the context types in a single global union,
 // taking advantage of the fact that only one command is executed at a time.
 typedef union {
 	getPublicKeyContext_t getPublicKeyContext;
 	signHashContext_t signHashContext;
 	signTxnContext_t signTxnContext;
+	signEvmTxnContext_t signEvmTxnContext;
+	addRecipientContext_t addRecipientContext;
 } commandContext;
 extern commandContext global;
 
+// Upper bound on the size of the command context, in bytes. Raise it
+// knowingly: the union lives in the few KB of RAM the Nano S gives us. Run
+// "make context_sizes" to print the size of each context.
+#define COMMAND_CONTEXT_MAX_SIZE 1600
+_Static_assert(sizeof(commandContext) <= COMMAND_CONTEXT_MAX_SIZE,
+               "commandContext grew beyond COMMAND_CONTEXT_MAX_SIZE");
+
 // ui_idle displays the main menu screen. Command handlers should call ui_idle
 // when they finish.
 void ui_idle(void);
@@ -79,4 +155,9 @@ void ui_idle(void);
 // within G_io_apdu_buffer (before the code is appended).
 void io_exchange_with_code(uint16_t code, uint16_t tx);
 
+// zil_io_reset brings the USB transport back up after an EXCEPTION_IO_RESET
+// caught in the middle of a command. Unlike a restart of the main loop, it
+// leaves the screen and the BLE link alone.
+void zil_io_reset(void);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,57 @@
+import json
+import sys
+from pathlib import Path
+
+import pytest
+from ragger.conftest import configuration
+
+BENCH_DIR = Path(__file__).parent.resolve()
+
+# The benchmarks drive the app through the client of the functional tests.
+sys.path.insert(0, str(BENCH_DIR.parent / "functional"))
+
+###########################
+### CONFIGURATION START ###
+###########################
+
+# You can configure optional parameters by overriding the value of ragger.configuration.OPTIONAL_CONFIGURATION
+# Please refer to ragger/conftest/configuration.py for their descriptions and accepted values
+
+#########################
+### CONFIGURATION END ###
+#########################
+
+# Pull all features from the base ragger conftest using the overridden configuration
+pytest_plugins = ("ragger.conftest.base_conftest", )
+
+
+def pytest_addoption(parser):
+    parser.addoption("--bench_iterations", type=int, default=10,
+                     help="number of signatures per benchmark case")
+    parser.addoption("--bench_output", default="bench_results.json",
+                     help="file the results are written to, as JSON")
+    parser.addoption("--bench_thresholds", default=None,
+                     help="JSON file with the limits a case must stay within, none by default")
+
+
+@pytest.fixture(scope="session")
+def bench_iterations(pytestconfig):
+    return pytestconfig.getoption("bench_iterations")
+
+
+@pytest.fixture(scope="session")
+def bench_thresholds(pytestconfig):
+    path = pytestconfig.getoption("bench_thresholds")
+    if path is None:
+        return {}
+    with open(path) as f:
+        return json.load(f)
+
+
+@pytest.fixture(scope="session")
+def bench_results(pytestconfig):
+    results = []
+    yield results
+    with open(pytestconfig.getoption("bench_output"), "w") as f:
+        json.dump({"results": results}, f, indent=2)
+        f.write("\n")
@@ -0,0 +1,113 @@
+import math
+from time import perf_counter
+
+import pytest
+from ragger.backend import SpeculosBackend
+from ragger.bip import calculate_public_key_and_chaincode, CurveChoice
+
+from apps.zilliqa import ZilliqaClient, STREAM_LEN, MAX_STREAM_LEN
+from apps.txn_pb2 import ByteArray, ProtoTransactionCoreInfo
+from utils import auto_approve
+
+ZILLIQA_KEY_INDEX = 1
+
+# Size of the `data` field of the benchmarked transactions.
+TXN_SIZES = {
+    "simple": 0,
+    "1KB": 1024,
+    "10KB": 10 * 1024,
+    "100KB": 100 * 1024,
+}
+
+CHUNK_SIZES = [STREAM_LEN, 64, MAX_STREAM_LEN]
+
+# Large data fields are not displayed, but Nano S still pages through the
+# amounts and addresses one screen at a time.
+APPROVE_TIMEOUT = 120
+
+
+def make_transaction(data_len):
+    transaction = ProtoTransactionCoreInfo(
+        version=65537,
+        nonce=13,
+        toaddr=bytes.fromhex("8AD0357EBB5515F694DE597EDA6F3F6BDBAD0FD9"),
+        senderpubkey=ByteArray(data=bytes.fromhex("0205273e54f262f8717a687250591dcfb5755b8ce4e3bd340c7abefd0de1276574")),
+        amount=ByteArray(data=(1100000000000).to_bytes(16, byteorder='big')),
+        gasprice=ByteArray(data=(2000000000).to_bytes(16, byteorder='big')),
+        gaslimit=1
+    )
+    if data_len:
+        transaction.data = (b"{'bench':" + b"0" * data_len)[:data_len]
+    return transaction.SerializeToString()
+
+
+def percentile(samples, pct):
+    ordered = sorted(samples)
+    rank = max(1, math.ceil(pct / 100 * len(ordered)))
+    return ordered[rank - 1]
+
+
+def check_thresholds(thresholds, device, result):
+    limits = dict(thresholds.get("default", {}).get(result["size"], {}))
+    limits.update(thresholds.get(device, {}).get(result["size"], {}))
+
+    failures = []
+    if "max_stream_p99_ms_per_apdu" in limits:
+        per_apdu = result["stream_p99_ms"] / result["apdus"]
+        if per_apdu > limits["max_stream_p99_ms_per_apdu"]:
+            failures.append("stream p99 {:.2f} ms/APDU > {}".format(
+                per_apdu, limits["max_stream_p99_ms_per_apdu"]))
+    if "min_sigs_per_min" in limits:
+        if result["sigs_per_min"] < limits["min_sigs_per_min"]:
+            failures.append("{:.2f} signatures/min < {}".format(
+                result["sigs_per_min"], limits["min_sigs_per_min"]))
+    return failures
+
+
+@pytest.mark.parametrize("chunk", CHUNK_SIZES)
+@pytest.mark.parametrize("size", TXN_SIZES)
+def test_sign_tx_bench(firmware, backend, navigator, bench_iterations,
+                       bench_thresholds, bench_results, size, chunk):
+    if not isinstance(backend, SpeculosBackend):
+        pytest.skip("benchmarks only run on Speculos")
+
+    transaction = make_transaction(TXN_SIZES[size])
+    client = ZilliqaClient(backend)
+
+    # Streaming time runs until the last chunk is sent and the review starts.
+    # Signing time also covers the review and the returned signature.
+    stream_times, sign_times = [], []
+    start = perf_counter()
+    for _ in range(bench_iterations):
+        t0 = perf_counter()
+        with client.send_async_sign_transaction_message(ZILLIQA_KEY_INDEX,
+                                                        transaction,
+                                                        stream_len=chunk):
+            stream_times.append(perf_counter() - t0)
+            auto_approve(firmware, navigator, timeout=APPROVE_TIMEOUT)
+        sign_times.append(perf_counter() - t0)
+        signature = client.get_async_response().data
+    elapsed = perf_counter() - start
+
+    path = "44'/313'/{}'/0'/0'".format(ZILLIQA_KEY_INDEX)
+    public_key, _ = calculate_public_key_and_chaincode(CurveChoice.Secp256k1, path,
+                                                       compress_public_key=True)
+    client.verify_signature(transaction, signature, bytes.fromhex(public_key))
+
+    result = {
+        "device": firmware.device,
+        "size": size,
+        "txn_bytes": len(transaction),
+        "chunk": chunk,
+        "apdus": math.ceil(len(transaction) / chunk),
+        "iterations": bench_iterations,
+        "stream_p50_ms": percentile(stream_times, 50) * 1000,
+        "stream_p99_ms": percentile(stream_times, 99) * 1000,
+        "sign_p50_ms": percentile(sign_times, 50) * 1000,
+        "sign_p99_ms": percentile(sign_times, 99) * 1000,
+        "sigs_per_min": bench_iterations * 60 / elapsed,
+    }
+    bench_results.append(result)
+
+    failures = check_thresholds(bench_thresholds, firmware.device, result)
+    assert not failures, "; ".join(failures)
@@ -0,0 +1,180 @@
+"""Framing of the transactions streamed with INS_SIGN_TXN and
+INS_SIGN_EVM_TXN (see src/stream.h), without copying them more than once.
+
+Every payload is: the key (first one only), hostBytesLeft (4 bytes, what is
+still to come after this chunk), txnLen (4 bytes), the offset of the chunk
+(4 bytes, if asked for), the CRC-32 of the transaction up to the end of the
+chunk (4 bytes, if asked for) and the chunk. Integers are little-endian.
+
+Only depends on the standard library, so that tools/benchFraming.py runs
+without ragger.
+"""
+
+import sys
+
+from array import array
+from struct import pack, pack_into
+from typing import Iterator, Sequence, Tuple, Union
+from zlib import crc32
+
+# Any command: the key is a BIP32 path rather than a key index.
+P1_BIP32_PATH = 0x80
+
+# A key index, for 44'/313'/index'/0'/0', or a BIP32 path within 44'/313',
+# as a string ("44'/313'/0'/0/7") or a list of components.
+Key = Union[int, str, Sequence[int]]
+
+HARDENED = 0x80000000
+MAX_BIP32_PATH = 6
+
+# Largest command data (Lc) the app takes on USB, BLE or NFC (see
+# INS_GET_TRANSPORT): the key, the header fields and the chunk of a payload
+# must all fit in it.
+MAX_DATA = 255
+
+
+def parse_path(path: str) -> Tuple[int, ...]:
+    components = []
+    for part in path.strip().lstrip("m/").split("/"):
+        hardened = part.endswith("'") or part.endswith("h")
+        value = int(part.rstrip("'h"))
+        components.append(value | HARDENED if hardened else value)
+    return tuple(components)
+
+
+def key_payload(key: Key) -> Tuple[int, bytes]:
+    """The P1 flag and the payload bytes that give the device a key."""
+    if isinstance(key, int):
+        return 0, pack("<I", key)
+    path = parse_path(key) if isinstance(key, str) else tuple(key)
+    if not 2 < len(path) <= MAX_BIP32_PATH:
+        raise ValueError("a path has 3 to {} components".format(MAX_BIP32_PATH))
+    return P1_BIP32_PATH, bytes([len(path)]) + pack("<{}I".format(len(path)), *path)
+
+
+def frame_header(offsets: bool = False, checksum: bool = False) -> int:
+    """The bytes of a payload between the key and the chunk."""
+    return 8 + (4 if offsets else 0) + (4 if checksum else 0)
+
+
+def max_stream_len(key: bytes, offsets: bool = False, checksum: bool = False,
+                   max_data: int = MAX_DATA) -> int:
+    """The longest chunk that fits in max_data bytes of payload with key in
+    front of it, and the offset and checksum fields if asked for: a key
+    index takes 4 bytes, a BIP32 path up to 25, and each field 4. The key is
+    b"" for a stream picked up past its first chunk."""
+    return max_data - len(key) - frame_header(offsets, checksum)
+
+
+# Up to this chunk size, the chunks are copied one byte lane at a time (see
+# ChunkFramer): fewer, longer copies than one per chunk, but each of them
+# strides over the whole buffer.
+LANE_COPY_MAX = 32
+
+
+def _put_lanes(buf: bytearray, at: int, stride: int, end: int, values: array) -> None:
+    """Write the 32-bit values as little-endian integers at buf[at],
+    buf[at + stride]... up to end, a byte lane at a time."""
+    if sys.byteorder == "big":
+        values.byteswap()
+    data = values.tobytes()
+    for k in range(4):
+        buf[at + k:end:stride] = data[k::4]
+
+
+class ChunkFramer:
+    """Lays the payloads of a whole transaction out in one buffer, and hands
+    them out as memoryviews into it. All the chunks but the last have the
+    same size, so their payloads are equally spaced: each header field and
+    each byte of the small chunks is written to all of them with one strided
+    slice assignment instead of a Python loop per chunk. The buffer is kept
+    from one transaction to the next and only grows, so a framer that is
+    reused does not allocate it again.
+
+    The payloads of a transaction stay valid until the next call to frames:
+    they can all be in flight at once, but must not be kept past it."""
+
+    def __init__(self):
+        self._buf = bytearray()
+
+    def frames(self, key: bytes, transaction: bytes, stream_len: int, offset: int = 0,
+               offsets: bool = False, checksum: bool = False,
+               max_data: int = MAX_DATA) -> Iterator[Tuple[memoryview, bool]]:
+        """The payloads of transaction from offset on, each with a flag set
+        on the last one. key is the payload that gives the device the key,
+        sent in front of the chunk at offset 0. They are all laid out by the
+        time this returns, and the views are made as they are asked for.
+        Raises ValueError if the first payload, the longest, would not fit
+        in max_data bytes."""
+        if stream_len <= 0:
+            raise ValueError("stream_len must be positive")
+        length = max(len(transaction) - offset, 0)
+        if length == 0:
+            return iter(())
+        full, rest = divmod(length, stream_len)
+        header = frame_header(offsets, checksum)
+        stride = header + stream_len
+        base = len(key) if offset == 0 else 0
+        if base + header + min(stream_len, length) > max_data:
+            raise ValueError("payloads of {} bytes of key, {} of header and chunks of {} do not fit in {}".format(
+                base, header, stream_len, max_data))
+        size = base + length + (full + (1 if rest else 0)) * header
+        if len(self._buf) < size:
+            # A new buffer rather than a resize: the payloads handed out
+            # before may still be referenced, and they pin the old one.
+            self._buf = bytearray(size)
+
+        buf = self._buf
+        out = memoryview(buf)
+        src = memoryview(transaction)
+        if base:
+            out[:base] = key
+        crc = crc32(src[:offset]) if checksum else 0
+        # The full chunks, in payloads of stride bytes from base to end.
+        end = base + full * stride
+        starts = range(offset, offset + full * stream_len, stream_len)
+
+        # An empty extended slice assignment would try to resize buf, which
+        # the views into it forbid.
+        if full:
+            _put_lanes(buf, base, stride, end, array("I", range(length - stream_len, rest - 1, -stream_len)))
+            _put_lanes(buf, base + 4, stride, end, array("I", [stream_len]) * full)
+            field = base + 8
+            if offsets:
+                _put_lanes(buf, field, stride, end, array("I", starts))
+                field += 4
+            if checksum:
+                crcs = array("I")
+                for start in starts:
+                    crc = crc32(transaction[start:start + stream_len], crc)
+                    crcs.append(crc)
+                _put_lanes(buf, field, stride, end, crcs)
+            if stream_len <= LANE_COPY_MAX:
+                for j in range(stream_len):
+                    buf[base + header + j:end:stride] = transaction[offset + j:offset + full * stream_len:stream_len]
+            else:
+                for at, start in zip(range(base + header, end, stride), starts):
+                    buf[at:at + stream_len] = transaction[start:start + stream_len]
+
+        if rest:
+            start = offset + full * stream_len
+            pack_into("<II", buf, end, 0, rest)
+            field = end + 8
+            if offsets:
+                pack_into("<I", buf, field, start)
+                field += 4
+            if checksum:
+                crc = crc32(src[start:], crc)
+                pack_into("<I", buf, field, crc)
+            out[end + header:end + header + rest] = src[start:]
+        return self._payloads(out, base, stride, end + (header + rest if rest else 0))
+
+    @staticmethod
+    def _payloads(out: memoryview, base: int, stride: int, size: int) -> Iterator[Tuple[memoryview, bool]]:
+        # Making them all at once costs more than the framing: memoryviews
+        # are large, and the garbage collector keeps going over them.
+        first = 0
+        for at in range(base + stride, size, stride):
+            yield out[first:at], False
+            first = at
+        yield out[first:size], True
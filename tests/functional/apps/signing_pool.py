@@ -0,0 +1,250 @@
+"""Spread signing requests over several devices.
+
+Every device has its own queue and worker thread, so N devices sign N
+transactions at a time. A request goes to the device its key index is
+pinned to, or else to the device with the least pending work. Requests
+that fail because the device or its transport went away (the host side of
+an EXCEPTION_IO_RESET) are retried, after an optional reconnect, and so
+are transactions the device could not finish signing (SW_SIGN_RETRY);
+other status words such as a rejected review are returned to the caller
+as they are.
+"""
+
+import queue
+import threading
+import time
+from concurrent.futures import Future
+from dataclasses import dataclass, field
+from typing import Callable, Dict, List, Optional, Sequence
+
+from ragger.error import ExceptionRAPDU
+
+try:
+    from .zilliqa import ZilliqaClient, ErrorType, STREAM_LEN
+except ImportError:  # imported as a top-level module, as tools/*.py do
+    from zilliqa import ZilliqaClient, ErrorType, STREAM_LEN
+
+# What a dropped transport raises: OSError covers socket, HID and the
+# ConnectionError of the Speculos REST client.
+IO_RESET_ERRORS = (OSError, EOFError)
+
+
+@dataclass
+class Device:
+    client: ZilliqaClient
+    # Walks through the review once the last chunk is sent, e.g. with the
+    # ragger navigator; None when someone approves on the device itself.
+    approve: Optional[Callable[[], None]] = None
+    # Returns a fresh client for the same device after an IO reset.
+    reconnect: Optional[Callable[[], ZilliqaClient]] = None
+    name: str = ""
+
+
+@dataclass
+class DeviceStats:
+    name: str
+    signatures: int = 0
+    failures: int = 0
+    io_resets: int = 0
+    busy_s: float = 0.0
+
+
+@dataclass
+class PoolStats:
+    devices: List[DeviceStats]
+    signatures: int
+    failures: int
+    retries: int
+    elapsed_s: float
+
+    @property
+    def sigs_per_s(self) -> float:
+        return self.signatures / self.elapsed_s if self.elapsed_s else 0.0
+
+
+@dataclass
+class _Request:
+    kind: str
+    index: int
+    payload: bytes
+    stream_len: int
+    pinned: bool
+    future: Future = field(default_factory=Future)
+    attempts: int = 0
+
+
+class SigningPool:
+    def __init__(self, devices: Sequence[Device], max_attempts: int = 3,
+                 io_reset_errors=IO_RESET_ERRORS):
+        if not devices:
+            raise ValueError("a signing pool needs at least one device")
+        self._devices = list(devices)
+        self._max_attempts = max_attempts
+        self._io_reset_errors = io_reset_errors
+        self._pins: Dict[int, int] = {}
+        self._lock = threading.Lock()
+        self._idle = threading.Condition(self._lock)
+        # Queued plus in-flight requests, per device.
+        self._pending = [0] * len(self._devices)
+        self._queues = [queue.Queue() for _ in self._devices]
+        self._stats = [DeviceStats(d.name or "device{}".format(i))
+                       for i, d in enumerate(self._devices)]
+        self._retries = 0
+        self._started = None
+        self._finished = None
+        self._workers = [threading.Thread(target=self._worker, args=(i,), daemon=True)
+                         for i in range(len(self._devices))]
+        for worker in self._workers:
+            worker.start()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def pin(self, key_index: int, device: int) -> None:
+        """Send every request for key_index to the given device, e.g. when
+        only that device holds the seed of the account."""
+        if not 0 <= device < len(self._devices):
+            raise IndexError("no device {}".format(device))
+        with self._lock:
+            self._pins[key_index] = device
+
+    def sign_transaction(self, index: int, transaction: bytes,
+                         stream_len: int = STREAM_LEN) -> Future:
+        """Queue a transaction, the future resolves to its signature."""
+        return self._submit("txn", index, transaction, stream_len)
+
+    def sign_hash(self, index: int, hash_bytes: bytes) -> Future:
+        """Queue a hash, the future resolves to its signature."""
+        return self._submit("hash", index, hash_bytes, 0)
+
+    def stats(self) -> PoolStats:
+        with self._lock:
+            devices = [DeviceStats(**vars(s)) for s in self._stats]
+            started, finished, retries = self._started, self._finished, self._retries
+        elapsed = (finished - started) if started is not None and finished is not None else 0.0
+        return PoolStats(devices=devices,
+                         signatures=sum(d.signatures for d in devices),
+                         failures=sum(d.failures for d in devices),
+                         retries=retries,
+                         elapsed_s=elapsed)
+
+    def close(self) -> None:
+        """Finish the queued requests, retries included, and stop the
+        workers."""
+        with self._lock:
+            self._idle.wait_for(lambda: not any(self._pending))
+        for q in self._queues:
+            q.put(None)
+        for worker in self._workers:
+            worker.join()
+
+    def _submit(self, kind, index, payload, stream_len) -> Future:
+        with self._lock:
+            pinned = index in self._pins
+        request = _Request(kind, index, bytes(payload), stream_len, pinned)
+        self._dispatch(request)
+        return request.future
+
+    def _dispatch(self, request: _Request, avoid: Optional[int] = None) -> None:
+        with self._lock:
+            if request.index in self._pins:
+                device = self._pins[request.index]
+            else:
+                candidates = [i for i in range(len(self._devices)) if i != avoid] or [avoid]
+                device = min(candidates, key=lambda i: self._pending[i])
+            self._pending[device] += 1
+        self._queues[device].put(request)
+
+    def _sign(self, device: Device, request: _Request) -> bytes:
+        client = device.client
+        if request.kind == "txn":
+            session = client.send_async_sign_transaction_message(request.index, request.payload,
+                                                                 stream_len=request.stream_len)
+        else:
+            session = client.send_async_sign_hash_message(request.index, request.payload)
+        with session:
+            if device.approve is not None:
+                device.approve()
+        rapdu = client.get_async_response()
+        # Also with a backend that does not raise on status words.
+        if rapdu.status == ErrorType.SW_SIGN_RETRY:
+            raise ExceptionRAPDU(rapdu.status, rapdu.data)
+        return bytes(rapdu.data)
+
+    def _done(self, i: int) -> None:
+        with self._lock:
+            self._pending[i] -= 1
+            self._finished = time.perf_counter()
+            self._idle.notify_all()
+
+    def _worker(self, i: int) -> None:
+        device = self._devices[i]
+        stats = self._stats[i]
+        while True:
+            request = self._queues[i].get()
+            if request is None:
+                return
+            request.attempts += 1
+            t0 = time.perf_counter()
+            with self._lock:
+                if self._started is None:
+                    self._started = t0
+            try:
+                signature = self._sign(device, request)
+            except self._io_reset_errors as e:
+                retry = request.attempts < self._max_attempts
+                with self._lock:
+                    stats.io_resets += 1
+                    stats.busy_s += time.perf_counter() - t0
+                    if retry:
+                        self._retries += 1
+                    else:
+                        stats.failures += 1
+                if device.reconnect is not None:
+                    try:
+                        device.client = device.reconnect()
+                    except Exception:
+                        # Keep the old client, its next failure is
+                        # retried elsewhere all the same.
+                        pass
+                if retry:
+                    # Pinned requests wait for their device, others move on.
+                    # Requeue before this one counts as done so that close()
+                    # never sees an idle pool in between.
+                    self._dispatch(request, avoid=None if request.pinned else i)
+                else:
+                    request.future.set_exception(e)
+                self._done(i)
+                continue
+            except ExceptionRAPDU as e:
+                # The nonce drew a zero r or s: the whole transaction has to
+                # be streamed and approved again.
+                retry = e.status == ErrorType.SW_SIGN_RETRY and request.attempts < self._max_attempts
+                with self._lock:
+                    stats.busy_s += time.perf_counter() - t0
+                    if retry:
+                        self._retries += 1
+                    else:
+                        stats.failures += 1
+                if retry:
+                    self._dispatch(request, avoid=None if request.pinned else i)
+                else:
+                    request.future.set_exception(e)
+                self._done(i)
+                continue
+            except Exception as e:
+                with self._lock:
+                    stats.failures += 1
+                    stats.busy_s += time.perf_counter() - t0
+                request.future.set_exception(e)
+                self._done(i)
+                continue
+            with self._lock:
+                stats.signatures += 1
+                stats.busy_s += time.perf_counter() - t0
+                self._finished = time.perf_counter()
+            request.future.set_result(signature)
+            self._done(i)
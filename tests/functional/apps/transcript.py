@@ -0,0 +1,163 @@
+"""APDU transcripts: a compact binary log of the traffic between a client
+and the app, used to replay the exact same exchanges later
+(see tools/replayTranscript.py).
+
+File layout, all integers little-endian:
+
+    magic "ZILT" | version (u8)
+    records: kind (u8) | delta_us (u32) | length (u16) | payload
+
+delta_us is the time since the previous record, saturated at 2**32 - 1. A
+command is the full APDU (CLA INS P1 P2 Lc data), a response is the data
+followed by the status word, and a mark carries a UTF-8 label such as the
+name of the test that produced the following exchanges.
+"""
+
+from contextlib import contextmanager
+from dataclasses import dataclass
+from enum import IntEnum
+from struct import Struct
+from time import perf_counter_ns
+from typing import BinaryIO, Iterator, List, Optional
+
+from ragger.error import ExceptionRAPDU
+
+MAGIC = b"ZILT"
+VERSION = 1
+
+_HEADER = Struct("<4sB")
+_RECORD = Struct("<BIH")
+_MAX_DELTA_US = 2**32 - 1
+
+
+class Kind(IntEnum):
+    COMMAND = 0
+    RESPONSE = 1
+    # A command whose response only comes once the user has gone through a
+    # review on the device.
+    USER_COMMAND = 2
+    MARK = 3
+
+
+@dataclass
+class Record:
+    kind: Kind
+    delta_us: int
+    payload: bytes
+
+
+@dataclass
+class Exchange:
+    command: bytes
+    response: bytes
+    needs_user: bool
+    # Time from the command to its response, as recorded.
+    latency_us: int
+    # The last mark seen before this exchange, if any.
+    label: Optional[str]
+
+
+class TranscriptWriter:
+    def __init__(self, stream: BinaryIO):
+        self._stream = stream
+        self._last = perf_counter_ns()
+        stream.write(_HEADER.pack(MAGIC, VERSION))
+
+    def _write(self, kind: Kind, payload: bytes) -> None:
+        now = perf_counter_ns()
+        delta_us = min((now - self._last) // 1000, _MAX_DELTA_US)
+        self._last = now
+        self._stream.write(_RECORD.pack(kind, delta_us, len(payload)))
+        self._stream.write(payload)
+
+    def command(self, apdu: bytes, needs_user: bool = False) -> None:
+        self._write(Kind.USER_COMMAND if needs_user else Kind.COMMAND, apdu)
+
+    def response(self, data: bytes, status: int) -> None:
+        self._write(Kind.RESPONSE, bytes(data) + status.to_bytes(2, "big"))
+
+    def mark(self, label: str) -> None:
+        self._write(Kind.MARK, label.encode())
+
+    def flush(self) -> None:
+        self._stream.flush()
+
+
+def read_records(stream: BinaryIO) -> Iterator[Record]:
+    header = stream.read(_HEADER.size)
+    if len(header) != _HEADER.size:
+        raise ValueError("not a transcript: file too short")
+    magic, version = _HEADER.unpack(header)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("not a version {} transcript".format(VERSION))
+    while True:
+        head = stream.read(_RECORD.size)
+        if not head:
+            return
+        if len(head) != _RECORD.size:
+            raise ValueError("truncated record header")
+        kind, delta_us, length = _RECORD.unpack(head)
+        payload = stream.read(length)
+        if len(payload) != length:
+            raise ValueError("truncated record payload")
+        yield Record(Kind(kind), delta_us, payload)
+
+
+def read_exchanges(stream: BinaryIO) -> List[Exchange]:
+    """Pair every command with its response."""
+    exchanges = []
+    label = None
+    pending = None
+    for record in read_records(stream):
+        if record.kind == Kind.MARK:
+            label = record.payload.decode()
+        elif record.kind == Kind.RESPONSE:
+            if pending is None:
+                raise ValueError("response without a command")
+            exchanges.append(Exchange(pending.payload, record.payload,
+                                      pending.kind == Kind.USER_COMMAND,
+                                      record.delta_us, label))
+            pending = None
+        else:
+            if pending is not None:
+                raise ValueError("command without a response")
+            pending = record
+    return exchanges
+
+
+def _apdu(cla: int, ins: int, p1: int, p2: int, data: bytes) -> bytes:
+    return bytes([cla, ins, p1, p2, len(data)]) + bytes(data)
+
+
+class RecordingBackend:
+    """Wraps a ragger backend and logs every exchange to a transcript. All
+    other attributes are passed through to the wrapped backend."""
+
+    def __init__(self, backend, writer: TranscriptWriter):
+        self._backend = backend
+        self._writer = writer
+
+    def __getattr__(self, name):
+        return getattr(self._backend, name)
+
+    def exchange(self, cla: int, ins: int, p1: int = 0, p2: int = 0, data: bytes = b""):
+        self._writer.command(_apdu(cla, ins, p1, p2, data))
+        try:
+            rapdu = self._backend.exchange(cla, ins, p1, p2, data)
+        except ExceptionRAPDU as e:
+            self._writer.response(e.data, e.status)
+            raise
+        self._writer.response(rapdu.data, rapdu.status)
+        return rapdu
+
+    @contextmanager
+    def exchange_async(self, cla: int, ins: int, p1: int = 0, p2: int = 0, data: bytes = b""):
+        self._writer.command(_apdu(cla, ins, p1, p2, data), needs_user=True)
+        try:
+            with self._backend.exchange_async(cla, ins, p1, p2, data):
+                yield
+        except ExceptionRAPDU as e:
+            self._writer.response(e.data, e.status)
+            raise
+        rapdu = self._backend.last_async_response
+        self._writer.response(rapdu.data, rapdu.status)
@@ -1,12 +1,21 @@
 from contextlib import contextmanager
+from dataclasses import dataclass
 from enum import IntEnum
-from typing import Generator
-from struct import pack
+from typing import Generator, Iterator, Optional, Tuple
+from struct import pack, unpack
 from pyzil.crypto.schnorr import verify
 from bip_utils.addr import ZilAddrEncoder
 
 from ragger.backend.interface import BackendInterface, RAPDU
-from ragger.utils import split_message
+
+try:
+    from .framing import (ChunkFramer, Key, MAX_DATA, P1_BIP32_PATH, frame_header, key_payload,
+                          max_stream_len, parse_path)
+    from .transcript import RecordingBackend, TranscriptWriter
+except ImportError:  # imported as a top-level module, as tools/*.py do
+    from framing import (ChunkFramer, Key, MAX_DATA, P1_BIP32_PATH, frame_header, key_payload,
+                         max_stream_len, parse_path)
+    from transcript import RecordingBackend, TranscriptWriter
 
 
 class INS(IntEnum):
@@ -14,15 +23,27 @@ class INS(IntEnum):
     INS_GET_PUBLIC_KEY = 0x02
     INS_SIGN_TXN = 0x04
     INS_SIGN_HASH = 0x08
+    INS_GET_TRANSPORT = 0x10
+    INS_SIGN_EVM_TXN = 0x20
+    INS_ADD_RECIPIENT = 0x40
 
 
 CLA = 0xE0
 
+P1_SIGN_TXN_RESUMABLE = 0x01
+P1_SIGN_TXN_RESUME = 0x02
+P1_SIGN_TXN_OFFSETS = 0x04
+P1_SIGN_TXN_CHECKSUM = 0x08
+P1_RECIPIENT_REMOVE = 0x01
+
 P2_DISPLAY_PUBKEY = 0x00
 P2_DISPLAY_ADDRESS = 0x01
 P2_DISPLAY_NONE = 0x02
 
 STREAM_LEN = 16  # Stream in batches of STREAM_LEN bytes each.
+MAX_STREAM_LEN = 243  # Largest chunk that fits in one APDU with a key index
+# and its header, see max_stream_len for other keys and for the fields below.
+# Each of P1_SIGN_TXN_OFFSETS and P1_SIGN_TXN_CHECKSUM takes 4 bytes of it.
 
 STATUS_OK = 0x9000
 
@@ -30,13 +51,91 @@ STATUS_OK = 0x9000
 class ErrorType:
     SW_USER_REJECTED = 0x6985
     SW_INVALID_PARAM = 0x6B01
+    SW_IMPROPER_INIT = 0x6B02
+    SW_STREAM_MISMATCH = 0x6B03
+    SW_SIGN_RETRY = 0x6B04
+    SW_BOOK_FULL = 0x6B05
+    SW_NOT_IN_BOOK = 0x6B06
+    SW_DATA_NOT_ALLOWED = 0x6B07
     SW_INS_NOT_SUPPORTED = 0x6D00
     SW_CLA_NOT_SUPPORTED = 0x6E00
 
 
+def sign_transaction_payloads(index: Key, transaction: bytes,
+                              stream_len: int = STREAM_LEN,
+                              offset: int = 0, p1: int = 0,
+                              framer: Optional[ChunkFramer] = None) -> Iterator[Tuple[memoryview, bool]]:
+    """Yield the INS_SIGN_TXN payloads of a transaction from offset on, with
+    a flag set on the last one. The first payload also carries the key
+    (see key_payload for its P1 flag), and p1 is the one of the first frame: with P1_SIGN_TXN_OFFSETS
+    and P1_SIGN_TXN_CHECKSUM every payload carries the offset of its chunk
+    and the CRC-32 of the transaction up to its end. The payloads are views
+    into the buffer of framer (see ChunkFramer), a new one if None. Raises
+    ValueError when stream_len is too long for an APDU with this key and
+    these fields."""
+    if framer is None:
+        framer = ChunkFramer()
+    return framer.frames(key_payload(index)[1], transaction, stream_len, offset,
+                         offsets=bool(p1 & P1_SIGN_TXN_OFFSETS),
+                         checksum=bool(p1 & P1_SIGN_TXN_CHECKSUM))
+
+
+@dataclass
+class Link:
+    """How APDUs travel between the host and the device (INS_GET_TRANSPORT)."""
+    media: int         # G_io_apdu_media: 1 USB HID, 2 BLE, 5 WebUSB, 7 U2F...
+    segment: int       # Bytes per transport segment, 0 if the device does not know.
+    first_header: int  # Framing bytes in the first segment of an APDU,
+    next_header: int   # and in the next ones.
+    wrapper: int       # Bytes sent in front of the APDU, e.g. by U2F.
+    max_data: int      # Largest command data (Lc) the device takes on the link.
+
+    def segments(self, apdu_len: int) -> int:
+        first = self.segment - self.first_header
+        following = self.segment - self.next_header
+        rest = max(0, self.wrapper + apdu_len - first)
+        return 1 + -(-rest // following)
+
+
+def link_stream_len(link: Link, key_len: int = 4, p1: int = 0) -> int:
+    """The stream_len that carries the most transaction bytes per segment on
+    link, counting one more segment for every acknowledgement, for a stream
+    whose first frame has key_len bytes of key and the fields asked for by
+    p1. Same as zil_link_chunk_len of the C client."""
+    header = frame_header(offsets=bool(p1 & P1_SIGN_TXN_OFFSETS),
+                          checksum=bool(p1 & P1_SIGN_TXN_CHECKSUM))
+    # The first frame, with the key in front.
+    max_data = link.max_data if key_len + header < link.max_data < MAX_DATA else MAX_DATA
+    longest = min(MAX_STREAM_LEN, max_data - key_len - header)
+    if link.segment <= max(link.first_header, link.next_header):
+        return longest
+    # Continuation frames: CLA INS P1 P2 Lc and the header.
+    return max(range(longest, 0, -1),
+               key=lambda n: n / (link.segments(5 + header + n) + 1))
+
+
+@dataclass
+class SignSession:
+    """Where a resumable INS_SIGN_TXN stream stands on the device."""
+    session_id: int
+    # Offset of the next byte the device expects.
+    offset: int
+
+
 class ZilliqaClient:
+    # When set to a TranscriptWriter, every exchange of new clients is
+    # recorded to it (see the --transcript option of conftest.py).
+    transcript: Optional[TranscriptWriter] = None
+
     def __init__(self, backend: BackendInterface):
+        if self.transcript is not None:
+            backend = RecordingBackend(backend, self.transcript)
         self._backend = backend
+        self.sign_session: Optional[SignSession] = None
+        # P1 flags of the last transaction streamed.
+        self._sign_flags = 0
+        # Frames every transaction streamed, in the same buffer.
+        self._framer = ChunkFramer()
 
     def send_get_version(self) -> (int, int, int):
         rapdu: RAPDU = self._backend.exchange(CLA, INS.INS_GET_VERSION, 0, 0, b"")
@@ -51,6 +150,13 @@ class ZilliqaClient:
         patch = int(response[2])
         return (major, minor, patch)
 
+    def send_get_transport(self) -> Link:
+        rapdu: RAPDU = self._backend.exchange(CLA, INS.INS_GET_TRANSPORT, 0, 0, b"")
+        # response = media (1) || segment (2) || first header (1) ||
+        #            next header (1) || wrapper (1) || max data (2)
+        assert len(rapdu.data) == 8
+        return Link(*unpack("<BHBBBH", rapdu.data))
+
     def compute_adress_from_public_key(self, public_key: bytes) -> str:
         return ZilAddrEncoder.EncodeKey(public_key)
 
@@ -64,58 +170,112 @@ class ZilliqaClient:
         return public_key, address
 
     @contextmanager
-    def send_async_get_public_key(self, index: int,
+    def send_async_get_public_key(self, index: Key,
                                   disp_addr: bool) -> Generator[None, None, None]:
-        p1 = 0
         p2 = P2_DISPLAY_ADDRESS if disp_addr else P2_DISPLAY_PUBKEY
 
-        payload = pack("<I", index)
+        p1, payload = key_payload(index)
         with self._backend.exchange_async(CLA, INS.INS_GET_PUBLIC_KEY,
                                           p1, p2, payload):
             yield
 
-    def send_get_public_key_non_confirm(self, index: int) -> RAPDU:
-        p1 = 0
+    def send_get_public_key_non_confirm(self, index: Key) -> RAPDU:
         p2 = P2_DISPLAY_NONE
 
-        payload = pack("<I", index)
+        p1, payload = key_payload(index)
         return self._backend.exchange(CLA, INS.INS_GET_PUBLIC_KEY,
                                      p1, p2, payload)
 
     @contextmanager
     def send_async_sign_transaction_message(self,
-                                            index: int,
-                                            transaction: bytes) -> Generator[None, None, None]:
-
-        chunks = split_message(transaction, STREAM_LEN)
-        total_size = len(transaction)
-        sent_size = 0
-
-        for chunk in chunks:
-            chunk_size = len(chunk)
-
-            payload = b""
-            if sent_size == 0:
-                payload += pack("<I", index)
-            payload += pack("<I", total_size - sent_size - chunk_size)
-            payload += pack("<I", chunk_size)
-            payload += chunk
-
-            sent_size += chunk_size
-            if sent_size < total_size:
-                self._backend.exchange(CLA, INS.INS_SIGN_TXN, 0, 0, payload)
+                                            index: Key,
+                                            transaction: bytes,
+                                            stream_len: int = STREAM_LEN,
+                                            resumable: bool = False,
+                                            offsets: bool = False,
+                                            checksum: bool = False) -> Generator[None, None, None]:
+        """With resumable set, the device acknowledges every chunk with the
+        session id and offset kept in sign_session, and the stream can be
+        picked up again with resume_sign_transaction_message after the
+        transport failed. With offsets or checksum set, every chunk carries
+        its offset or the running CRC-32 of the transaction, and a chunk
+        that was dropped, repeated or corrupted on the way is answered with
+        SW_STREAM_MISMATCH as soon as it arrives."""
+        self.sign_session = None
+        self._sign_flags = ((P1_SIGN_TXN_RESUMABLE if resumable else 0) |
+                            (P1_SIGN_TXN_OFFSETS if offsets else 0) |
+                            (P1_SIGN_TXN_CHECKSUM if checksum else 0))
+        with self._stream_transaction(index, transaction, stream_len, 0):
+            yield
+
+    @contextmanager
+    def send_async_sign_evm_transaction_message(self,
+                                                index: Key,
+                                                transaction: bytes,
+                                                stream_len: int = STREAM_LEN) -> Generator[None, None, None]:
+        """Sign an RLP-encoded EIP-155 or EIP-1559 transaction, streamed as
+        INS_SIGN_TXN streams. The response is the y parity, r and s of its
+        ECDSA signature over the Keccak-256 of the transaction."""
+        self.sign_session = None
+        self._sign_flags = 0
+        with self._stream_transaction(index, transaction, stream_len, 0, INS.INS_SIGN_EVM_TXN):
+            yield
+
+    @contextmanager
+    def resume_sign_transaction_message(self,
+                                        transaction: bytes,
+                                        stream_len: int = STREAM_LEN) -> Generator[None, None, None]:
+        """Pick up the resumable stream of sign_session where the device
+        stopped, once the transport is back or after it answered a chunk
+        with SW_STREAM_MISMATCH."""
+        payload = pack("<I", self.sign_session.session_id)
+        rapdu = self._backend.exchange(CLA, INS.INS_SIGN_TXN, P1_SIGN_TXN_RESUME, 0, payload)
+        self._update_sign_session(rapdu.data)
+        with self._stream_transaction(0, transaction, stream_len, self.sign_session.offset):
+            yield
+
+    def _update_sign_session(self, ack: bytes) -> None:
+        # ack = session_id (4) || offset of the next byte expected (4)
+        if len(ack) == 8:
+            session_id, offset = unpack("<II", ack)
+            self.sign_session = SignSession(session_id, offset)
+
+    @contextmanager
+    def _stream_transaction(self, index: Key, transaction: bytes, stream_len: int,
+                            offset: int, ins: INS = INS.INS_SIGN_TXN) -> Generator[None, None, None]:
+        payloads = sign_transaction_payloads(index, transaction, stream_len, offset, self._sign_flags,
+                                             self._framer)
+        # Only the first frame says how to stream, and which key to use.
+        p1 = (self._sign_flags | key_payload(index)[0]) if offset == 0 else 0
+        for payload, last in payloads:
+            if not last:
+                rapdu = self._backend.exchange(CLA, ins, p1, 0, payload)
+                self._update_sign_session(rapdu.data)
             else:
-                with self._backend.exchange_async(CLA, INS.INS_SIGN_TXN, 0, 0, payload):
+                with self._backend.exchange_async(CLA, ins, p1, 0, payload):
                     yield
+            p1 = 0
+
+    @contextmanager
+    def send_async_add_recipient(self, address: bytes,
+                                 label: Optional[str]) -> Generator[None, None, None]:
+        """Add the 20-byte address to the book of trusted recipients under
+        label (1 to 16 printable ASCII characters), or remove it with label
+        None. The review of a transaction to a trusted recipient shows its
+        label instead of its address."""
+        p1 = P1_RECIPIENT_REMOVE if label is None else 0
+        payload = address + (label.encode("ascii") if label is not None else b"")
+        with self._backend.exchange_async(CLA, INS.INS_ADD_RECIPIENT, p1, 0, payload):
+            yield
 
     @contextmanager
     def send_async_sign_hash_message(self,
-                                     index: int,
+                                     index: Key,
                                      hash_bytes: bytes) -> Generator[None, None, None]:
 
-        payload = pack("<I", index)
+        p1, payload = key_payload(index)
         payload += hash_bytes
-        with self._backend.exchange_async(CLA, INS.INS_SIGN_HASH, 0, 0, payload):
+        with self._backend.exchange_async(CLA, INS.INS_SIGN_HASH, p1, 0, payload):
             yield
 
     def verify_signature(self, message, response, public_key):
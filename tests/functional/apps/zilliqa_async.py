@@ -0,0 +1,110 @@
+"""asyncio front end of ZilliqaClient.
+
+Backends are blocking, so every client gets one worker thread that owns its
+backend and runs the exchanges in order. The event loop builds the next
+payload and parses the previous response while that thread waits on the
+transport, and any number of clients, one per device, stream and wait for
+reviews side by side from the same loop.
+
+The next chunk is only sent once the previous one is acknowledged: ragger
+backends keep a single pending APDU. The C client (client/zil_client.h)
+pipelines deeper on transports that queue.
+"""
+
+import asyncio
+from concurrent.futures import ThreadPoolExecutor
+from typing import Callable, Optional, Tuple
+
+from ragger.backend.interface import BackendInterface, RAPDU
+
+try:
+    from .zilliqa import (ZilliqaClient, CLA, INS, P2_DISPLAY_NONE, STREAM_LEN, Key,
+                          key_payload, sign_transaction_payloads)
+except ImportError:  # imported as a top-level module, as tools/*.py do
+    from zilliqa import (ZilliqaClient, CLA, INS, P2_DISPLAY_NONE, STREAM_LEN, Key,
+                         key_payload, sign_transaction_payloads)
+
+
+class AsyncZilliqaClient:
+    def __init__(self, backend: BackendInterface):
+        # The synchronous client sets up _backend, transcript included.
+        self._client = ZilliqaClient(backend)
+        self._backend = self._client._backend
+        self._executor = ThreadPoolExecutor(max_workers=1, thread_name_prefix="zilliqa-io")
+        # One command at a time per device, even across tasks.
+        self._session = asyncio.Lock()
+
+    @property
+    def client(self) -> ZilliqaClient:
+        """The synchronous client on the same backend, for parsing and
+        checking responses."""
+        return self._client
+
+    async def __aenter__(self):
+        return self
+
+    async def __aexit__(self, *exc):
+        self.close()
+
+    def close(self) -> None:
+        self._executor.shutdown(wait=True)
+
+    async def _run(self, fn, *args) -> RAPDU:
+        return await asyncio.get_running_loop().run_in_executor(self._executor, fn, *args)
+
+    def _exchange_with_review(self, ins: int, p1: int, p2: int, payload: bytes,
+                              approve: Optional[Callable[[], None]]) -> RAPDU:
+        with self._backend.exchange_async(CLA, ins, p1, p2, payload):
+            if approve is not None:
+                approve()
+        return self._backend.last_async_response
+
+    async def get_version(self) -> Tuple[int, int, int]:
+        async with self._session:
+            rapdu = await self._run(self._backend.exchange, CLA, INS.INS_GET_VERSION, 0, 0, b"")
+        assert len(rapdu.data) == 3
+        return tuple(rapdu.data)
+
+    async def get_public_key(self, index: Key, p2: int = P2_DISPLAY_NONE,
+                             approve: Optional[Callable[[], None]] = None) -> Tuple[bytes, str]:
+        p1, payload = key_payload(index)
+        async with self._session:
+            if p2 == P2_DISPLAY_NONE:
+                rapdu = await self._run(self._backend.exchange, CLA, INS.INS_GET_PUBLIC_KEY, p1, p2, payload)
+            else:
+                rapdu = await self._run(self._exchange_with_review, INS.INS_GET_PUBLIC_KEY, p1, p2, payload,
+                                        approve)
+        return self._client.parse_get_public_key_response(rapdu.data)
+
+    async def sign_transaction(self, index: Key, transaction: bytes,
+                               stream_len: int = STREAM_LEN,
+                               approve: Optional[Callable[[], None]] = None) -> bytes:
+        """Stream the transaction and return its signature. approve runs on
+        the worker thread once the review is on screen; leave it out when
+        someone approves on the device."""
+        if not transaction:
+            raise ValueError("empty transaction")
+        # Only the first frame says which key to use.
+        p1 = key_payload(index)[0]
+        async with self._session:
+            ack = None
+            for payload, last in sign_transaction_payloads(index, transaction, stream_len,
+                                                           framer=self._client._framer):
+                # This payload was built while the previous chunk was in flight.
+                if ack is not None:
+                    await ack
+                if last:
+                    rapdu = await self._run(self._exchange_with_review, INS.INS_SIGN_TXN, p1, 0, payload,
+                                            approve)
+                    return bytes(rapdu.data)
+                ack = asyncio.ensure_future(self._run(self._backend.exchange, CLA, INS.INS_SIGN_TXN, p1, 0,
+                                                      payload))
+                p1 = 0
+
+    async def sign_hash(self, index: Key, hash_bytes: bytes,
+                        approve: Optional[Callable[[], None]] = None) -> bytes:
+        p1, payload = key_payload(index)
+        payload += hash_bytes
+        async with self._session:
+            rapdu = await self._run(self._exchange_with_review, INS.INS_SIGN_HASH, p1, 0, payload, approve)
+        return bytes(rapdu.data)
@@ -1,5 +1,9 @@
+import pytest
 from ragger.conftest import configuration
 
+from apps.transcript import TranscriptWriter
+from apps.zilliqa import ZilliqaClient
+
 ###########################
 ### CONFIGURATION START ###
 ###########################
@@ -13,3 +17,31 @@ from ragger.conftest import configuration
 
 # Pull all features from the base ragger conftest using the overridden configuration
 pytest_plugins = ("ragger.conftest.base_conftest", )
+
+
+def pytest_addoption(parser):
+    parser.addoption("--transcript", default=None,
+                     help="record every APDU exchanged by ZilliqaClient to this file, "
+                          "for tools/replayTranscript.py")
+
+
+@pytest.fixture(scope="session")
+def transcript(pytestconfig):
+    path = pytestconfig.getoption("transcript")
+    if path is None:
+        yield None
+        return
+    with open(path, "wb") as f:
+        yield TranscriptWriter(f)
+
+
+@pytest.fixture(autouse=True)
+def record_transcript(request, transcript):
+    if transcript is None:
+        yield
+        return
+    transcript.mark(request.node.name)
+    ZilliqaClient.transcript = transcript
+    yield
+    ZilliqaClient.transcript = None
+    transcript.flush()
@@ -0,0 +1,64 @@
+from ragger.backend.interface import RaisePolicy
+from ragger.navigator import NavInsID
+
+from apps.zilliqa import ZilliqaClient, ErrorType
+from apps.txn_pb2 import ByteArray, ProtoTransactionCoreInfo
+
+from utils import auto_approve, auto_reject
+
+ZILLIQA_KEY_INDEX = 1
+RECIPIENT = bytes.fromhex("8AD0357EBB5515F694DE597EDA6F3F6BDBAD0FD9")
+LABEL = "Savings"
+
+
+def transaction_to(toaddr):
+    senderpubkey = ByteArray(data=bytes.fromhex("0205273e54f262f8717a687250591dcfb5755b8ce4e3bd340c7abefd0de1276574"))
+    amount = ByteArray(data=(11 * 10 ** 11).to_bytes(16, byteorder='big'))
+    gasprice = ByteArray(data=(2 * 10 ** 9).to_bytes(16, byteorder='big'))
+    return ProtoTransactionCoreInfo(
+        version=65537,
+        nonce=13,
+        toaddr=toaddr,
+        senderpubkey=senderpubkey,
+        amount=amount,
+        gasprice=gasprice,
+        gaslimit=1
+    ).SerializeToString()
+
+
+def test_add_recipient_trusted_accepted(firmware, backend, navigator):
+    client = ZilliqaClient(backend)
+
+    # Add the recipient...
+    with client.send_async_add_recipient(RECIPIENT, LABEL):
+        auto_approve(firmware, navigator, approve_text="Hold to approve")
+    assert client.get_async_response().status == 0x9000
+
+    # ...whose transactions now show "Savings (trusted)" instead of the
+    # address...
+    with client.send_async_sign_transaction_message(ZILLIQA_KEY_INDEX, transaction_to(RECIPIENT)):
+        if firmware.device.startswith("nano"):
+            navigator.navigate_until_text(NavInsID.RIGHT_CLICK, [], "(trusted)")
+        else:
+            navigator.navigate_until_text(NavInsID.USE_CASE_REVIEW_TAP, [], "(trusted)")
+        auto_approve(firmware, navigator)
+    assert len(client.get_async_response().data) == 64
+
+    # ...until it is removed again.
+    with client.send_async_add_recipient(RECIPIENT, None):
+        auto_approve(firmware, navigator, approve_text="Hold to approve")
+    assert client.get_async_response().status == 0x9000
+
+
+def test_add_recipient_refused(firmware, backend, navigator):
+    client = ZilliqaClient(backend)
+    with client.send_async_add_recipient(RECIPIENT, LABEL):
+        backend.raise_policy = RaisePolicy.RAISE_NOTHING
+        auto_reject(firmware, navigator)
+    rapdu = client.get_async_response()
+    assert rapdu.status == ErrorType.SW_USER_REJECTED
+
+    # Nothing was added, so there is nothing to remove.
+    with client.send_async_add_recipient(RECIPIENT, None):
+        pass
+    assert client.get_async_response().status == ErrorType.SW_NOT_IN_BOOK
@@ -1,20 +1,19 @@
 from ragger.navigator import NavInsID
 
-from utils import ROOT_SCREENSHOT_PATH
-
 
 # In this test we check the behavior of the device main menu
-def test_app_mainmenu(firmware, navigator, test_name):
+def test_app_mainmenu(firmware, backend, navigator):
     # Navigate in the main menu
     if firmware.device.startswith("nano"):
-        instructions = [
-            NavInsID.RIGHT_CLICK,
-            NavInsID.RIGHT_CLICK
-        ]
+        for text in ["Version", "Contract data", "Quit"]:
+            navigator.navigate_until_text(NavInsID.RIGHT_CLICK, [], text,
+                                          screen_change_before_first_instruction=False)
+        navigator.navigate([NavInsID.RIGHT_CLICK], screen_change_before_first_instruction=False)
+        backend.wait_for_text_on_screen("is ready")
     else:
-        instructions = [
-            NavInsID.USE_CASE_HOME_INFO,
-            NavInsID.USE_CASE_SETTINGS_SINGLE_PAGE_EXIT
-        ]
-    navigator.navigate_and_compare(ROOT_SCREENSHOT_PATH, test_name, instructions,
-                                   screen_change_before_first_instruction=False)
+        navigator.navigate([NavInsID.USE_CASE_HOME_INFO], screen_change_before_first_instruction=False)
+        backend.wait_for_text_on_screen("Contract data")
+        navigator.navigate([NavInsID.USE_CASE_SETTINGS_NEXT], screen_change_before_first_instruction=False)
+        backend.wait_for_text_on_screen("Version")
+        navigator.navigate([NavInsID.USE_CASE_SETTINGS_MULTI_PAGE_EXIT],
+                           screen_change_before_first_instruction=False)
@@ -0,0 +1,74 @@
+import asyncio
+
+import pytest
+from ragger.backend import SpeculosBackend
+from ragger.bip import calculate_public_key_and_chaincode, CurveChoice
+
+from apps.zilliqa import MAX_STREAM_LEN
+from apps.zilliqa_async import AsyncZilliqaClient
+from apps.txn_pb2 import ByteArray, ProtoTransactionCoreInfo
+
+from utils import auto_approve
+
+ZILLIQA_KEY_INDEX = 1
+
+
+def make_transaction(data_len):
+    transaction = ProtoTransactionCoreInfo(
+        version=65537,
+        nonce=13,
+        toaddr=bytes.fromhex("8AD0357EBB5515F694DE597EDA6F3F6BDBAD0FD9"),
+        senderpubkey=ByteArray(data=bytes.fromhex("0205273e54f262f8717a687250591dcfb5755b8ce4e3bd340c7abefd0de1276574")),
+        amount=ByteArray(data=(1100000000000).to_bytes(16, byteorder='big')),
+        gasprice=ByteArray(data=(2000000000).to_bytes(16, byteorder='big')),
+        gaslimit=1
+    )
+    if data_len:
+        transaction.data = b"0" * data_len
+    return transaction.SerializeToString()
+
+
+def reference_public_key():
+    path = "44'/313'/{}'/0'/0'".format(ZILLIQA_KEY_INDEX)
+    public_key, _ = calculate_public_key_and_chaincode(CurveChoice.Secp256k1, path,
+                                                       compress_public_key=True)
+    return bytes.fromhex(public_key)
+
+
+@pytest.mark.parametrize("stream_len", [16, MAX_STREAM_LEN])
+def test_async_sign_transaction(firmware, backend, navigator, stream_len):
+    if not isinstance(backend, SpeculosBackend):
+        pytest.skip("reviews are approved through Speculos")
+
+    transaction = make_transaction(1024)
+
+    async def run():
+        async with AsyncZilliqaClient(backend) as client:
+            # Queued behind each other on the one device.
+            version, (public_key, _), signature = await asyncio.gather(
+                client.get_version(),
+                client.get_public_key(ZILLIQA_KEY_INDEX),
+                client.sign_transaction(ZILLIQA_KEY_INDEX, transaction, stream_len=stream_len,
+                                        approve=lambda: auto_approve(firmware, navigator)))
+            return client.client, version, public_key, signature
+
+    client, version, public_key, signature = asyncio.run(run())
+    assert len(version) == 3
+    assert public_key == reference_public_key()
+    client.verify_signature(transaction, signature, public_key)
+
+
+def test_async_sign_hash(firmware, backend, navigator):
+    if not isinstance(backend, SpeculosBackend):
+        pytest.skip("reviews are approved through Speculos")
+
+    hash_bytes = bytes.fromhex("02E681C8EB3602CDB9261F407E2C2EE6CB9BA996AAA895677E133C02BEFC1F84")
+
+    async def run():
+        async with AsyncZilliqaClient(backend) as client:
+            signature = await client.sign_hash(ZILLIQA_KEY_INDEX, hash_bytes,
+                                               approve=lambda: auto_approve(firmware, navigator))
+            return client.client, signature
+
+    client, signature = asyncio.run(run())
+    client.verify_signature(hash_bytes, signature, reference_public_key())
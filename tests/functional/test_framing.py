@@ -0,0 +1,83 @@
+from struct import pack
+from zlib import crc32
+
+import pytest
+
+from apps.framing import ChunkFramer, LANE_COPY_MAX, MAX_DATA, key_payload, max_stream_len
+
+
+def concat_payloads(key, transaction, stream_len, offset, offsets, checksum):
+    """The payloads built one by one, the way the app reads them."""
+    payloads = []
+    crc = crc32(transaction[:offset])
+    for start in range(offset, len(transaction), stream_len):
+        chunk = transaction[start:start + stream_len]
+        payload = key if start == 0 else b""
+        payload += pack("<II", len(transaction) - start - len(chunk), len(chunk))
+        if offsets:
+            payload += pack("<I", start)
+        if checksum:
+            crc = crc32(chunk, crc)
+            payload += pack("<I", crc)
+        payloads.append((payload + chunk, start + len(chunk) == len(transaction)))
+    return payloads
+
+
+@pytest.mark.parametrize("stream_len", [1, 16, LANE_COPY_MAX, LANE_COPY_MAX + 1, None])
+@pytest.mark.parametrize("offsets,checksum", [(False, False), (True, False), (False, True), (True, True)])
+def test_framing_matches_concatenation(stream_len, offsets, checksum):
+    framer = ChunkFramer()
+    key = bytes([3]) + pack("<3I", 0x8000002C, 0x80000139, 0x80000000)
+    if stream_len is None:
+        # The longest that fits.
+        stream_len = max_stream_len(key, offsets, checksum)
+    # Shrinking and growing again reuses the buffer, or replaces it.
+    for size in [1000, stream_len, stream_len - 1, 3 * stream_len + 1, 5000]:
+        transaction = bytes(i * 7 % 251 for i in range(size))
+        for offset in [0, 1, size // 2, size]:
+            payloads = [(bytes(payload), last)
+                        for payload, last in framer.frames(key, transaction, stream_len, offset,
+                                                           offsets, checksum)]
+            assert payloads == concat_payloads(key, transaction, stream_len, offset, offsets, checksum)
+
+
+def test_framing_payloads_stay_valid_until_next_call():
+    framer = ChunkFramer()
+    transaction = bytes(range(100))
+    payloads = list(framer.frames(b"", transaction, 16))
+    # They can all be in flight at once.
+    assert b"".join(bytes(payload)[8:] for payload, _ in payloads) == transaction
+    # A longer transaction needs a new buffer: the old payloads are left alone.
+    framer.frames(b"", bytes(1000), 16)
+    assert b"".join(bytes(payload)[8:] for payload, _ in payloads) == transaction
+
+
+@pytest.mark.parametrize("key", [1, "44'/313'/0'/0/7", "44'/313'/1'/2'/3'/4'"])
+def test_framing_fits_in_an_apdu(key):
+    framer = ChunkFramer()
+    key = key_payload(key)[1]
+    transaction = bytes(1000)
+    longest = max_stream_len(key)
+    payloads = list(framer.frames(key, transaction, longest))
+    assert len(payloads[0][0]) == MAX_DATA
+    # A path takes more room than a key index.
+    with pytest.raises(ValueError):
+        framer.frames(key, transaction, longest + 1)
+    # Past the first chunk, there is no key.
+    framer.frames(key, transaction, longest + len(key), offset=longest)
+    with pytest.raises(ValueError):
+        framer.frames(key, transaction, longest + len(key) + 1, offset=longest)
+
+
+@pytest.mark.parametrize("offsets,checksum", [(True, False), (False, True), (True, True)])
+def test_framing_fields_fit_in_an_apdu(offsets, checksum):
+    framer = ChunkFramer()
+    key = key_payload(1)[1]
+    transaction = bytes(1000)
+    longest = max_stream_len(key, offsets, checksum)
+    assert longest == 243 - (4 if offsets else 0) - (4 if checksum else 0)
+    payloads = list(framer.frames(key, transaction, longest, offsets=offsets, checksum=checksum))
+    assert len(payloads[0][0]) == MAX_DATA
+    assert all(len(payload) <= MAX_DATA for payload, _ in payloads)
+    with pytest.raises(ValueError):
+        framer.frames(key, transaction, longest + 1, offsets=offsets, checksum=checksum)
@@ -11,7 +11,7 @@ ZILLIQA_KEY_INDEX = 1
 
 def check_get_public_key_resp(backend, key_index, public_key):
     if isinstance(backend, SpeculosBackend):
-        path = "44'/313'/{}'/0'/0'".format(key_index)
+        path = key_index if isinstance(key_index, str) else "44'/313'/{}'/0'/0'".format(key_index)
         ref_public_key, _ = calculate_public_key_and_chaincode(CurveChoice.Secp256k1,
                                                                path,
                                                                compress_public_key=True)
@@ -76,6 +76,25 @@ def test_get_public_key_silent(backend, navigator, test_name):
     check_get_public_key_resp(backend, ZILLIQA_KEY_INDEX, public_key)
 
 
+def test_get_public_key_silent_path(backend, navigator, test_name):
+    client = ZilliqaClient(backend)
+    # A key index is the path 44'/313'/index'/0'/0'.
+    by_index = client.send_get_public_key_non_confirm(ZILLIQA_KEY_INDEX)
+    by_path = client.send_get_public_key_non_confirm("44'/313'/{}'/0'/0'".format(ZILLIQA_KEY_INDEX))
+    assert by_path.data == by_index.data
+    for path in ["44'/313'/0'/0/7", "44'/313'/5'", "44'/313'/1'/2/3'/4"]:
+        response = client.send_get_public_key_non_confirm(path)
+        public_key, address = client.parse_get_public_key_response(response.data)
+        check_get_public_key_resp(backend, path, public_key)
+
+
+def test_get_public_key_path_outside_zilliqa(backend, navigator, test_name):
+    client = ZilliqaClient(backend)
+    backend.raise_policy = RaisePolicy.RAISE_NOTHING
+    rapdu = client.send_get_public_key_non_confirm("44'/60'/0'/0/0")
+    assert rapdu.status == ErrorType.SW_INVALID_PARAM
+
+
 def test_get_public_key_show_addr_refused(firmware, backend, navigator, test_name):
     client = ZilliqaClient(backend)
     if firmware.device.startswith("nano"):
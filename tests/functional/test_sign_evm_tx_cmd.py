@@ -0,0 +1,116 @@
+from Crypto.Hash import keccak
+from ecdsa import SECP256k1, VerifyingKey
+from ecdsa.util import sigdecode_string
+
+from ragger.backend import SpeculosBackend
+from ragger.backend.interface import RaisePolicy
+from ragger.bip import calculate_public_key_and_chaincode, CurveChoice
+from ragger.navigator import NavInsID
+
+from apps.zilliqa import ZilliqaClient, ErrorType, MAX_STREAM_LEN
+
+from utils import auto_approve, auto_reject, toggle_contract_data
+
+ZILLIQA_KEY_INDEX = 1
+# Zilliqa EVM testnet
+CHAIN_ID = 33101
+# The EIP-55 example address, 0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAed.
+EVM_TO = bytes.fromhex("5aaeb6053f3e94c9b9a09f33669435e7ef1beaed")
+
+
+def rlp_header(base, length):
+    if length < 56:
+        return bytes([base + length])
+    n = length.to_bytes((length.bit_length() + 7) // 8, byteorder='big')
+    return bytes([base + 55 + len(n)]) + n
+
+
+def rlp_str(data):
+    if len(data) == 1 and data[0] < 0x80:
+        return data
+    return rlp_header(0x80, len(data)) + data
+
+
+def rlp_uint(v):
+    return rlp_str(v.to_bytes((v.bit_length() + 7) // 8, byteorder='big'))
+
+
+def rlp_list(items):
+    payload = b"".join(items)
+    return rlp_header(0xC0, len(payload)) + payload
+
+
+def evm_transaction(data=b""):
+    """EIP-155 transfer of 1.5 ZIL to EVM_TO at 4761 Gwei per gas for 21000
+    gas, calling it with data."""
+    return rlp_list([rlp_uint(7), rlp_uint(4761 * 10 ** 9), rlp_uint(21000),
+                     rlp_str(EVM_TO), rlp_uint(15 * 10 ** 17), rlp_str(data),
+                     rlp_uint(CHAIN_ID), rlp_uint(0), rlp_uint(0)])
+
+
+def check_evm_signature(client, backend, transaction, response):
+    # response = y parity (1) || r (32) || s (32)
+    assert len(response) == 65 and response[0] in (0, 1)
+    if isinstance(backend, SpeculosBackend):
+        path = "44'/313'/{}'/0'/0'".format(ZILLIQA_KEY_INDEX)
+        ref_public_key, _ = calculate_public_key_and_chaincode(CurveChoice.Secp256k1,
+                                                               path,
+                                                               compress_public_key=True)
+        public_key = bytes.fromhex(ref_public_key)
+    else:
+        rapdu = client.send_get_public_key_non_confirm(ZILLIQA_KEY_INDEX)
+        public_key, _ = client.parse_get_public_key_response(rapdu.data)
+    digest = keccak.new(digest_bits=256, data=transaction).digest()
+    key = VerifyingKey.from_string(public_key, curve=SECP256k1)
+    assert key.verify_digest(response[1:], digest, sigdecode=sigdecode_string)
+
+
+def test_sign_evm_tx_simple_accepted(firmware, backend, navigator):
+    transaction = evm_transaction()
+    client = ZilliqaClient(backend)
+    with client.send_async_sign_evm_transaction_message(ZILLIQA_KEY_INDEX, transaction):
+        auto_approve(firmware, navigator)
+    response = client.get_async_response().data
+    check_evm_signature(client, backend, transaction, response)
+
+
+def test_sign_evm_tx_simple_refused(firmware, backend, navigator):
+    transaction = evm_transaction()
+    client = ZilliqaClient(backend)
+    with client.send_async_sign_evm_transaction_message(ZILLIQA_KEY_INDEX, transaction):
+        backend.raise_policy = RaisePolicy.RAISE_NOTHING
+        auto_reject(firmware, navigator)
+    rapdu = client.get_async_response()
+    assert rapdu.status == ErrorType.SW_USER_REJECTED
+    assert len(rapdu.data) == 0
+
+
+def test_sign_evm_tx_data_not_allowed(backend):
+    # Contract data is refused by default, without a review.
+    client = ZilliqaClient(backend)
+    backend.raise_policy = RaisePolicy.RAISE_NOTHING
+    with client.send_async_sign_evm_transaction_message(ZILLIQA_KEY_INDEX,
+                                                        evm_transaction(bytes(range(100))),
+                                                        MAX_STREAM_LEN):
+        pass
+    rapdu = client.get_async_response()
+    assert rapdu.status == ErrorType.SW_DATA_NOT_ALLOWED
+
+
+def test_sign_evm_tx_data_accepted(firmware, backend, navigator):
+    # A call of transfer(address,uint256).
+    data = bytes.fromhex("a9059cbb") + bytes(12) + EVM_TO + (10 ** 18).to_bytes(32, byteorder='big')
+    transaction = evm_transaction(data)
+    client = ZilliqaClient(backend)
+    toggle_contract_data(firmware, navigator)
+    try:
+        with client.send_async_sign_evm_transaction_message(ZILLIQA_KEY_INDEX, transaction):
+            # The review opens with the blind signing warning.
+            backend.wait_for_text_on_screen("Blind signing")
+            if not firmware.device.startswith("nano"):
+                navigator.navigate([NavInsID.USE_CASE_CHOICE_CONFIRM])
+            auto_approve(firmware, navigator)
+        response = client.get_async_response().data
+        check_evm_signature(client, backend, transaction, response)
+    finally:
+        toggle_contract_data(firmware, navigator)
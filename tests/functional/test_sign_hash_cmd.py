@@ -7,7 +7,7 @@ from ragger.navigator import NavInsID
 from apps.zilliqa import ZilliqaClient, ErrorType
 
 from utils import ROOT_SCREENSHOT_PATH, get_nano_review_instructions
-from utils import get_fat_review_instructions
+from utils import get_fat_review_instructions, auto_approve
 
 ZILLIQA_KEY_INDEX = 1
 
@@ -47,6 +47,27 @@ def test_sign_hash_accepted(test_name, firmware, backend, navigator):
     check_signature(client, backend, message_bytes, response)
 
 
+def test_sign_hash_path_accepted(firmware, backend, navigator):
+    # A key given by its BIP32 path shows the path instead of the index.
+    path = "44'/313'/0'/0/7"
+    message_bytes = bytes.fromhex("02E681C8EB3602CDB9261F407E2C2EE6CB9BA996AAA895677E133C02BEFC1F84")
+
+    client = ZilliqaClient(backend)
+    with client.send_async_sign_hash_message(path, message_bytes):
+        backend.wait_for_text_on_screen("0'/0/7")
+        auto_approve(firmware, navigator)
+    response = client.get_async_response().data
+    if isinstance(backend, SpeculosBackend):
+        ref_public_key, _ = calculate_public_key_and_chaincode(CurveChoice.Secp256k1,
+                                                               path,
+                                                               compress_public_key=True)
+        public_key = bytes.fromhex(ref_public_key)
+    else:
+        rapdu = client.send_get_public_key_non_confirm(path)
+        public_key, _ = client.parse_get_public_key_response(rapdu.data)
+    client.verify_signature(message_bytes, response, public_key)
+
+
 def test_sign_hash_refused(test_name, firmware, backend, navigator):
     message = "02E681C8EB3602CDB9261F407E2C2EE6CB9BA996AAA895677E133C02BEFC1F84"
     message_bytes = bytes.fromhex(message)
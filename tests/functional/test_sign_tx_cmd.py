@@ -1,14 +1,16 @@
+import pytest
 from ragger.backend import SpeculosBackend
 from ragger.backend.interface import RaisePolicy
 from ragger.bip import calculate_public_key_and_chaincode, CurveChoice
 
 from ragger.navigator import NavInsID
 
-from apps.zilliqa import ZilliqaClient, ErrorType
+from apps.zilliqa import ZilliqaClient, ErrorType, CLA, INS, P1_SIGN_TXN_RESUME
+from apps.zilliqa import P1_SIGN_TXN_OFFSETS, P1_SIGN_TXN_CHECKSUM, sign_transaction_payloads
+from apps.framing import key_payload, max_stream_len
 from apps.txn_pb2 import ByteArray, ProtoTransactionCoreInfo
 
-from utils import ROOT_SCREENSHOT_PATH, get_nano_review_instructions
-from utils import get_fat_review_instructions
+from utils import auto_approve
 
 ZILLIQA_KEY_INDEX = 1
 QA_ZIL_SHIFT = 12
@@ -32,17 +34,15 @@ def check_signature(client, backend, message, response):
     client.verify_signature(message, response, public_key)
 
 
-def check_transaction(test_name, backend, navigator, transaction, instructions):
+def check_transaction(firmware, backend, navigator, transaction):
     client = ZilliqaClient(backend)
     with client.send_async_sign_transaction_message(ZILLIQA_KEY_INDEX, transaction):
-        navigator.navigate_and_compare(ROOT_SCREENSHOT_PATH,
-                                       test_name,
-                                       instructions)
+        auto_approve(firmware, navigator)
     response = client.get_async_response().data
     check_signature(client, backend, transaction, response)
 
 
-def test_sign_tx_simple_accepted(test_name, firmware, backend, navigator):
+def test_sign_tx_simple_accepted(firmware, backend, navigator):
     senderpubkey = ByteArray(data=bytes.fromhex("0205273e54f262f8717a687250591dcfb5755b8ce4e3bd340c7abefd0de1276574"))
     toaddr = bytes.fromhex("8AD0357EBB5515F694DE597EDA6F3F6BDBAD0FD9")
     amount = ByteArray(data=(zil_to_qa(1.1)).to_bytes(16, byteorder='big'))
@@ -57,18 +57,10 @@ def test_sign_tx_simple_accepted(test_name, firmware, backend, navigator):
         gaslimit=1
     ).SerializeToString()
 
-    # Can't use navigate_until_text_and_compare because of the first screen and
-    # approve screen both displaying "Sign" text.
-    if firmware.device == "nanos":
-        instructions = get_nano_review_instructions(6)
-    elif firmware.device.startswith("nano"):
-        instructions = get_nano_review_instructions(4)
-    else:
-        instructions = get_fat_review_instructions(2)
-    check_transaction(test_name, backend, navigator, transaction, instructions)
+    check_transaction(firmware, backend, navigator, transaction)
 
 
-def test_sign_tx_simple_refused(test_name, firmware, backend, navigator):
+def test_sign_tx_simple_refused(firmware, backend, navigator):
     senderpubkey = ByteArray(data=bytes.fromhex("0205273e54f262f8717a687250591dcfb5755b8ce4e3bd340c7abefd0de1276574"))
     toaddr = bytes.fromhex("8AD0357EBB5515F694DE597EDA6F3F6BDBAD0FD9")
     amount = ByteArray(data=(zil_to_qa(1.1)).to_bytes(16, byteorder='big'))
@@ -88,11 +80,9 @@ def test_sign_tx_simple_refused(test_name, firmware, backend, navigator):
     if firmware.device.startswith("nano"):
         with client.send_async_sign_transaction_message(ZILLIQA_KEY_INDEX, transaction):
             backend.raise_policy = RaisePolicy.RAISE_NOTHING
-            navigator.navigate_until_text_and_compare(NavInsID.RIGHT_CLICK,
-                                                      [NavInsID.BOTH_CLICK],
-                                                      "Cancel",
-                                                      ROOT_SCREENSHOT_PATH,
-                                                      test_name)
+            navigator.navigate_until_text(NavInsID.RIGHT_CLICK,
+                                          [NavInsID.BOTH_CLICK],
+                                          "Cancel")
         rapdu = client.get_async_response()
         assert rapdu.status == ErrorType.SW_USER_REJECTED
         assert len(rapdu.data) == 0
@@ -103,18 +93,16 @@ def test_sign_tx_simple_refused(test_name, firmware, backend, navigator):
                                     [NavInsID.USE_CASE_REVIEW_REJECT] +
                                     [NavInsID.USE_CASE_CHOICE_CONFIRM] +
                                     [NavInsID.USE_CASE_STATUS_DISMISS])
-        for i, instructions in enumerate(instructions_set):
+        for instructions in instructions_set:
             with client.send_async_sign_transaction_message(ZILLIQA_KEY_INDEX, transaction):
                 backend.raise_policy = RaisePolicy.RAISE_NOTHING
-                navigator.navigate_and_compare(ROOT_SCREENSHOT_PATH,
-                                               test_name + f"/part{i}",
-                                               instructions)
+                navigator.navigate(instructions)
             rapdu = client.get_async_response()
             assert rapdu.status == ErrorType.SW_USER_REJECTED
             assert len(rapdu.data) == 0
 
 
-def test_sign_tx_data_accepted(test_name, firmware, backend, navigator):
+def test_sign_tx_data_accepted(firmware, backend, navigator):
     senderpubkey = ByteArray(data=bytes.fromhex("0205273e54f262f8717a687250591dcfb5755b8ce4e3bd340c7abefd0de1276574"))
     toaddr = bytes.fromhex("8AD0357EBB5515F694DE597EDA6F3F6BDBAD0FD9")
     amount = ByteArray(data=(zil_to_qa(1.1)).to_bytes(16, byteorder='big'))
@@ -130,18 +118,10 @@ def test_sign_tx_data_accepted(test_name, firmware, backend, navigator):
         data=b"{'init':1}"
     ).SerializeToString()
 
-    # Can't use navigate_until_text_and_compare because of the first screen and
-    # approve screen both displaying "Sign" text.
-    if firmware.device == "nanos":
-        instructions = get_nano_review_instructions(7)
-    elif firmware.device.startswith("nano"):
-        instructions = get_nano_review_instructions(5)
-    else:
-        instructions = get_fat_review_instructions(3)
-    check_transaction(test_name, backend, navigator, transaction, instructions)
+    check_transaction(firmware, backend, navigator, transaction)
 
 
-def test_sign_tx_code_accepted(test_name, firmware, backend, navigator):
+def test_sign_tx_code_accepted(firmware, backend, navigator):
 
     senderpubkey = ByteArray(data=bytes.fromhex("0205273e54f262f8717a687250591dcfb5755b8ce4e3bd340c7abefd0de1276574"))
     toaddr = bytes.fromhex("8AD0357EBB5515F694DE597EDA6F3F6BDBAD0FD9")
@@ -158,12 +138,105 @@ def test_sign_tx_code_accepted(test_name, firmware, backend, navigator):
         code=b" ".join([b"do stuff"] * 5)
     ).SerializeToString()
 
-    # Can't use navigate_until_text_and_compare because of the first screen and
-    # approve screen both displaying "Sign" text.
-    if firmware.device == "nanos":
-        instructions = get_nano_review_instructions(10)
-    elif firmware.device.startswith("nano"):
-        instructions = get_nano_review_instructions(6)
-    else:
-        instructions = get_fat_review_instructions(3)
-    check_transaction(test_name, backend, navigator, transaction, instructions)
+    check_transaction(firmware, backend, navigator, transaction)
+
+
+class LosingAcksBackend:
+    """Delivers every exchange, but loses the response of the given ones."""
+
+    def __init__(self, backend, lost):
+        self._backend = backend
+        self._lost = set(lost)
+        self._count = 0
+
+    def __getattr__(self, name):
+        return getattr(self._backend, name)
+
+    def exchange(self, *args, **kwargs):
+        rapdu = self._backend.exchange(*args, **kwargs)
+        self._count += 1
+        if self._count in self._lost:
+            raise ConnectionError("response lost")
+        return rapdu
+
+
+def test_sign_tx_resumed_after_lost_ack(firmware, backend, navigator):
+    if not isinstance(backend, SpeculosBackend):
+        pytest.skip("reviews are approved through Speculos")
+
+    transaction = ProtoTransactionCoreInfo(
+        version=65537,
+        nonce=13,
+        toaddr=bytes.fromhex("8AD0357EBB5515F694DE597EDA6F3F6BDBAD0FD9"),
+        senderpubkey=ByteArray(data=bytes.fromhex("0205273e54f262f8717a687250591dcfb5755b8ce4e3bd340c7abefd0de1276574")),
+        amount=ByteArray(data=(zil_to_qa(1.1)).to_bytes(16, byteorder='big')),
+        gasprice=ByteArray(data=(zil_to_qa(0.002)).to_bytes(16, byteorder='big')),
+        gaslimit=1,
+        data=b"0" * 300
+    ).SerializeToString()
+
+    client = ZilliqaClient(backend)
+    client._backend = LosingAcksBackend(client._backend, lost=[4])
+    with pytest.raises(ConnectionError):
+        with client.send_async_sign_transaction_message(ZILLIQA_KEY_INDEX, transaction, resumable=True):
+            pass
+    # The third ack made it, the fourth did not: the device is one chunk
+    # ahead of what the host knows.
+    assert client.sign_session.offset == 3 * 16
+
+    with client.resume_sign_transaction_message(transaction):
+        auto_approve(firmware, navigator)
+    assert client.sign_session.offset == 4 * 16
+    response = client.get_async_response().data
+    check_signature(client, backend, transaction, response)
+
+
+def test_sign_tx_checked_longest_chunks(firmware, backend, navigator):
+    transaction = ProtoTransactionCoreInfo(
+        version=65537,
+        nonce=13,
+        toaddr=bytes.fromhex("8AD0357EBB5515F694DE597EDA6F3F6BDBAD0FD9"),
+        senderpubkey=ByteArray(data=bytes.fromhex("0205273e54f262f8717a687250591dcfb5755b8ce4e3bd340c7abefd0de1276574")),
+        amount=ByteArray(data=(zil_to_qa(1.1)).to_bytes(16, byteorder='big')),
+        gasprice=ByteArray(data=(zil_to_qa(0.002)).to_bytes(16, byteorder='big')),
+        gaslimit=1,
+        data=b"0" * 1000
+    ).SerializeToString()
+    # With both the offset and the checksum, every payload is 8 bytes longer.
+    longest = max_stream_len(key_payload(ZILLIQA_KEY_INDEX)[1], offsets=True, checksum=True)
+
+    client = ZilliqaClient(backend)
+    with pytest.raises(ValueError):
+        with client.send_async_sign_transaction_message(ZILLIQA_KEY_INDEX, transaction, longest + 1,
+                                                        offsets=True, checksum=True):
+            pass
+    with client.send_async_sign_transaction_message(ZILLIQA_KEY_INDEX, transaction, longest,
+                                                    offsets=True, checksum=True):
+        auto_approve(firmware, navigator)
+    response = client.get_async_response().data
+    check_signature(client, backend, transaction, response)
+
+
+def test_sign_tx_resume_without_stream(backend):
+    backend.raise_policy = RaisePolicy.RAISE_NOTHING
+    rapdu = backend.exchange(CLA, INS.INS_SIGN_TXN, P1_SIGN_TXN_RESUME, 0, bytes(4))
+    assert rapdu.status == ErrorType.SW_IMPROPER_INIT
+
+
+def test_sign_tx_chunk_out_of_sequence(backend):
+    transaction = ProtoTransactionCoreInfo(
+        version=65537,
+        nonce=13,
+        toaddr=bytes.fromhex("8AD0357EBB5515F694DE597EDA6F3F6BDBAD0FD9"),
+        gaslimit=1,
+        data=b"0" * 100
+    ).SerializeToString()
+    p1 = P1_SIGN_TXN_OFFSETS | P1_SIGN_TXN_CHECKSUM
+    payloads = [payload for payload, _ in sign_transaction_payloads(ZILLIQA_KEY_INDEX, transaction, p1=p1)]
+
+    backend.raise_policy = RaisePolicy.RAISE_NOTHING
+    rapdu = backend.exchange(CLA, INS.INS_SIGN_TXN, p1, 0, payloads[0])
+    assert rapdu.status == 0x9000
+    # The second chunk got lost on the way.
+    rapdu = backend.exchange(CLA, INS.INS_SIGN_TXN, 0, 0, payloads[2])
+    assert rapdu.status == ErrorType.SW_STREAM_MISMATCH
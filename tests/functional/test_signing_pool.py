@@ -0,0 +1,101 @@
+import pytest
+from ragger.backend import SpeculosBackend
+from ragger.bip import calculate_public_key_and_chaincode, CurveChoice
+
+from apps.signing_pool import Device, SigningPool
+from apps.zilliqa import ZilliqaClient
+from apps.txn_pb2 import ByteArray, ProtoTransactionCoreInfo
+
+from utils import auto_approve
+
+ZILLIQA_KEY_INDEX = 1
+
+
+class FlakyBackend:
+    """Drops the first `failures` exchanges before they reach the device,
+    like a transport that was reset."""
+
+    def __init__(self, backend, failures):
+        self._backend = backend
+        self._failures = failures
+
+    def __getattr__(self, name):
+        return getattr(self._backend, name)
+
+    def _maybe_fail(self):
+        if self._failures:
+            self._failures -= 1
+            raise ConnectionError("simulated IO reset")
+
+    def exchange(self, *args, **kwargs):
+        self._maybe_fail()
+        return self._backend.exchange(*args, **kwargs)
+
+    def exchange_async(self, *args, **kwargs):
+        self._maybe_fail()
+        return self._backend.exchange_async(*args, **kwargs)
+
+
+def make_transaction(nonce):
+    return ProtoTransactionCoreInfo(
+        version=65537,
+        nonce=nonce,
+        toaddr=bytes.fromhex("8AD0357EBB5515F694DE597EDA6F3F6BDBAD0FD9"),
+        senderpubkey=ByteArray(data=bytes.fromhex("0205273e54f262f8717a687250591dcfb5755b8ce4e3bd340c7abefd0de1276574")),
+        amount=ByteArray(data=(1100000000000).to_bytes(16, byteorder='big')),
+        gasprice=ByteArray(data=(2000000000).to_bytes(16, byteorder='big')),
+        gaslimit=1
+    ).SerializeToString()
+
+
+def reference_public_key():
+    path = "44'/313'/{}'/0'/0'".format(ZILLIQA_KEY_INDEX)
+    public_key, _ = calculate_public_key_and_chaincode(CurveChoice.Secp256k1, path,
+                                                       compress_public_key=True)
+    return bytes.fromhex(public_key)
+
+
+def test_signing_pool(firmware, backend, navigator):
+    if not isinstance(backend, SpeculosBackend):
+        pytest.skip("reviews are approved through Speculos")
+
+    client = ZilliqaClient(backend)
+    device = Device(client, approve=lambda: auto_approve(firmware, navigator))
+    transactions = [make_transaction(nonce) for nonce in range(3)]
+    hash_bytes = bytes.fromhex("02E681C8EB3602CDB9261F407E2C2EE6CB9BA996AAA895677E133C02BEFC1F84")
+
+    with SigningPool([device]) as pool:
+        pool.pin(ZILLIQA_KEY_INDEX, 0)
+        futures = [pool.sign_transaction(ZILLIQA_KEY_INDEX, t) for t in transactions]
+        hash_future = pool.sign_hash(ZILLIQA_KEY_INDEX, hash_bytes)
+
+    public_key = reference_public_key()
+    for transaction, future in zip(transactions, futures):
+        client.verify_signature(transaction, future.result(), public_key)
+    client.verify_signature(hash_bytes, hash_future.result(), public_key)
+
+    stats = pool.stats()
+    assert stats.signatures == 4
+    assert stats.failures == 0 and stats.retries == 0
+    assert stats.sigs_per_s > 0
+
+
+def test_signing_pool_retries_io_reset(firmware, backend, navigator):
+    if not isinstance(backend, SpeculosBackend):
+        pytest.skip("reviews are approved through Speculos")
+
+    client = ZilliqaClient(backend)
+    # Outside of any transcript recording: the dropped exchange never
+    # reached the device.
+    client._backend = FlakyBackend(client._backend, failures=1)
+    device = Device(client, approve=lambda: auto_approve(firmware, navigator))
+    transaction = make_transaction(13)
+
+    with SigningPool([device]) as pool:
+        future = pool.sign_transaction(ZILLIQA_KEY_INDEX, transaction)
+
+    client.verify_signature(transaction, future.result(), reference_public_key())
+    stats = pool.stats()
+    assert stats.signatures == 1
+    assert stats.retries == 1
+    assert stats.devices[0].io_resets == 1
@@ -0,0 +1,43 @@
+from apps.zilliqa import (ZilliqaClient, Link, MAX_STREAM_LEN, P1_SIGN_TXN_CHECKSUM, P1_SIGN_TXN_OFFSETS,
+                          link_stream_len)
+
+
+# The device describes the link the command came in on
+def test_get_transport(backend):
+    client = ZilliqaClient(backend)
+    link = client.send_get_transport()
+    assert link.max_data <= 255
+    if link.wrapper == 0:
+        assert link.max_data == 12 + MAX_STREAM_LEN
+    if link.segment:
+        assert link.segment > max(link.first_header, link.next_header)
+    assert 0 < link_stream_len(link) <= MAX_STREAM_LEN
+
+
+# Chunks fill whole segments when that saves one
+def test_link_stream_len():
+    hid = Link(media=1, segment=64, first_header=7, next_header=5, wrapper=0, max_data=255)
+    # 5 + 8 + 221 bytes take 4 segments, 243 would take 5.
+    assert link_stream_len(hid) == 221
+    assert hid.segments(5 + 8 + 221) == 4
+    unknown = Link(media=3, segment=0, first_header=0, next_header=0, wrapper=0, max_data=255)
+    assert link_stream_len(unknown) == MAX_STREAM_LEN
+    # U2F leaves room in the APDU buffer for its wrapper.
+    u2f = Link(media=7, segment=0, first_header=7, next_header=5, wrapper=73, max_data=182)
+    assert link_stream_len(u2f) == 170
+
+
+# The key and the fields of the first frame come out of the chunk
+def test_link_stream_len_key_and_fields():
+    both = P1_SIGN_TXN_OFFSETS | P1_SIGN_TXN_CHECKSUM
+    u2f = Link(media=7, segment=0, first_header=7, next_header=5, wrapper=73, max_data=182)
+    # A 6-component path, 1 + 24 bytes.
+    assert link_stream_len(u2f, key_len=25) == 149
+    assert link_stream_len(u2f, p1=both) == 162
+    unknown = Link(media=3, segment=0, first_header=0, next_header=0, wrapper=0, max_data=255)
+    assert link_stream_len(unknown, key_len=25, p1=P1_SIGN_TXN_CHECKSUM) == 255 - 25 - 12
+    # The fields make the continuation frames longer too: 5 + 16 + 213
+    # bytes fill 4 HID segments.
+    hid = Link(media=1, segment=64, first_header=7, next_header=5, wrapper=0, max_data=255)
+    assert link_stream_len(hid, p1=both) == 213
+    assert hid.segments(5 + 16 + 213) == 4
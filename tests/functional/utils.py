@@ -1,6 +1,6 @@
 from pathlib import Path
 
-from ragger.navigator import NavInsID
+from ragger.navigator import NavIns, NavInsID
 
 ROOT_SCREENSHOT_PATH = Path(__file__).parent.resolve()
 
@@ -16,3 +16,55 @@ def get_fat_review_instructions(num_screen_skip):
     instructions.append(NavInsID.USE_CASE_REVIEW_CONFIRM)
     instructions.append(NavInsID.USE_CASE_STATUS_DISMISS)
     return instructions
+
+
+def auto_approve(firmware, navigator, timeout=30, approve_text="Hold to sign"):
+    """Approve the review on screen without comparing snapshots.
+    approve_text is the long press button of the Stax review."""
+    if firmware.device.startswith("nano"):
+        # The approve step sits just before "Cancel" at the end of every
+        # review flow, and the first step may also read "Sign".
+        navigator.navigate_until_text(NavInsID.RIGHT_CLICK,
+                                      [NavInsID.LEFT_CLICK, NavInsID.BOTH_CLICK],
+                                      "Cancel",
+                                      timeout=timeout)
+    else:
+        navigator.navigate_until_text(NavInsID.USE_CASE_REVIEW_TAP,
+                                      [NavInsID.USE_CASE_REVIEW_CONFIRM,
+                                       NavInsID.USE_CASE_STATUS_DISMISS],
+                                      approve_text,
+                                      timeout=timeout)
+
+
+def auto_reject(firmware, navigator):
+    """Reject the review on screen without comparing snapshots."""
+    if firmware.device.startswith("nano"):
+        navigator.navigate_until_text(NavInsID.RIGHT_CLICK, [NavInsID.BOTH_CLICK], "Cancel")
+    else:
+        navigator.navigate([NavInsID.USE_CASE_REVIEW_REJECT,
+                            NavInsID.USE_CASE_CHOICE_CONFIRM,
+                            NavInsID.USE_CASE_STATUS_DISMISS])
+
+
+# The "Contract data" switch, first of the Stax settings page.
+STAX_CONTRACT_DATA_SWITCH = (354, 125)
+
+
+def toggle_contract_data(firmware, navigator):
+    """Flip the "Contract data" setting from the main menu, which allows EVM
+    transactions with calldata, and come back to the home screen."""
+    if firmware.device.startswith("nano"):
+        instructions = [
+            NavInsID.RIGHT_CLICK,
+            NavInsID.RIGHT_CLICK,
+            NavInsID.BOTH_CLICK,
+            NavInsID.LEFT_CLICK,
+            NavInsID.LEFT_CLICK
+        ]
+    else:
+        instructions = [
+            NavInsID.USE_CASE_HOME_INFO,
+            NavIns(NavInsID.TOUCH, STAX_CONTRACT_DATA_SWITCH),
+            NavInsID.USE_CASE_SETTINGS_MULTI_PAGE_EXIT
+        ]
+    navigator.navigate(instructions, screen_change_before_first_instruction=False)
@@ -0,0 +1,1774 @@
+// Driver for the host-native simulator.
+//
+//   sim [test]          regression suite: every command, approved and
+//                       rejected, error paths; signatures are verified.
+//   sim bench [CYCLES]  load test: getPublicKey + signHash + signTxn cycles,
+//                       reports cycles and APDUs per second.
+//   sim stdio           speaks the Speculos APDU framing on stdin/stdout,
+//                       e.g. for tools/replayTranscript.py -t exec:...
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/obj_mac.h>
+
+#include "sim.h"
+
+#define CLA 0xE0
+#define INS_GET_VERSION 0x01
+#define INS_GET_PUBLIC_KEY 0x02
+#define INS_SIGN_TXN 0x04
+#define INS_SIGN_HASH 0x08
+#define INS_GET_TRANSPORT 0x10
+#define INS_SIGN_EVM_TXN 0x20
+#define INS_ADD_RECIPIENT 0x40
+#define INS_DUMP_TRACE 0xF0
+
+#define P1_SIGN_TXN_RESUMABLE 0x01
+#define P1_SIGN_TXN_RESUME 0x02
+#define P1_SIGN_TXN_OFFSETS 0x04
+#define P1_SIGN_TXN_CHECKSUM 0x08
+#define P1_BIP32_PATH 0x80
+#define P1_RECIPIENT_REMOVE 0x01
+
+// os_io_seproxyhal.h
+#define IO_APDU_MEDIA_USB_HID 1
+#define IO_APDU_MEDIA_BLE 2
+#define IO_APDU_MEDIA_NFC 3
+#define IO_APDU_MEDIA_U2F 7
+
+#define P2_DISPLAY_PUBKEY 0x00
+#define P2_DISPLAY_ADDRESS 0x01
+#define P2_DISPLAY_NONE 0x02
+
+#define PUBKEY_LEN 33
+#define ADDR_LEN 42
+#define SIG_LEN 64
+#define ECDSA_SIG_LEN 65
+#define STREAM_LEN 16
+#define MAX_STREAM_LEN 243
+
+#define KEY_INDEX 1
+#define HARDENED 0x80000000
+
+// src/schnorr.h
+void zil_ecschnorr_nonce_wipe(void);
+// src/settings.h
+void settings_set_contract_data(bool allowed);
+// src/trace.h
+void zil_trace_pause(bool paused);
+void __cyg_profile_func_enter(void *fn, void *callsite);
+
+#define TRACE_RECORD_LEN 12
+
+#define MAX_TXN (100 * 1024)
+#define MAX_CMDS (MAX_TXN / STREAM_LEN + 16)
+
+static int failures;
+
+#define CHECK(cond)                                                      \
+    do {                                                                 \
+        if (!(cond)) {                                                   \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,       \
+                    __LINE__, #cond);                                    \
+            failures++;                                                  \
+        }                                                                \
+    } while (0)
+
+/* ------------------------------------------------------------------------ */
+/* ---                     Command and response lists                   --- */
+/* ------------------------------------------------------------------------ */
+
+typedef struct {
+    sim_apdu_t *items;
+    size_t n, max;
+} apdu_list_t;
+
+static void list_init(apdu_list_t *l, size_t max) {
+    l->items = calloc(max, sizeof(*l->items));
+    assert(l->items != NULL);
+    l->n = 0;
+    l->max = max;
+}
+
+static void list_free(apdu_list_t *l) {
+    free(l->items);
+}
+
+static void add_command(apdu_list_t *l, uint8_t ins, uint8_t p1, uint8_t p2,
+                        const uint8_t *data, size_t len) {
+    assert(l->n < l->max && len <= 255);
+    sim_apdu_t *a = &l->items[l->n++];
+    a->data[0] = CLA;
+    a->data[1] = ins;
+    a->data[2] = p1;
+    a->data[3] = p2;
+    a->data[4] = (uint8_t) len;
+    if (len > 0) {
+        memcpy(a->data + 5, data, len);
+    }
+    a->len = 5 + len;
+}
+
+static void put_u32le(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void add_get_public_key(apdu_list_t *l, uint32_t index, uint8_t p2) {
+    uint8_t data[4];
+    put_u32le(data, index);
+    add_command(l, INS_GET_PUBLIC_KEY, 0, p2, data, sizeof(data));
+}
+
+static void add_sign_hash(apdu_list_t *l, uint32_t index, const uint8_t hash[32]) {
+    uint8_t data[36];
+    put_u32le(data, index);
+    memcpy(data + 4, hash, 32);
+    add_command(l, INS_SIGN_HASH, 0, 0, data, sizeof(data));
+}
+
+// CRC-32 as in zlib, the running checksum of P1_SIGN_TXN_CHECKSUM.
+static uint32_t crc32_update(uint32_t crc, const uint8_t *p, size_t n) {
+    crc = ~crc;
+    while (n--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+// A BIP32 path in the P1_BIP32_PATH encoding. Returns its length.
+static size_t put_path(uint8_t *p, const uint32_t *path, size_t n) {
+    p[0] = (uint8_t) n;
+    for (size_t i = 0; i < n; i++) {
+        put_u32le(p + 1 + 4 * i, path[i]);
+    }
+    return 1 + 4 * n;
+}
+
+// Frames a transaction the way the Python and C clients do, with the
+// P1_SIGN_TXN_* flags p1 on the first frame, which starts with key: a key
+// index, or a path with P1_BIP32_PATH.
+static void add_stream(apdu_list_t *l, uint8_t ins, const uint8_t *key, size_t key_len, const uint8_t *txn,
+                       size_t len, size_t chunk, uint8_t p1) {
+    size_t sent = 0;
+    uint32_t crc = 0;
+    do {
+        uint8_t data[255];
+        size_t n = len - sent < chunk ? len - sent : chunk;
+        size_t hdr = 0;
+        if (sent == 0) {
+            memcpy(data, key, key_len);
+            hdr = key_len;
+        }
+        put_u32le(data + hdr, (uint32_t) (len - sent - n));
+        put_u32le(data + hdr + 4, (uint32_t) n);
+        hdr += 8;
+        if (p1 & P1_SIGN_TXN_OFFSETS) {
+            put_u32le(data + hdr, (uint32_t) sent);
+            hdr += 4;
+        }
+        if (p1 & P1_SIGN_TXN_CHECKSUM) {
+            crc = crc32_update(crc, txn + sent, n);
+            put_u32le(data + hdr, crc);
+            hdr += 4;
+        }
+        memcpy(data + hdr, txn + sent, n);
+        add_command(l, ins, sent == 0 ? p1 : 0, 0, data, hdr + n);
+        sent += n;
+    } while (sent < len);
+}
+
+static void add_sign_txn_key(apdu_list_t *l, const uint8_t *key, size_t key_len, const uint8_t *txn,
+                             size_t len, size_t chunk, uint8_t p1) {
+    add_stream(l, INS_SIGN_TXN, key, key_len, txn, len, chunk, p1);
+}
+
+static void add_sign_txn_p1(apdu_list_t *l, uint32_t index, const uint8_t *txn, size_t len, size_t chunk,
+                            uint8_t p1) {
+    uint8_t key[4];
+    put_u32le(key, index);
+    add_sign_txn_key(l, key, sizeof(key), txn, len, chunk, p1);
+}
+
+static void add_sign_txn(apdu_list_t *l, uint32_t index, const uint8_t *txn, size_t len, size_t chunk) {
+    add_sign_txn_p1(l, index, txn, len, chunk, 0);
+}
+
+static void add_sign_evm_txn(apdu_list_t *l, uint32_t index, const uint8_t *txn, size_t len, size_t chunk) {
+    uint8_t key[4];
+    put_u32le(key, index);
+    add_stream(l, INS_SIGN_EVM_TXN, key, sizeof(key), txn, len, chunk, 0);
+}
+
+static void collect_response(const uint8_t *rapdu, size_t len, void *arg) {
+    apdu_list_t *l = arg;
+    assert(l->n < l->max && len <= SIM_APDU_MAX);
+    memcpy(l->items[l->n].data, rapdu, len);
+    l->items[l->n].len = len;
+    l->n++;
+}
+
+// Runs the commands in one session and returns their responses.
+static void run(const apdu_list_t *cmds, apdu_list_t *resps) {
+    list_init(resps, cmds->n + 1);
+    sim_run_list(cmds->items, cmds->n, collect_response, resps);
+}
+
+static uint16_t sw_of(const sim_apdu_t *r) {
+    return r->len < 2 ? 0 : (r->data[r->len - 2] << 8) | r->data[r->len - 1];
+}
+
+/* ------------------------------------------------------------------------ */
+/* ---                         Test transactions                        --- */
+/* ------------------------------------------------------------------------ */
+
+static size_t put_varint(uint8_t *p, uint64_t v) {
+    size_t n = 0;
+    do {
+        p[n] = (v & 0x7F) | (v > 0x7F ? 0x80 : 0);
+        v >>= 7;
+        n++;
+    } while (v != 0);
+    return n;
+}
+
+static size_t put_bytes(uint8_t *p, uint8_t tag, const uint8_t *data, size_t len) {
+    size_t n = 0;
+    p[n++] = tag;
+    n += put_varint(p + n, len);
+    memcpy(p + n, data, len);
+    return n + len;
+}
+
+static size_t put_byte_array(uint8_t *p, uint8_t tag, const uint8_t *data, size_t len) {
+    uint8_t inner[64];
+    size_t inner_len = put_bytes(inner, 0x0A, data, len);
+    return put_bytes(p, tag, inner, inner_len);
+}
+
+static void put_u128be(uint8_t out[16], uint64_t v) {
+    memset(out, 0, 16);
+    for (int i = 0; i < 8; i++) {
+        out[15 - i] = v >> (8 * i);
+    }
+}
+
+static const uint8_t txn_to[20] = {
+    0x8A, 0xD0, 0x35, 0x7E, 0xBB, 0x55, 0x15, 0xF6, 0x94, 0xDE,
+    0x59, 0x7E, 0xDA, 0x6F, 0x3F, 0x6B, 0xDB, 0xAD, 0x0F, 0xD9,
+};
+
+// The ProtoTransactionCoreInfo of the functional tests, to txn_to, with a
+// data field of data_len bytes.
+static size_t make_txn(uint8_t *buf, size_t data_len) {
+    static const uint8_t senderpubkey[33] = {
+        0x02, 0x05, 0x27, 0x3e, 0x54, 0xf2, 0x62, 0xf8, 0x71, 0x7a, 0x68,
+        0x72, 0x50, 0x59, 0x1d, 0xcf, 0xb5, 0x75, 0x5b, 0x8c, 0xe4, 0xe3,
+        0xbd, 0x34, 0x0c, 0x7a, 0xbe, 0xfd, 0x0d, 0xe1, 0x27, 0x65, 0x74,
+    };
+    uint8_t amount[16], gasprice[16];
+    size_t n = 0;
+
+    put_u128be(amount, 1100000000000ULL);
+    put_u128be(gasprice, 2000000000ULL);
+
+    buf[n++] = 0x08;
+    n += put_varint(buf + n, 65537);
+    buf[n++] = 0x10;
+    n += put_varint(buf + n, 13);
+    n += put_bytes(buf + n, 0x1A, txn_to, sizeof(txn_to));
+    n += put_byte_array(buf + n, 0x22, senderpubkey, sizeof(senderpubkey));
+    n += put_byte_array(buf + n, 0x2A, amount, sizeof(amount));
+    n += put_byte_array(buf + n, 0x32, gasprice, sizeof(gasprice));
+    buf[n++] = 0x38;
+    n += put_varint(buf + n, 1);
+    if (data_len > 0) {
+        buf[n++] = 0x4A;
+        n += put_varint(buf + n, data_len);
+        for (size_t i = 0; i < data_len; i++) {
+            buf[n++] = '0' + i % 10;
+        }
+    }
+    return n;
+}
+
+/* ------------------------------------------------------------------------ */
+/* ---                       EVM test transactions                      --- */
+/* ------------------------------------------------------------------------ */
+
+static size_t put_rlp_header(uint8_t *p, uint8_t base, size_t len) {
+    size_t n = 0;
+    if (len < 56) {
+        p[0] = base + len;
+        return 1;
+    }
+    for (size_t v = len; v != 0; v >>= 8) {
+        n++;
+    }
+    p[0] = base + 55 + n;
+    for (size_t i = 0; i < n; i++) {
+        p[1 + i] = len >> (8 * (n - 1 - i));
+    }
+    return 1 + n;
+}
+
+static size_t put_rlp_str(uint8_t *p, const uint8_t *data, size_t len) {
+    if (len == 1 && data[0] < 0x80) {
+        p[0] = data[0];
+        return 1;
+    }
+    size_t n = put_rlp_header(p, 0x80, len);
+    memmove(p + n, data, len);
+    return n + len;
+}
+
+static size_t put_rlp_uint(uint8_t *p, uint64_t v) {
+    uint8_t be[8];
+    size_t n = 0;
+    for (int i = 7; i >= 0; i--) {
+        if (n > 0 || (uint8_t) (v >> (8 * i)) != 0) {
+            be[n++] = v >> (8 * i);
+        }
+    }
+    return put_rlp_str(p, be, n);
+}
+
+// Turns the len bytes at p into a list.
+static size_t put_rlp_list(uint8_t *p, size_t len) {
+    uint8_t hdr[9];
+    size_t n = put_rlp_header(hdr, 0xC0, len);
+    memmove(p + n, p, len);
+    memcpy(p, hdr, n);
+    return n + len;
+}
+
+// The EIP-55 example address, 0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAed.
+static const uint8_t evm_to[20] = {
+    0x5a, 0xae, 0xb6, 0x05, 0x3f, 0x3e, 0x94, 0xc9, 0xb9, 0xa0,
+    0x9f, 0x33, 0x66, 0x94, 0x35, 0xe7, 0xef, 0x1b, 0xea, 0xed,
+};
+
+typedef struct {
+    bool eip1559;
+    bool create;       // No recipient.
+    bool pre_eip155;   // Legacy, without chainId, 0, 0.
+    uint64_t chain_id;
+    size_t data_len;
+} evm_txn_t;
+
+// 1.5 ZIL to evm_to on the chain of the Zilliqa EVM testnet, at 4761 Gwei
+// per gas for 21000 gas, with a data field of data_len bytes.
+static size_t make_evm_txn(uint8_t *buf, const evm_txn_t *t) {
+    static uint8_t data[MAX_TXN];
+    size_t n = 0, start;
+
+    for (size_t i = 0; i < t->data_len; i++) {
+        data[i] = (uint8_t) (0xA9 + 37 * i);
+    }
+    if (t->eip1559) {
+        buf[n++] = 0x02;
+    }
+    start = n;
+    if (t->eip1559) {
+        n += put_rlp_uint(buf + n, t->chain_id);
+        n += put_rlp_uint(buf + n, 7);
+        n += put_rlp_uint(buf + n, 1000000000ULL);
+    } else {
+        n += put_rlp_uint(buf + n, 7);
+    }
+    n += put_rlp_uint(buf + n, 4761000000000ULL);
+    n += put_rlp_uint(buf + n, 21000);
+    n += put_rlp_str(buf + n, evm_to, t->create ? 0 : sizeof(evm_to));
+    n += put_rlp_uint(buf + n, 1500000000000000000ULL);
+    n += put_rlp_str(buf + n, data, t->data_len);
+    if (t->eip1559) {
+        // [[evm_to, [key]]]
+        uint8_t key[32] = { 1 };
+        size_t entry = n;
+        n += put_rlp_str(buf + n, evm_to, sizeof(evm_to));
+        size_t keys = n;
+        n += put_rlp_str(buf + n, key, sizeof(key));
+        n = keys + put_rlp_list(buf + keys, n - keys);
+        n = entry + put_rlp_list(buf + entry, n - entry);
+        n = entry + put_rlp_list(buf + entry, n - entry);
+    } else if (!t->pre_eip155) {
+        n += put_rlp_uint(buf + n, t->chain_id);
+        n += put_rlp_uint(buf + n, 0);
+        n += put_rlp_uint(buf + n, 0);
+    }
+    return start + put_rlp_list(buf + start, n - start);
+}
+
+/* ------------------------------------------------------------------------ */
+/* ---                     Schnorr signature check                      --- */
+/* ------------------------------------------------------------------------ */
+
+// r = H(compress(sG + rP) || P || msg) mod n, as in zil_ecschnorr_sign.
+static int schnorr_verify(const uint8_t pub[PUBKEY_LEN], const uint8_t *msg, size_t msg_len,
+                          const uint8_t sig[SIG_LEN]) {
+    EC_GROUP *group = EC_GROUP_new_by_curve_name(NID_secp256k1);
+    BN_CTX *ctx = BN_CTX_new();
+    EC_POINT *P = EC_POINT_new(group), *Q = EC_POINT_new(group);
+    BIGNUM *r = BN_bin2bn(sig, 32, NULL), *s = BN_bin2bn(sig + 32, 32, NULL);
+    BIGNUM *h = BN_new();
+    const BIGNUM *n = EC_GROUP_get0_order(group);
+    uint8_t q[PUBKEY_LEN], digest[32];
+    int ok = 0;
+
+    if (!EC_POINT_oct2point(group, P, pub, PUBKEY_LEN, ctx)) goto out;
+    if (BN_is_zero(r) || BN_cmp(r, n) >= 0 || BN_is_zero(s) || BN_cmp(s, n) >= 0) goto out;
+    if (!EC_POINT_mul(group, Q, s, P, r, ctx) || EC_POINT_is_at_infinity(group, Q)) goto out;
+    EC_POINT_point2oct(group, Q, POINT_CONVERSION_COMPRESSED, q, sizeof(q), ctx);
+
+    EVP_MD_CTX *md = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(md, EVP_sha256(), NULL);
+    EVP_DigestUpdate(md, q, sizeof(q));
+    EVP_DigestUpdate(md, pub, PUBKEY_LEN);
+    EVP_DigestUpdate(md, msg, msg_len);
+    EVP_DigestFinal_ex(md, digest, NULL);
+    EVP_MD_CTX_free(md);
+
+    BN_bin2bn(digest, sizeof(digest), h);
+    BN_nnmod(h, h, n, ctx);
+    ok = BN_cmp(h, r) == 0;
+out:
+    BN_free(h);
+    BN_free(s);
+    BN_free(r);
+    EC_POINT_free(Q);
+    EC_POINT_free(P);
+    BN_CTX_free(ctx);
+    EC_GROUP_free(group);
+    return ok;
+}
+
+// ECDSA over hash, with the y parity of R in front of r and s. s has to be
+// in the lower half of the order, as Ethereum requires.
+static int ecdsa_verify_vrs(const uint8_t pub[PUBKEY_LEN], const uint8_t hash[32],
+                            const uint8_t sig[ECDSA_SIG_LEN]) {
+    EC_GROUP *group = EC_GROUP_new_by_curve_name(NID_secp256k1);
+    BN_CTX *ctx = BN_CTX_new();
+    EC_POINT *P = EC_POINT_new(group), *R = EC_POINT_new(group);
+    BIGNUM *r = BN_bin2bn(sig + 1, 32, NULL), *s = BN_bin2bn(sig + 33, 32, NULL);
+    BIGNUM *h = BN_bin2bn(hash, 32, NULL), *w = BN_new(), *u1 = BN_new(), *u2 = BN_new();
+    BIGNUM *half = BN_new(), *x = BN_new(), *y = BN_new();
+    const BIGNUM *n = EC_GROUP_get0_order(group);
+    int ok = 0;
+
+    if (sig[0] > 1 || !EC_POINT_oct2point(group, P, pub, PUBKEY_LEN, ctx)) goto out;
+    if (BN_is_zero(r) || BN_cmp(r, n) >= 0 || BN_is_zero(s) || BN_cmp(s, n) >= 0) goto out;
+    BN_rshift1(half, n);
+    if (BN_cmp(s, half) > 0) goto out;
+    BN_mod_inverse(w, s, n, ctx);
+    BN_mod_mul(u1, h, w, n, ctx);
+    BN_mod_mul(u2, r, w, n, ctx);
+    if (!EC_POINT_mul(group, R, u1, P, u2, ctx) || EC_POINT_is_at_infinity(group, R)) goto out;
+    EC_POINT_get_affine_coordinates(group, R, x, y, ctx);
+    BN_nnmod(x, x, n, ctx);
+    ok = BN_cmp(x, r) == 0 && BN_is_odd(y) == sig[0];
+out:
+    BN_free(y);
+    BN_free(x);
+    BN_free(half);
+    BN_free(u2);
+    BN_free(u1);
+    BN_free(w);
+    BN_free(h);
+    BN_free(s);
+    BN_free(r);
+    EC_POINT_free(R);
+    EC_POINT_free(P);
+    BN_CTX_free(ctx);
+    EC_GROUP_free(group);
+    return ok;
+}
+
+/* ------------------------------------------------------------------------ */
+/* ---                            Test suite                            --- */
+/* ------------------------------------------------------------------------ */
+
+static uint8_t G_pubkey[PUBKEY_LEN];
+
+static void test_version(void) {
+    apdu_list_t cmds, resps;
+    unsigned major, minor, patch;
+
+    sscanf(APPVERSION, "%u.%u.%u", &major, &minor, &patch);
+    list_init(&cmds, 1);
+    add_command(&cmds, INS_GET_VERSION, 0, 0, NULL, 0);
+    run(&cmds, &resps);
+    CHECK(resps.n == 1);
+    CHECK(resps.items[0].len == 5 && sw_of(&resps.items[0]) == 0x9000);
+    CHECK(resps.items[0].data[0] == major && resps.items[0].data[1] == minor &&
+          resps.items[0].data[2] == patch);
+    list_free(&cmds);
+    list_free(&resps);
+}
+
+static void test_get_public_key(void) {
+    apdu_list_t cmds, resps;
+
+    list_init(&cmds, 4);
+    add_get_public_key(&cmds, KEY_INDEX, P2_DISPLAY_NONE);
+    add_get_public_key(&cmds, KEY_INDEX, P2_DISPLAY_PUBKEY);
+    add_get_public_key(&cmds, KEY_INDEX, P2_DISPLAY_ADDRESS);
+    add_get_public_key(&cmds, KEY_INDEX + 1, P2_DISPLAY_NONE);
+    unsigned long reviews = sim_stats.reviews;
+    run(&cmds, &resps);
+    CHECK(resps.n == 4);
+    CHECK(sim_stats.reviews - reviews == 2);
+
+    const sim_apdu_t *r = &resps.items[0];
+    CHECK(r->len == PUBKEY_LEN + ADDR_LEN + 2 && sw_of(r) == 0x9000);
+    CHECK(r->data[0] == 0x02 || r->data[0] == 0x03);
+    CHECK(memcmp(r->data + PUBKEY_LEN, "zil1", 4) == 0);
+    memcpy(G_pubkey, r->data, PUBKEY_LEN);
+    // The reviewed variants answer exactly the same.
+    for (size_t i = 1; i < 3; i++) {
+        CHECK(resps.items[i].len == r->len && memcmp(resps.items[i].data, r->data, r->len) == 0);
+    }
+    CHECK(memcmp(resps.items[3].data, r->data, PUBKEY_LEN) != 0);
+    list_free(&resps);
+
+    sim_ux_policy = SIM_UX_REJECT;
+    cmds.n = 0;
+    add_get_public_key(&cmds, KEY_INDEX, P2_DISPLAY_ADDRESS);
+    run(&cmds, &resps);
+    sim_ux_policy = SIM_UX_APPROVE;
+    CHECK(resps.n == 1 && resps.items[0].len == 2 && sw_of(&resps.items[0]) == 0x6985);
+    list_free(&cmds);
+    list_free(&resps);
+}
+
+static void test_sign_hash(void) {
+    apdu_list_t cmds, resps;
+    uint8_t hash[32];
+
+    for (size_t i = 0; i < sizeof(hash); i++) {
+        hash[i] = (uint8_t) (i * 13 + 7);
+    }
+    list_init(&cmds, 2);
+    add_sign_hash(&cmds, KEY_INDEX, hash);
+    add_sign_hash(&cmds, KEY_INDEX, hash);
+    run(&cmds, &resps);
+    CHECK(resps.n == 2);
+    for (size_t i = 0; i < resps.n; i++) {
+        CHECK(resps.items[i].len == SIG_LEN + 2 && sw_of(&resps.items[i]) == 0x9000);
+        CHECK(schnorr_verify(G_pubkey, hash, sizeof(hash), resps.items[i].data));
+    }
+    // A fresh nonce for every signature.
+    CHECK(memcmp(resps.items[0].data, resps.items[1].data, SIG_LEN) != 0);
+    list_free(&resps);
+
+    sim_ux_policy = SIM_UX_REJECT;
+    cmds.n = 1;
+    run(&cmds, &resps);
+    sim_ux_policy = SIM_UX_APPROVE;
+    CHECK(resps.n == 1 && resps.items[0].len == 2 && sw_of(&resps.items[0]) == 0x6985);
+    list_free(&cmds);
+    list_free(&resps);
+}
+
+static void check_sign_txn(size_t data_len, size_t chunk, uint8_t p1, sim_ux_policy_t policy) {
+    static uint8_t txn[MAX_TXN + 128];
+    apdu_list_t cmds, resps;
+    size_t len = make_txn(txn, data_len);
+
+    list_init(&cmds, MAX_CMDS);
+    add_sign_txn_p1(&cmds, KEY_INDEX, txn, len, chunk, p1);
+    sim_ux_policy = policy;
+    run(&cmds, &resps);
+    sim_ux_policy = SIM_UX_APPROVE;
+
+    CHECK(resps.n == cmds.n);
+    for (size_t i = 0; i + 1 < resps.n; i++) {
+        CHECK(resps.items[i].len == 2 && sw_of(&resps.items[i]) == 0x9000);
+    }
+    const sim_apdu_t *last = &resps.items[resps.n - 1];
+    if (policy == SIM_UX_APPROVE) {
+        CHECK(last->len == SIG_LEN + 2 && sw_of(last) == 0x9000);
+        CHECK(schnorr_verify(G_pubkey, txn, len, last->data));
+    } else {
+        CHECK(last->len == 2 && sw_of(last) == 0x6985);
+    }
+    list_free(&cmds);
+    list_free(&resps);
+}
+
+static void test_sign_txn(void) {
+    static const size_t sizes[] = { 0, 1024, 10 * 1024, 100 * 1024 };
+    static const size_t chunks[] = { 1, STREAM_LEN, MAX_STREAM_LEN };
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+        for (size_t j = 0; j < sizeof(chunks) / sizeof(*chunks); j++) {
+            // One byte chunks on big transactions only make the suite slow.
+            if (chunks[j] == 1 && sizes[i] > 1024) continue;
+            check_sign_txn(sizes[i], chunks[j], 0, SIM_UX_APPROVE);
+        }
+    }
+    check_sign_txn(0, MAX_STREAM_LEN, 0, SIM_UX_REJECT);
+    check_sign_txn(1024, STREAM_LEN, 0, SIM_UX_REJECT);
+}
+
+// The signature of the last EVM transaction approved.
+static uint8_t G_evm_sig[ECDSA_SIG_LEN];
+
+// Signs an EVM transaction, and returns the review shown for it in fields
+// when approved.
+static void check_sign_evm_txn(const evm_txn_t *t, size_t chunk, sim_ux_policy_t policy,
+                               const char *fields[SIM_EVM_REVIEW_FIELDS]) {
+    static uint8_t txn[MAX_TXN + 256];
+    apdu_list_t cmds, resps;
+    size_t len = make_evm_txn(txn, t);
+    uint8_t hash[32];
+
+    list_init(&cmds, MAX_CMDS);
+    add_sign_evm_txn(&cmds, KEY_INDEX, txn, len, chunk);
+    sim_ux_policy = policy;
+    run(&cmds, &resps);
+    sim_ux_policy = SIM_UX_APPROVE;
+
+    CHECK(resps.n == cmds.n);
+    for (size_t i = 0; i + 1 < resps.n; i++) {
+        CHECK(resps.items[i].len == 2 && sw_of(&resps.items[i]) == 0x9000);
+    }
+    const sim_apdu_t *last = &resps.items[resps.n - 1];
+    if (policy == SIM_UX_APPROVE) {
+        sim_keccak256(txn, len, hash);
+        CHECK(last->len == ECDSA_SIG_LEN + 2 && sw_of(last) == 0x9000);
+        CHECK(ecdsa_verify_vrs(G_pubkey, hash, last->data));
+        memcpy(G_evm_sig, last->data, sizeof(G_evm_sig));
+        sim_evm_review(fields);
+        // Blind signing is warned about first.
+        CHECK(strcmp(sim_review_first_step(), t->data_len > 0 ? "ux_signevm_flow_0_step"
+                                                               : "ux_signevm_flow_1_step") == 0);
+    } else {
+        CHECK(last->len == 2 && sw_of(last) == 0x6985);
+    }
+    list_free(&cmds);
+    list_free(&resps);
+}
+
+static void check_evm_review(const char *fields[SIM_EVM_REVIEW_FIELDS], const char *to, const char *data) {
+    CHECK(strcmp(fields[0], "33101") == 0);
+    CHECK(strcmp(fields[1], "1.5 ZIL") == 0);
+    CHECK(strcmp(fields[2], "0.099981 ZIL") == 0);
+    CHECK(strcmp(fields[3], "1.599981 ZIL") == 0);
+    CHECK(strcmp(fields[4], to) == 0);
+    CHECK(strcmp(fields[5], data) == 0);
+}
+
+static void test_sign_evm_txn(void) {
+    static const uint8_t empty_keccak[32] = {
+        0xc5, 0xd2, 0x46, 0x01, 0x86, 0xf7, 0x23, 0x3c, 0x92, 0x7e, 0x7d, 0xb2, 0xdc, 0xc7, 0x03, 0xc0,
+        0xe5, 0x00, 0xb6, 0x53, 0xca, 0x82, 0x27, 0x3b, 0x7b, 0xfa, 0xd8, 0x04, 0x5d, 0x85, 0xa4, 0x70,
+    };
+    static const char to[] = "0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAed";
+    static const size_t sizes[] = { 0, 3, 10 * 1024 };
+    const char *fields[SIM_EVM_REVIEW_FIELDS];
+    uint8_t hash[32], sig[ECDSA_SIG_LEN];
+    char data[64];
+
+    sim_keccak256(NULL, 0, hash);
+    CHECK(memcmp(hash, empty_keccak, sizeof(hash)) == 0);
+
+    settings_set_contract_data(true);
+    for (int eip1559 = 0; eip1559 < 2; eip1559++) {
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+            evm_txn_t t = { .eip1559 = eip1559, .chain_id = 33101, .data_len = sizes[i] };
+            if (sizes[i] == 0) {
+                strcpy(data, "");
+            } else if (sizes[i] < 4) {
+                strcpy(data, "0xa9cef3, 3 bytes");
+            } else {
+                snprintf(data, sizeof(data), "0xa9cef318, %zu bytes", sizes[i]);
+            }
+            check_sign_evm_txn(&t, MAX_STREAM_LEN, SIM_UX_APPROVE, fields);
+            check_evm_review(fields, to, data);
+            memcpy(sig, G_evm_sig, sizeof(sig));
+            check_sign_evm_txn(&t, STREAM_LEN, SIM_UX_APPROVE, fields);
+            check_evm_review(fields, to, data);
+            // RFC 6979: the nonce only depends on the key and the hash.
+            CHECK(memcmp(G_evm_sig, sig, sizeof(sig)) == 0);
+        }
+    }
+    evm_txn_t create = { .eip1559 = true, .create = true, .chain_id = 33101, .data_len = 100 };
+    check_sign_evm_txn(&create, MAX_STREAM_LEN, SIM_UX_APPROVE, fields);
+    check_evm_review(fields, "New contract", "0xa9cef318, 100 bytes");
+    check_sign_evm_txn(&create, STREAM_LEN, SIM_UX_REJECT, fields);
+    settings_set_contract_data(false);
+}
+
+// Expects one response per command, each with the given status word, and
+// the app to keep working afterwards.
+static void check_error(apdu_list_t *cmds, uint16_t sw) {
+    apdu_list_t resps;
+
+    add_command(cmds, INS_GET_VERSION, 0, 0, NULL, 0);
+    run(cmds, &resps);
+    CHECK(resps.n == cmds->n);
+    if (resps.n == cmds->n) {
+        CHECK(sw_of(&resps.items[resps.n - 2]) == sw);
+        CHECK(resps.items[resps.n - 1].len == 5 && sw_of(&resps.items[resps.n - 1]) == 0x9000);
+    }
+    list_free(&resps);
+    cmds->n = 0;
+}
+
+// Transactions that fit in the first frame are decoded from the APDU
+// buffer: fields the app does not know are skipped there as well, and a
+// frame that cuts the transaction short is caught all the same.
+static void test_single_frame(void) {
+    static const uint8_t unknown[] = { 0x78, 0x2A, 0x82, 0x01, 0x03, 'a', 'b', 'c' };
+    static uint8_t txn[512];
+    apdu_list_t cmds, resps;
+    size_t len = make_txn(txn, 100);
+
+    // Nothing to resume either.
+    check_sign_txn(100, MAX_STREAM_LEN, P1_SIGN_TXN_RESUMABLE, SIM_UX_APPROVE);
+
+    memcpy(txn + len, unknown, sizeof(unknown));
+    len += sizeof(unknown);
+    list_init(&cmds, MAX_CMDS);
+    for (size_t chunk = STREAM_LEN; chunk <= MAX_STREAM_LEN; chunk += MAX_STREAM_LEN - STREAM_LEN) {
+        cmds.n = 0;
+        add_sign_txn(&cmds, KEY_INDEX, txn, len, chunk);
+        run(&cmds, &resps);
+        const sim_apdu_t *last = &resps.items[resps.n - 1];
+        CHECK(resps.n == cmds.n && last->len == SIG_LEN + 2 && sw_of(last) == 0x9000);
+        CHECK(schnorr_verify(G_pubkey, txn, len, last->data));
+        list_free(&resps);
+    }
+
+    cmds.n = 0;
+    add_sign_txn(&cmds, KEY_INDEX, txn, len - 2, MAX_STREAM_LEN);
+    check_error(&cmds, 0x6801);
+    list_free(&cmds);
+}
+
+// The framing of every link, as the command came in on it.
+static void test_transport(void) {
+    static const struct {
+        unsigned media;
+        uint8_t expected[8];
+    } links[] = {
+        { IO_APDU_MEDIA_USB_HID, { IO_APDU_MEDIA_USB_HID, 64, 0, 7, 5, 0, 255, 0 } },
+        { IO_APDU_MEDIA_BLE, { IO_APDU_MEDIA_BLE, 32, 0, 5, 3, 0, 255, 0 } },
+        { IO_APDU_MEDIA_U2F, { IO_APDU_MEDIA_U2F, 64, 0, 7, 5, 73, 182, 0 } },
+        { IO_APDU_MEDIA_NFC, { IO_APDU_MEDIA_NFC, 0, 0, 0, 0, 0, 255, 0 } },
+    };
+    static uint8_t txn[2048];
+    size_t len = make_txn(txn, 1000);
+    apdu_list_t cmds, resps;
+
+    list_init(&cmds, MAX_CMDS);
+    for (size_t i = 0; i < sizeof(links) / sizeof(*links); i++) {
+        cmds.n = 0;
+        add_command(&cmds, INS_GET_TRANSPORT, 0, 0, NULL, 0);
+        sim_apdu_media = links[i].media;
+        run(&cmds, &resps);
+        CHECK(resps.n == 1 && resps.items[0].len == 10 && sw_of(&resps.items[0]) == 0x9000);
+        CHECK(memcmp(resps.items[0].data, links[i].expected, 8) == 0);
+        size_t max_data = resps.items[0].data[6] | (resps.items[0].data[7] << 8);
+        list_free(&resps);
+
+        // A transaction whose first frame, key index and header included,
+        // is exactly as long as the link takes.
+        cmds.n = 0;
+        add_sign_txn(&cmds, KEY_INDEX, txn, len, max_data - 12);
+        CHECK(cmds.items[0].len == 5 + max_data);
+        run(&cmds, &resps);
+        sim_apdu_media = IO_APDU_MEDIA_USB_HID;
+        const sim_apdu_t *last = &resps.items[resps.n - 1];
+        CHECK(resps.n == cmds.n && last->len == SIG_LEN + 2 && sw_of(last) == 0x9000);
+        CHECK(schnorr_verify(G_pubkey, txn, len, last->data));
+        list_free(&resps);
+    }
+
+    cmds.n = 0;
+    add_command(&cmds, INS_GET_TRANSPORT, 1, 0, NULL, 0);
+    check_error(&cmds, 0x6B01);
+    add_command(&cmds, INS_GET_TRANSPORT, 0, 0, cmds.items[0].data, 1);
+    check_error(&cmds, 0x6A87);
+    list_free(&cmds);
+}
+
+// A label, or a removal with label NULL.
+static void add_recipient(apdu_list_t *l, const uint8_t addr[20], const char *label) {
+    uint8_t data[64];
+    size_t n = label == NULL ? 0 : strlen(label);
+
+    memcpy(data, addr, 20);
+    if (label != NULL) {
+        memcpy(data + 20, label, n);
+    }
+    add_command(l, INS_ADD_RECIPIENT, label == NULL ? P1_RECIPIENT_REMOVE : 0, 0, data, 20 + n);
+}
+
+// Runs one command, and returns its status word.
+static uint16_t run_one(apdu_list_t *cmds, sim_ux_policy_t policy) {
+    apdu_list_t resps;
+    uint16_t sw = 0;
+
+    sim_ux_policy = policy;
+    run(cmds, &resps);
+    sim_ux_policy = SIM_UX_APPROVE;
+    if (resps.n == 1 && resps.items[0].len == 2) {
+        sw = sw_of(&resps.items[0]);
+    }
+    list_free(&resps);
+    cmds->n = 0;
+    return sw;
+}
+
+// Signs the test transaction and returns the recipient its review showed.
+static const char *sign_txn_to(size_t chunk) {
+    static uint8_t txn[512];
+    apdu_list_t cmds, resps;
+    size_t len = make_txn(txn, 100);
+
+    list_init(&cmds, MAX_CMDS);
+    add_sign_txn(&cmds, KEY_INDEX, txn, len, chunk);
+    run(&cmds, &resps);
+    const sim_apdu_t *last = &resps.items[resps.n - 1];
+    CHECK(resps.n == cmds.n && last->len == SIG_LEN + 2 && sw_of(last) == 0x9000);
+    CHECK(schnorr_verify(G_pubkey, txn, len, last->data));
+    list_free(&cmds);
+    list_free(&resps);
+    return sim_txn_to();
+}
+
+// The book of trusted recipients: only approved changes reach flash, a
+// trusted recipient shows up with its label, and the hash table holds up
+// to full with every address in the same bucket.
+static void test_addr_book(void) {
+    uint8_t addrs[32][20];
+    apdu_list_t cmds;
+    unsigned long writes;
+
+    list_init(&cmds, 1);
+    CHECK(strncmp(sign_txn_to(MAX_STREAM_LEN), "zil1", 4) == 0);
+
+    writes = sim_stats.nvm_writes;
+    add_recipient(&cmds, txn_to, "Alice");
+    CHECK(run_one(&cmds, SIM_UX_REJECT) == 0x6985);
+    CHECK(sim_stats.nvm_writes == writes);
+    CHECK(strncmp(sign_txn_to(MAX_STREAM_LEN), "zil1", 4) == 0);
+
+    add_recipient(&cmds, txn_to, "Alice");
+    CHECK(run_one(&cmds, SIM_UX_APPROVE) == 0x9000);
+    CHECK(sim_stats.nvm_writes == writes + 1);
+    CHECK(strcmp(sign_txn_to(MAX_STREAM_LEN), "Alice (trusted)") == 0);
+    CHECK(strcmp(sign_txn_to(STREAM_LEN), "Alice (trusted)") == 0);
+    add_recipient(&cmds, txn_to, "Bob's shop #2");
+    CHECK(run_one(&cmds, SIM_UX_APPROVE) == 0x9000);
+    CHECK(strcmp(sign_txn_to(MAX_STREAM_LEN), "Bob's shop #2 (trusted)") == 0);
+
+    // Labels are 1 to 16 printable characters.
+    add_recipient(&cmds, txn_to, "");
+    CHECK(run_one(&cmds, SIM_UX_APPROVE) == 0x6B01);
+    add_recipient(&cmds, txn_to, "0123456789abcdefg");
+    CHECK(run_one(&cmds, SIM_UX_APPROVE) == 0x6B01);
+    add_recipient(&cmds, txn_to, "Alice\n");
+    CHECK(run_one(&cmds, SIM_UX_APPROVE) == 0x6B01);
+    add_command(&cmds, INS_ADD_RECIPIENT, 0, 0, txn_to, 19);
+    CHECK(run_one(&cmds, SIM_UX_APPROVE) == 0x6A87);
+    add_recipient(&cmds, txn_to, "Alice");
+    cmds.items[0].data[2] = P1_RECIPIENT_REMOVE;
+    CHECK(run_one(&cmds, SIM_UX_APPROVE) == 0x6A87);
+    add_recipient(&cmds, txn_to, "Alice");
+    cmds.items[0].data[2] = 0x02;
+    CHECK(run_one(&cmds, SIM_UX_APPROVE) == 0x6B01);
+
+    // Fill the book with addresses that all hash like txn_to, which is
+    // addrs[0] already.
+    for (size_t i = 0; i < 32; i++) {
+        memcpy(addrs[i], txn_to, 20);
+        addrs[i][19] ^= i;
+        if (i > 0) {
+            add_recipient(&cmds, addrs[i], "Collision");
+            CHECK(run_one(&cmds, SIM_UX_APPROVE) == 0x9000);
+        }
+    }
+    uint8_t extra[20] = { 1 };
+    add_recipient(&cmds, extra, "Extra");
+    CHECK(run_one(&cmds, SIM_UX_APPROVE) == 0x6B05);
+
+    // The address after a removed one is still found, and a new one takes
+    // the place of the removed one.
+    add_recipient(&cmds, addrs[5], NULL);
+    CHECK(run_one(&cmds, SIM_UX_APPROVE) == 0x9000);
+    add_recipient(&cmds, addrs[5], NULL);
+    CHECK(run_one(&cmds, SIM_UX_APPROVE) == 0x6B06);
+    add_recipient(&cmds, addrs[20], NULL);
+    CHECK(run_one(&cmds, SIM_UX_REJECT) == 0x6985);
+    add_recipient(&cmds, extra, "Extra");
+    CHECK(run_one(&cmds, SIM_UX_APPROVE) == 0x9000);
+    add_recipient(&cmds, addrs[5], "Collision");
+    CHECK(run_one(&cmds, SIM_UX_APPROVE) == 0x6B05);
+    CHECK(strcmp(sign_txn_to(MAX_STREAM_LEN), "Bob's shop #2 (trusted)") == 0);
+
+    // Empty it for the other tests.
+    memcpy(addrs[5], extra, 20);
+    for (size_t i = 0; i < 32; i++) {
+        add_recipient(&cmds, addrs[i], NULL);
+        CHECK(run_one(&cmds, SIM_UX_APPROVE) == 0x9000);
+    }
+    CHECK(strncmp(sign_txn_to(MAX_STREAM_LEN), "zil1", 4) == 0);
+    list_free(&cmds);
+}
+
+// Transactions that are not canonical RLP, have bytes after their list, or
+// could be replayed on another chain.
+static void test_evm_errors(void) {
+    static uint8_t txn[1024];
+    evm_txn_t t = { .chain_id = 33101, .data_len = 100 };
+    const char *fields[SIM_EVM_REVIEW_FIELDS];
+    apdu_list_t cmds, resps;
+    size_t len;
+
+    list_init(&cmds, 64);
+    settings_set_contract_data(true);
+    for (int eip1559 = 0; eip1559 < 2; eip1559++) {
+        t.eip1559 = eip1559;
+        len = make_evm_txn(txn, &t);
+        txn[len] = 0x80;
+        add_sign_evm_txn(&cmds, KEY_INDEX, txn, len + 1, STREAM_LEN);
+        check_error(&cmds, 0x6801);
+        add_sign_evm_txn(&cmds, KEY_INDEX, txn, len - 1, MAX_STREAM_LEN);
+        check_error(&cmds, 0x6801);
+
+        // The length of the list on two bytes, the first of them 0.
+        uint8_t *list = txn + eip1559;
+        CHECK(list[0] == 0xF8);
+        memmove(list + 1, list, len - eip1559);
+        list[0] = 0xF9;
+        list[1] = 0;
+        add_sign_evm_txn(&cmds, KEY_INDEX, txn, len + 1, MAX_STREAM_LEN);
+        check_error(&cmds, 0x6801);
+    }
+
+    t.eip1559 = false;
+    t.pre_eip155 = true;
+    len = make_evm_txn(txn, &t);
+    add_sign_evm_txn(&cmds, KEY_INDEX, txn, len, MAX_STREAM_LEN);
+    check_error(&cmds, 0x6801);
+    t.pre_eip155 = false;
+    t.chain_id = 0;
+    len = make_evm_txn(txn, &t);
+    add_sign_evm_txn(&cmds, KEY_INDEX, txn, len, MAX_STREAM_LEN);
+    check_error(&cmds, 0x6801);
+
+    // EIP-2930 transactions are not supported.
+    t.eip1559 = true;
+    t.chain_id = 33101;
+    len = make_evm_txn(txn, &t);
+    txn[0] = 0x01;
+    add_sign_evm_txn(&cmds, KEY_INDEX, txn, len, MAX_STREAM_LEN);
+    check_error(&cmds, 0x6801);
+
+    // Contract data is refused unless allowed in the settings, as soon as
+    // its length is decoded rather than at the end of the stream. Transfers
+    // are not affected.
+    settings_set_contract_data(false);
+    t.data_len = 100;
+    len = make_evm_txn(txn, &t);
+    add_sign_evm_txn(&cmds, KEY_INDEX, txn, len, MAX_STREAM_LEN);
+    check_error(&cmds, 0x6B07);
+    add_sign_evm_txn(&cmds, KEY_INDEX, txn, len, STREAM_LEN);
+    run(&cmds, &resps);
+    size_t i = 0;
+    while (i < resps.n && sw_of(&resps.items[i]) == 0x9000) {
+        i++;
+    }
+    CHECK(i + 1 < cmds.n && sw_of(&resps.items[i]) == 0x6B07);
+    list_free(&resps);
+    cmds.n = 0;
+    t.data_len = 0;
+    check_sign_evm_txn(&t, STREAM_LEN, SIM_UX_APPROVE, fields);
+    list_free(&cmds);
+}
+
+static void test_errors(void) {
+    static uint8_t txn[512];
+    apdu_list_t cmds;
+    uint8_t data[64] = { 0 };
+
+    list_init(&cmds, 64);
+
+    add_command(&cmds, INS_GET_VERSION, 0, 0, NULL, 0);
+    cmds.items[0].data[0] = 0x80;
+    check_error(&cmds, 0x6E00);
+
+    add_command(&cmds, 0x03, 0, 0, NULL, 0);
+    check_error(&cmds, 0x6D00);
+
+    // Lc does not match the length of the APDU.
+    add_command(&cmds, INS_GET_VERSION, 0, 0, data, 4);
+    cmds.items[0].len--;
+    check_error(&cmds, 0x6A87);
+
+    add_get_public_key(&cmds, KEY_INDEX, 0x03);
+    check_error(&cmds, 0x6B01);
+
+    add_command(&cmds, INS_GET_PUBLIC_KEY, 0, P2_DISPLAY_NONE, data, 5);
+    check_error(&cmds, 0x6A87);
+
+    add_command(&cmds, INS_SIGN_HASH, 0, 0, data, 35);
+    check_error(&cmds, 0x6801);
+
+    // The chunk is shorter than announced.
+    size_t len = make_txn(txn, 100);
+    add_sign_txn(&cmds, KEY_INDEX, txn, len, len);
+    cmds.items[0].data[5 + 8]++;
+    check_error(&cmds, 0x6A87);
+
+    // The host stops in the middle of a transaction.
+    add_sign_txn(&cmds, KEY_INDEX, txn, len, STREAM_LEN);
+    cmds.n = 2;
+    add_command(&cmds, INS_SIGN_TXN, 0, 0, NULL, 0);
+    check_error(&cmds, 0x6801);
+
+    // A continuation announcing more than ZIL_MAX_TXN_SIZE.
+    add_sign_txn(&cmds, KEY_INDEX, txn, len, STREAM_LEN);
+    cmds.n = 2;
+    put_u32le(cmds.items[1].data + 5, 0xFFFFFF00);
+    check_error(&cmds, 0x6801);
+
+    list_free(&cmds);
+}
+
+// Streams a resumable transaction, command by command, and breaks it off
+// once: with a transport reset, or by resuming after a lost acknowledgement.
+typedef struct {
+    const uint8_t *txn;
+    size_t len, chunk;
+    size_t next;            // offset of the next chunk to send
+    unsigned chunks;        // chunks sent so far
+    unsigned break_after;   // chunks before the interruption
+    bool reset;             // interrupt with a reset, otherwise lose an ack
+    uint32_t wrong_session; // resume with this id when not 0
+    int step;               // 0 streaming, 1 reset due, 2 resume due, 3 done
+    uint32_t session;
+    unsigned acks;
+    bool ack_error;
+    sim_apdu_t last;
+} resume_feed_t;
+
+static uint32_t get_u32le(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static bool resume_next(sim_apdu_t *apdu, void *arg) {
+    resume_feed_t *f = arg;
+    apdu_list_t one = { apdu, 0, 1 };
+
+    switch (f->step) {
+    case 1:
+        apdu->len = SIM_APDU_RESET;
+        f->step = 2;
+        return true;
+    case 2: {
+        uint8_t data[4];
+        put_u32le(data, f->wrong_session ? f->wrong_session : f->session);
+        add_command(&one, INS_SIGN_TXN, P1_SIGN_TXN_RESUME, 0, data, sizeof(data));
+        f->step = f->wrong_session ? 3 : 0;
+        return true;
+    }
+    case 3:
+        return false;
+    }
+
+    size_t n = f->len - f->next < f->chunk ? f->len - f->next : f->chunk;
+    uint8_t data[255];
+    size_t hdr = 0;
+    if (f->next == 0) {
+        put_u32le(data, KEY_INDEX);
+        hdr = 4;
+    }
+    put_u32le(data + hdr, (uint32_t) (f->len - f->next - n));
+    put_u32le(data + hdr + 4, (uint32_t) n);
+    memcpy(data + hdr + 8, f->txn + f->next, n);
+    add_command(&one, INS_SIGN_TXN, f->next == 0 ? P1_SIGN_TXN_RESUMABLE : 0, 0, data, hdr + 8 + n);
+    f->next += n;
+    f->chunks++;
+    if (f->next == f->len) {
+        f->step = 3;
+    } else if (f->chunks == f->break_after) {
+        if (!f->reset) {
+            // The ack of this chunk is lost, the host would send it again.
+            f->next -= n;
+        }
+        f->step = f->reset ? 1 : 2;
+    }
+    return true;
+}
+
+static void resume_response(const uint8_t *rapdu, size_t len, void *arg) {
+    resume_feed_t *f = arg;
+    memcpy(f->last.data, rapdu, len);
+    f->last.len = len;
+    if (f->step == 3 || len != 10 || rapdu[8] != 0x90 || rapdu[9] != 0x00) {
+        if (f->step != 3) f->ack_error = true;
+        return;
+    }
+    // Every acknowledgement carries the session and where to carry on.
+    f->acks++;
+    f->session = get_u32le(rapdu);
+    f->next = get_u32le(rapdu + 4);
+}
+
+static void check_resume(bool reset, unsigned break_after, bool wrong_session) {
+    static uint8_t txn[2048];
+    resume_feed_t f = { 0 };
+
+    f.txn = txn;
+    f.len = make_txn(txn, 1024);
+    f.chunk = STREAM_LEN;
+    f.break_after = break_after;
+    f.reset = reset;
+    unsigned long resets = sim_stats.resets;
+    sim_run(resume_next, resume_response, &f);
+
+    CHECK(sim_stats.resets - resets == (reset ? 1 : 0));
+    if (wrong_session) {
+        return;
+    }
+    CHECK(!f.ack_error);
+    CHECK(f.session != 0);
+    CHECK(f.last.len == SIG_LEN + 2 && sw_of(&f.last) == 0x9000);
+    CHECK(schnorr_verify(G_pubkey, txn, f.len, f.last.data));
+}
+
+static void test_resume(void) {
+    apdu_list_t cmds;
+    uint8_t session[4] = { 1, 2, 3, 4 };
+
+    check_resume(true, 1, false);
+    check_resume(true, 20, false);
+    check_resume(false, 5, false);
+
+    // Resuming with somebody else's session aborts the stream.
+    static uint8_t txn[2048];
+    resume_feed_t f = { 0 };
+    f.txn = txn;
+    f.len = make_txn(txn, 1024);
+    f.chunk = STREAM_LEN;
+    f.break_after = 3;
+    f.reset = true;
+    f.wrong_session = 0x12345679;
+    sim_run(resume_next, resume_response, &f);
+    CHECK(f.last.len == 2 && sw_of(&f.last) == 0x6801);
+
+    // There is nothing to resume outside of a stream.
+    list_init(&cmds, 4);
+    add_command(&cmds, INS_SIGN_TXN, P1_SIGN_TXN_RESUME, 0, session, sizeof(session));
+    check_error(&cmds, 0x6B02);
+    add_command(&cmds, INS_SIGN_TXN, 0x80, 0, session, sizeof(session));
+    check_error(&cmds, 0x6B01);
+    list_free(&cmds);
+}
+
+// Every stream checks that chunks follow each other, and with
+// P1_SIGN_TXN_OFFSETS and P1_SIGN_TXN_CHECKSUM each chunk also carries its
+// offset and the running CRC-32: a chunk that does not fit is refused
+// with 0x6B03 when it comes in.
+static void test_stream_checks(void) {
+    static const uint8_t check[] = "123456789";
+    static uint8_t txn[2048];
+    const uint8_t both = P1_SIGN_TXN_OFFSETS | P1_SIGN_TXN_CHECKSUM;
+    apdu_list_t cmds, resps;
+    size_t len = make_txn(txn, 1024);
+
+    CHECK(crc32_update(0, check, 9) == 0xCBF43926);
+
+    check_sign_txn(1024, STREAM_LEN, P1_SIGN_TXN_OFFSETS, SIM_UX_APPROVE);
+    check_sign_txn(1024, STREAM_LEN, P1_SIGN_TXN_CHECKSUM, SIM_UX_APPROVE);
+    check_sign_txn(0, MAX_STREAM_LEN - 8, both, SIM_UX_APPROVE);
+    check_sign_txn(10 * 1024, MAX_STREAM_LEN - 8, both, SIM_UX_APPROVE);
+
+    list_init(&cmds, MAX_CMDS);
+
+    // A dropped chunk, with nothing but hostBytesLeft to tell.
+    add_sign_txn(&cmds, KEY_INDEX, txn, len, STREAM_LEN);
+    cmds.items[2] = cmds.items[3];
+    cmds.n = 3;
+    check_error(&cmds, 0x6B03);
+
+    // A chunk sent twice.
+    add_sign_txn(&cmds, KEY_INDEX, txn, len, STREAM_LEN);
+    cmds.items[2] = cmds.items[1];
+    cmds.n = 3;
+    check_error(&cmds, 0x6B03);
+
+    // The offset of a chunk is not where the previous one ended.
+    add_sign_txn_p1(&cmds, KEY_INDEX, txn, len, STREAM_LEN, P1_SIGN_TXN_OFFSETS);
+    put_u32le(cmds.items[2].data + 5 + 8, 3 * STREAM_LEN);
+    cmds.n = 3;
+    check_error(&cmds, 0x6B03);
+
+    // The first chunk has to start the transaction.
+    add_sign_txn_p1(&cmds, KEY_INDEX, txn, len, STREAM_LEN, P1_SIGN_TXN_OFFSETS);
+    put_u32le(cmds.items[0].data + 5 + 12, STREAM_LEN);
+    cmds.n = 1;
+    check_error(&cmds, 0x6B03);
+
+    // A corrupted byte, in the first chunk and in a later one.
+    add_sign_txn_p1(&cmds, KEY_INDEX, txn, len, STREAM_LEN, both);
+    cmds.items[0].data[5 + 20] ^= 0x01;
+    cmds.n = 1;
+    check_error(&cmds, 0x6B03);
+    add_sign_txn_p1(&cmds, KEY_INDEX, txn, len, STREAM_LEN, P1_SIGN_TXN_CHECKSUM);
+    cmds.items[4].data[5 + 12] ^= 0x80;
+    cmds.n = 5;
+    check_error(&cmds, 0x6B03);
+
+    // A resumable stream refuses the corrupted chunk, says where it stands
+    // and takes the right one.
+    add_sign_txn_p1(&cmds, KEY_INDEX, txn, len, STREAM_LEN, both | P1_SIGN_TXN_RESUMABLE);
+    memmove(&cmds.items[5], &cmds.items[4], (cmds.n - 4) * sizeof(*cmds.items));
+    cmds.n++;
+    cmds.items[4].data[5 + 16] ^= 0x01;
+    run(&cmds, &resps);
+    CHECK(resps.n == cmds.n);
+    if (resps.n == cmds.n) {
+        const sim_apdu_t *nack = &resps.items[4];
+        const sim_apdu_t *last = &resps.items[resps.n - 1];
+        CHECK(nack->len == 10 && sw_of(nack) == 0x6B03);
+        CHECK(get_u32le(nack->data + 4) == 4 * STREAM_LEN);
+        CHECK(resps.items[5].len == 10 && sw_of(&resps.items[5]) == 0x9000);
+        CHECK(last->len == SIG_LEN + 2 && sw_of(last) == 0x9000);
+        CHECK(schnorr_verify(G_pubkey, txn, len, last->data));
+    }
+    list_free(&resps);
+
+    // Only the command that started a stream goes on with it: another INS
+    // or CLA in the middle is refused, whatever its P1.
+    add_sign_txn(&cmds, KEY_INDEX, txn, len, STREAM_LEN);
+    cmds.items[2].data[1] = INS_SIGN_EVM_TXN;
+    cmds.n = 3;
+    check_error(&cmds, 0x6B02);
+    add_sign_txn_p1(&cmds, KEY_INDEX, txn, len, STREAM_LEN, P1_SIGN_TXN_RESUMABLE);
+    cmds.items[2].data[0] = 0xE1;
+    cmds.n = 3;
+    check_error(&cmds, 0x6B02);
+    add_sign_txn_p1(&cmds, KEY_INDEX, txn, len, STREAM_LEN, P1_SIGN_TXN_RESUMABLE);
+    cmds.items[2].data[1] = INS_GET_VERSION;
+    cmds.items[2].data[2] = P1_SIGN_TXN_RESUME;
+    cmds.n = 3;
+    check_error(&cmds, 0x6B02);
+
+    list_free(&cmds);
+}
+
+// A zero r or s. A hash is signed again with another nonce on the spot, a
+// streamed transaction has to be sent again.
+static void test_sign_retry(void) {
+    static uint8_t txn[2048];
+    apdu_list_t cmds, resps;
+    uint8_t hash[32] = { 1 };
+    size_t len = make_txn(txn, 100);
+
+    list_init(&cmds, MAX_CMDS);
+    add_sign_hash(&cmds, KEY_INDEX, hash);
+    sim_zero_scalars = 2;
+    run(&cmds, &resps);
+    CHECK(sim_zero_scalars == 0);
+    CHECK(resps.n == 1 && resps.items[0].len == SIG_LEN + 2 && sw_of(&resps.items[0]) == 0x9000);
+    CHECK(schnorr_verify(G_pubkey, hash, sizeof(hash), resps.items[0].data));
+    list_free(&resps);
+
+    cmds.n = 0;
+    add_sign_txn(&cmds, KEY_INDEX, txn, len, STREAM_LEN);
+    size_t last = cmds.n - 1;
+    add_sign_txn(&cmds, KEY_INDEX, txn, len, STREAM_LEN);
+    sim_zero_scalars = 1;
+    run(&cmds, &resps);
+    CHECK(sim_zero_scalars == 0);
+    CHECK(resps.n == cmds.n);
+    if (resps.n == cmds.n) {
+        CHECK(resps.items[last].len == 2 && sw_of(&resps.items[last]) == 0x6B04);
+        const sim_apdu_t *r = &resps.items[resps.n - 1];
+        CHECK(r->len == SIG_LEN + 2 && sw_of(r) == 0x9000);
+        CHECK(schnorr_verify(G_pubkey, txn, len, r->data));
+    }
+    list_free(&resps);
+    list_free(&cmds);
+}
+
+typedef struct {
+    apdu_list_t *resps;
+    unsigned long scalar_mults[MAX_CMDS];
+} mults_feed_t;
+
+static void count_mults(const uint8_t *rapdu, size_t len, void *arg) {
+    mults_feed_t *f = arg;
+    f->scalar_mults[f->resps->n] = sim_stats.scalar_mults;
+    collect_response(rapdu, len, f->resps);
+}
+
+// Nonces are computed in the APDU loop, one before each wait for a command
+// or for the user and none while streaming, and signing then takes one from
+// the pool. A failed computation leaves the pool as it was.
+static void test_nonce_pool(void) {
+    static uint8_t txn[2048];
+    static mults_feed_t f;
+    apdu_list_t cmds, resps;
+    uint8_t hash[32] = { 2 };
+    size_t len = make_txn(txn, 1024);
+    unsigned long before;
+
+    list_init(&cmds, MAX_CMDS);
+
+    // One nonce before the command, one before the review: the signature
+    // takes the first.
+    zil_ecschnorr_nonce_wipe();
+    add_sign_hash(&cmds, KEY_INDEX, hash);
+    before = sim_stats.scalar_mults;
+    run(&cmds, &resps);
+    CHECK(sim_stats.scalar_mults - before == 2);
+    CHECK(resps.n == 1 && sw_of(&resps.items[0]) == 0x9000);
+    CHECK(schnorr_verify(G_pubkey, hash, sizeof(hash), resps.items[0].data));
+    list_free(&resps);
+
+    // Commands answered at once fill the pool up, and then leave it be.
+    cmds.n = 0;
+    for (int i = 0; i < ZIL_NONCE_POOL_SIZE + 2; i++) {
+        add_command(&cmds, INS_GET_VERSION, 0, 0, NULL, 0);
+    }
+    before = sim_stats.scalar_mults;
+    run(&cmds, &resps);
+    CHECK(resps.n == cmds.n);
+    CHECK(sim_stats.scalar_mults - before == ZIL_NONCE_POOL_SIZE - 1);
+    list_free(&resps);
+
+    // The pool is full: nothing to compute while streaming. The nonce the
+    // stream took at its start is replaced before the review.
+    cmds.n = 0;
+    add_sign_txn(&cmds, KEY_INDEX, txn, len, STREAM_LEN);
+    list_init(&resps, cmds.n + 1);
+    f.resps = &resps;
+    before = sim_stats.scalar_mults;
+    sim_run_list(cmds.items, cmds.n, count_mults, &f);
+    CHECK(resps.n == cmds.n);
+    if (resps.n == cmds.n) {
+        CHECK(f.scalar_mults[resps.n - 2] == before);
+        CHECK(f.scalar_mults[resps.n - 1] == before + 1);
+        const sim_apdu_t *last = &resps.items[resps.n - 1];
+        CHECK(last->len == SIG_LEN + 2 && sw_of(last) == 0x9000);
+        CHECK(schnorr_verify(G_pubkey, txn, len, last->data));
+    }
+    list_free(&resps);
+
+    // Both nonces fail: the signature computes its own.
+    zil_ecschnorr_nonce_wipe();
+    cmds.n = 0;
+    add_sign_hash(&cmds, KEY_INDEX, hash);
+    sim_failing_scalar_mults = 2;
+    before = sim_stats.scalar_mults;
+    run(&cmds, &resps);
+    CHECK(sim_failing_scalar_mults == 0);
+    CHECK(sim_stats.scalar_mults - before == 3);
+    CHECK(resps.n == 1 && sw_of(&resps.items[0]) == 0x9000);
+    CHECK(schnorr_verify(G_pubkey, hash, sizeof(hash), resps.items[0].data));
+    list_free(&resps);
+    list_free(&cmds);
+}
+
+static void add_get_public_key_path(apdu_list_t *l, const uint32_t *path, size_t n, uint8_t p2) {
+    uint8_t data[1 + 4 * 8];
+    add_command(l, INS_GET_PUBLIC_KEY, P1_BIP32_PATH, p2, data, put_path(data, path, n));
+}
+
+// Keys given by path, with the cache of 44'/313' the simulator is built
+// with, match a derivation of the whole path from the seed.
+static void test_key_paths(void) {
+    static uint8_t txn[512];
+    static const uint32_t paths[][6] = {
+        { 44 | HARDENED, 313 | HARDENED, KEY_INDEX | HARDENED, HARDENED, HARDENED },
+        { 44 | HARDENED, 313 | HARDENED, HARDENED, 0, 7 },
+        { 44 | HARDENED, 313 | HARDENED, 5 | HARDENED },
+        { 44 | HARDENED, 313 | HARDENED, 1 | HARDENED, 2, 3 | HARDENED, 0x7FFFFFFF },
+    };
+    static const size_t lens[] = { 5, 5, 3, 6 };
+    const size_t npaths = sizeof(lens) / sizeof(lens[0]);
+    uint8_t pubs[4][PUBKEY_LEN], data[64], hash[32] = { 4 };
+    apdu_list_t cmds, resps;
+    size_t len = make_txn(txn, 100);
+
+    list_init(&cmds, 64);
+    for (size_t i = 0; i < npaths; i++) {
+        sim_public_key(paths[i], lens[i], pubs[i]);
+        add_get_public_key_path(&cmds, paths[i], lens[i], P2_DISPLAY_NONE);
+    }
+    // A key index is the path 44'/313'/index'/0'/0'.
+    CHECK(memcmp(pubs[0], G_pubkey, PUBKEY_LEN) == 0);
+    add_get_public_key_path(&cmds, paths[1], lens[1], P2_DISPLAY_ADDRESS);
+    size_t n = put_path(data, paths[1], lens[1]);
+    memcpy(data + n, hash, sizeof(hash));
+    add_command(&cmds, INS_SIGN_HASH, P1_BIP32_PATH, 0, data, n + sizeof(hash));
+    size_t first_txn = cmds.n;
+    add_sign_txn_key(&cmds, data, put_path(data, paths[3], lens[3]), txn, len, STREAM_LEN,
+                     P1_BIP32_PATH | P1_SIGN_TXN_CHECKSUM);
+
+    unsigned long derivations = sim_stats.derivations;
+    run(&cmds, &resps);
+    CHECK(resps.n == cmds.n);
+    if (resps.n == cmds.n) {
+        for (size_t i = 0; i < npaths; i++) {
+            CHECK(sw_of(&resps.items[i]) == 0x9000 &&
+                  memcmp(resps.items[i].data, pubs[i], PUBKEY_LEN) == 0);
+        }
+        CHECK(memcmp(resps.items[npaths].data, pubs[1], PUBKEY_LEN) == 0);
+        CHECK(sw_of(&resps.items[npaths + 1]) == 0x9000 &&
+              schnorr_verify(pubs[1], hash, sizeof(hash), resps.items[npaths + 1].data));
+        const sim_apdu_t *last = &resps.items[resps.n - 1];
+        CHECK(sw_of(&resps.items[first_txn]) == 0x9000);
+        CHECK(last->len == SIG_LEN + 2 && sw_of(last) == 0x9000);
+        CHECK(schnorr_verify(pubs[3], txn, len, last->data));
+    }
+    // Only the 44'/313' node comes from the OS, once per command: it is
+    // kept while the command streams and waits for the user, the signed
+    // transaction derives its key twice, and it is wiped after the answer.
+    CHECK(sim_stats.derivations - derivations == npaths + 3);
+    list_free(&resps);
+
+    // Nor is it kept from one key of a scan to the next.
+    cmds.n = 0;
+    for (uint32_t i = 0; i < 4; i++) {
+        add_get_public_key(&cmds, i, P2_DISPLAY_NONE);
+    }
+    derivations = sim_stats.derivations;
+    run(&cmds, &resps);
+    CHECK(resps.n == 4 && sim_stats.derivations - derivations == 4);
+    CHECK(memcmp(resps.items[KEY_INDEX].data, G_pubkey, PUBKEY_LEN) == 0);
+    list_free(&resps);
+    cmds.n = 0;
+
+    // An accelerator error on the way down leaves the whole path to the OS.
+    add_get_public_key_path(&cmds, paths[1], lens[1], P2_DISPLAY_NONE);
+    sim_failing_addms = 1;
+    derivations = sim_stats.derivations;
+    run(&cmds, &resps);
+    CHECK(sim_failing_addms == 0 && sim_stats.derivations - derivations == 2);
+    CHECK(resps.n == 1 && sw_of(&resps.items[0]) == 0x9000 &&
+          memcmp(resps.items[0].data, pubs[1], PUBKEY_LEN) == 0);
+    list_free(&resps);
+    cmds.n = 0;
+
+    // Outside of 44'/313'.
+    uint32_t bad[6] = { 44 | HARDENED, 60 | HARDENED, HARDENED, 0, 0 };
+    add_get_public_key_path(&cmds, bad, 5, P2_DISPLAY_NONE);
+    check_error(&cmds, 0x6B01);
+    bad[1] = 313;
+    add_get_public_key_path(&cmds, bad, 5, P2_DISPLAY_NONE);
+    check_error(&cmds, 0x6B01);
+    // Too short, too long, or cut off.
+    add_get_public_key_path(&cmds, paths[0], 2, P2_DISPLAY_NONE);
+    check_error(&cmds, 0x6B01);
+    n = put_path(data, paths[3], 6);
+    data[0] = 7;
+    add_command(&cmds, INS_GET_PUBLIC_KEY, P1_BIP32_PATH, P2_DISPLAY_NONE, data, n + 4);
+    check_error(&cmds, 0x6B01);
+    add_command(&cmds, INS_GET_PUBLIC_KEY, P1_BIP32_PATH, P2_DISPLAY_NONE, data, 0);
+    check_error(&cmds, 0x6A87);
+    n = put_path(data, paths[0], 5);
+    add_command(&cmds, INS_GET_PUBLIC_KEY, P1_BIP32_PATH, P2_DISPLAY_NONE, data, n - 1);
+    check_error(&cmds, 0x6A87);
+    add_command(&cmds, INS_GET_PUBLIC_KEY, P1_BIP32_PATH, P2_DISPLAY_NONE, data, n + 1);
+    check_error(&cmds, 0x6A87);
+    add_sign_txn_key(&cmds, data, n - 4, txn, len, len, P1_BIP32_PATH);
+    check_error(&cmds, 0x6A87);
+
+    // Other bits of P1 are ignored, as they always were.
+    put_u32le(data, KEY_INDEX);
+    memcpy(data + 4, hash, sizeof(hash));
+    add_command(&cmds, INS_SIGN_HASH, 0x40, 0, data, 4 + sizeof(hash));
+    add_command(&cmds, INS_GET_PUBLIC_KEY, 0x7F, P2_DISPLAY_NONE, data, 4);
+    run(&cmds, &resps);
+    CHECK(resps.n == 2);
+    if (resps.n == 2) {
+        CHECK(sw_of(&resps.items[0]) == 0x9000 &&
+              schnorr_verify(G_pubkey, hash, sizeof(hash), resps.items[0].data));
+        CHECK(sw_of(&resps.items[1]) == 0x9000 &&
+              memcmp(resps.items[1].data, G_pubkey, PUBKEY_LEN) == 0);
+    }
+    list_free(&resps);
+
+    list_free(&cmds);
+}
+
+typedef struct {
+    uint32_t total;
+    size_t n;
+    struct {
+        uint32_t fn, tick;
+        uint16_t stack_left;
+        uint8_t depth, kind;
+    } records[4096];
+} trace_dump_t;
+
+// Reads the whole trace, page by page, and clears it.
+static void dump_trace(trace_dump_t *t) {
+    apdu_list_t cmds, resps;
+    uint8_t index[2];
+
+    t->n = 0;
+    list_init(&cmds, 1);
+    for (;;) {
+        cmds.n = 0;
+        index[0] = t->n;
+        index[1] = t->n >> 8;
+        add_command(&cmds, INS_DUMP_TRACE, 0, 0, index, sizeof(index));
+        run(&cmds, &resps);
+        const sim_apdu_t *r = &resps.items[0];
+        CHECK(resps.n == 1 && sw_of(r) == 0x9000 && r->len >= 10 && (r->len - 10) % TRACE_RECORD_LEN == 0);
+        CHECK(get_u32le(r->data + 4) == (uint32_t) (uintptr_t) &__cyg_profile_func_enter);
+        t->total = get_u32le(r->data);
+        size_t n = resps.n == 1 && r->len >= 10 ? (r->len - 10) / TRACE_RECORD_LEN : 0;
+        for (size_t i = 0; i < n && t->n < 4096; i++, t->n++) {
+            const uint8_t *p = r->data + 8 + i * TRACE_RECORD_LEN;
+            t->records[t->n].fn = get_u32le(p);
+            t->records[t->n].tick = get_u32le(p + 4);
+            t->records[t->n].stack_left = p[8] | (p[9] << 8);
+            t->records[t->n].depth = p[10];
+            t->records[t->n].kind = p[11];
+        }
+        list_free(&resps);
+        if (n == 0) {
+            break;
+        }
+    }
+    cmds.n = 0;
+    add_command(&cmds, INS_DUMP_TRACE, 1, 0, NULL, 0);
+    run(&cmds, &resps);
+    CHECK(resps.n == 1 && resps.items[0].len == 2 && sw_of(&resps.items[0]) == 0x9000);
+    list_free(&resps);
+    list_free(&cmds);
+}
+
+// Every traced call made while signing shows up, entered and left in
+// order, and a THROW out of the decoder does not leave the calls it cut
+// short on the stack of the next transaction.
+static void test_trace(void) {
+    static uint8_t txn[512];
+    static trace_dump_t t;
+    apdu_list_t cmds, resps;
+    size_t len = make_txn(txn, 100);
+
+    list_init(&cmds, 64);
+    dump_trace(&t);
+    add_sign_txn(&cmds, KEY_INDEX, txn, len, STREAM_LEN);
+    run(&cmds, &resps);
+    CHECK(resps.n == cmds.n && sw_of(&resps.items[resps.n - 1]) == 0x9000);
+    list_free(&resps);
+
+    dump_trace(&t);
+    CHECK(t.total == t.n && t.n > 2);
+    if (t.n > 2) {
+        // handleSignTxn is the outermost traced call.
+        uint32_t outer = t.records[0].fn;
+        unsigned depth = 0, max_depth = 0;
+        uint16_t min_left = t.records[0].stack_left;
+        bool ordered = t.records[0].kind == 0;
+        for (size_t i = 0; i < t.n; i++) {
+            if (t.records[i].kind == 0) {
+                ordered &= t.records[i].depth == depth++;
+            } else {
+                ordered &= depth > 0 && t.records[i].depth == --depth;
+            }
+            ordered &= t.records[i].tick - t.records[0].tick < 1000000000;
+            if (depth > max_depth) max_depth = depth;
+            if (t.records[i].stack_left < min_left) min_left = t.records[i].stack_left;
+        }
+        CHECK(ordered && depth == 0);
+        CHECK(t.records[t.n - 1].depth == 0 && t.records[t.n - 1].kind == 1);
+        CHECK(max_depth > 3 && min_left < t.records[0].stack_left && min_left > 0);
+
+        // The chunk after the first is dropped: istream_callback throws
+        // from within pb_decode.
+        cmds.n = 0;
+        add_sign_txn(&cmds, KEY_INDEX, txn, len, STREAM_LEN);
+        cmds.items[1] = cmds.items[2];
+        cmds.n = 2;
+        add_sign_txn(&cmds, KEY_INDEX, txn, len, STREAM_LEN);
+        run(&cmds, &resps);
+        CHECK(sw_of(&resps.items[1]) == 0x6B03);
+        CHECK(sw_of(&resps.items[resps.n - 1]) == 0x9000);
+        list_free(&resps);
+
+        dump_trace(&t);
+        unsigned outer_enters = 0;
+        for (size_t i = 0; i < t.n; i++) {
+            if (t.records[i].fn == outer && t.records[i].kind == 0) {
+                CHECK(t.records[i].depth == 0);
+                outer_enters++;
+            }
+        }
+        CHECK(outer_enters == 2);
+        CHECK(t.records[t.n - 1].depth == 0);
+    }
+
+    // Reading pauses the tracer until the trace is cleared.
+    cmds.n = 0;
+    uint8_t index[2] = { 0 };
+    add_command(&cmds, INS_DUMP_TRACE, 0, 0, index, sizeof(index));
+    add_sign_txn(&cmds, KEY_INDEX, txn, len, MAX_STREAM_LEN);
+    add_command(&cmds, INS_DUMP_TRACE, 0, 0, index, sizeof(index));
+    add_command(&cmds, INS_DUMP_TRACE, 1, 0, NULL, 0);
+    run(&cmds, &resps);
+    CHECK(resps.n == 4 && resps.items[0].len == 10 && resps.items[2].len == 10);
+    list_free(&resps);
+    add_command(&cmds, INS_DUMP_TRACE, 2, 0, NULL, 0);
+    check_error(&cmds, 0x6B01);
+    add_command(&cmds, INS_DUMP_TRACE, 0, 0, index, 1);
+    check_error(&cmds, 0x6A87);
+    list_free(&cmds);
+}
+
+static int run_tests(void) {
+    test_version();
+    test_get_public_key();
+    test_sign_hash();
+    test_sign_txn();
+    test_single_frame();
+    test_sign_evm_txn();
+    test_errors();
+    test_evm_errors();
+    test_addr_book();
+    test_transport();
+    test_resume();
+    test_stream_checks();
+    test_sign_retry();
+    test_nonce_pool();
+    test_key_paths();
+    test_trace();
+    if (failures) {
+        fprintf(stderr, "%d simulator checks failed\n", failures);
+        return 1;
+    }
+    printf("All simulator tests passed (%lu APDUs, %lu reviews)\n",
+           sim_stats.commands, sim_stats.reviews);
+    return 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/* ---                             Load test                            --- */
+/* ------------------------------------------------------------------------ */
+
+typedef struct {
+    const apdu_list_t *cycle;
+    unsigned long cycles, done;
+    size_t next;
+    unsigned long errors;
+} bench_feed_t;
+
+static bool bench_next(sim_apdu_t *apdu, void *arg) {
+    bench_feed_t *feed = arg;
+    if (feed->next == feed->cycle->n) {
+        feed->next = 0;
+        feed->done++;
+    }
+    if (feed->done == feed->cycles) return false;
+    *apdu = feed->cycle->items[feed->next++];
+    return true;
+}
+
+static void bench_response(const uint8_t *rapdu, size_t len, void *arg) {
+    bench_feed_t *feed = arg;
+    if (len < 2 || rapdu[len - 2] != 0x90 || rapdu[len - 1] != 0x00) {
+        feed->errors++;
+    }
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int run_bench(unsigned long cycles) {
+    static uint8_t txn[2048];
+    apdu_list_t cycle;
+    uint8_t hash[32] = { 0 };
+
+    zil_trace_pause(true);
+    // One cycle: a silent public key, a hash and two transactions.
+    list_init(&cycle, 128);
+    add_get_public_key(&cycle, KEY_INDEX, P2_DISPLAY_NONE);
+    add_sign_hash(&cycle, KEY_INDEX, hash);
+    add_sign_txn(&cycle, KEY_INDEX, txn, make_txn(txn, 0), MAX_STREAM_LEN);
+    add_sign_txn(&cycle, KEY_INDEX, txn, make_txn(txn, 1024), STREAM_LEN);
+
+    bench_feed_t feed = { &cycle, cycles, 0, 0, 0 };
+    sim_stats_t before = sim_stats;
+    double t0 = now();
+    sim_run(bench_next, bench_response, &feed);
+    double elapsed = now() - t0;
+
+    unsigned long apdus = sim_stats.commands - before.commands;
+    printf("%lu cycles, %lu APDUs, %lu signatures in %.3f s: %.1f cycles/s, %.0f APDUs/s, %.1f signatures/s\n",
+           cycles, apdus, sim_stats.reviews - before.reviews, elapsed,
+           cycles / elapsed, apdus / elapsed, (sim_stats.reviews - before.reviews) / elapsed);
+    list_free(&cycle);
+    if (feed.errors) {
+        fprintf(stderr, "%lu responses with an error status\n", feed.errors);
+        return 1;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/* ---                           stdio framing                          --- */
+/* ------------------------------------------------------------------------ */
+
+static bool stdio_next(sim_apdu_t *apdu, void *arg) {
+    (void) arg;
+    uint8_t hdr[4];
+    if (fread(hdr, 1, sizeof(hdr), stdin) != sizeof(hdr)) return false;
+    uint32_t len = ((uint32_t) hdr[0] << 24) | (hdr[1] << 16) | (hdr[2] << 8) | hdr[3];
+    if (len > SIM_APDU_MAX) {
+        fprintf(stderr, "sim: %u byte APDU is too long\n", len);
+        return false;
+    }
+    apdu->len = len;
+    return fread(apdu->data, 1, len, stdin) == len;
+}
+
+static void stdio_response(const uint8_t *rapdu, size_t len, void *arg) {
+    (void) arg;
+    // The length does not count the status word.
+    uint32_t n = len - 2;
+    uint8_t hdr[4] = { n >> 24, n >> 16, n >> 8, n };
+    fwrite(hdr, 1, sizeof(hdr), stdout);
+    fwrite(rapdu, 1, len, stdout);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    const char *mode = argc > 1 ? argv[1] : "test";
+
+    if (strcmp(mode, "test") == 0) {
+        return run_tests();
+    }
+    if (strcmp(mode, "bench") == 0) {
+        return run_bench(argc > 2 ? strtoul(argv[2], NULL, 0) : 1000);
+    }
+    if (strcmp(mode, "stdio") == 0) {
+        sim_run(stdio_next, stdio_response, NULL);
+        return 0;
+    }
+    fprintf(stderr, "usage: %s [test | bench [CYCLES] | stdio]\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,147 @@
+// Host stand-in for the subset of the Ledger SDK cx.h used by the app. The
+// primitives are implemented on top of OpenSSL in sim_sdk.c.
+
+#ifndef ZIL_SIM_CX_H
+#define ZIL_SIM_CX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define CX_LAST (1 << 0)
+#define CX_NO_REINIT (1 << 15)
+#define CX_NONE 0
+#define CX_RND_RFC6979 (3 << 9)
+
+#define CX_ECCINFO_PARITY_ODD 1
+#define CX_ECCINFO_xGTn 2
+
+typedef enum {
+    CX_SHA256 = 3,
+    CX_KECCAK = 6,
+} cx_md_t;
+
+typedef int cx_curve_t;
+
+typedef struct {
+    int algo;
+} cx_hash_t;
+
+typedef struct {
+    cx_hash_t header;
+    uint32_t blen;
+    uint64_t length;
+    uint32_t acc[8];
+    uint8_t block[64];
+} cx_sha256_t;
+
+typedef struct {
+    cx_hash_t header;
+    size_t output_size;
+    size_t block_size;
+    size_t blen;
+    uint8_t block[200];
+    uint64_t acc[25];
+} cx_sha3_t;
+
+typedef struct {
+    cx_curve_t curve;
+    size_t d_len;
+    unsigned char d[32];
+} cx_ecfp_private_key_t;
+
+typedef struct {
+    cx_curve_t curve;
+    size_t W_len;
+    unsigned char W[65];
+} cx_ecfp_public_key_t;
+
+typedef cx_ecfp_public_key_t cx_ecfp_256_public_key_t;
+
+typedef uint32_t cx_err_t;
+
+#define CX_OK 0x00000000
+#define CX_LOCKED 0xFFFFFF81
+#define CX_NOT_LOCKED 0xFFFFFF83
+#define CX_INTERNAL_ERROR 0xFFFFFF85
+#define CX_INVALID_PARAMETER_SIZE 0xFFFFFF86
+#define CX_INVALID_PARAMETER 0xFFFFFF88
+#define CX_MEMORY_FULL 0xFFFFFF8B
+#define CX_EC_INVALID_CURVE 0xFFFFFFA3
+
+#define CX_CHECK(call)         \
+    do {                       \
+        error = call;          \
+        if (error) goto end;   \
+    } while (0)
+
+// A number in accelerator memory, valid from cx_bn_alloc to cx_bn_unlock.
+typedef uint32_t cx_bn_t;
+
+typedef struct {
+    cx_curve_t curve;
+    cx_bn_t x;
+    cx_bn_t y;
+    cx_bn_t z;
+} cx_ecpoint_t;
+
+typedef enum {
+    CX_CURVE_PARAM_NONE = 0,
+    CX_CURVE_PARAM_A = 1,
+    CX_CURVE_PARAM_B = 2,
+    CX_CURVE_PARAM_Field = 3,
+    CX_CURVE_PARAM_Gx = 4,
+    CX_CURVE_PARAM_Gy = 5,
+    CX_CURVE_PARAM_Order = 6,
+    CX_CURVE_PARAM_Cofactor = 7,
+} cx_curve_dom_param_t;
+
+int cx_sha256_init(cx_sha256_t *hash);
+int cx_hash(cx_hash_t *hash, int mode, const unsigned char *in, unsigned int len,
+            unsigned char *out, unsigned int out_len);
+int cx_keccak_init(cx_sha3_t *hash, size_t size);
+int cx_hash_sha256(const unsigned char *in, unsigned int len, unsigned char *out, unsigned int out_len);
+
+unsigned char *cx_rng(unsigned char *buffer, unsigned int len);
+
+int cx_ecfp_init_private_key(cx_curve_t curve, const unsigned char *raw_key, unsigned int key_len,
+                             cx_ecfp_private_key_t *pvkey);
+int cx_ecfp_init_public_key(cx_curve_t curve, const unsigned char *raw_key, unsigned int key_len,
+                            cx_ecfp_public_key_t *key);
+int cx_ecfp_generate_pair(cx_curve_t curve, cx_ecfp_public_key_t *pubkey,
+                          cx_ecfp_private_key_t *privkey, int keepprivate);
+int cx_ecfp_generate_pair2(cx_curve_t curve, cx_ecfp_public_key_t *pubkey,
+                           cx_ecfp_private_key_t *privkey, int keepprivate, int hashID);
+cx_err_t cx_ecdsa_sign_rs_no_throw(const cx_ecfp_private_key_t *key, uint32_t mode, cx_md_t hashID,
+                                   const uint8_t *hash, size_t hash_len, size_t rs_len, uint8_t *sig_r,
+                                   uint8_t *sig_s, uint32_t *info);
+
+cx_err_t cx_bn_lock(size_t word_nbytes, uint32_t flags);
+uint32_t cx_bn_unlock(void);
+cx_err_t cx_bn_alloc(cx_bn_t *x, size_t nbytes);
+cx_err_t cx_bn_alloc_init(cx_bn_t *x, size_t nbytes, const uint8_t *value, size_t value_nbytes);
+cx_err_t cx_bn_export(const cx_bn_t x, uint8_t *bytes, size_t nbytes);
+cx_err_t cx_bn_copy(cx_bn_t a, const cx_bn_t b);
+cx_err_t cx_bn_is_zero(const cx_bn_t a, bool *zero);
+cx_err_t cx_bn_cmp(const cx_bn_t a, const cx_bn_t b, int *diff);
+cx_err_t cx_bn_sub(cx_bn_t r, const cx_bn_t a, const cx_bn_t b);
+cx_err_t cx_bn_shr(cx_bn_t x, uint32_t n);
+cx_err_t cx_bn_reduce(cx_bn_t r, const cx_bn_t d, const cx_bn_t n);
+cx_err_t cx_bn_mod_mul(cx_bn_t r, const cx_bn_t a, const cx_bn_t b, const cx_bn_t m);
+cx_err_t cx_bn_mod_sub(cx_bn_t r, const cx_bn_t a, const cx_bn_t b, const cx_bn_t n);
+cx_err_t cx_bn_rng(cx_bn_t r, const cx_bn_t n);
+
+cx_err_t cx_ecdomain_parameter_bn(cx_curve_t cv, cx_curve_dom_param_t id, cx_bn_t p);
+cx_err_t cx_ecdomain_generator_bn(cx_curve_t cv, cx_ecpoint_t *P);
+cx_err_t cx_ecpoint_alloc(cx_ecpoint_t *P, cx_curve_t cv);
+cx_err_t cx_ecpoint_rnd_scalarmul(cx_ecpoint_t *P, const uint8_t *k, size_t k_len);
+cx_err_t cx_ecpoint_compress(const cx_ecpoint_t *P, uint8_t *xy_compressed, size_t xy_compressed_len,
+                             uint32_t *sign);
+
+cx_err_t cx_math_addm_no_throw(uint8_t *r, const uint8_t *a, const uint8_t *b, const uint8_t *m, size_t len);
+cx_err_t cx_math_cmp_no_throw(const uint8_t *a, const uint8_t *b, size_t length, int *diff);
+
+int cx_hmac_sha512(const unsigned char *key, unsigned int key_len, const unsigned char *in,
+                   unsigned int len, unsigned char *mac, unsigned int mac_len);
+
+#endif
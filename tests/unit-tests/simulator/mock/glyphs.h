@@ -0,0 +1,16 @@
+// Host stand-in for the glyphs generated by the SDK build.
+
+#ifndef ZIL_SIM_GLYPHS_H
+#define ZIL_SIM_GLYPHS_H
+
+typedef struct {
+    int unused;
+} bagl_icon_details_t;
+
+extern const bagl_icon_details_t C_icon_certificate;
+extern const bagl_icon_details_t C_icon_crossmark;
+extern const bagl_icon_details_t C_icon_dashboard;
+extern const bagl_icon_details_t C_icon_eye;
+extern const bagl_icon_details_t C_icon_validate_14;
+
+#endif
@@ -0,0 +1,130 @@
+// Host stand-in for the subset of the Ledger SDK os.h used by the app.
+
+#ifndef ZIL_SIM_OS_H
+#define ZIL_SIM_OS_H
+
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define WIDE
+#define PIC(x) (x)
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+#define U2BE(buf, off) ((((uint16_t)(buf)[off]) << 8) | ((uint16_t)(buf)[(off) + 1]))
+#define U4BE(buf, off) ((((uint32_t)(buf)[off]) << 24) | (((uint32_t)(buf)[(off) + 1]) << 16) | \
+                        (((uint32_t)(buf)[(off) + 2]) << 8) | ((uint32_t)(buf)[(off) + 3]))
+#define U4LE(buf, off) ((((uint32_t)(buf)[(off) + 3]) << 24) | (((uint32_t)(buf)[(off) + 2]) << 16) | \
+                        (((uint32_t)(buf)[(off) + 1]) << 8) | ((uint32_t)(buf)[off]))
+
+size_t strlcpy(char *dst, const char *src, size_t size);
+size_t strlcat(char *dst, const char *src, size_t size);
+
+// Ledger's snprintf knows "%.*h" and "%.*H" (bytes as lower/upper hex).
+int zil_sim_snprintf(char *str, size_t size, const char *format, ...);
+#define snprintf zil_sim_snprintf
+
+// Exceptions, with the same setjmp based semantics as the SDK.
+typedef unsigned short exception_t;
+
+typedef struct try_context_s {
+    jmp_buf jmp_buf;
+    struct try_context_s *previous;
+    exception_t ex;
+} try_context_t;
+
+try_context_t *try_context_get(void);
+try_context_t *try_context_set(try_context_t *ctx);
+void os_longjmp(unsigned int exception) __attribute__((noreturn));
+
+#define BEGIN_TRY_L(L) { try_context_t __try##L;
+#define TRY_L(L)                                          \
+    __try##L.previous = try_context_set(&__try##L);       \
+    __try##L.ex = setjmp(__try##L.jmp_buf);               \
+    if (__try##L.ex == 0) {
+#define CATCH_L(L, x)                                     \
+    goto __FINALLY##L;                                    \
+    }                                                     \
+    else if (__try##L.ex == (x)) {                        \
+        __try##L.ex = 0;                                  \
+        CLOSE_TRY_L(L);
+#define CATCH_OTHER_L(L, e)                               \
+    goto __FINALLY##L;                                    \
+    }                                                     \
+    else {                                                \
+        exception_t e;                                    \
+        e = __try##L.ex;                                  \
+        __try##L.ex = 0;                                  \
+        CLOSE_TRY_L(L);
+#define CATCH_ALL_L(L)                                    \
+    goto __FINALLY##L;                                    \
+    }                                                     \
+    else {                                                \
+        __try##L.ex = 0;                                  \
+        CLOSE_TRY_L(L);
+#define FINALLY_L(L)                                      \
+    goto __FINALLY##L;                                    \
+    }                                                     \
+    __FINALLY##L:                                         \
+    if (try_context_get() == &__try##L) {                 \
+        try_context_set(__try##L.previous);               \
+    }
+#define CLOSE_TRY_L(L) try_context_set(__try##L.previous)
+#define END_TRY_L(L)                                      \
+    if (__try##L.ex != 0) {                               \
+        THROW_L(L, __try##L.ex);                          \
+    }                                                     \
+    }
+#define THROW_L(L, x) os_longjmp(x)
+
+#define BEGIN_TRY BEGIN_TRY_L(_)
+#define TRY TRY_L(_)
+#define CATCH(x) CATCH_L(_, x)
+#define CATCH_OTHER(e) CATCH_OTHER_L(_, e)
+#define CATCH_ALL CATCH_ALL_L(_)
+#define FINALLY FINALLY_L(_)
+#define CLOSE_TRY CLOSE_TRY_L(_)
+#define END_TRY END_TRY_L(_)
+#define THROW(x) os_longjmp(x)
+
+#define EXCEPTION 1
+#define INVALID_PARAMETER 2
+#define EXCEPTION_OVERFLOW 3
+#define EXCEPTION_SECURITY 4
+#define INVALID_CRC 5
+#define INVALID_CHECKSUM 6
+#define INVALID_COUNTER 7
+#define NOT_SUPPORTED 8
+#define INVALID_STATE 9
+#define TIMEOUT 10
+#define EXCEPTION_PIC 11
+#define EXCEPTION_APPEXIT 12
+#define EXCEPTION_IO_OVERFLOW 13
+#define EXCEPTION_IO_HEADER 14
+#define EXCEPTION_IO_STATE 15
+#define EXCEPTION_IO_RESET 16
+#define EXCEPTION_CXPORT 17
+#define EXCEPTION_SYSTEM 18
+
+#define CX_CURVE_SECP256K1 0x21
+
+void os_perso_derive_node_bip32(int curve, const uint32_t *path, unsigned int pathLength,
+                                unsigned char *privateKey, unsigned char *chain);
+void os_sched_exit(int exit_code) __attribute__((noreturn));
+
+// Writes src_len bytes of src_adr, or zeros if NULL, to the N_ variables,
+// which are read-only otherwise.
+void nvm_write(void *dst_adr, void *src_adr, unsigned int src_len);
+
+#include "cx.h"
+
+#endif
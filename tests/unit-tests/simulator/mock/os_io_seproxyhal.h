@@ -0,0 +1,36 @@
+// Host stand-in for the APDU transport of the Ledger SDK. io_exchange is
+// implemented by the simulator, which feeds APDUs from memory.
+
+#ifndef ZIL_SIM_OS_IO_SEPROXYHAL_H
+#define ZIL_SIM_OS_IO_SEPROXYHAL_H
+
+#include "os.h"
+
+#define IO_APDU_BUFFER_SIZE 260
+
+#define CHANNEL_APDU 0
+#define CHANNEL_KEYBOARD 1
+#define CHANNEL_SPI 2
+#define IO_RESET_AFTER_REPLIED 0x80
+#define IO_RECEIVE_DATA 0x40
+#define IO_RETURN_AFTER_TX 0x20
+#define IO_ASYNCH_REPLY 0x10
+#define IO_FLAGS 0xF8
+
+typedef enum {
+    IO_APDU_MEDIA_NONE = 0,
+    IO_APDU_MEDIA_USB_HID = 1,
+    IO_APDU_MEDIA_BLE,
+    IO_APDU_MEDIA_NFC,
+    IO_APDU_MEDIA_USB_CCID,
+    IO_APDU_MEDIA_USB_WEBUSB,
+    IO_APDU_MEDIA_RAW,
+    IO_APDU_MEDIA_U2F,
+} io_apdu_media_t;
+
+extern unsigned char G_io_apdu_buffer[IO_APDU_BUFFER_SIZE];
+extern io_apdu_media_t G_io_apdu_media;
+
+unsigned short io_exchange(unsigned char channel_and_flags, unsigned short tx_len);
+
+#endif
@@ -0,0 +1,44 @@
+// Host stand-in for the BAGL UX flow API. Flows are recorded instead of
+// displayed; the simulator "presses" their validation steps.
+
+#ifndef ZIL_SIM_UX_H
+#define ZIL_SIM_UX_H
+
+#include <stddef.h>
+#include "glyphs.h"
+
+typedef struct ux_sim_step_s {
+    const char *name;
+    void (*validate)(void);
+} ux_sim_step_t;
+
+typedef ux_sim_step_t ux_flow_step_t;
+
+typedef struct {
+    int stack_count;
+} ux_state_t;
+
+typedef struct {
+    int unused;
+} bolos_ux_params_t;
+
+typedef struct {
+    int unused;
+} bagl_element_t;
+
+extern ux_state_t G_ux;
+
+#define UX_STEP_NOCB(stepname, layout, ...) \
+    const ux_sim_step_t stepname = {#stepname, NULL}
+#define UX_STEP_VALID(stepname, layout, validate_cb, ...) \
+    static void stepname##_validate(void) { validate_cb; } \
+    const ux_sim_step_t stepname = {#stepname, stepname##_validate}
+#define UX_FLOW_DEF_NOCB UX_STEP_NOCB
+#define UX_FLOW_DEF_VALID UX_STEP_VALID
+#define UX_FLOW(flow_name, ...) \
+    const ux_sim_step_t *const flow_name[] = {__VA_ARGS__, NULL}
+
+void ux_flow_init(unsigned int stack_slot, const ux_sim_step_t *const *steps, const void *start_step);
+void ux_stack_push(void);
+
+#endif
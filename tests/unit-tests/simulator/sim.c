@@ -0,0 +1,164 @@
+// Builds the app's main.c (zil_main, lookupHandler) on the host, with an
+// io_exchange that takes its commands from the simulator driver and a UX
+// that validates the review as soon as the handler waits for the user.
+
+#include "sim.h"
+
+#include "../../../src/main.c"
+
+#include <time.h>
+
+sim_stats_t sim_stats;
+sim_ux_policy_t sim_ux_policy = SIM_UX_APPROVE;
+unsigned sim_apdu_media = IO_APDU_MEDIA_USB_HID;
+uintptr_t sim_stack_end;
+
+uint32_t sim_trace_clock(void) __attribute__((no_instrument_function));
+uint32_t sim_trace_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t) (ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+unsigned char G_io_apdu_buffer[IO_APDU_BUFFER_SIZE];
+io_apdu_media_t G_io_apdu_media = IO_APDU_MEDIA_USB_HID;
+
+const bagl_icon_details_t C_icon_certificate;
+const bagl_icon_details_t C_icon_crossmark;
+const bagl_icon_details_t C_icon_dashboard;
+const bagl_icon_details_t C_icon_eye;
+const bagl_icon_details_t C_icon_validate_14;
+
+static const ux_sim_step_t *const *G_flow;
+static const ux_sim_step_t *const *G_review;
+static sim_command_fn *G_next_command;
+static sim_response_fn *G_on_response;
+static void *G_arg;
+static bool G_exhausted;
+
+void zil_io_reset(void) {
+}
+
+void ux_stack_push(void) {
+    G_ux.stack_count++;
+}
+
+void ux_flow_init(unsigned int stack_slot, const ux_sim_step_t *const *steps, const void *start_step) {
+    (void) stack_slot;
+    (void) start_step;
+    G_flow = steps;
+}
+
+// Press the first (approve) or last (reject) validation step of the
+// current flow, the way a user would after scrolling through the review.
+static void ux_answer(void) {
+    const ux_sim_step_t *approve = NULL, *reject = NULL;
+
+    for (const ux_sim_step_t *const *step = G_flow; step != NULL && *step != NULL; step++) {
+        if ((*step)->validate == NULL) continue;
+        if (approve == NULL) approve = *step;
+        reject = *step;
+    }
+    if (approve == NULL) {
+        fprintf(stderr, "sim: handler is waiting for the user without a review\n");
+        THROW(EXCEPTION_IO_RESET);
+    }
+    sim_stats.reviews++;
+    G_review = G_flow;
+    (sim_ux_policy == SIM_UX_APPROVE ? approve : reject)->validate();
+}
+
+const char *sim_review_first_step(void) {
+    return G_review != NULL ? G_review[0]->name : "";
+}
+
+unsigned short io_exchange(unsigned char channel_and_flags, unsigned short tx_len) {
+    if (tx_len > 0 && !(channel_and_flags & IO_ASYNCH_REPLY)) {
+        sim_stats.responses++;
+        G_on_response(G_io_apdu_buffer, tx_len, G_arg);
+    }
+    if (channel_and_flags & IO_RETURN_AFTER_TX) {
+        return 0;
+    }
+    if (channel_and_flags & IO_ASYNCH_REPLY) {
+        ux_answer();
+    }
+
+    sim_apdu_t apdu;
+    if (!G_next_command(&apdu, G_arg)) {
+        G_exhausted = true;
+        return 0;
+    }
+    if (apdu.len == SIM_APDU_RESET) {
+        sim_stats.resets++;
+        THROW(EXCEPTION_IO_RESET);
+    }
+    sim_stats.commands++;
+    G_io_apdu_media = sim_apdu_media;
+    memcpy(G_io_apdu_buffer, apdu.data, apdu.len);
+    return apdu.len;
+}
+
+unsigned long sim_run(sim_command_fn *next_command, sim_response_fn *on_response, void *arg) {
+    unsigned long before = sim_stats.responses;
+
+    G_next_command = next_command;
+    G_on_response = on_response;
+    G_arg = arg;
+    G_exhausted = false;
+    // Stack left, as the tracer reports it, is counted from 60kB below.
+    sim_stack_end = (uintptr_t) __builtin_frame_address(0) - 0xF000;
+    // Like main(): start over after a reset, until the commands run out.
+    while (!G_exhausted) {
+        BEGIN_TRY {
+            TRY {
+                ui_idle();
+                zil_main();
+            }
+            CATCH(EXCEPTION_IO_RESET) {
+            }
+            FINALLY {
+            }
+        }
+        END_TRY;
+    }
+    return sim_stats.responses - before;
+}
+
+typedef struct {
+    const sim_apdu_t *cmds;
+    size_t n, next;
+    sim_response_fn *on_response;
+    void *arg;
+} list_feed_t;
+
+static bool list_next(sim_apdu_t *apdu, void *arg) {
+    list_feed_t *feed = arg;
+    if (feed->next == feed->n) return false;
+    *apdu = feed->cmds[feed->next++];
+    return true;
+}
+
+static void list_response(const uint8_t *rapdu, size_t len, void *arg) {
+    list_feed_t *feed = arg;
+    feed->on_response(rapdu, len, feed->arg);
+}
+
+unsigned long sim_run_list(const sim_apdu_t *cmds, size_t n, sim_response_fn *on_response, void *arg) {
+    list_feed_t feed = {cmds, n, 0, on_response, arg};
+    return sim_run(list_next, list_response, &feed);
+}
+
+void sim_evm_review(const char *fields[SIM_EVM_REVIEW_FIELDS]) {
+    const signEvmTxnContext_t *c = &global.signEvmTxnContext;
+    fields[0] = c->chainStr;
+    fields[1] = c->valueStr;
+    fields[2] = c->feeStr;
+    fields[3] = c->totalStr;
+    fields[4] = c->toStr;
+    fields[5] = c->dataStr;
+}
+
+const char *sim_txn_to(void) {
+    return global.signTxnContext.toAddrStr;
+}
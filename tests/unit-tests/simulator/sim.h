@@ -0,0 +1,81 @@
+// Host-native APDU dispatcher simulator: runs zil_main and the command
+// handlers against APDUs fed from memory, with a UX that auto-answers.
+
+#ifndef ZIL_SIM_H
+#define ZIL_SIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SIM_APDU_MAX 260
+
+typedef enum {
+    SIM_UX_APPROVE,
+    SIM_UX_REJECT,
+} sim_ux_policy_t;
+
+typedef struct {
+    uint8_t data[SIM_APDU_MAX];
+    size_t len;
+} sim_apdu_t;
+
+// A command of this length is not delivered: io_exchange throws
+// EXCEPTION_IO_RESET instead, like a USB reset.
+#define SIM_APDU_RESET ((size_t) -1)
+
+// Called for every response APDU (data followed by the status word).
+typedef void sim_response_fn(const uint8_t *rapdu, size_t len, void *arg);
+// Returns the next command APDU into apdu, or false when there is none left.
+typedef bool sim_command_fn(sim_apdu_t *apdu, void *arg);
+
+typedef struct {
+    unsigned long commands;
+    unsigned long responses;
+    unsigned long reviews;
+    unsigned long derivations;
+    unsigned long resets;
+    unsigned long scalar_mults;
+    unsigned long nvm_writes;
+} sim_stats_t;
+
+extern sim_stats_t sim_stats;
+extern sim_ux_policy_t sim_ux_policy;
+// How many of the next Schnorr scalars r or s come out as 0, a case that
+// otherwise only happens with probability 2^-256.
+extern unsigned sim_zero_scalars;
+// How many of the next scalar multiplications fail, the way they would on
+// an accelerator error.
+extern unsigned sim_failing_scalar_mults;
+// Same for the next modular additions of cx_math_addm_no_throw.
+extern unsigned sim_failing_addms;
+// The link the commands come in on, an IO_APDU_MEDIA_* value: USB HID
+// unless changed.
+extern unsigned sim_apdu_media;
+
+// Compressed public key of a BIP32 path of the simulator seed, derived
+// without the app and without counting as a derivation.
+void sim_public_key(const uint32_t *path, unsigned int len, uint8_t pub[33]);
+
+// Keccak-256 of the mock SDK, the hash EVM transactions are signed over.
+void sim_keccak256(const uint8_t *in, size_t len, uint8_t out[32]);
+
+// The review strings of the last INS_SIGN_EVM_TXN, in the order of the
+// flow: chain ID, amount, max fee, total, recipient and data.
+#define SIM_EVM_REVIEW_FIELDS 6
+void sim_evm_review(const char *fields[SIM_EVM_REVIEW_FIELDS]);
+
+// The name of the first step of the last review answered.
+const char *sim_review_first_step(void);
+
+// The recipient shown by the review of the last INS_SIGN_TXN.
+const char *sim_txn_to(void);
+
+// Run zil_main until next_command runs dry. Returns the number of
+// responses sent.
+unsigned long sim_run(sim_command_fn *next_command, sim_response_fn *on_response, void *arg);
+
+// Run one exchange session over a list of command APDUs.
+unsigned long sim_run_list(const sim_apdu_t *cmds, size_t n, sim_response_fn *on_response, void *arg);
+
+#endif
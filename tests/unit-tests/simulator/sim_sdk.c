@@ -0,0 +1,806 @@
+// Host implementation of the Ledger SDK services used by the app: strings,
+// exceptions, SHA-256, secp256k1 and BIP32 derivation (through OpenSSL).
+// The seed is the Speculos default one, so keys match the emulator's.
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/obj_mac.h>
+#include <openssl/rand.h>
+
+#include "os.h"
+#include "cx.h"
+#include "sim.h"
+
+static const char SIM_MNEMONIC[] =
+    "glory promote mansion idle axis finger extra february uncover one trip resource "
+    "lawn turtle enact monster seven myth punch hobby comfort wild raise skin";
+
+/* ---------------------------------------------------------------------- */
+/* Strings                                                                */
+/* ---------------------------------------------------------------------- */
+
+size_t strlcpy(char *dst, const char *src, size_t size) {
+    size_t len = strlen(src);
+    if (size) {
+        size_t n = len >= size ? size - 1 : len;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+
+size_t strlcat(char *dst, const char *src, size_t size) {
+    size_t dlen = strnlen(dst, size);
+    if (dlen == size) {
+        return size + strlen(src);
+    }
+    return dlen + strlcpy(dst + dlen, src, size - dlen);
+}
+
+#undef snprintf
+int zil_sim_snprintf(char *str, size_t size, const char *format, ...) {
+    char spec[32];
+    size_t out = 0;
+    va_list ap;
+
+    va_start(ap, format);
+    for (const char *p = format; *p != '\0'; p++) {
+        if (*p != '%') {
+            if (out + 1 < size) str[out] = *p;
+            out++;
+            continue;
+        }
+        if (strncmp(p, "%.*h", 4) == 0 || strncmp(p, "%.*H", 4) == 0) {
+            const char *digits = p[3] == 'h' ? "0123456789abcdef" : "0123456789ABCDEF";
+            int len = va_arg(ap, int);
+            const unsigned char *bytes = va_arg(ap, const unsigned char *);
+            for (int i = 0; i < len; i++) {
+                if (out + 1 < size) str[out] = digits[bytes[i] >> 4];
+                out++;
+                if (out + 1 < size) str[out] = digits[bytes[i] & 0xF];
+                out++;
+            }
+            p += 3;
+            continue;
+        }
+        // Plain conversion: copy it out and let vsnprintf handle it.
+        size_t n = strcspn(p + 1, "diouxXcsp%") + 2;
+        if (n >= sizeof(spec)) abort();
+        memcpy(spec, p, n);
+        spec[n] = '\0';
+        int w;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+        char *dst = out < size ? str + out : NULL;
+        size_t room = out < size ? size - out : 0;
+        switch (spec[n - 1]) {
+            case 's': w = snprintf(dst, room, spec, va_arg(ap, const char *)); break;
+            case 'p': w = snprintf(dst, room, spec, va_arg(ap, void *)); break;
+            case '%': w = snprintf(dst, room, "%%"); break;
+            default: w = snprintf(dst, room, spec, va_arg(ap, int)); break;
+        }
+#pragma GCC diagnostic pop
+        out += w;
+        p += n - 1;
+    }
+    va_end(ap);
+    if (size) str[out < size ? out : size - 1] = '\0';
+    return out;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Exceptions                                                             */
+/* ---------------------------------------------------------------------- */
+
+static try_context_t *G_try_last;
+
+try_context_t *try_context_get(void) {
+    return G_try_last;
+}
+
+try_context_t *try_context_set(try_context_t *ctx) {
+    try_context_t *previous = G_try_last;
+    G_try_last = ctx;
+    return previous;
+}
+
+void os_longjmp(unsigned int exception) {
+    if (G_try_last == NULL) {
+        fprintf(stderr, "uncaught exception 0x%x\n", exception);
+        abort();
+    }
+    longjmp(G_try_last->jmp_buf, exception);
+}
+
+void os_sched_exit(int exit_code) {
+    exit(exit_code);
+}
+
+// The N_ variables are const, in read-only pages as in flash: only
+// nvm_write lifts the protection, for as long as it writes.
+void nvm_write(void *dst_adr, void *src_adr, unsigned int src_len) {
+    uintptr_t page = (uintptr_t) sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t) dst_adr & ~(page - 1);
+    size_t len = (uintptr_t) dst_adr + src_len - start;
+
+    if (mprotect((void *) start, len, PROT_READ | PROT_WRITE) != 0) {
+        perror("sim: nvm_write");
+        abort();
+    }
+    if (src_adr == NULL) {
+        memset(dst_adr, 0, src_len);
+    } else {
+        memcpy(dst_adr, src_adr, src_len);
+    }
+    mprotect((void *) start, len, PROT_READ);
+    sim_stats.nvm_writes++;
+}
+
+/* ---------------------------------------------------------------------- */
+/* SHA-256, kept in the caller's struct so that midstates can be copied   */
+/* ---------------------------------------------------------------------- */
+
+static const uint32_t K256[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(cx_sha256_t *h, const uint8_t *b) {
+    uint32_t w[64], s[8];
+    for (int i = 0; i < 16; i++) w[i] = U4BE(b, 4 * i);
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    memcpy(s, h->acc, sizeof(s));
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = s[7] + (ROR(s[4], 6) ^ ROR(s[4], 11) ^ ROR(s[4], 25)) +
+                      ((s[4] & s[5]) ^ (~s[4] & s[6])) + K256[i] + w[i];
+        uint32_t t2 = (ROR(s[0], 2) ^ ROR(s[0], 13) ^ ROR(s[0], 22)) +
+                      ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+        memmove(s + 1, s, 7 * sizeof(uint32_t));
+        s[4] += t1;
+        s[0] = t1 + t2;
+    }
+    for (int i = 0; i < 8; i++) h->acc[i] += s[i];
+}
+
+int cx_sha256_init(cx_sha256_t *hash) {
+    static const uint32_t iv[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                   0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    memset(hash, 0, sizeof(*hash));
+    hash->header.algo = CX_SHA256;
+    memcpy(hash->acc, iv, sizeof(iv));
+    return 0;
+}
+
+static int keccak_hash(cx_sha3_t *h, int mode, const unsigned char *in, unsigned int len,
+                       unsigned char *out, unsigned int out_len);
+
+int cx_hash(cx_hash_t *hash, int mode, const unsigned char *in, unsigned int len,
+            unsigned char *out, unsigned int out_len) {
+    if (hash->algo == CX_KECCAK) {
+        return keccak_hash((cx_sha3_t *) hash, mode, in, len, out, out_len);
+    }
+    cx_sha256_t *h = (cx_sha256_t *) hash;
+    h->length += len;
+    while (len > 0) {
+        unsigned int n = MIN(len, 64 - h->blen);
+        memcpy(h->block + h->blen, in, n);
+        h->blen += n;
+        in += n;
+        len -= n;
+        if (h->blen == 64) {
+            sha256_block(h, h->block);
+            h->blen = 0;
+        }
+    }
+    if (mode & CX_LAST) {
+        uint64_t bits = h->length * 8;
+        uint8_t pad[72] = {0x80};
+        unsigned int padlen = (h->blen < 56 ? 56 : 120) - h->blen;
+        for (int i = 0; i < 8; i++) pad[padlen + i] = bits >> (56 - 8 * i);
+        cx_hash(hash, 0, pad, padlen + 8, NULL, 0);
+        if (out != NULL && out_len >= 32) {
+            for (int i = 0; i < 8; i++) {
+                out[4 * i] = h->acc[i] >> 24;
+                out[4 * i + 1] = h->acc[i] >> 16;
+                out[4 * i + 2] = h->acc[i] >> 8;
+                out[4 * i + 3] = h->acc[i];
+            }
+        }
+        if (!(mode & CX_NO_REINIT)) {
+            cx_sha256_init(h);
+        }
+        return 32;
+    }
+    return 0;
+}
+
+int cx_hash_sha256(const unsigned char *in, unsigned int len, unsigned char *out, unsigned int out_len) {
+    cx_sha256_t h;
+    cx_sha256_init(&h);
+    return cx_hash(&h.header, CX_LAST, in, len, out, out_len);
+}
+
+/* ---------------------------------------------------------------------- */
+/* Keccak-256, the pre-standard SHA-3 padding of Ethereum                 */
+/* ---------------------------------------------------------------------- */
+
+static const uint64_t keccak_rc[24] = {
+    0x0000000000000001, 0x0000000000008082, 0x800000000000808a, 0x8000000080008000,
+    0x000000000000808b, 0x0000000080000001, 0x8000000080008081, 0x8000000000008009,
+    0x000000000000008a, 0x0000000000000088, 0x0000000080008009, 0x000000008000000a,
+    0x000000008000808b, 0x800000000000008b, 0x8000000000008089, 0x8000000000008003,
+    0x8000000000008002, 0x8000000000000080, 0x000000000000800a, 0x800000008000000a,
+    0x8000000080008081, 0x8000000000008080, 0x0000000080000001, 0x8000000080008008};
+static const unsigned keccak_rot[25] = {0,  1,  62, 28, 27, 36, 44, 6,  55, 20, 3,  10, 43,
+                                        25, 39, 41, 45, 15, 21, 8,  18, 2,  61, 56, 14};
+
+#define ROL64(x, n) ((n) ? ((x) << (n)) | ((x) >> (64 - (n))) : (x))
+
+static void keccak_f(uint64_t a[25]) {
+    for (int round = 0; round < 24; round++) {
+        uint64_t c[5], b[25];
+        for (int x = 0; x < 5; x++) c[x] = a[x] ^ a[x + 5] ^ a[x + 10] ^ a[x + 15] ^ a[x + 20];
+        for (int x = 0; x < 5; x++) {
+            uint64_t d = c[(x + 4) % 5] ^ ROL64(c[(x + 1) % 5], 1);
+            for (int y = 0; y < 25; y += 5) a[y + x] ^= d;
+        }
+        // rho and pi: b[y, 2x + 3y] = rot(a[x, y])
+        for (int x = 0; x < 5; x++) {
+            for (int y = 0; y < 5; y++) {
+                b[y + 5 * ((2 * x + 3 * y) % 5)] = ROL64(a[x + 5 * y], keccak_rot[x + 5 * y]);
+            }
+        }
+        for (int y = 0; y < 25; y += 5) {
+            for (int x = 0; x < 5; x++) a[y + x] = b[y + x] ^ (~b[y + (x + 1) % 5] & b[y + (x + 2) % 5]);
+        }
+        a[0] ^= keccak_rc[round];
+    }
+}
+
+static void keccak_absorb(cx_sha3_t *h) {
+    for (size_t i = 0; i < h->block_size / 8; i++) {
+        uint64_t lane = 0;
+        for (int j = 7; j >= 0; j--) lane = (lane << 8) | h->block[8 * i + j];
+        h->acc[i] ^= lane;
+    }
+    keccak_f(h->acc);
+    h->blen = 0;
+}
+
+int cx_keccak_init(cx_sha3_t *hash, size_t size) {
+    if (size != 256) THROW(INVALID_PARAMETER);
+    memset(hash, 0, sizeof(*hash));
+    hash->header.algo = CX_KECCAK;
+    hash->output_size = size / 8;
+    hash->block_size = 200 - 2 * hash->output_size;
+    return 0;
+}
+
+static int keccak_hash(cx_sha3_t *h, int mode, const unsigned char *in, unsigned int len,
+                       unsigned char *out, unsigned int out_len) {
+    while (len > 0) {
+        unsigned int n = MIN(len, h->block_size - h->blen);
+        memcpy(h->block + h->blen, in, n);
+        h->blen += n;
+        in += n;
+        len -= n;
+        if (h->blen == h->block_size) keccak_absorb(h);
+    }
+    if (!(mode & CX_LAST)) return 0;
+
+    memset(h->block + h->blen, 0, h->block_size - h->blen);
+    h->block[h->blen] ^= 0x01;
+    h->block[h->block_size - 1] ^= 0x80;
+    keccak_absorb(h);
+    if (out != NULL && out_len >= h->output_size) {
+        for (size_t i = 0; i < h->output_size; i++) out[i] = h->acc[i / 8] >> (8 * (i % 8));
+    }
+    int size = h->output_size;
+    if (!(mode & CX_NO_REINIT)) cx_keccak_init(h, 8 * size);
+    return size;
+}
+
+void sim_keccak256(const uint8_t *in, size_t len, uint8_t out[32]) {
+    cx_sha3_t h;
+    cx_keccak_init(&h, 256);
+    keccak_hash(&h, CX_LAST, in, len, out, 32);
+}
+
+/* ---------------------------------------------------------------------- */
+/* Randomness                                                             */
+/* ---------------------------------------------------------------------- */
+
+unsigned char *cx_rng(unsigned char *buffer, unsigned int len) {
+    if (RAND_bytes(buffer, len) != 1) abort();
+    return buffer;
+}
+
+/* ---------------------------------------------------------------------- */
+/* secp256k1                                                              */
+/* ---------------------------------------------------------------------- */
+
+static EC_GROUP *secp256k1(void) {
+    static EC_GROUP *group;
+    if (group == NULL) group = EC_GROUP_new_by_curve_name(NID_secp256k1);
+    return group;
+}
+
+static BN_CTX *bn_ctx(void) {
+    static BN_CTX *ctx;
+    if (ctx == NULL) ctx = BN_CTX_new();
+    return ctx;
+}
+
+int cx_ecfp_init_private_key(cx_curve_t curve, const unsigned char *raw_key, unsigned int key_len,
+                             cx_ecfp_private_key_t *pvkey) {
+    pvkey->curve = curve;
+    pvkey->d_len = key_len;
+    if (raw_key != NULL) memcpy(pvkey->d, raw_key, key_len);
+    return key_len;
+}
+
+int cx_ecfp_init_public_key(cx_curve_t curve, const unsigned char *raw_key, unsigned int key_len,
+                            cx_ecfp_public_key_t *key) {
+    key->curve = curve;
+    key->W_len = key_len;
+    if (raw_key != NULL) memcpy(key->W, raw_key, key_len);
+    return key_len;
+}
+
+int cx_ecfp_generate_pair2(cx_curve_t curve, cx_ecfp_public_key_t *pubkey,
+                           cx_ecfp_private_key_t *privkey, int keepprivate, int hashID) {
+    (void) keepprivate;
+    (void) hashID;
+    EC_POINT *pt = EC_POINT_new(secp256k1());
+    BIGNUM *d = BN_bin2bn(privkey->d, privkey->d_len, NULL);
+    if (!EC_POINT_mul(secp256k1(), pt, d, NULL, NULL, bn_ctx())) THROW(INVALID_PARAMETER);
+    pubkey->curve = curve;
+    pubkey->W_len = EC_POINT_point2oct(secp256k1(), pt, POINT_CONVERSION_UNCOMPRESSED,
+                                       pubkey->W, sizeof(pubkey->W), bn_ctx());
+    BN_free(d);
+    EC_POINT_free(pt);
+    return 0;
+}
+
+int cx_ecfp_generate_pair(cx_curve_t curve, cx_ecfp_public_key_t *pubkey,
+                          cx_ecfp_private_key_t *privkey, int keepprivate) {
+    return cx_ecfp_generate_pair2(curve, pubkey, privkey, keepprivate, CX_NONE);
+}
+
+// HMAC-SHA256 of the concatenation of in[0..count-1], 97 bytes at most,
+// keyed with K.
+static void hmac_sha256(const uint8_t K[32], const uint8_t *const *in, const size_t *in_len, int count,
+                        uint8_t out[32]) {
+    uint8_t msg[97];
+    size_t msg_len = 0;
+    unsigned int len = 32;
+    for (int i = 0; i < count; i++) {
+        memcpy(msg + msg_len, in[i], in_len[i]);
+        msg_len += in_len[i];
+    }
+    HMAC(EVP_sha256(), K, 32, msg, msg_len, out, &len);
+    OPENSSL_cleanse(msg, sizeof(msg));
+}
+
+// The nonces of RFC 6979 (section 3.2) with HMAC-SHA256, for a 256-bit
+// order: K and V are set up from the key and the hash, and every call to
+// rfc6979_next gives the next candidate, as CX_RND_RFC6979 does on the
+// device.
+typedef struct {
+    uint8_t K[32], V[32];
+    bool started;
+} rfc6979_t;
+
+static void rfc6979_init(rfc6979_t *st, const BIGNUM *d, const BIGNUM *e) {
+    uint8_t x[32], h[32], sep;
+    const uint8_t *in[4] = { st->V, &sep, x, h };
+    const size_t len[4] = { 32, 1, 32, 32 };
+    BN_bn2binpad(d, x, 32);
+    BN_bn2binpad(e, h, 32);
+    memset(st->V, 0x01, 32);
+    memset(st->K, 0x00, 32);
+    for (sep = 0; sep < 2; sep++) {
+        hmac_sha256(st->K, in, len, 4, st->K);
+        hmac_sha256(st->K, in, len, 1, st->V);
+    }
+    st->started = false;
+    OPENSSL_cleanse(x, sizeof(x));
+}
+
+static void rfc6979_next(rfc6979_t *st, const BIGNUM *n, BIGNUM *k) {
+    static const uint8_t zero = 0;
+    const uint8_t *in[2] = { st->V, &zero };
+    const size_t len[2] = { 32, 1 };
+    do {
+        if (st->started) {
+            hmac_sha256(st->K, in, len, 2, st->K);
+            hmac_sha256(st->K, in, len, 1, st->V);
+        }
+        st->started = true;
+        hmac_sha256(st->K, in, len, 1, st->V);
+        BN_bin2bn(st->V, 32, k);
+    } while (BN_is_zero(k) || BN_cmp(k, n) >= 0);
+}
+
+// The nonce comes from RFC 6979 whatever the mode, like every signature the
+// app makes, so that signatures repeat from one run to the next.
+cx_err_t cx_ecdsa_sign_rs_no_throw(const cx_ecfp_private_key_t *key, uint32_t mode, cx_md_t hashID,
+                                   const uint8_t *hash, size_t hash_len, size_t rs_len, uint8_t *sig_r,
+                                   uint8_t *sig_s, uint32_t *info) {
+    (void) mode;
+    (void) hashID;
+    const BIGNUM *n = EC_GROUP_get0_order(secp256k1());
+    BIGNUM *d = BN_bin2bn(key->d, key->d_len, BN_secure_new());
+    BIGNUM *e = BN_bin2bn(hash, hash_len, NULL), *k = BN_secure_new(), *r = BN_new(), *s = BN_new();
+    BIGNUM *x = BN_new(), *y = BN_new();
+    EC_POINT *R = EC_POINT_new(secp256k1());
+    rfc6979_t nonces;
+
+    BN_nnmod(e, e, n, bn_ctx());
+    rfc6979_init(&nonces, d, e);
+    do {
+        rfc6979_next(&nonces, n, k);
+        EC_POINT_mul(secp256k1(), R, k, NULL, NULL, bn_ctx());
+        EC_POINT_get_affine_coordinates(secp256k1(), R, x, y, bn_ctx());
+        BN_nnmod(r, x, n, bn_ctx());
+        // s = k^-1 (e + r d)
+        BN_mod_mul(s, r, d, n, bn_ctx());
+        BN_mod_add(s, s, e, n, bn_ctx());
+        BN_mod_inverse(k, k, n, bn_ctx());
+        BN_mod_mul(s, s, k, n, bn_ctx());
+    } while (BN_is_zero(r) || BN_is_zero(s));
+
+    *info = (BN_is_odd(y) ? CX_ECCINFO_PARITY_ODD : 0) | (BN_cmp(x, n) >= 0 ? CX_ECCINFO_xGTn : 0);
+    cx_err_t error = BN_bn2binpad(r, sig_r, rs_len) < 0 || BN_bn2binpad(s, sig_s, rs_len) < 0
+                         ? CX_INVALID_PARAMETER_SIZE : CX_OK;
+    OPENSSL_cleanse(&nonces, sizeof(nonces));
+    EC_POINT_free(R);
+    BN_free(y);
+    BN_free(x);
+    BN_free(s);
+    BN_free(r);
+    BN_clear_free(k);
+    BN_free(e);
+    BN_clear_free(d);
+    return error;
+}
+
+static void bn_export(const BIGNUM *v, unsigned char *out, unsigned int len) {
+    if (BN_bn2binpad(v, out, len) < 0) THROW(INVALID_PARAMETER);
+}
+
+unsigned sim_failing_addms;
+
+cx_err_t cx_math_addm_no_throw(uint8_t *r, const uint8_t *a, const uint8_t *b, const uint8_t *m, size_t len) {
+    if (sim_failing_addms) {
+        sim_failing_addms--;
+        return CX_INTERNAL_ERROR;
+    }
+    BIGNUM *ba = BN_bin2bn(a, len, NULL), *bb = BN_bin2bn(b, len, NULL), *bm = BN_bin2bn(m, len, NULL);
+    cx_err_t error = CX_OK;
+    if (!BN_mod_add(ba, ba, bb, bm, bn_ctx()) || BN_bn2binpad(ba, r, len) < 0) {
+        error = CX_INTERNAL_ERROR;
+    }
+    BN_free(ba);
+    BN_free(bb);
+    BN_free(bm);
+    return error;
+}
+
+cx_err_t cx_math_cmp_no_throw(const uint8_t *a, const uint8_t *b, size_t length, int *diff) {
+    *diff = memcmp(a, b, length);
+    return CX_OK;
+}
+
+int cx_hmac_sha512(const unsigned char *key, unsigned int key_len, const unsigned char *in,
+                   unsigned int len, unsigned char *mac, unsigned int mac_len) {
+    unsigned int out_len = mac_len;
+    if (mac_len < 64) THROW(INVALID_PARAMETER);
+    HMAC(EVP_sha512(), key, key_len, in, len, mac, &out_len);
+    return out_len;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Accelerator memory (cx_bn, cx_ecpoint)                                 */
+/* ---------------------------------------------------------------------- */
+
+// Handles are 1 + a slot index, the slots are freed all together by
+// cx_bn_unlock, and nothing is available without the lock: the app gets
+// told off for what the device would not take either.
+#define BN_SLOTS 16
+
+static struct {
+    bool locked;
+    BIGNUM *slot[BN_SLOTS];
+} bn_mem;
+
+static BIGNUM *bn_get(cx_bn_t x) {
+    if (!bn_mem.locked || x == 0 || x > BN_SLOTS) return NULL;
+    return bn_mem.slot[x - 1];
+}
+
+cx_err_t cx_bn_lock(size_t word_nbytes, uint32_t flags) {
+    (void) flags;
+    if (bn_mem.locked) return CX_LOCKED;
+    if (word_nbytes == 0 || word_nbytes % 4 != 0) return CX_INVALID_PARAMETER_SIZE;
+    bn_mem.locked = true;
+    return CX_OK;
+}
+
+uint32_t cx_bn_unlock(void) {
+    if (!bn_mem.locked) return CX_NOT_LOCKED;
+    for (unsigned i = 0; i < BN_SLOTS; i++) {
+        BN_clear_free(bn_mem.slot[i]);
+        bn_mem.slot[i] = NULL;
+    }
+    bn_mem.locked = false;
+    return CX_OK;
+}
+
+cx_err_t cx_bn_alloc(cx_bn_t *x, size_t nbytes) {
+    if (!bn_mem.locked) return CX_NOT_LOCKED;
+    if (nbytes == 0 || nbytes > 64) return CX_INVALID_PARAMETER_SIZE;
+    for (unsigned i = 0; i < BN_SLOTS; i++) {
+        if (bn_mem.slot[i] == NULL) {
+            bn_mem.slot[i] = BN_secure_new();
+            BN_zero(bn_mem.slot[i]);
+            *x = i + 1;
+            return CX_OK;
+        }
+    }
+    return CX_MEMORY_FULL;
+}
+
+cx_err_t cx_bn_alloc_init(cx_bn_t *x, size_t nbytes, const uint8_t *value, size_t value_nbytes) {
+    if (value_nbytes > nbytes) return CX_INVALID_PARAMETER_SIZE;
+    cx_err_t error = cx_bn_alloc(x, nbytes);
+    if (error == CX_OK) BN_bin2bn(value, value_nbytes, bn_get(*x));
+    return error;
+}
+
+cx_err_t cx_bn_export(const cx_bn_t x, uint8_t *bytes, size_t nbytes) {
+    BIGNUM *v = bn_get(x);
+    if (v == NULL) return CX_INVALID_PARAMETER;
+    if (BN_bn2binpad(v, bytes, nbytes) < 0) return CX_INVALID_PARAMETER_SIZE;
+    return CX_OK;
+}
+
+cx_err_t cx_bn_copy(cx_bn_t a, const cx_bn_t b) {
+    BIGNUM *ba = bn_get(a), *bb = bn_get(b);
+    if (ba == NULL || bb == NULL) return CX_INVALID_PARAMETER;
+    BN_copy(ba, bb);
+    return CX_OK;
+}
+
+cx_err_t cx_bn_cmp(const cx_bn_t a, const cx_bn_t b, int *diff) {
+    BIGNUM *ba = bn_get(a), *bb = bn_get(b);
+    if (ba == NULL || bb == NULL) return CX_INVALID_PARAMETER;
+    *diff = BN_cmp(ba, bb);
+    return CX_OK;
+}
+
+// No carry out: the app only subtracts the smaller number.
+cx_err_t cx_bn_sub(cx_bn_t r, const cx_bn_t a, const cx_bn_t b) {
+    BIGNUM *br = bn_get(r), *ba = bn_get(a), *bb = bn_get(b);
+    if (br == NULL || ba == NULL || bb == NULL) return CX_INVALID_PARAMETER;
+    if (BN_cmp(ba, bb) < 0) return CX_INVALID_PARAMETER;
+    return BN_sub(br, ba, bb) ? CX_OK : CX_INVALID_PARAMETER;
+}
+
+cx_err_t cx_bn_shr(cx_bn_t x, uint32_t n) {
+    BIGNUM *bx = bn_get(x);
+    if (bx == NULL) return CX_INVALID_PARAMETER;
+    return BN_rshift(bx, bx, n) ? CX_OK : CX_INVALID_PARAMETER;
+}
+
+unsigned sim_zero_scalars;
+
+// Only schnorr.c asks, about r and s.
+cx_err_t cx_bn_is_zero(const cx_bn_t a, bool *zero) {
+    BIGNUM *v = bn_get(a);
+    if (v == NULL) return CX_INVALID_PARAMETER;
+    if (sim_zero_scalars) {
+        sim_zero_scalars--;
+        *zero = true;
+    } else {
+        *zero = BN_is_zero(v);
+    }
+    return CX_OK;
+}
+
+cx_err_t cx_bn_reduce(cx_bn_t r, const cx_bn_t d, const cx_bn_t n) {
+    BIGNUM *br = bn_get(r), *bd = bn_get(d), *bn = bn_get(n);
+    if (br == NULL || bd == NULL || bn == NULL) return CX_INVALID_PARAMETER;
+    return BN_nnmod(br, bd, bn, bn_ctx()) ? CX_OK : CX_INVALID_PARAMETER;
+}
+
+cx_err_t cx_bn_mod_mul(cx_bn_t r, const cx_bn_t a, const cx_bn_t b, const cx_bn_t m) {
+    BIGNUM *br = bn_get(r), *ba = bn_get(a), *bb = bn_get(b), *bm = bn_get(m);
+    if (br == NULL || ba == NULL || bb == NULL || bm == NULL) return CX_INVALID_PARAMETER;
+    return BN_mod_mul(br, ba, bb, bm, bn_ctx()) ? CX_OK : CX_INVALID_PARAMETER;
+}
+
+cx_err_t cx_bn_mod_sub(cx_bn_t r, const cx_bn_t a, const cx_bn_t b, const cx_bn_t n) {
+    BIGNUM *br = bn_get(r), *ba = bn_get(a), *bb = bn_get(b), *bn = bn_get(n);
+    if (br == NULL || ba == NULL || bb == NULL || bn == NULL) return CX_INVALID_PARAMETER;
+    return BN_mod_sub(br, ba, bb, bn, bn_ctx()) ? CX_OK : CX_INVALID_PARAMETER;
+}
+
+// Uniform in [0, n), drawn from cx_rng like the device does.
+cx_err_t cx_bn_rng(cx_bn_t r, const cx_bn_t n) {
+    BIGNUM *br = bn_get(r), *bn = bn_get(n);
+    if (br == NULL || bn == NULL || BN_is_zero(bn)) return CX_INVALID_PARAMETER;
+    unsigned char buf[64];
+    int len = BN_num_bytes(bn);
+    do {
+        cx_rng(buf, len);
+        BN_bin2bn(buf, len, br);
+        BN_mask_bits(br, BN_num_bits(bn));
+    } while (BN_cmp(br, bn) >= 0);
+    OPENSSL_cleanse(buf, sizeof(buf));
+    return CX_OK;
+}
+
+cx_err_t cx_ecdomain_parameter_bn(cx_curve_t cv, cx_curve_dom_param_t id, cx_bn_t p) {
+    BIGNUM *bp = bn_get(p);
+    if (bp == NULL) return CX_INVALID_PARAMETER;
+    if (cv != CX_CURVE_SECP256K1) return CX_EC_INVALID_CURVE;
+    switch (id) {
+    case CX_CURVE_PARAM_Order:
+        BN_copy(bp, EC_GROUP_get0_order(secp256k1()));
+        return CX_OK;
+    case CX_CURVE_PARAM_Field:
+        EC_GROUP_get_curve(secp256k1(), bp, NULL, NULL, bn_ctx());
+        return CX_OK;
+    default:
+        return CX_INVALID_PARAMETER;
+    }
+}
+
+// Points are kept affine, z is unused.
+cx_err_t cx_ecpoint_alloc(cx_ecpoint_t *P, cx_curve_t cv) {
+    cx_err_t error;
+    if (cv != CX_CURVE_SECP256K1) return CX_EC_INVALID_CURVE;
+    P->curve = cv;
+    CX_CHECK(cx_bn_alloc(&P->x, 32));
+    CX_CHECK(cx_bn_alloc(&P->y, 32));
+    CX_CHECK(cx_bn_alloc(&P->z, 32));
+end:
+    return error;
+}
+
+cx_err_t cx_ecdomain_generator_bn(cx_curve_t cv, cx_ecpoint_t *P) {
+    BIGNUM *x = bn_get(P->x), *y = bn_get(P->y);
+    if (x == NULL || y == NULL) return CX_INVALID_PARAMETER;
+    if (cv != CX_CURVE_SECP256K1 || P->curve != cv) return CX_EC_INVALID_CURVE;
+    EC_POINT_get_affine_coordinates(secp256k1(), EC_GROUP_get0_generator(secp256k1()), x, y,
+                                    bn_ctx());
+    return CX_OK;
+}
+
+unsigned sim_failing_scalar_mults;
+
+cx_err_t cx_ecpoint_rnd_scalarmul(cx_ecpoint_t *P, const uint8_t *k, size_t k_len) {
+    BIGNUM *x = bn_get(P->x), *y = bn_get(P->y);
+    if (x == NULL || y == NULL) return CX_INVALID_PARAMETER;
+    sim_stats.scalar_mults++;
+    if (sim_failing_scalar_mults) {
+        sim_failing_scalar_mults--;
+        return CX_INTERNAL_ERROR;
+    }
+    cx_err_t error = CX_INVALID_PARAMETER;
+    EC_POINT *pt = EC_POINT_new(secp256k1());
+    BIGNUM *bk = BN_bin2bn(k, k_len, BN_secure_new());
+    if (EC_POINT_set_affine_coordinates(secp256k1(), pt, x, y, bn_ctx()) &&
+        EC_POINT_mul(secp256k1(), pt, NULL, pt, bk, bn_ctx()) &&
+        EC_POINT_get_affine_coordinates(secp256k1(), pt, x, y, bn_ctx())) {
+        error = CX_OK;
+    }
+    BN_clear_free(bk);
+    EC_POINT_free(pt);
+    return error;
+}
+
+cx_err_t cx_ecpoint_compress(const cx_ecpoint_t *P, uint8_t *xy_compressed, size_t xy_compressed_len,
+                             uint32_t *sign) {
+    BIGNUM *y = bn_get(P->y);
+    if (y == NULL) return CX_INVALID_PARAMETER;
+    *sign = BN_is_odd(y);
+    return cx_bn_export(P->x, xy_compressed, xy_compressed_len);
+}
+
+/* ---------------------------------------------------------------------- */
+/* BIP32                                                                  */
+/* ---------------------------------------------------------------------- */
+
+static void bip32_master(uint8_t key[32], uint8_t chain[32]) {
+    uint8_t seed[64], I[64];
+    unsigned int len = sizeof(I);
+    PKCS5_PBKDF2_HMAC(SIM_MNEMONIC, strlen(SIM_MNEMONIC), (const uint8_t *) "mnemonic", 8, 2048,
+                      EVP_sha512(), sizeof(seed), seed);
+    HMAC(EVP_sha512(), "Bitcoin seed", 12, seed, sizeof(seed), I, &len);
+    memcpy(key, I, 32);
+    memcpy(chain, I + 32, 32);
+}
+
+static void bip32_ckd(uint8_t key[32], uint8_t chain[32], uint32_t index) {
+    uint8_t data[37], I[64];
+    unsigned int len = sizeof(I);
+    if (index & 0x80000000) {
+        data[0] = 0;
+        memcpy(data + 1, key, 32);
+    } else {
+        cx_ecfp_private_key_t pv;
+        cx_ecfp_public_key_t pub;
+        cx_ecfp_init_private_key(CX_CURVE_SECP256K1, key, 32, &pv);
+        cx_ecfp_generate_pair(CX_CURVE_SECP256K1, &pub, &pv, 1);
+        data[0] = (pub.W[64] & 1) ? 0x03 : 0x02;
+        memcpy(data + 1, pub.W + 1, 32);
+    }
+    data[33] = index >> 24;
+    data[34] = index >> 16;
+    data[35] = index >> 8;
+    data[36] = index;
+    HMAC(EVP_sha512(), chain, 32, data, sizeof(data), I, &len);
+    BIGNUM *il = BN_bin2bn(I, 32, NULL), *k = BN_bin2bn(key, 32, NULL);
+    BN_mod_add(k, k, il, EC_GROUP_get0_order(secp256k1()), bn_ctx());
+    bn_export(k, key, 32);
+    memcpy(chain, I + 32, 32);
+    BN_free(il);
+    BN_free(k);
+}
+
+static void bip32_derive(const uint32_t *path, unsigned int pathLength, unsigned char *privateKey,
+                         unsigned char *chain) {
+    static uint8_t master_key[32], master_chain[32];
+    static bool have_master;
+    uint8_t key[32], c[32];
+
+    if (!have_master) {
+        bip32_master(master_key, master_chain);
+        have_master = true;
+    }
+    memcpy(key, master_key, 32);
+    memcpy(c, master_chain, 32);
+    for (unsigned int i = 0; i < pathLength; i++) {
+        bip32_ckd(key, c, path[i]);
+    }
+    memcpy(privateKey, key, 32);
+    if (chain != NULL) memcpy(chain, c, 32);
+}
+
+void os_perso_derive_node_bip32(int curve, const uint32_t *path, unsigned int pathLength,
+                                unsigned char *privateKey, unsigned char *chain) {
+    (void) curve;
+    bip32_derive(path, pathLength, privateKey, chain);
+    sim_stats.derivations++;
+}
+
+void sim_public_key(const uint32_t *path, unsigned int len, uint8_t pub[33]) {
+    uint8_t key[32];
+    bip32_derive(path, len, key, NULL);
+    BIGNUM *d = BN_bin2bn(key, 32, NULL);
+    EC_POINT *pt = EC_POINT_new(secp256k1());
+    EC_POINT_mul(secp256k1(), pt, d, NULL, NULL, bn_ctx());
+    EC_POINT_point2oct(secp256k1(), pt, POINT_CONVERSION_COMPRESSED, pub, 33, bn_ctx());
+    EC_POINT_free(pt);
+    BN_free(d);
+}
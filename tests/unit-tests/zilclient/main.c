@@ -0,0 +1,280 @@
+// Runs the client library against a fake transport that answers like the
+// app does, and checks the frames it sends.
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zil_client.h"
+
+#define MAX_QUEUED 8
+
+typedef struct {
+    zil_transport_t base;
+    // Responses not read yet, oldest first.
+    uint8_t queue[MAX_QUEUED][ZIL_RESPONSE_MAX];
+    size_t queue_len[MAX_QUEUED];
+    unsigned head, count, max_count;
+
+    // Signing state, like the StreamData of the app.
+    bool streaming;
+    uint32_t key_index;
+    uint32_t host_bytes_left;
+    uint8_t txn[4096];
+    size_t txn_len;
+
+    // Scripted behaviour.
+    unsigned frames;
+    unsigned fail_frame;  // answer this frame with 0x6801, 0 for never
+    uint16_t final_sw;
+    unsigned empty_frames;
+} mock_device_t;
+
+static void respond(mock_device_t *m, const uint8_t *data, size_t len, uint16_t sw) {
+    assert(m->count < MAX_QUEUED);
+    unsigned slot = (m->head + m->count) % MAX_QUEUED;
+    if (len > 0) {
+        memcpy(m->queue[slot], data, len);
+    }
+    m->queue[slot][len] = sw >> 8;
+    m->queue[slot][len + 1] = sw & 0xFF;
+    m->queue_len[slot] = len + 2;
+    m->count++;
+    if (m->count > m->max_count) {
+        m->max_count = m->count;
+    }
+}
+
+static uint32_t u4le(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void sign_txn(mock_device_t *m, const uint8_t *data, size_t lc) {
+    size_t hdr = m->streaming ? 8 : 12;
+    if (lc < hdr) {
+        m->empty_frames++;
+        m->streaming = false;
+        respond(m, NULL, 0, 0x6801);
+        return;
+    }
+    if (!m->streaming) {
+        m->key_index = u4le(data);
+        data += 4;
+        m->txn_len = 0;
+    } else {
+        // A continuation is only read once the previous chunk was acked.
+        assert(m->host_bytes_left != 0);
+    }
+    uint32_t left = u4le(data);
+    uint32_t len = u4le(data + 4);
+    if (lc != hdr + len) {
+        m->streaming = false;
+        respond(m, NULL, 0, 0x6A87);
+        return;
+    }
+    assert(!m->streaming || m->host_bytes_left == left + len);
+    memcpy(m->txn + m->txn_len, data + 8, len);
+    m->txn_len += len;
+    m->host_bytes_left = left;
+
+    if (m->frames == m->fail_frame) {
+        m->streaming = false;
+        respond(m, NULL, 0, 0x6801);
+    } else if (left != 0) {
+        m->streaming = true;
+        respond(m, NULL, 0, ZIL_SW_OK);
+    } else {
+        // The review starts here: every earlier ack must have been read.
+        assert(m->count == 0);
+        m->streaming = false;
+        uint8_t sig[ZIL_SIG_LEN];
+        for (size_t i = 0; i < sizeof(sig); i++) {
+            sig[i] = m->txn[i % m->txn_len] ^ (uint8_t)m->key_index;
+        }
+        respond(m, sig, m->final_sw == ZIL_SW_OK ? sizeof(sig) : 0, m->final_sw);
+    }
+}
+
+static int mock_send(zil_transport_t *t, const uint8_t *apdu, size_t len) {
+    mock_device_t *m = (mock_device_t *)t;
+    assert(len >= 5 && apdu[0] == ZIL_CLA && apdu[4] == len - 5);
+    m->frames++;
+    switch (apdu[1]) {
+    case ZIL_INS_GET_VERSION: {
+        static const uint8_t version[3] = { 0, 5, 3 };
+        respond(m, version, sizeof(version), ZIL_SW_OK);
+        break;
+    }
+    case ZIL_INS_GET_TRANSPORT: {
+        // BLE with 32-byte segments.
+        static const uint8_t link[8] = { 2, 32, 0, 5, 3, 0, 255, 0 };
+        respond(m, link, sizeof(link), ZIL_SW_OK);
+        break;
+    }
+    case ZIL_INS_SIGN_TXN:
+        sign_txn(m, apdu + 5, len - 5);
+        break;
+    default:
+        respond(m, NULL, 0, 0x6D00);
+        break;
+    }
+    return 0;
+}
+
+static int mock_recv(zil_transport_t *t, uint8_t resp[ZIL_RESPONSE_MAX], size_t *len) {
+    mock_device_t *m = (mock_device_t *)t;
+    if (m->count == 0) {
+        return ZIL_ERR_IO;
+    }
+    memcpy(resp, m->queue[m->head], m->queue_len[m->head]);
+    *len = m->queue_len[m->head];
+    m->head = (m->head + 1) % MAX_QUEUED;
+    m->count--;
+    return 0;
+}
+
+static void mock_init(mock_device_t *m, unsigned max_inflight) {
+    memset(m, 0, sizeof(*m));
+    m->base.send = mock_send;
+    m->base.recv = mock_recv;
+    m->base.max_inflight = max_inflight;
+    m->final_sw = ZIL_SW_OK;
+}
+
+static bool short_reader(void *arg, uint8_t *buf, size_t len) {
+    size_t *avail = arg;
+    if (len > *avail) {
+        return false;
+    }
+    memset(buf, 0xAB, len);
+    *avail -= len;
+    return true;
+}
+
+static void test_version(void) {
+    mock_device_t m;
+    zil_client_t c;
+    mock_init(&m, 1);
+    zil_client_init(&c, &m.base);
+    uint8_t v[3];
+    assert(zil_get_version(&c, v) == 0);
+    assert(v[0] == 0 && v[1] == 5 && v[2] == 3);
+}
+
+static void test_link(void) {
+    mock_device_t m;
+    zil_client_t c;
+    mock_init(&m, 1);
+    zil_client_init(&c, &m.base);
+    zil_link_t link;
+    assert(zil_get_transport(&c, &link) == 0);
+    assert(link.media == 2 && link.segment == 32 && link.first_header == 5 &&
+           link.next_header == 3 && link.wrapper == 0 && link.max_data == 255);
+
+    // 5 + 8 + 221 bytes fill 4 HID segments exactly, one more byte of
+    // chunk takes a fifth.
+    zil_link_t hid = { 1, 64, 7, 5, 0, 255 };
+    assert(zil_link_chunk_len(&hid, ZIL_KEY_INDEX_LEN, 0) == 221);
+    // Small segments: the largest chunk whose last segment is full.
+    zil_link_t ble = { 2, 20, 5, 3, 0, 255 };
+    assert(zil_link_chunk_len(&ble, ZIL_KEY_INDEX_LEN, 0) == 240);
+    // Nothing known about the link.
+    zil_link_t nfc = { 3, 0, 0, 0, 0, 255 };
+    assert(zil_link_chunk_len(&nfc, ZIL_KEY_INDEX_LEN, 0) == ZIL_TXN_CHUNK_MAX);
+    // U2F: the first frame, 4 + 8 + 170 bytes, fills the 182 the device
+    // takes behind the wrapper.
+    zil_link_t u2f = { 7, 0, 7, 5, 73, 182 };
+    assert(zil_link_chunk_len(&u2f, ZIL_KEY_INDEX_LEN, 0) == 170);
+    // Less of it with a 6-component path, 1 + 24 bytes, or with both the
+    // offset and the checksum in every frame.
+    assert(zil_link_chunk_len(&u2f, 25, 0) == 149);
+    assert(zil_link_chunk_len(&u2f, ZIL_KEY_INDEX_LEN, ZIL_SIGN_TXN_OFFSETS | ZIL_SIGN_TXN_CHECKSUM) == 162);
+    assert(zil_link_chunk_len(&nfc, 25, ZIL_SIGN_TXN_CHECKSUM) == 255 - 25 - 12);
+    // The fields make the continuation frames longer too: 5 + 16 + 213
+    // bytes fill 4 HID segments.
+    assert(zil_link_chunk_len(&hid, ZIL_KEY_INDEX_LEN, ZIL_SIGN_TXN_OFFSETS | ZIL_SIGN_TXN_CHECKSUM) == 213);
+}
+
+static void test_stream(size_t txn_len, size_t chunk, unsigned window) {
+    mock_device_t m;
+    zil_client_t c;
+    mock_init(&m, 2);
+    zil_client_init(&c, &m.base);
+    c.chunk_len = chunk;
+    c.window = window;
+
+    uint8_t txn[4096];
+    for (size_t i = 0; i < txn_len; i++) {
+        txn[i] = (uint8_t)(i * 7 + 1);
+    }
+    uint8_t sig[ZIL_SIG_LEN];
+    assert(zil_sign_txn(&c, 5, txn, txn_len, sig) == 0);
+    assert(m.key_index == 5);
+    assert(m.txn_len == txn_len && memcmp(m.txn, txn, txn_len) == 0);
+    assert(m.frames == (txn_len + chunk - 1) / chunk);
+    assert(m.max_count <= window);
+    assert(m.count == 0);
+    assert(sig[0] == (txn[0] ^ 5));
+}
+
+static void test_device_error(unsigned window) {
+    mock_device_t m;
+    zil_client_t c;
+    mock_init(&m, 2);
+    zil_client_init(&c, &m.base);
+    c.chunk_len = 16;
+    c.window = window;
+    m.fail_frame = 3;
+
+    uint8_t txn[200] = { 0 }, sig[ZIL_SIG_LEN];
+    assert(zil_sign_txn(&c, 0, txn, sizeof(txn), sig) == 0x6801);
+    // Nothing may be left unread for the next command.
+    assert(m.count == 0);
+}
+
+static void test_rejected(void) {
+    mock_device_t m;
+    zil_client_t c;
+    mock_init(&m, 2);
+    zil_client_init(&c, &m.base);
+    m.final_sw = ZIL_SW_USER_REJECTED;
+
+    uint8_t txn[300] = { 0 }, sig[ZIL_SIG_LEN];
+    assert(zil_sign_txn(&c, 0, txn, sizeof(txn), sig) == ZIL_SW_USER_REJECTED);
+}
+
+static void test_short_source(void) {
+    mock_device_t m;
+    zil_client_t c;
+    mock_init(&m, 2);
+    zil_client_init(&c, &m.base);
+    c.chunk_len = 16;
+
+    size_t avail = 40;
+    uint8_t sig[ZIL_SIG_LEN];
+    assert(zil_sign_txn_cb(&c, 0, 100, short_reader, NULL, &avail, sig) == ZIL_ERR_SOURCE);
+    // The device was told to give up on the transaction.
+    assert(m.empty_frames == 1);
+    assert(!m.streaming && m.count == 0);
+}
+
+int main(void) {
+    static const size_t sizes[] = { 1, 15, 16, 17, 243, 244, 1000, 4096 };
+    static const size_t chunks[] = { 1, 16, ZIL_TXN_CHUNK_MAX };
+
+    test_version();
+    test_link();
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+        for (size_t j = 0; j < sizeof(chunks) / sizeof(*chunks); j++) {
+            test_stream(sizes[i], chunks[j], 1);
+            test_stream(sizes[i], chunks[j], 2);
+        }
+    }
+    test_device_error(1);
+    test_device_error(2);
+    test_rejected();
+    test_short_source();
+    printf("All zilclient tests passed\n");
+    return 0;
+}
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""Time the framing of large transactions into INS_SIGN_TXN payloads on the
+host: ChunkFramer, fresh and reused, against building every payload with
+pack() and byte concatenation as the client used to. No device needed.
+"""
+
+import sys
+import argparse
+import os
+import time
+
+from pathlib import Path
+from struct import pack
+from zlib import crc32
+
+REPO_ROOT_DIRECTORY = Path(__file__).parent
+ZILLIQA_LIB_DIRECTORY = (REPO_ROOT_DIRECTORY / "../tests/functional/apps").resolve().as_posix()
+sys.path.append(ZILLIQA_LIB_DIRECTORY)
+from framing import ChunkFramer
+
+KEY = pack("<I", 0)
+
+
+def concat_frames(key, transaction, stream_len, offsets, checksum):
+    """The payloads as pack(), concatenation and split_message made them."""
+    chunks = [transaction[x:x + stream_len] for x in range(0, len(transaction), stream_len)]
+    total_size = len(transaction)
+    sent_size = 0
+    crc = 0
+    for chunk in chunks:
+        payload = b""
+        if sent_size == 0:
+            payload += key
+        payload += pack("<I", total_size - sent_size - len(chunk))
+        payload += pack("<I", len(chunk))
+        if offsets:
+            payload += pack("<I", sent_size)
+        if checksum:
+            crc = crc32(chunk, crc)
+            payload += pack("<I", crc)
+        payload += chunk
+        sent_size += len(chunk)
+        yield payload, sent_size == total_size
+
+
+def best_of(runs, fn):
+    """The shortest time to get all the payloads of fn, as a client sending
+    them one after the other would."""
+    best = None
+    for _ in range(runs):
+        start = time.perf_counter()
+        for _ in fn():
+            pass
+        elapsed = time.perf_counter() - start
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+
+def main(args):
+    framer = ChunkFramer()
+    print("{:>8} {:>6} {:>8} {:>10} {:>10} {:>10}".format(
+        "size", "chunk", "frames", "concat", "framer", "reused"))
+    for size_kib in args.sizes:
+        transaction = os.urandom(size_kib * 1024)
+        for stream_len in args.stream_lens:
+            def concat():
+                return concat_frames(KEY, transaction, stream_len, args.offsets, args.checksum)
+
+            def fresh():
+                return ChunkFramer().frames(KEY, transaction, stream_len,
+                                            offsets=args.offsets, checksum=args.checksum)
+
+            def reused():
+                return framer.frames(KEY, transaction, stream_len,
+                                     offsets=args.offsets, checksum=args.checksum)
+
+            expected = list(concat())
+            if [(bytes(p), last) for p, last in reused()] != expected:
+                sys.exit("ChunkFramer and the reference disagree on {} KiB in chunks of {}"
+                         .format(size_kib, stream_len))
+            times = [best_of(args.runs, fn) for fn in (concat, fresh, reused)]
+            print("{:>7}K {:>6} {:>8} {:>9.1f}ms {:>9.1f}ms {:>9.1f}ms".format(
+                size_kib, stream_len, len(expected), *(t * 1000 for t in times)))
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--sizes", type=int, nargs="+", default=[64, 1024, 4096],
+                        help="transaction sizes, in KiB")
+    parser.add_argument("--stream-lens", type=int, nargs="+", default=[16, 243],
+                        help="chunk sizes")
+    parser.add_argument("--offsets", action="store_true", help="frame with P1_SIGN_TXN_OFFSETS")
+    parser.add_argument("--checksum", action="store_true", help="frame with P1_SIGN_TXN_CHECKSUM")
+    parser.add_argument("--runs", type=int, default=5, help="best of this many runs")
+    main(parser.parse_args())
@@ -0,0 +1,12 @@
+// Compiled with -S by "make context_sizes" to report the RAM footprint of
+// each command context. Never linked into the app.
+
+#include <stdint.h>
+#include "zilliqa_ux.h"
+
+const uint32_t ctx_size_getPublicKeyContext = sizeof(getPublicKeyContext_t);
+const uint32_t ctx_size_signHashContext = sizeof(signHashContext_t);
+const uint32_t ctx_size_signTxnContext = sizeof(signTxnContext_t);
+const uint32_t ctx_size_signEvmTxnContext = sizeof(signEvmTxnContext_t);
+const uint32_t ctx_size_addRecipientContext = sizeof(addRecipientContext_t);
+const uint32_t ctx_size_commandContext = sizeof(commandContext);
@@ -0,0 +1,55 @@
+#!/bin/sh
+#
+# Compare the flash and stack footprint of the trimmed nanopb build (the
+# default) against the full library (NANOPB_FULL=1) on every target.
+#
+# Needs the same SDK environment variables as build-all.sh; targets whose
+# variable is unset are skipped.
+#
+# Flash is the text+data of bin/app.elf. Stack is the sum of the frames on the
+# deepest decode path: a ProtoTransactionCoreInfo field nests one ByteArray
+# submessage whose bytes go to a callback, so pb_decode_noinit and
+# decode_static_field appear twice.
+
+DECODE_PATH="pb_decode pb_decode_noinit decode_static_field pb_dec_submessage pb_decode_noinit decode_static_field decode_callback_field pb_read"
+
+SIZE=${GCCPATH}arm-none-eabi-size
+RESULTS=$(mktemp)
+trap 'rm -f "$RESULTS"' EXIT
+
+decode_stack() {
+    find . -name '*.su' | xargs cat | awk -v path="$DECODE_PATH" '
+        { split($1, loc, ":"); frame[loc[4]] = $2 }
+        END {
+            n = split(path, fns, " ")
+            for (i = 1; i <= n; i++) total += frame[fns[i]]
+            print total
+        }'
+}
+
+measure() {
+    target=$1 sdk=$2 config=$3
+    shift 3
+    make clean > /dev/null
+    find . -name '*.su' -delete
+    if ! make BOLOS_SDK="$sdk" STACK_USAGE=1 "$@" > /dev/null; then
+        echo "build failed: $target $config" >&2
+        exit 1
+    fi
+    flash=$($SIZE bin/app.elf | awk 'NR == 2 { print $1 + $2 }')
+    echo "$target $config $flash $(decode_stack)" >> "$RESULTS"
+}
+
+for entry in nanos:$NANOS_SDK nanosp:$NANOSP_SDK nanox:$NANOX_SDK stax:$STAX_SDK; do
+    target=${entry%%:*}
+    sdk=${entry#*:}
+    [ -n "$sdk" ] || continue
+    measure "$target" "$sdk" full NANOPB_FULL=1
+    measure "$target" "$sdk" trimmed
+done
+
+awk '
+    BEGIN { printf "%-8s %12s %12s %12s %12s %12s %12s\n", "target", "flash full", "flash trim", "flash saved", "stack full", "stack trim", "stack saved" }
+    $2 == "full" { flash[$1] = $3; stack[$1] = $4; next }
+    { printf "%-8s %12d %12d %12d %12d %12d %12d\n", $1, flash[$1], $3, flash[$1] - $3, stack[$1], $4, stack[$1] - $4 }
+' "$RESULTS"
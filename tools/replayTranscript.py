@@ -0,0 +1,235 @@
+#!/usr/bin/env python3
+"""Replay an APDU transcript recorded with `pytest --transcript FILE` and
+compare the timing of every exchange with the recording.
+
+Targets:
+  speculos[:HOST:PORT]  the APDU port of a running Speculos (default
+                        127.0.0.1:9999). Reviews are approved through the
+                        Speculos REST API on Nano devices (--approve nano);
+                        use --approve none to approve by hand or on Stax.
+  exec:COMMAND          a program that speaks the Speculos APDU framing on
+                        stdin/stdout, such as a host-native build of zil_main
+                        that approves reviews by itself.
+  hid                   the first Ledger device on USB, through ragger's
+                        LedgerCommBackend. Reviews are approved by hand.
+"""
+
+import sys
+import argparse
+import json
+import shlex
+import socket
+import struct
+import subprocess
+import time
+import urllib.request
+
+from pathlib import Path
+
+REPO_ROOT_DIRECTORY = Path(__file__).parent
+ZILLIQA_LIB_DIRECTORY = (REPO_ROOT_DIRECTORY / "../tests/functional/apps").resolve().as_posix()
+sys.path.append(ZILLIQA_LIB_DIRECTORY)
+from transcript import read_exchanges
+
+# How long a review may take to show up and be approved.
+APPROVE_TIMEOUT = 60
+
+
+def read_exact(read, n):
+    buf = b""
+    while len(buf) < n:
+        chunk = read(n - len(buf))
+        if not chunk:
+            raise ConnectionError("target closed the connection")
+        buf += chunk
+    return buf
+
+
+def send_apdu(write, apdu):
+    write(struct.pack(">I", len(apdu)) + apdu)
+
+
+def read_response(read):
+    # The length does not count the status word.
+    (length,) = struct.unpack(">I", read_exact(read, 4))
+    return read_exact(read, length + 2)
+
+
+class SpeculosTarget:
+    def __init__(self, host, port, api, approve):
+        self._sock = socket.create_connection((host, port))
+        self._sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self._api = api.rstrip("/")
+        self._approve = approve
+
+    def _screen(self):
+        with urllib.request.urlopen(self._api + "/events?currentscreenonly=true") as r:
+            return [e["text"] for e in json.load(r)["events"]]
+
+    def _press(self, button):
+        request = urllib.request.Request(self._api + "/button/" + button,
+                                         data=json.dumps({"action": "press-and-release"}).encode(),
+                                         headers={"Content-Type": "application/json"})
+        urllib.request.urlopen(request).close()
+
+    def _approve_review(self, idle_screen):
+        # Wait for the review to replace the idle screen, scroll to its last
+        # step ("Cancel" or "Reject"), then go back one step and validate.
+        deadline = time.monotonic() + APPROVE_TIMEOUT
+        while self._screen() == idle_screen:
+            if time.monotonic() > deadline:
+                raise TimeoutError("no review showed up")
+            time.sleep(0.05)
+        while not {"Cancel", "Reject"} & set(self._screen()):
+            if time.monotonic() > deadline:
+                raise TimeoutError("could not reach the end of the review")
+            self._press("right")
+        self._press("left")
+        self._press("both")
+
+    def exchange(self, apdu, needs_user):
+        idle_screen = self._screen() if needs_user and self._approve == "nano" else None
+        send_apdu(self._sock.sendall, apdu)
+        if idle_screen is not None:
+            self._approve_review(idle_screen)
+        return read_response(self._sock.recv)
+
+    def close(self):
+        self._sock.close()
+
+
+class ExecTarget:
+    def __init__(self, command):
+        self._proc = subprocess.Popen(shlex.split(command), stdin=subprocess.PIPE,
+                                      stdout=subprocess.PIPE, bufsize=0)
+
+    def exchange(self, apdu, needs_user):
+        send_apdu(self._proc.stdin.write, apdu)
+        return read_response(self._proc.stdout.read)
+
+    def close(self):
+        self._proc.stdin.close()
+        self._proc.wait()
+
+
+class HidTarget:
+    def __init__(self):
+        # Only this target needs ragger.
+        from ragger.backend import LedgerCommBackend
+        from ragger.backend.interface import RaisePolicy
+        self._backend = LedgerCommBackend(None, interface="hid")
+        self._backend.raise_policy = RaisePolicy.RAISE_NOTHING
+        self._backend.__enter__()
+
+    def exchange(self, apdu, needs_user):
+        rapdu = self._backend.exchange_raw(apdu)
+        return bytes(rapdu.data) + struct.pack(">H", rapdu.status)
+
+    def close(self):
+        self._backend.__exit__(None, None, None)
+
+
+def open_target(args):
+    if args.target == "hid":
+        return HidTarget()
+    if args.target.startswith("exec:"):
+        return ExecTarget(args.target[len("exec:"):])
+    if args.target == "speculos":
+        return SpeculosTarget("127.0.0.1", 9999, args.api, args.approve)
+    if args.target.startswith("speculos:"):
+        host, port = args.target[len("speculos:"):].rsplit(":", 1)
+        return SpeculosTarget(host, int(port), args.api, args.approve)
+    raise SystemExit("unknown target " + args.target)
+
+
+def percentile(samples, pct):
+    if not samples:
+        return 0.0
+    ordered = sorted(samples)
+    return ordered[max(0, -(-len(ordered) * pct // 100) - 1)]
+
+
+def main(args):
+    with open(args.transcript, "rb") as f:
+        exchanges = read_exchanges(f)
+
+    def matches(r):
+        return r["sw_match"] and r["len_match"] and (r["data_match"] or not args.exact)
+
+    target = open_target(args)
+    results = []
+    label = None
+    try:
+        for i, ex in enumerate(exchanges):
+            t0 = time.perf_counter()
+            response = target.exchange(ex.command, ex.needs_user)
+            replay_us = (time.perf_counter() - t0) * 1e6
+            results.append({
+                "index": i,
+                "label": ex.label,
+                "ins": ex.command[1],
+                "needs_user": ex.needs_user,
+                "recorded_us": ex.latency_us,
+                "replay_us": round(replay_us),
+                "delta_us": round(replay_us) - ex.latency_us,
+                # Signatures use a fresh nonce, so only the status words and
+                # lengths have to match, unless both builds drew it from the
+                # seeded generator of TEST_RNG=1 (--exact).
+                "sw_match": response[-2:] == ex.response[-2:],
+                "len_match": len(response) == len(ex.response),
+                "data_match": response == ex.response,
+            })
+            r = results[-1]
+            if args.quiet:
+                continue
+            if ex.label != label:
+                label = ex.label
+                print("# " + (label or "(no label)"))
+            print("{:5d}  INS {:02x}{}  recorded {:10.3f} ms  replay {:10.3f} ms  delta {:+10.3f} ms{}".format(
+                i, r["ins"], " (user)" if ex.needs_user else "       ",
+                r["recorded_us"] / 1000, r["replay_us"] / 1000, r["delta_us"] / 1000,
+                "" if matches(r) else "  MISMATCH"))
+    finally:
+        target.close()
+
+    # Exchanges that wait for a review are dominated by the user, leave them
+    # out of the totals.
+    timed = [r for r in results if not r["needs_user"]]
+    deltas = [r["delta_us"] for r in timed]
+    summary = {
+        "exchanges": len(results),
+        "timed_exchanges": len(timed),
+        "recorded_total_us": sum(r["recorded_us"] for r in timed),
+        "replay_total_us": sum(r["replay_us"] for r in timed),
+        "delta_p50_us": percentile(deltas, 50),
+        "delta_p99_us": percentile(deltas, 99),
+        "mismatches": sum(1 for r in results if not matches(r)),
+    }
+    print("{exchanges} exchanges, {mismatches} mismatches; without reviews: recorded {rec:.3f} ms, "
+          "replay {rep:.3f} ms, delta p50 {p50:+.3f} ms, p99 {p99:+.3f} ms".format(
+              rec=summary["recorded_total_us"] / 1000, rep=summary["replay_total_us"] / 1000,
+              p50=summary["delta_p50_us"] / 1000, p99=summary["delta_p99_us"] / 1000, **summary))
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump({"summary": summary, "exchanges": results}, f, indent=2)
+            f.write("\n")
+    return 1 if summary["mismatches"] else 0
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('transcript', type=str)
+    parser.add_argument('--target', '-t', type=str, default="speculos")
+    parser.add_argument('--api', type=str, default="http://127.0.0.1:5000",
+                        help="Speculos REST API, used to approve reviews")
+    parser.add_argument('--approve', choices=["nano", "none"], default="nano")
+    parser.add_argument('--json', '-j', type=str, required=False,
+                        help="also write the results to this file")
+    parser.add_argument('--exact', '-e', action='store_true', required=False,
+                        help="responses must match byte for byte, for a recording and a "
+                             "target both built with TEST_RNG=1")
+    parser.add_argument('--quiet', '-q', action='store_true', required=False)
+    args = parser.parse_args()
+    sys.exit(main(args))
@@ -0,0 +1,183 @@
+#!/usr/bin/env python3
+"""Sign a batch of transactions over one connection to the device, e.g. a
+payout file, and write the signatures out as they come.
+
+Every line of the input is a JSON object with an "id", copied to the output,
+an optional "key" (a key index or a BIP32 path, --index otherwise) and the
+transaction, as one of:
+  "txn": hex           a serialized ProtoTransactionCoreInfo (INS_SIGN_TXN)
+  "evm": hex           an RLP-encoded EIP-155 or EIP-1559 transaction
+                       (INS_SIGN_EVM_TXN)
+  "toAddr", "amount", "gasPrice", "gasLimit", "nonce", "version",
+  "pubKey", "code", "data"
+                       the fields of a Zilliqa transaction, addresses and
+                       keys in hex and amounts in Qa (needs protobuf)
+
+Every line of the output is {"id", "signature" (hex), "ms", "apdus"}, or
+{"id", "error"} for a transaction that was rejected or could not be read;
+the batch goes on with the next one. Targets are those of
+replayTranscript.py: hid, speculos[:HOST:PORT] or exec:COMMAND.
+"""
+
+import sys
+import argparse
+import json
+import time
+
+from pathlib import Path
+
+REPO_ROOT_DIRECTORY = Path(__file__).parent
+ZILLIQA_LIB_DIRECTORY = (REPO_ROOT_DIRECTORY / "../tests/functional/apps").resolve().as_posix()
+sys.path.append(ZILLIQA_LIB_DIRECTORY)
+from framing import ChunkFramer, key_payload, max_stream_len
+from replayTranscript import open_target, percentile
+
+CLA = 0xE0
+INS_SIGN_TXN = 0x04
+INS_SIGN_EVM_TXN = 0x20
+SW_OK = 0x9000
+MAX_STREAM_LEN = 243
+
+FIELDS = ("toAddr", "amount", "gasPrice", "gasLimit", "nonce", "version", "pubKey", "code", "data")
+
+
+class BatchError(Exception):
+    pass
+
+
+def zilliqa_transaction(entry):
+    """Serialize the fields of a Zilliqa transaction, as ProtoTransactionCoreInfo."""
+    from txn_pb2 import ByteArray, ProtoTransactionCoreInfo
+
+    def qa(name):
+        return ByteArray(data=int(entry.get(name, 0)).to_bytes(16, byteorder="big"))
+
+    return ProtoTransactionCoreInfo(
+        version=int(entry.get("version", 0)),
+        nonce=int(entry.get("nonce", 0)),
+        toaddr=bytes.fromhex(entry["toAddr"].removeprefix("0x")),
+        senderpubkey=ByteArray(data=bytes.fromhex(entry.get("pubKey", "").removeprefix("0x"))),
+        amount=qa("amount"),
+        gasprice=qa("gasPrice"),
+        gaslimit=int(entry.get("gasLimit", 0)),
+        code=entry.get("code", "").encode(),
+        data=entry.get("data", "").encode(),
+    ).SerializeToString()
+
+
+def read_entry(entry, default_key):
+    """The INS, key and transaction of an input line."""
+    try:
+        key = entry.get("key", default_key)
+        if "txn" in entry:
+            ins, transaction = INS_SIGN_TXN, bytes.fromhex(entry["txn"].removeprefix("0x"))
+        elif "evm" in entry:
+            ins, transaction = INS_SIGN_EVM_TXN, bytes.fromhex(entry["evm"].removeprefix("0x"))
+        elif "toAddr" in entry:
+            ins, transaction = INS_SIGN_TXN, zilliqa_transaction(entry)
+        else:
+            raise BatchError("no txn, evm or toAddr")
+        unknown = set(entry) - {"id", "key", "txn", "evm"} - set(FIELDS)
+        if unknown:
+            raise BatchError("unknown fields " + ", ".join(sorted(unknown)))
+        key_payload(key)
+    except (TypeError, ValueError) as e:
+        raise BatchError(str(e)) from None
+    if not transaction:
+        raise BatchError("empty transaction")
+    return ins, key, transaction
+
+
+def sign(target, framer, ins, key, transaction, stream_len):
+    """Stream the transaction, and return its signature and the number of
+    APDUs it took."""
+    p1, key_bytes = key_payload(key)
+    # The first payload carries the key as well, and all must fit in an APDU.
+    stream_len = min(stream_len, max_stream_len(key_bytes))
+    apdus = 0
+    for payload, last in framer.frames(key_bytes, transaction, stream_len):
+        apdu = bytes([CLA, ins, p1, 0, len(payload)]) + payload
+        response = target.exchange(apdu, last)
+        apdus += 1
+        status = int.from_bytes(response[-2:], "big")
+        if status != SW_OK:
+            raise BatchError("SW {:04X}".format(status))
+        p1 = 0
+    return response[:-2], apdus
+
+
+def main(args):
+    source = sys.stdin if args.input == "-" else open(args.input)
+    target = open_target(args)
+    framer = ChunkFramer()
+    latencies = []
+    failures = 0
+    total_bytes = 0
+    total_apdus = 0
+    start = time.perf_counter()
+    try:
+        with source, open(args.output, "w") as out:
+            for number, line in enumerate(source, 1):
+                if not line.strip():
+                    continue
+                entry_id = number
+                try:
+                    try:
+                        entry = json.loads(line)
+                    except ValueError as e:
+                        raise BatchError("not JSON: {}".format(e)) from None
+                    if not isinstance(entry, dict):
+                        raise BatchError("not a JSON object")
+                    entry_id = entry.get("id", number)
+                    ins, key, transaction = read_entry(entry, args.index)
+                    t0 = time.perf_counter()
+                    signature, apdus = sign(target, framer, ins, key, transaction, args.stream_len)
+                    ms = (time.perf_counter() - t0) * 1000
+                    latencies.append(ms)
+                    total_bytes += len(transaction)
+                    total_apdus += apdus
+                    result = {"id": entry_id, "signature": signature.hex(), "ms": round(ms, 3),
+                              "apdus": apdus}
+                except BatchError as e:
+                    failures += 1
+                    result = {"id": entry_id, "error": str(e)}
+                    if not args.quiet:
+                        print("line {}: {}: {}".format(number, entry_id, e), file=sys.stderr)
+                out.write(json.dumps(result) + "\n")
+                # What was signed is on disk even if the batch stops here.
+                out.flush()
+    finally:
+        target.close()
+    elapsed = time.perf_counter() - start
+
+    signed = len(latencies)
+    print("{} signed, {} failed in {:.3f} s: {:.1f} signatures/s, {:.1f} KiB/s, {} APDUs".format(
+        signed, failures, elapsed, signed / elapsed if elapsed else 0.0,
+        total_bytes / 1024 / elapsed if elapsed else 0.0, total_apdus))
+    if latencies:
+        # Reviews included: on a device approved by hand, they are most of it.
+        print("latency: p50 {:.3f} ms, p90 {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms".format(
+            percentile(latencies, 50), percentile(latencies, 90), percentile(latencies, 99),
+            max(latencies)))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('input', type=str, help="JSONL transactions, - for stdin")
+    parser.add_argument('output', type=str, help="JSONL signatures")
+    parser.add_argument('--target', '-t', type=str, default="hid")
+    parser.add_argument('--api', type=str, default="http://127.0.0.1:5000",
+                        help="Speculos REST API, used to approve reviews")
+    parser.add_argument('--approve', choices=["nano", "none"], default="nano")
+    parser.add_argument('--index', '-i', type=int, default=0,
+                        help="key index of the transactions without a key")
+    parser.add_argument('--stream-len', type=int, default=MAX_STREAM_LEN,
+                        help="transaction bytes per APDU, at most {} (less with a BIP32 path)".format(
+                            MAX_STREAM_LEN))
+    parser.add_argument('--quiet', '-q', action='store_true', required=False)
+    args = parser.parse_args()
+    if not 0 < args.stream_len <= MAX_STREAM_LEN:
+        parser.error("--stream-len must be 1 to {}".format(MAX_STREAM_LEN))
+    sys.exit(main(args))
@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+"""Read the function call trace of a TRACE=1 build (see src/trace.h) and turn
+it into folded stacks for flamegraph.pl or speedscope, and a stack depth
+profile of the traced functions.
+
+The trace is read from a target with INS_DUMP_TRACE, after replaying an
+optional transcript so that it covers a known workload, or loaded from a
+dump saved earlier with --save. Targets are those of replayTranscript.py.
+
+Records carry function addresses; their names come from the symbols of
+--elf, the bin/app.elf of the same build. The address of
+__cyg_profile_func_enter in the dump tells where the app was loaded.
+
+Stacks are weighted by the ticks between events: the number of traced
+events unless the build defines ZIL_TRACE_CLOCK.
+"""
+
+import sys
+import argparse
+import bisect
+import json
+import subprocess
+import struct
+
+from collections import Counter, defaultdict
+
+CLA = 0xE0
+INS_DUMP_TRACE = 0xF0
+P1_TRACE_READ = 0x00
+P1_TRACE_CLEAR = 0x01
+
+# total, address of __cyg_profile_func_enter
+HEADER = struct.Struct("<II")
+# fn, tick, stack left, depth, kind
+RECORD = struct.Struct("<IIHBB")
+ENTER, EXIT = 0, 1
+
+REF_SYMBOL = "__cyg_profile_func_enter"
+
+
+def apdu(ins, p1, data=b""):
+    return bytes([CLA, ins, p1, 0, len(data)]) + data
+
+
+def check_sw(response):
+    sw = int.from_bytes(response[-2:], "big")
+    if sw != 0x9000:
+        raise SystemExit("INS_DUMP_TRACE failed with {:04x}, is this a TRACE=1 build?".format(sw))
+    return response[:-2]
+
+
+def clear(target):
+    check_sw(target.exchange(apdu(INS_DUMP_TRACE, P1_TRACE_CLEAR), False))
+
+
+def read_dump(target):
+    """Read every record kept, then clear the trace, which also resumes
+    tracing."""
+    records = []
+    total = ref = 0
+    while True:
+        data = check_sw(target.exchange(apdu(INS_DUMP_TRACE, P1_TRACE_READ,
+                                             struct.pack("<H", len(records))), False))
+        total, ref = HEADER.unpack_from(data)
+        page = data[HEADER.size:]
+        if not page:
+            break
+        records += [list(r) for r in RECORD.iter_unpack(page)]
+    clear(target)
+    return {"total": total, "ref": ref, "records": records}
+
+
+def replay(target, path):
+    from replayTranscript import read_exchanges
+    with open(path, "rb") as f:
+        for ex in read_exchanges(f):
+            target.exchange(ex.command, ex.needs_user)
+
+
+class Symbols:
+    def __init__(self, elf, ref):
+        out = subprocess.run(["nm", "-n", "--defined-only", elf], check=True,
+                             capture_output=True, text=True).stdout
+        self._addrs, self._names = [], []
+        ref_addr = None
+        for line in out.splitlines():
+            fields = line.split()
+            if len(fields) != 3 or fields[1] not in "tTwW":
+                continue
+            addr = int(fields[0], 16)
+            self._addrs.append(addr)
+            self._names.append(fields[2])
+            if fields[2] == REF_SYMBOL:
+                ref_addr = addr
+        if ref_addr is None:
+            raise SystemExit("{} has no {}, is it a TRACE=1 build?".format(elf, REF_SYMBOL))
+        # The device only keeps 32 bits of an address, and sets the lowest
+        # one for Thumb code.
+        self._offset = (ref - ref_addr) & 0xFFFFFFFF
+
+    def name(self, fn):
+        addr = (fn - self._offset) & 0xFFFFFFFE
+        i = bisect.bisect_right(self._addrs, addr) - 1
+        if i < 0:
+            return "0x{:08x}".format(fn)
+        return self._names[i]
+
+
+def fold(records, name):
+    """Weigh every stack by the ticks until the next event. A record knows
+    its depth, so the calls a THROW cut short drop off by themselves."""
+    folded = Counter()
+    stack = []
+    for prev, rec in zip(records, records[1:] + [None]):
+        fn, tick, _, depth, kind = prev
+        # The records of a wrapped buffer may start below unknown callers.
+        stack = stack[:depth] + ["?"] * (depth - len(stack))
+        if kind == ENTER:
+            stack.append(name(fn))
+        if rec is not None and stack:
+            folded[";".join(stack)] += (rec[1] - tick) & 0xFFFFFFFF
+    return folded
+
+
+def stack_profile(records, name):
+    calls = Counter()
+    min_left = {}
+    max_depth = defaultdict(int)
+    for fn, _, left, depth, kind in records:
+        f = name(fn)
+        if kind == ENTER:
+            calls[f] += 1
+        min_left[f] = min(left, min_left.get(f, left))
+        max_depth[f] = max(max_depth[f], depth)
+    return calls, min_left, max_depth
+
+
+def main(args):
+    if args.load:
+        with open(args.load) as f:
+            dump = json.load(f)
+    else:
+        from replayTranscript import open_target
+        target = open_target(args)
+        try:
+            if args.transcript:
+                clear(target)
+                replay(target, args.transcript)
+            dump = read_dump(target)
+        finally:
+            target.close()
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump(dump, f)
+            f.write("\n")
+
+    records = dump["records"]
+    if not records:
+        print("the trace is empty", file=sys.stderr)
+        return 1
+    if args.elf:
+        name = Symbols(args.elf, dump["ref"]).name
+    else:
+        def name(fn):
+            return "0x{:08x}".format(fn)
+
+    folded = fold(records, name)
+    out = open(args.output, "w") if args.output else sys.stdout
+    try:
+        for stack, ticks in sorted(folded.items()):
+            if ticks:
+                out.write("{} {}\n".format(stack, ticks))
+    finally:
+        if args.output:
+            out.close()
+
+    # The stack left when the outermost traced function was entered.
+    base = max([r[2] for r in records if r[4] == ENTER] or [records[0][2]])
+    calls, min_left, max_depth = stack_profile(records, name)
+    report = sys.stderr if not args.output else sys.stdout
+    print("{} events, {} kept; stack left at the outermost call {} bytes".format(
+        dump["total"], len(records), base), file=report)
+    print("{:>8} {:>10} {:>10} {:>6}  {}".format("calls", "min left", "used", "depth", "function"),
+          file=report)
+    for f in sorted(min_left, key=lambda f: min_left[f]):
+        print("{:8d} {:10d} {:10d} {:6d}  {}".format(calls[f], min_left[f], base - min_left[f],
+                                                     max_depth[f], f), file=report)
+    return 0
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--target', '-t', type=str, default="speculos")
+    parser.add_argument('--api', type=str, default="http://127.0.0.1:5000",
+                        help="Speculos REST API, used to approve reviews")
+    parser.add_argument('--approve', choices=["nano", "none"], default="nano")
+    parser.add_argument('--transcript', type=str, required=False,
+                        help="clear the trace and replay this transcript first")
+    parser.add_argument('--elf', '-e', type=str, required=False,
+                        help="bin/app.elf of the traced build, to name the functions")
+    parser.add_argument('--load', '-l', type=str, required=False,
+                        help="read the trace from a dump saved with --save")
+    parser.add_argument('--save', '-s', type=str, required=False,
+                        help="also write the raw trace to this file")
+    parser.add_argument('--output', '-o', type=str, required=False,
+                        help="write the folded stacks here rather than to stdout")
+    args = parser.parse_args()
+    sys.exit(main(args))